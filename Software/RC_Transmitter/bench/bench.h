@@ -0,0 +1,21 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Host benchmarks linked into one program (bench_main.cpp). Each takes the
+// command line after the program name, so argv[0] is the bench's own name
+// and its arguments follow as if it were a program of its own. Correctness
+// checks live in the unit tests under test/, these only time and report.
+int deltaBench(int argc, char** argv);
+int receiverBench(int argc, char** argv);
+int filterBench(int argc, char** argv);
+int mixerBench(int argc, char** argv);
+int trimBench(int argc, char** argv);
+int buttonBench(int argc, char** argv);
+int busBench(int argc, char** argv);
+int imuBench(int argc, char** argv);
+int codecBench(int argc, char** argv);
+int oledBench(int argc, char** argv);
+int mapperBench(int argc, char** argv);
+int profilerBench(int argc, char** argv);
+
+#endif
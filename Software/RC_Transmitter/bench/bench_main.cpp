@@ -0,0 +1,43 @@
+// Host benchmarks, all in one program:
+//
+//   program <bench> [arguments]
+//
+// Run without a name for the list of benches and their arguments.
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+
+struct Bench {
+  const char* name;
+  int (*run)(int argc, char** argv);
+  const char* usage;
+};
+
+static const Bench BENCHES[] = {
+  { "delta", deltaBench, "[trace_file] [frames]  delta against full frames under loss" },
+  { "receiver", receiverBench, "[frames] [period_us]  receiver frame-to-output latency" },
+  { "filter", filterBench, "[frames]  input filter chain cost per frame" },
+  { "mixer", mixerBench, "[frames]  mixer cost per frame, presets and a full matrix" },
+  { "trim", trimBench, "[idle_seconds]  trim button expander reads, idle and held" },
+  { "button", buttonBench, "[presses]  fast menu taps, debouncer against the old lockout" },
+  { "bus", busBench, "[seconds]  input latency on the I2C bus while the OLED streams" },
+  { "imu", imuBench, "[samples] [trace_file]  attitude filter cost per sample" },
+  { "codec", codecBench, "[frames]  frame encode and decode time, packed against raw" },
+  { "oled", oledBench, "[frames]  OLED bytes and CPU per frame, whole flush against page diff" },
+  { "mapper", mapperBench, "[samples]  stick mapping per sample, precomputed against map()" },
+  { "profiler", profilerBench, "[frames]  loop profiler phase timers, cost per frame" },
+};
+static const size_t BENCH_COUNT = sizeof(BENCHES) / sizeof(BENCHES[0]);
+
+int main(int argc, char** argv) {
+  for (size_t i = 0; argc > 1 && i < BENCH_COUNT; i++) {
+    if (strcmp(argv[1], BENCHES[i].name) == 0) return BENCHES[i].run(argc - 1, argv + 1);
+  }
+
+  fprintf(stderr, "usage: %s <bench> [arguments]\n", argv[0]);
+  for (size_t i = 0; i < BENCH_COUNT; i++) {
+    fprintf(stderr, "  %-10s %s\n", BENCHES[i].name, BENCHES[i].usage);
+  }
+  return 1;
+}
@@ -0,0 +1,195 @@
+// Input-read latency on the shared I2C bus while the OLED streams, on a
+// simulated bus with a timing model: 9 clocks per byte at 400 kHz plus a
+// fixed cost per transaction. Three clients run through BusArbiter
+// (bus_arbiter.h) as the firmware's tasks do:
+//   oled      back-to-back full-screen flushes, 8 pages of a window
+//             command and 31-byte data chunks (sendWindow)
+//   imu       a FIFO burst of 4 samples (48 bytes) every IMU_PERIOD_US, as
+//             the IMU task drains it; the 2-byte count read before it
+//             is left out
+//   expander  a 2-byte read after each INT, at random 2-20 ms intervals
+// The same load runs twice: once with the whole flush as one transaction,
+// as display() sends it, and once with the chunked flush, which lets the
+// reads in between chunks.
+//
+//   program bus [seconds]
+//
+// The grant order and latency bound are unit tests in test/test_bus_arbiter.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "bus_arbiter.h"
+#include "bench.h"
+
+static const uint32_t I2C_CLOCK_HZ = 400000;
+static const uint32_t TRANSACTION_OVERHEAD_US = 30;   // Driver setup, start and stop
+static const uint32_t IMU_PERIOD_US = 20000;
+static const uint8_t IMU_BURST_BYTES = 48;
+static const uint8_t OLED_PAGES = 8;
+static const uint8_t OLED_WIDTH = 128;
+static const uint8_t OLED_CHUNK = 31;
+static const uint8_t OLED_WINDOW_BYTES = 7;             // Control byte and 6 commands
+static const uint32_t EXPANDER_MIN_GAP_US = 2000;
+static const uint32_t EXPANDER_MAX_GAP_US = 20000;
+static const uint32_t DEFAULT_SECONDS = 10;
+static const uint32_t IDLE = 0xFFFFFFFF;
+
+// Address byte plus payload
+static uint32_t transferUs(uint32_t payload_bytes) {
+  return (uint32_t)((uint64_t)(payload_bytes + 1) * 9 * 1000000 / I2C_CLOCK_HZ) + TRANSACTION_OVERHEAD_US;
+}
+
+// Transactions of one full-screen flush
+static std::vector<uint32_t> flushTransactions(bool chunked) {
+  std::vector<uint32_t> durations;
+  if (!chunked) {
+    // Command header, then the whole buffer behind one control byte
+    durations.push_back(transferUs(OLED_WINDOW_BYTES + 1 + OLED_PAGES * OLED_WIDTH));
+    return durations;
+  }
+  for (uint8_t page = 0; page < OLED_PAGES; page++) {
+    durations.push_back(transferUs(OLED_WINDOW_BYTES));
+    for (uint16_t sent = 0; sent < OLED_WIDTH; sent += OLED_CHUNK) {
+      uint16_t chunk = OLED_WIDTH - sent < OLED_CHUNK ? OLED_WIDTH - sent : OLED_CHUNK;
+      durations.push_back(transferUs(chunk + 1));
+    }
+  }
+  return durations;
+}
+
+struct Client {
+  uint32_t next_request;     // IDLE for a client that never asks
+  uint32_t requested_at;
+  uint32_t duration;         // Of the outstanding transaction
+};
+
+struct Result {
+  uint32_t expander_reads;
+  uint32_t expander_max_us;
+  uint32_t expander_p99_us;
+  double expander_avg_us;
+  uint32_t imu_max_us;
+  uint32_t flushes;
+  BusDeviceStats stats[BUS_DEVICE_COUNT];
+};
+
+// Discrete-event run of all three clients over the arbiter
+static Result simulate(bool chunked, bool with_inputs, uint32_t duration_us) {
+  BusArbiter arbiter;
+  std::vector<uint32_t> flush = flushTransactions(chunked);
+  size_t flush_step = 0;
+  uint32_t random_state = 12345;
+
+  Client clients[BUS_DEVICE_COUNT];
+  clients[BUS_IMU].next_request = with_inputs ? 0 : IDLE;
+  clients[BUS_EXPANDER].next_request = with_inputs ? 700 : IDLE;
+  clients[BUS_OLED].next_request = 0;
+  bool outstanding[BUS_DEVICE_COUNT] = {};
+
+  Result result = {};
+  std::vector<uint32_t> expander_latency;
+  uint32_t imu_latency_max = 0;
+  uint32_t busy_until = 0;
+  uint32_t now = 0;
+
+  for (;;) {
+    // Next event: the transfer in flight ends or a client asks
+    uint32_t next = arbiter.currentOwner() != BUS_FREE ? busy_until : IDLE;
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      if (!outstanding[i] && clients[i].next_request < next) next = clients[i].next_request;
+    }
+    if (next == IDLE || next >= duration_us) break;
+    now = next;
+
+    uint8_t owner = arbiter.currentOwner();
+    if (owner != BUS_FREE && busy_until == now) {
+      Client& done = clients[owner];
+      uint32_t latency = now - done.requested_at;
+      outstanding[owner] = false;
+      if (owner == BUS_EXPANDER) {
+        expander_latency.push_back(latency);
+        random_state = random_state * 1103515245 + 12345;
+        done.next_request = now + EXPANDER_MIN_GAP_US +
+                            (random_state >> 8) % (EXPANDER_MAX_GAP_US - EXPANDER_MIN_GAP_US);
+      } else if (owner == BUS_IMU) {
+        if (latency > imu_latency_max) imu_latency_max = latency;
+        done.next_request = done.requested_at + IMU_PERIOD_US;
+        if (done.next_request < now) done.next_request = now;
+      } else {
+        flush_step = (flush_step + 1) % flush.size();
+        if (flush_step == 0) result.flushes++;
+        done.next_request = now;
+      }
+
+      uint8_t granted = arbiter.release(owner, now);
+      if (granted != BUS_FREE) busy_until = now + clients[granted].duration;
+    }
+
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      if (outstanding[i] || clients[i].next_request != now) continue;
+      outstanding[i] = true;
+      clients[i].requested_at = now;
+      clients[i].duration = i == BUS_OLED ? flush[flush_step]
+                          : i == BUS_IMU ? transferUs(IMU_BURST_BYTES + 1)
+                          : transferUs(2);
+      if (arbiter.request(i, now)) busy_until = now + clients[i].duration;
+    }
+  }
+
+  result.expander_reads = expander_latency.size();
+  if (!expander_latency.empty()) {
+    std::sort(expander_latency.begin(), expander_latency.end());
+    uint64_t total = 0;
+    for (size_t i = 0; i < expander_latency.size(); i++) total += expander_latency[i];
+    result.expander_avg_us = (double)total / expander_latency.size();
+    result.expander_max_us = expander_latency.back();
+    result.expander_p99_us = expander_latency[expander_latency.size() * 99 / 100];
+  }
+  result.imu_max_us = imu_latency_max;
+  for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+    result.stats[i] = arbiter.stats(i);
+  }
+  return result;
+}
+
+static void printResult(const char* name, const Result& result, uint32_t seconds) {
+  static const char* const DEVICE_NAMES[BUS_DEVICE_COUNT] = { "imu", "expander", "oled" };
+  printf("\n%s: %.1f flushes/s, %u expander reads\n", name, (double)result.flushes / seconds,
+         result.expander_reads);
+  printf("  expander latency avg=%.0f p99=%u max=%u us, imu max=%u us\n", result.expander_avg_us,
+         result.expander_p99_us, result.expander_max_us, result.imu_max_us);
+  for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+    const BusDeviceStats& stats = result.stats[i];
+    printf("  %-8s n=%-6lu busy=%5.1f%% hold max=%5lu us wait avg=%4lu max=%5lu us\n", DEVICE_NAMES[i],
+           (unsigned long)stats.transactions, 100.0 * stats.busy_us / (seconds * 1e6),
+           (unsigned long)stats.hold_max_us,
+           (unsigned long)(stats.transactions ? stats.wait_total_us / stats.transactions : 0),
+           (unsigned long)stats.wait_max_us);
+  }
+}
+
+int busBench(int argc, char** argv) {
+  uint32_t seconds = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_SECONDS;
+  if (seconds == 0 || seconds > 4000) {
+    fprintf(stderr, "usage: %s [seconds, up to 4000]\n", argv[0]);
+    return 1;
+  }
+  uint32_t duration_us = seconds * 1000000;
+
+  Result whole = simulate(false, true, duration_us);
+  Result chunked = simulate(true, true, duration_us);
+  Result alone = simulate(true, false, duration_us);
+  printResult("whole flush", whole, seconds);
+  printResult("chunked flush", chunked, seconds);
+
+  uint64_t busy_us = 0;
+  for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+    busy_us += chunked.stats[i].busy_us;
+  }
+  printf("\nchunked flush with no inputs: %.1f flushes/s\n", (double)alone.flushes / seconds);
+  printf("bus busy under input load: %.1f%%\n", 100.0 * busy_us / duration_us);
+  return 0;
+}
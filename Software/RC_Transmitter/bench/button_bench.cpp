@@ -0,0 +1,136 @@
+// Replays a burst of fast taps on the menu buttons (default 50, 8 per
+// second, alternating up and down) on a virtual millisecond clock and
+// counts the presses seen by the debouncer (button_events.h), ticked every
+// ButtonDebouncer::TICK_MS, and by the previous input path: a 10 ms poll
+// with one 200 ms lockout shared by all buttons.
+//
+//   program button [presses]
+//
+// The bounce, chord and repeat checks are unit tests in test/test_button_events.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "button_events.h"
+#include "bench.h"
+
+static const uint32_t DEFAULT_PRESSES = 50;
+static const uint32_t TAP_PERIOD_MS = 125;
+static const uint32_t TAP_LENGTH_MS = 60;
+static const uint32_t OLD_POLL_MS = 10;
+static const uint32_t OLD_LOCKOUT_MS = 200;
+
+// One pin change at a millisecond
+struct Edge {
+  uint32_t at_ms;
+  uint8_t button;
+  bool pressed;
+};
+
+struct Run {
+  std::vector<ButtonEvent> events;
+  std::vector<uint32_t> times;
+};
+
+static bool edgeBefore(const Edge& a, const Edge& b) { return a.at_ms < b.at_ms; }
+
+// Contact bounce: toggles every millisecond for bounce_ms, settling on pressed
+static void addEdge(std::vector<Edge>& edges, uint32_t at_ms, uint8_t button, bool pressed, uint32_t bounce_ms) {
+  for (uint32_t t = 0; t < bounce_ms; t++) {
+    Edge edge = { at_ms + t, button, (t % 2 == 0) == pressed };
+    edges.push_back(edge);
+  }
+  Edge edge = { at_ms + bounce_ms, button, pressed };
+  edges.push_back(edge);
+}
+
+// Replays edges for duration_ms and records every event with its tick
+static Run replay(std::vector<Edge> edges, uint32_t duration_ms) {
+  std::stable_sort(edges.begin(), edges.end(), edgeBefore);
+  ButtonEventQueue queue;
+  ButtonDebouncer debouncer(queue);
+
+  Run run;
+  uint8_t down = 0;
+  size_t next = 0;
+  for (uint32_t now = 0; now <= duration_ms; now++) {
+    while (next < edges.size() && edges[next].at_ms == now) {
+      uint8_t bit = 1 << edges[next].button;
+      down = edges[next].pressed ? down | bit : down & ~bit;
+      next++;
+    }
+    if (now % ButtonDebouncer::TICK_MS == 0) {
+      debouncer.tick(down);
+      ButtonEvent event;
+      while (queue.pop(event)) {
+        run.events.push_back(event);
+        run.times.push_back(now);
+      }
+    }
+  }
+  return run;
+}
+
+static uint32_t count(const Run& run, uint8_t button, uint8_t type) {
+  uint32_t total = 0;
+  for (size_t i = 0; i < run.events.size(); i++) {
+    if (run.events[i].button == button && run.events[i].type == type) total++;
+  }
+  return total;
+}
+
+// The input path this replaces: raw levels polled every 10 ms, an edge
+// only counts outside one 200 ms window shared by all buttons, and the
+// previous levels are only updated when the window has passed
+static uint32_t oldPathPresses(const std::vector<Edge>& sorted, uint32_t duration_ms) {
+  bool level[MENU_BUTTON_COUNT] = {};
+  bool prev[MENU_BUTTON_COUNT] = {};
+  uint32_t last_press = 0;
+  bool pressed_once = false;
+  uint32_t presses = 0;
+  size_t next = 0;
+
+  for (uint32_t now = 0; now <= duration_ms; now++) {
+    while (next < sorted.size() && sorted[next].at_ms == now) {
+      level[sorted[next].button] = sorted[next].pressed;
+      next++;
+    }
+    if (now % OLD_POLL_MS != 0) continue;
+    if (pressed_once && now - last_press < OLD_LOCKOUT_MS) continue;
+    for (uint8_t i = 0; i < MENU_BUTTON_COUNT; i++) {
+      if (level[i] && !prev[i]) {
+        presses++;
+        last_press = now;
+        pressed_once = true;
+      }
+      prev[i] = level[i];
+    }
+  }
+  return presses;
+}
+
+int buttonBench(int argc, char** argv) {
+  uint32_t presses = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_PRESSES;
+  if (presses == 0) {
+    fprintf(stderr, "usage: %s [presses]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<Edge> taps;
+  for (uint32_t i = 0; i < presses; i++) {
+    uint8_t button = i % 2 == 0 ? BUTTON_UP : BUTTON_DOWN;
+    addEdge(taps, 100 + i * TAP_PERIOD_MS, button, true, 3);
+    addEdge(taps, 100 + i * TAP_PERIOD_MS + TAP_LENGTH_MS, button, false, 3);
+  }
+  uint32_t duration = 200 + presses * TAP_PERIOD_MS;
+  Run run = replay(taps, duration);
+  std::stable_sort(taps.begin(), taps.end(), edgeBefore);
+  uint32_t debounced = count(run, BUTTON_UP, BUTTON_PRESS) + count(run, BUTTON_DOWN, BUTTON_PRESS);
+  uint32_t old_path = oldPathPresses(taps, duration);
+  printf("%u taps at %.0f/s, up and down in turn:\n", presses, 1000.0 / TAP_PERIOD_MS);
+  printf("  debouncer        %3u presses\n", debounced);
+  printf("  200 ms lockout   %3u presses\n", old_path);
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Measures the bit-packed frame codec (frame_codec.h) against sending the
+// ChannelData struct as it lies in memory: bytes on air per frame and
+// encode and decode time per frame over a trace of moving sticks (default
+// 1000000 frames).
+//
+//   program codec [frames]
+//
+// The round-trip, clamping and version checks are unit tests in
+// test/test_frame_codec.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "frame_codec.h"
+#include "bench.h"
+
+static const uint32_t DEFAULT_FRAMES = 1000000;
+static const uint32_t TRACE_FRAMES = 4096;
+
+// Sticks sweeping over their range, switches flipping now and then
+static void synthesize(std::vector<ChannelData>& trace) {
+  uint32_t state = 0x13579BD;
+  trace.resize(TRACE_FRAMES);
+  for (uint32_t f = 0; f < TRACE_FRAMES; f++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    ChannelData data = {};
+    data.throttle = (int16_t)(f % 1024) - 511;
+    data.pitch = (int16_t)(state % 1024) - 511;
+    data.roll = (int16_t)((state >> 10) % 1024) - 511;
+    data.yaw = (int16_t)((f * 7) % 1024) - 511;
+    data.aux1 = (int16_t)((state >> 20) % 1024) - 511;
+    data.aux2 = 0;
+    data.aux3 = (f >> 6) & 1;
+    data.aux7 = (int8_t)((f >> 8) % 3) - 1;
+    data.receiver_id = f & 7;
+    trace[f] = data;
+  }
+}
+
+static double seconds(std::chrono::steady_clock::time_point started) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+static double timeEncode(const std::vector<ChannelData>& trace, uint32_t frames) {
+  uint8_t frame[FRAME_SIZE];
+  volatile uint32_t sink = 0;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < frames; i++) {
+    encodeFrame(trace[i % TRACE_FRAMES], (uint8_t)i, frame);
+    sink = sink + frame[5];
+  }
+  (void)sink;
+  return seconds(started);
+}
+
+static double timeDecode(const std::vector<ChannelData>& trace, uint32_t frames) {
+  std::vector<uint8_t> frames_on_air(TRACE_FRAMES * FRAME_SIZE);
+  for (uint32_t i = 0; i < TRACE_FRAMES; i++) {
+    encodeFrame(trace[i], (uint8_t)i, &frames_on_air[i * FRAME_SIZE]);
+  }
+  ChannelData data = {};
+  uint8_t sequence;
+  volatile int32_t sink = 0;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < frames; i++) {
+    decodeFrame(&frames_on_air[(i % TRACE_FRAMES) * FRAME_SIZE], FRAME_SIZE, data, sequence);
+    sink = sink + data.pitch;
+  }
+  (void)sink;
+  return seconds(started);
+}
+
+// The struct as it was sent before the codec
+static double timeRawCopy(const std::vector<ChannelData>& trace, uint32_t frames) {
+  uint8_t frame[sizeof(ChannelData)];
+  ChannelData data = {};
+  volatile int32_t sink = 0;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < frames; i++) {
+    memcpy(frame, &trace[i % TRACE_FRAMES], sizeof(frame));
+    memcpy(&data, frame, sizeof(frame));
+    sink = sink + data.pitch;
+  }
+  (void)sink;
+  return seconds(started);
+}
+
+int codecBench(int argc, char** argv) {
+  uint32_t frames = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_FRAMES;
+  if (frames == 0) {
+    fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<ChannelData> trace;
+  synthesize(trace);
+  double encode = timeEncode(trace, frames);
+  double decode = timeDecode(trace, frames);
+  double raw = timeRawCopy(trace, frames);
+
+  printf("bytes on air: packed %u, raw struct %u\n", FRAME_SIZE, (unsigned)sizeof(ChannelData));
+  printf("%u frames on this host:\n", frames);
+  printf("  encode      %6.1f ns/frame  %6.2f M frames/s\n", encode * 1e9 / frames, frames / encode / 1e6);
+  printf("  decode      %6.1f ns/frame  %6.2f M frames/s\n", decode * 1e9 / frames, frames / decode / 1e6);
+  printf("  raw copy    %6.1f ns/frame, both ends\n", raw * 1e9 / frames);
+  return 0;
+}
@@ -0,0 +1,316 @@
+// Replays stick traces through the frame codecs and compares delta frames
+// (delta_codec.h) with sending every frame in full.
+//
+//   program delta [trace_file] [frames]
+//
+// trace_file holds lines as printed by the transmitter's 'T' command,
+// "trace,<ms>,throttle,pitch,roll,yaw,aux1..aux8"; other lines are skipped.
+// Without one a synthetic session of frames (default 200000) at 100 Hz is
+// replayed: sticks resting at centre with residual ADC noise, a manoeuvre
+// every few seconds, a throttle that ramps and holds, and a switch flip now
+// and then.
+//
+// Each case drops frames and ACKs independently at the given rates, and
+// restarts the receiver every RESTART_FRAMES frames, which loses its
+// history without the transmitter knowing. Reported per case:
+//   bytes/frame   average over the air, keyframes included
+//   stale         runs of frames after which the receiver's channels
+//                 differed from the transmitter's, mean and worst, in frames
+//                 and ms at the trace's frame spacing
+//   undecodable   frames that arrived but could not be decoded
+// followed by the encode and decode cost per frame on this host.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <delta_codec.h>
+#include "bench.h"
+
+static const uint32_t DEFAULT_FRAMES = 200000;
+static const uint32_t SYNTHETIC_PERIOD_MS = 10;
+static const uint32_t RESTART_FRAMES = 20000;
+static const uint8_t TIMING_PASSES = 20;
+
+struct LossCase {
+  uint8_t frame_loss;           // %
+  uint8_t ack_loss;             // % of delivered frames
+};
+
+static const LossCase LOSS_CASES[] = {{0, 0}, {5, 0}, {5, 5}, {20, 5}, {50, 10}};
+
+struct ReplayResult {
+  uint64_t bytes;
+  uint32_t frames;
+  uint32_t undecodable;
+  uint32_t keyframes;
+  uint32_t stale_runs;
+  uint64_t stale_frames;
+  uint32_t worst_stale;
+};
+
+// xorshift32, so every run replays the same losses
+class BenchRandom {
+private:
+  uint32_t state;
+
+public:
+  explicit BenchRandom(uint32_t seed) : state(seed ? seed : 1) {}
+
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  // Uniform in [0, range)
+  uint32_t below(uint32_t range) { return next() % range; }
+
+  bool percent(uint8_t chance) { return below(100) < chance; }
+};
+
+static int16_t clampChannel(int32_t value) {
+  if (value < -511) return -511;
+  if (value > 512) return 512;
+  return (int16_t)value;
+}
+
+static bool sameChannels(const ChannelData& a, const ChannelData& b) {
+  int16_t first[6], second[6];
+  analogChannels(a, first);
+  analogChannels(b, second);
+  return memcmp(first, second, sizeof(first)) == 0 && sameSwitches(a, b);
+}
+
+static bool loadTrace(const char* path, std::vector<ChannelData>& trace) {
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+
+  char line[160];
+  while (fgets(line, sizeof(line), file)) {
+    unsigned long ms;
+    int t, p, r, y, a1, a2, a7, a8;
+    unsigned a3, a4, a5, a6;
+    if (sscanf(line, "trace,%lu,%d,%d,%d,%d,%d,%d,%u,%u,%u,%u,%d,%d", &ms, &t, &p, &r, &y,
+               &a1, &a2, &a3, &a4, &a5, &a6, &a7, &a8) != 13) {
+      continue;
+    }
+    ChannelData data = {};
+    data.throttle = clampChannel(t);
+    data.pitch = clampChannel(p);
+    data.roll = clampChannel(r);
+    data.yaw = clampChannel(y);
+    data.aux1 = clampChannel(a1);
+    data.aux2 = clampChannel(a2);
+    data.aux3 = a3 & 1;
+    data.aux4 = a4 & 1;
+    data.aux5 = a5 & 1;
+    data.aux6 = a6 & 1;
+    data.aux7 = a7 < 0 ? -1 : (a7 > 0 ? 1 : 0);
+    data.aux8 = a8 < 0 ? -1 : (a8 > 0 ? 1 : 0);
+    data.timestamp = ms;
+    trace.push_back(data);
+  }
+  fclose(file);
+  return !trace.empty();
+}
+
+// What is left of ADC noise after oversampling: the odd count of flicker
+// after mapping
+static int16_t noise(BenchRandom& random) {
+  uint32_t draw = random.below(8);
+  return draw == 0 ? -1 : (draw == 1 ? 1 : 0);
+}
+
+static void synthesizeTrace(uint32_t frames, std::vector<ChannelData>& trace) {
+  BenchRandom random(0xC0FFEE);
+  int32_t throttle = -511, throttle_target = -511;
+  int32_t stick[3] = {0, 0, 0}, stick_target[3] = {0, 0, 0};
+  uint32_t manoeuvre_end = 0, next_manoeuvre = 300;
+  int32_t knob[2] = {-200, 300};
+  ChannelData data = {};
+
+  for (uint32_t i = 0; i < frames; i++) {
+    // Pitch, roll and yaw return to centre between manoeuvres
+    if (i == next_manoeuvre) {
+      for (uint8_t s = 0; s < 3; s++) {
+        stick_target[s] = (int32_t)random.below(801) - 400;
+      }
+      manoeuvre_end = i + 50 + random.below(150);
+      next_manoeuvre = manoeuvre_end + 200 + random.below(600);
+    } else if (i == manoeuvre_end) {
+      stick_target[0] = stick_target[1] = stick_target[2] = 0;
+    }
+    for (uint8_t s = 0; s < 3; s++) {
+      stick[s] += (stick_target[s] - stick[s]) / 8;
+    }
+
+    // Throttle ramps to a new level every 10 s or so and holds it
+    if (random.below(1000) == 0) throttle_target = (int32_t)random.below(1024) - 511;
+    if (throttle < throttle_target) throttle += throttle_target - throttle < 6 ? throttle_target - throttle : 6;
+    if (throttle > throttle_target) throttle -= throttle - throttle_target < 6 ? throttle - throttle_target : 6;
+
+    // Knobs are nudged rarely, switches flipped rarely
+    if (random.below(3000) == 0) knob[random.below(2)] += (int32_t)random.below(201) - 100;
+    if (random.below(2000) == 0) {
+      switch (random.below(6)) {
+        case 0: data.aux3 = !data.aux3; break;
+        case 1: data.aux4 = !data.aux4; break;
+        case 2: data.aux5 = !data.aux5; break;
+        case 3: data.aux6 = !data.aux6; break;
+        case 4: data.aux7 = (int8_t)random.below(3) - 1; break;
+        default: data.aux8 = (int8_t)random.below(3) - 1; break;
+      }
+    }
+
+    data.throttle = clampChannel(throttle + noise(random));
+    data.pitch = clampChannel(stick[0] + noise(random));
+    data.roll = clampChannel(stick[1] + noise(random));
+    data.yaw = clampChannel(stick[2] + noise(random));
+    data.aux1 = clampChannel(knob[0] + noise(random));
+    data.aux2 = clampChannel(knob[1] + noise(random));
+    data.timestamp = i * SYNTHETIC_PERIOD_MS;
+    trace.push_back(data);
+  }
+}
+
+// Median spacing of the trace timestamps
+static uint32_t tracePeriod(const std::vector<ChannelData>& trace) {
+  std::vector<uint32_t> spacings;
+  for (size_t i = 1; i < trace.size(); i++) {
+    if (trace[i].timestamp > trace[i - 1].timestamp) {
+      spacings.push_back(trace[i].timestamp - trace[i - 1].timestamp);
+    }
+  }
+  if (spacings.empty()) return SYNTHETIC_PERIOD_MS;
+  std::nth_element(spacings.begin(), spacings.begin() + spacings.size() / 2, spacings.end());
+  return spacings[spacings.size() / 2];
+}
+
+static ReplayResult replay(const std::vector<ChannelData>& trace, const LossCase& loss, bool delta) {
+  BenchRandom random(0x5EED + loss.frame_loss * 101 + loss.ack_loss);
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ReplayResult result = {};
+  ChannelData held = {};
+  bool holding = false;
+  uint32_t stale = 0;
+  uint8_t sequence = 0;
+
+  for (size_t i = 0; i < trace.size(); i++) {
+    if (i > 0 && i % RESTART_FRAMES == 0) {
+      decoder.reset();
+      holding = false;
+    }
+
+    uint8_t frame[FRAME_SIZE];
+    uint8_t length = delta ? encoder.encode(trace[i], sequence, frame)
+                           : encodeFrame(trace[i], sequence, frame);
+    if (!delta || !encoder.lastWasDelta()) result.keyframes++;
+    result.bytes += length;
+    result.frames++;
+    sequence++;
+
+    // The radio ACKs whatever arrives, decodable or not
+    if (!random.percent(loss.frame_loss)) {
+      ChannelData data;
+      uint8_t received;
+      if (decoder.decode(frame, length, data, received)) {
+        held = data;
+        holding = true;
+      } else {
+        result.undecodable++;
+      }
+      if (!random.percent(loss.ack_loss)) encoder.acknowledge();
+    }
+
+    if (holding && sameChannels(held, trace[i])) {
+      if (stale > 0) {
+        result.stale_runs++;
+        result.stale_frames += stale;
+        if (stale > result.worst_stale) result.worst_stale = stale;
+      }
+      stale = 0;
+    } else {
+      stale++;
+    }
+  }
+  return result;
+}
+
+// Nanoseconds per frame to encode, then decode, the trace without loss
+static void measureCost(const std::vector<ChannelData>& trace, bool delta,
+                        double& encode_ns, double& decode_ns) {
+  std::vector<uint8_t> frames(trace.size() * FRAME_SIZE);
+  std::vector<uint8_t> lengths(trace.size());
+  volatile uint32_t sink = 0;
+
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint8_t pass = 0; pass < TIMING_PASSES; pass++) {
+    DeltaEncoder encoder;
+    for (size_t i = 0; i < trace.size(); i++) {
+      uint8_t* frame = &frames[i * FRAME_SIZE];
+      lengths[i] = delta ? encoder.encode(trace[i], (uint8_t)i, frame)
+                         : encodeFrame(trace[i], (uint8_t)i, frame);
+      encoder.acknowledge();
+    }
+  }
+  std::chrono::steady_clock::time_point encoded = std::chrono::steady_clock::now();
+  for (uint8_t pass = 0; pass < TIMING_PASSES; pass++) {
+    DeltaDecoder decoder;
+    for (size_t i = 0; i < trace.size(); i++) {
+      ChannelData data;
+      uint8_t sequence;
+      bool ok = delta ? decoder.decode(&frames[i * FRAME_SIZE], lengths[i], data, sequence)
+                      : decodeFrame(&frames[i * FRAME_SIZE], lengths[i], data, sequence);
+      sink = sink + (ok ? data.throttle : 1);
+    }
+  }
+  std::chrono::steady_clock::time_point decoded = std::chrono::steady_clock::now();
+  (void)sink;
+
+  double count = (double)trace.size() * TIMING_PASSES;
+  encode_ns = std::chrono::duration<double, std::nano>(encoded - started).count() / count;
+  decode_ns = std::chrono::duration<double, std::nano>(decoded - encoded).count() / count;
+}
+
+int deltaBench(int argc, char** argv) {
+  std::vector<ChannelData> trace;
+  if (argc > 1 && strcmp(argv[1], "-") != 0) {
+    if (!loadTrace(argv[1], trace)) {
+      fprintf(stderr, "no trace lines in %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    synthesizeTrace(argc > 2 ? (uint32_t)atol(argv[2]) : DEFAULT_FRAMES, trace);
+  }
+  uint32_t period_ms = tracePeriod(trace);
+  printf("%s: %u frames, %u ms apart, receiver restart every %u frames\n",
+         argc > 1 && strcmp(argv[1], "-") != 0 ? argv[1] : "synthetic", (unsigned)trace.size(),
+         period_ms, RESTART_FRAMES);
+  printf("keyframe every %u frames, history %u frames\n\n", DELTA_KEYFRAME_INTERVAL, DELTA_HISTORY);
+
+  printf("loss%%  ack%%  codec  bytes/frame  keyframes  stale mean  stale worst      undecodable\n");
+  for (size_t c = 0; c < sizeof(LOSS_CASES) / sizeof(LOSS_CASES[0]); c++) {
+    for (uint8_t delta = 0; delta < 2; delta++) {
+      ReplayResult result = replay(trace, LOSS_CASES[c], delta != 0);
+      double mean = result.stale_runs ? (double)result.stale_frames / result.stale_runs : 0;
+      printf("%5u %5u  %-5s %12.2f %9.1f%% %7.2f fr %6u fr %6u ms %12u\n",
+             LOSS_CASES[c].frame_loss, LOSS_CASES[c].ack_loss, delta ? "delta" : "full",
+             (double)result.bytes / result.frames, 100.0 * result.keyframes / result.frames, mean,
+             result.worst_stale, result.worst_stale * period_ms, result.undecodable);
+    }
+  }
+
+  double encode_ns, decode_ns;
+  printf("\ncost per frame on this host:\n");
+  measureCost(trace, false, encode_ns, decode_ns);
+  printf("  full   encode %6.1f ns  decode %6.1f ns\n", encode_ns, decode_ns);
+  measureCost(trace, true, encode_ns, decode_ns);
+  printf("  delta  encode %6.1f ns  decode %6.1f ns\n", encode_ns, decode_ns);
+  return 0;
+}
@@ -0,0 +1,79 @@
+// Measures what the input filter chain (input_filter.h) costs per frame:
+// all six analog channels of noisy sticks (default 200000 frames) through
+// the default chain, with every stage on, with every stage switched off,
+// and through an empty pipeline.
+//
+//   program filter [frames]
+//
+// The step-response checks are unit tests in test/test_input_filter.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "input_filter.h"
+#include "bench.h"
+
+static const uint32_t PERIOD_US = 5000;     // Transmitter slot interval
+static const uint32_t DEFAULT_FRAMES = 200000;
+static const uint8_t CHANNELS = 6;
+static const uint8_t TIMING_PASSES = 10;
+
+static ChannelFilter makeFilter(uint8_t median, uint8_t smoothing, uint8_t deadband, uint16_t slew) {
+  ChannelFilter filter = { median, smoothing, deadband, 0, slew };
+  return filter;
+}
+
+// Sticks resting with ADC noise, the odd manoeuvre
+static void synthesize(uint32_t frames, std::vector<int16_t>& samples) {
+  uint32_t state = 0x1234567;
+  samples.resize((size_t)frames * CHANNELS);
+  for (uint32_t f = 0; f < frames; f++) {
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      int16_t base = (f / 400 + c) % 5 == 0 ? 300 : 0;
+      samples[(size_t)f * CHANNELS + c] = base + (int16_t)(state % 7) - 3;
+    }
+  }
+}
+
+// Nanoseconds to filter all channels of one frame
+template <class Filter>
+static double measure(const std::vector<int16_t>& samples, const ChannelFilter& settings) {
+  volatile int32_t sink = 0;
+  size_t frames = samples.size() / CHANNELS;
+
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint8_t pass = 0; pass < TIMING_PASSES; pass++) {
+    Filter filters[CHANNELS];
+    for (uint8_t c = 0; c < CHANNELS; c++) filters[c].configure(settings, PERIOD_US);
+    for (size_t f = 0; f < frames; f++) {
+      int32_t total = 0;
+      for (uint8_t c = 0; c < CHANNELS; c++) total += filters[c].apply(samples[f * CHANNELS + c]);
+      sink = sink + total;
+    }
+  }
+  std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+  (void)sink;
+  return std::chrono::duration<double, std::nano>(finished - started).count() / ((double)frames * TIMING_PASSES);
+}
+
+int filterBench(int argc, char** argv) {
+  uint32_t frames = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_FRAMES;
+  if (frames == 0) {
+    fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<int16_t> samples;
+  synthesize(frames, samples);
+  printf("cost per frame, %u channels, %u frames on this host:\n", CHANNELS, frames);
+  printf("  default chain   %6.1f ns\n", measure<InputFilter>(samples, makeFilter(1, 64, 2, 0)));
+  printf("  all stages on   %6.1f ns\n", measure<InputFilter>(samples, makeFilter(1, 64, 2, 2000)));
+  printf("  all stages off  %6.1f ns\n", measure<InputFilter>(samples, makeFilter(0, 0, 0, 0)));
+  printf("  empty pipeline  %6.1f ns\n", measure<FilterPipeline<> >(samples, makeFilter(0, 0, 0, 0)));
+  return 0;
+}
@@ -0,0 +1,151 @@
+// Times the fixed-point attitude filter (attitude_filter.h) per sample,
+// over a synthetic trace at IMU_SAMPLE_RATE (default 1000000 samples) of
+// the transmitter rocking with motor-like vibration, in the sensor's raw
+// units, or over a recorded one: a text file with one raw sample per line,
+// "ax,ay,az,gx,gy,gz" as read from the FIFO.
+//
+//   program imu [samples] [trace_file]
+//
+// The accuracy checks on synthetic traces are unit tests in
+// test/test_attitude_filter.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "attitude_filter.h"
+#include "mpu6050_fifo.h"
+#include "bench.h"
+
+static const uint32_t DEFAULT_SAMPLES = 1000000;
+static const double DEG = M_PI / 180;
+
+// Deterministic noise, roughly normal (sum of four uniforms)
+class Noise {
+private:
+  uint32_t state;
+
+public:
+  explicit Noise(uint32_t seed) : state(seed) {}
+
+  double next(double sigma) {
+    double total = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      state = state * 1664525u + 1013904223u;
+      total += (state >> 8) / 16777216.0 - 0.5;
+    }
+    return total * sigma * 1.732;
+  }
+};
+
+// Where the transmitter is at a moment, angles in radians, rates in rad/s,
+// plus any acceleration on top of gravity (in g, sensor axes)
+struct Pose {
+  double pitch, roll;
+  double pitch_rate, roll_rate;
+  double extra[3];
+};
+
+struct TraceSettings {
+  double gyro_bias_dps[3];
+  double accel_noise_g;
+  double gyro_noise_dps;
+  uint32_t seed;
+};
+
+static ImuSample sensorSample(const Pose& pose, const TraceSettings& settings, Noise& noise) {
+  double accel[3] = { -sin(pose.pitch), sin(pose.roll) * cos(pose.pitch), cos(pose.roll) * cos(pose.pitch) };
+  double rates[3] = { pose.roll_rate / DEG, pose.pitch_rate / DEG, 0 };
+  ImuSample sample;
+  for (uint8_t i = 0; i < 3; i++) {
+    double g = accel[i] + pose.extra[i] + noise.next(settings.accel_noise_g);
+    double dps = rates[i] + settings.gyro_bias_dps[i] + noise.next(settings.gyro_noise_dps);
+    sample.accel[i] = (int16_t)lround(g * AttitudeFilter::ACCEL_LSB_PER_G);
+    sample.gyro[i] = (int16_t)lround(dps * AttitudeFilter::GYRO_LSB_PER_DPS_X10 / 10);
+  }
+  return sample;
+}
+
+static double angleDegrees(int16_t angle) {
+  return angle * 360.0 / 65536;
+}
+
+static void rocking(double seconds, Pose& pose) {
+  double pitch_w = 2 * M_PI * 0.5;
+  double roll_w = 2 * M_PI * 0.3;
+  pose.pitch = 25 * DEG * sin(pitch_w * seconds);
+  pose.roll = 15 * DEG * sin(roll_w * seconds);
+  pose.pitch_rate = 25 * DEG * pitch_w * cos(pitch_w * seconds);
+  pose.roll_rate = 15 * DEG * roll_w * cos(roll_w * seconds);
+}
+
+// Rocking with vibration the motors of a model on the bench might shake
+// into the transmitter, aliased at the sample rate
+static void vibrating(double seconds, Pose& pose) {
+  rocking(seconds, pose);
+  pose.extra[0] = 0.25 * sin(2 * M_PI * 83 * seconds);
+  pose.extra[1] = 0.25 * sin(2 * M_PI * 71 * seconds + 1);
+  pose.extra[2] = 0.25 * sin(2 * M_PI * 97 * seconds + 2);
+}
+
+static const TraceSettings NOISY = { { 1.5, -0.8, 0.3 }, 0.02, 0.3, 11 };
+
+static bool loadTrace(const char* path, std::vector<ImuSample>& trace) {
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+  int values[6];
+  while (fscanf(file, "%d,%d,%d,%d,%d,%d", &values[0], &values[1], &values[2], &values[3], &values[4],
+                &values[5]) == 6) {
+    ImuSample sample;
+    for (uint8_t i = 0; i < 3; i++) {
+      sample.accel[i] = (int16_t)values[i];
+      sample.gyro[i] = (int16_t)values[3 + i];
+    }
+    trace.push_back(sample);
+  }
+  fclose(file);
+  return !trace.empty();
+}
+
+int imuBench(int argc, char** argv) {
+  uint32_t samples = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_SAMPLES;
+  if (samples == 0) {
+    fprintf(stderr, "usage: %s [samples] [trace_file]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<ImuSample> trace;
+  if (argc > 2) {
+    if (!loadTrace(argv[2], trace)) {
+      fprintf(stderr, "cannot read a trace from %s\n", argv[2]);
+      return 1;
+    }
+  } else {
+    Noise noise(NOISY.seed);
+    trace.resize(IMU_SAMPLE_RATE * 60);
+    for (size_t i = 0; i < trace.size(); i++) {
+      Pose pose = {};
+      vibrating((double)i / IMU_SAMPLE_RATE, pose);
+      trace[i] = sensorSample(pose, NOISY, noise);
+    }
+  }
+
+  AttitudeFilter filter(IMU_SAMPLE_RATE);
+  volatile int32_t sink = 0;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < samples; i++) {
+    filter.update(trace[i % trace.size()]);
+    sink = sink + filter.pitch();
+  }
+  std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+  (void)sink;
+  double ns = std::chrono::duration<double, std::nano>(finished - started).count() / samples;
+  printf("filter cost over %u samples of a %u-sample %s trace: %.1f ns/sample\n", samples,
+         (unsigned)trace.size(), argc > 2 ? "recorded" : "synthetic", ns);
+  printf("  %.1f us of CPU per second at %u Hz, last attitude %.2f/%.2f degrees\n",
+         ns * IMU_SAMPLE_RATE / 1000, IMU_SAMPLE_RATE, angleDegrees(filter.pitch()), angleDegrees(filter.roll()));
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Measures the precomputed stick mappers (channel_mapper.h) against the
+// map() calls they replaced: time per sample over a sweep of raw ADC values
+// through six calibrated channels (default 10000000 samples).
+//
+//   program mapper [samples]
+//
+// The bit-exactness checks are unit tests in test/test_channel_mapper.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "channel_mapper.h"
+#include "bench.h"
+
+static const uint32_t DEFAULT_SAMPLES = 10000000;
+static const uint8_t CHANNELS = 6;
+
+struct Calibration {
+  int16_t min_val;
+  int16_t mid_val;
+  int16_t max_val;
+  int16_t trim;
+};
+
+static const Calibration CALIBRATIONS[CHANNELS] = {
+  { 120, 2010, 3980, 0 }, { 95, 2060, 4010, 12 }, { 140, 1985, 3950, -7 },
+  { 80, 2040, 4020, 3 }, { 0, 2048, 4095, 0 }, { 300, 1900, 3700, 0 },
+};
+
+// map() as in the ESP32 Arduino core, kept out of line like the library call
+__attribute__((noinline))
+static long arduinoMap(long x, long in_min, long in_max, long out_min, long out_max) {
+  const long run = in_max - in_min;
+  if (run == 0) return -1;
+  const long rise = out_max - out_min;
+  const long delta = x - in_min;
+  return (delta * rise) / run + out_min;
+}
+
+static double seconds(std::chrono::steady_clock::time_point started) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+// The raw value of a sample, sweeping each channel at a different rate
+static uint16_t rawSample(uint32_t i, uint8_t channel) {
+  return (uint16_t)((i * (7 + channel * 2)) & 4095);
+}
+
+static double timeMap(uint32_t samples) {
+  volatile int32_t sink = 0;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < samples / CHANNELS; i++) {
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+      const Calibration& cal = CALIBRATIONS[c];
+      uint16_t raw = rawSample(i, c);
+      long mapped = raw < cal.mid_val ? arduinoMap(raw, cal.min_val, cal.mid_val, -511, 0)
+                                      : arduinoMap(raw, cal.mid_val, cal.max_val, 0, 512);
+      sink = sink + (int16_t)(mapped + cal.trim);
+    }
+  }
+  (void)sink;
+  return seconds(started);
+}
+
+static double timeMapper(uint32_t samples) {
+  ChannelMapper mappers[CHANNELS];
+  for (uint8_t c = 0; c < CHANNELS; c++) {
+    const Calibration& cal = CALIBRATIONS[c];
+    mappers[c].configure(cal.min_val, cal.mid_val, cal.max_val, cal.trim);
+  }
+  volatile int32_t sink = 0;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < samples / CHANNELS; i++) {
+    for (uint8_t c = 0; c < CHANNELS; c++) {
+      sink = sink + mappers[c].map(rawSample(i, c));
+    }
+  }
+  (void)sink;
+  return seconds(started);
+}
+
+int mapperBench(int argc, char** argv) {
+  uint32_t samples = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_SAMPLES;
+  if (samples < CHANNELS) {
+    fprintf(stderr, "usage: %s [samples]\n", argv[0]);
+    return 1;
+  }
+  samples -= samples % CHANNELS;
+
+  double mapped = timeMap(samples);
+  double mapper = timeMapper(samples);
+
+  printf("%u samples over %u channels on this host:\n", samples, CHANNELS);
+  printf("  map()          %6.2f ns/sample\n", mapped * 1e9 / samples);
+  printf("  ChannelMapper  %6.2f ns/sample  %.1fx\n", mapper * 1e9 / samples, mapped / (mapper > 0 ? mapper : 1e-9));
+  return 0;
+}
@@ -0,0 +1,105 @@
+// Measures what mixing a frame (mixer.h) costs: each preset and a full
+// matrix, every source into every output, the maximum the program holds,
+// half of the terms curved. Default 200000 frames.
+//
+//   program mixer [frames]
+//
+// The known-mix checks are unit tests in test/test_mixer.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "mixer.h"
+#include "bench.h"
+
+static const uint32_t DEFAULT_FRAMES = 200000;
+static const uint8_t TIMING_PASSES = 10;
+
+static ChannelData sticks(int16_t throttle, int16_t pitch, int16_t roll, int16_t yaw) {
+  ChannelData data = {};
+  data.throttle = throttle;
+  data.pitch = pitch;
+  data.roll = roll;
+  data.yaw = yaw;
+  data.aux1 = 123;
+  data.aux2 = -45;
+  return data;
+}
+
+static MixProgram preset(uint8_t index) {
+  MixProgram program;
+  program.compile(MIX_PRESETS[index].rules, MIX_PRESETS[index].rule_count);
+  return program;
+}
+
+// Every source into every output, weights spread over -100..100%
+static std::vector<MixRule> fullMatrix() {
+  std::vector<MixRule> rules;
+  for (uint8_t out = 0; out < MIX_OUTPUT_COUNT; out++) {
+    for (uint8_t source = 0; source < MIX_SOURCE_COUNT; source++) {
+      MixRule rule = { source, out, (int8_t)(((source * 7 + out * 13) % 21 - 10) * 10),
+                       (uint8_t)((source + out) % 2 ? (source % MIX_CURVE_COUNT) : MIX_NO_CURVE), 0 };
+      rules.push_back(rule);
+    }
+  }
+  return rules;
+}
+
+static void synthesize(uint32_t frames, std::vector<ChannelData>& trace) {
+  uint32_t state = 0x2468ACE;
+  trace.resize(frames);
+  for (uint32_t f = 0; f < frames; f++) {
+    int16_t values[6];
+    for (uint8_t c = 0; c < 6; c++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      values[c] = (int16_t)(state % 1024) - 511;
+    }
+    ChannelData data = sticks(values[0], values[1], values[2], values[3]);
+    data.aux1 = values[4];
+    data.aux2 = values[5];
+    data.aux3 = state & 1;
+    data.aux7 = (int8_t)(state % 3) - 1;
+    trace[f] = data;
+  }
+}
+
+// Nanoseconds to mix one frame
+static double measure(const MixProgram& program, const std::vector<ChannelData>& trace) {
+  volatile int32_t sink = 0;
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (uint8_t pass = 0; pass < TIMING_PASSES; pass++) {
+    for (size_t i = 0; i < trace.size(); i++) {
+      ChannelData data = trace[i];
+      program.apply(data);
+      sink = sink + data.pitch + data.aux2;
+    }
+  }
+  std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+  (void)sink;
+  return std::chrono::duration<double, std::nano>(finished - started).count() / ((double)trace.size() * TIMING_PASSES);
+}
+
+int mixerBench(int argc, char** argv) {
+  uint32_t frames = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_FRAMES;
+  if (frames == 0) {
+    fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<ChannelData> trace;
+  synthesize(frames, trace);
+  printf("cost per frame, %u frames on this host:\n", frames);
+  for (uint8_t i = 0; i < MIX_PRESET_COUNT; i++) {
+    MixProgram program = preset(i);
+    printf("  %-13s %2u terms %6.1f ns\n", MIX_PRESETS[i].name, program.termCount(), measure(program, trace));
+  }
+  std::vector<MixRule> rules = fullMatrix();
+  MixProgram full;
+  full.compile(&rules[0], (uint8_t)rules.size());
+  printf("  %-13s %2u terms %6.1f ns\n", "full matrix", full.termCount(), measure(full, trace));
+  return 0;
+}
@@ -0,0 +1,107 @@
+// Bytes on the I2C bus and CPU per frame for the OLED refresh, flushing
+// every page whole as display() did against sending only the column window
+// of each page that changed (framebuffer_diff.h). Frames are synthetic
+// 128x64 screens (default 10000 frames each):
+//   static    nothing changes, as a menu left alone
+//   live      three 4-digit readouts on separate pages change every frame
+//   menu      the cursor moves to another line every 10th frame
+//   full      every byte changes, the worst case for the diff
+// Bytes follow sendWindow(): 8 for the page and column window, then 2 per
+// chunk of up to 31 data bytes. Bus time is at 400 kHz, 9 clocks per byte.
+//
+//   program oled [frames]
+//
+// The window checks are unit tests in test/test_framebuffer_diff.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "framebuffer_diff.h"
+#include "bench.h"
+
+static const uint8_t WIDTH = 128;
+static const uint8_t HEIGHT = 64;
+static const uint8_t PAGES = HEIGHT / 8;
+static const uint8_t CHUNK = 31;
+static const uint32_t I2C_CLOCK_HZ = 400000;
+static const uint32_t DEFAULT_FRAMES = 10000;
+
+enum Screen { SCREEN_STATIC, SCREEN_LIVE, SCREEN_MENU, SCREEN_FULL, SCREEN_COUNT };
+static const char* const SCREEN_NAMES[SCREEN_COUNT] = { "static", "live", "menu", "full" };
+
+static uint32_t windowBytes(uint8_t first, uint8_t last) {
+  uint16_t length = last - first + 1;
+  return 8 + length + (length + CHUNK - 1) / CHUNK * 2;
+}
+
+// A 6-column glyph per digit
+static void drawNumber(uint8_t* frame, uint8_t page, uint8_t column, uint32_t value) {
+  for (uint8_t digit = 0; digit < 4; digit++) {
+    uint8_t d = value % 10;
+    value /= 10;
+    for (uint8_t x = 0; x < 5; x++) {
+      frame[page * WIDTH + column + (3 - digit) * 6 + x] = (uint8_t)((d + 1) * (x + 3)) | 0x01;
+    }
+  }
+}
+
+static void drawFrame(uint8_t* frame, Screen screen, uint32_t index) {
+  switch (screen) {
+    case SCREEN_STATIC:
+      break;
+    case SCREEN_LIVE:
+      drawNumber(frame, 2, 60, index % 10000);
+      drawNumber(frame, 4, 60, (index * 7) % 10000);
+      drawNumber(frame, 6, 60, 5000 + index % 37);
+      break;
+    case SCREEN_MENU: {
+      uint8_t line = 2 + (index / 10) % 6;
+      for (uint8_t page = 2; page < PAGES; page++) {
+        memset(frame + page * WIDTH, page == line ? 0x3E : 0x00, 12);
+      }
+      break;
+    }
+    default:
+      for (uint16_t i = 0; i < WIDTH * PAGES; i++) frame[i] = (uint8_t)(i + index * 13);
+      break;
+  }
+}
+
+int oledBench(int argc, char** argv) {
+  uint32_t frames = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_FRAMES;
+  if (frames == 0) {
+    fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t full_bytes = PAGES * windowBytes(0, WIDTH - 1);
+  printf("%u frames per screen on this host, whole flush %u bytes (%.1f ms of bus)\n", frames, full_bytes,
+         full_bytes * 9 * 1000.0 / I2C_CLOCK_HZ);
+  printf("  screen    bytes/frame   bus/frame   diff cpu/frame\n");
+  for (uint8_t s = 0; s < SCREEN_COUNT; s++) {
+    static uint8_t frame[WIDTH * PAGES];
+    for (uint16_t i = 0; i < sizeof(frame); i++) frame[i] = (uint8_t)(i * 37);
+    FramebufferDiff<WIDTH, HEIGHT> diff;
+    uint64_t bytes = 0;
+    double diff_ns = 0;
+
+    for (uint32_t f = 0; f < frames; f++) {
+      drawFrame(frame, (Screen)s, f);
+      std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+      uint32_t frame_bytes = 0;
+      for (uint8_t page = 0; page < PAGES; page++) {
+        uint8_t first, last;
+        if (diff.takeDirtyRange(frame, page, first, last)) frame_bytes += windowBytes(first, last);
+      }
+      diff_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+      // The first pass sends everything on either path
+      if (f > 0) bytes += frame_bytes;
+    }
+    double per_frame = frames > 1 ? (double)bytes / (frames - 1) : 0;
+    printf("  %-8s %9.1f   %7.3f ms   %8.1f ns\n", SCREEN_NAMES[s], per_frame,
+           per_frame * 9 * 1000.0 / I2C_CLOCK_HZ, diff_ns / frames);
+  }
+  return 0;
+}
@@ -0,0 +1,195 @@
+// Measures the receiver's frame-to-output path on the host: the same
+// ReceiverEndpoint and LatestValue hand-off the firmware runs, with a
+// radio thread and an output thread in place of the two tasks.
+//
+//   program receiver [frames] [period_us]
+//
+// The radio thread encodes a stick sweep with the transmitter's
+// DeltaEncoder, stamps each frame as the IRQ would, decodes it and
+// publishes the pulses; the output thread wakes on a notification, takes
+// the newest pulses and records how long after the stamp it got them.
+// Reported:
+//   frame->output   stamp to pulses in hand, mean, p99 and worst
+//   pulse start     plus the wait for the next output period at 50 and
+//                   400 Hz, where a new pulse width takes effect
+//   failsafe        silence after the last frame until failsafe pulses
+//                   reached the output thread, against the timeout
+//
+// Host scheduling stands in for FreeRTOS, so absolute figures are only
+// indicative; the firmware reports its own with the 's' command.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <delta_codec.h>
+#include <receiver_endpoint.h>
+#include "latest_value.h"
+#include "bench.h"
+
+static const uint32_t DEFAULT_FRAMES = 2000;
+static const uint32_t DEFAULT_PERIOD_US = 2000;
+static const uint16_t OUTPUT_RATES_HZ[] = {50, 400};
+
+typedef std::chrono::steady_clock Clock;
+
+struct OutputFrame {
+  uint16_t pulse_us[RECEIVER_MAX_OUTPUTS];
+  uint32_t arrival_us;
+};
+
+// The output task's notification
+class Notifier {
+private:
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool pending;
+
+public:
+  Notifier() : pending(false) {}
+
+  void give() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = true;
+    condition.notify_one();
+  }
+
+  void take() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!pending) condition.wait(lock);
+    pending = false;
+  }
+};
+
+static Clock::time_point started;
+static LatestValue<OutputFrame> latest_outputs;
+static Notifier output_notifier;
+static std::vector<uint32_t> latencies;
+static std::vector<uint32_t> ready_times;   // When the output thread had the pulses
+static uint32_t failsafe_seen_us = 0;
+static std::atomic<bool> stopping(false);
+
+static uint32_t elapsedUs() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - started).count();
+}
+
+static void outputThread() {
+  uint16_t written[RECEIVER_MAX_OUTPUTS] = {};
+  while (!stopping) {
+    output_notifier.take();
+    OutputFrame frame;
+    if (!latest_outputs.read(frame)) continue;
+    uint32_t now_us = elapsedUs();
+    memcpy(written, frame.pulse_us, sizeof(written));
+    if (frame.arrival_us != 0) {
+      latencies.push_back(now_us - frame.arrival_us);
+      ready_times.push_back(now_us);
+    } else if (failsafe_seen_us == 0) {
+      failsafe_seen_us = now_us;
+    }
+  }
+}
+
+static void publish(const ReceiverEndpoint& endpoint, const ReceiverSettings& settings, uint32_t arrival_us) {
+  OutputFrame frame;
+  endpoint.outputs(settings, frame.pulse_us);
+  frame.arrival_us = arrival_us;
+  latest_outputs.publish(frame);
+  output_notifier.give();
+}
+
+static uint32_t percentile(std::vector<uint32_t> values, uint8_t pct) {
+  if (values.empty()) return 0;
+  size_t index = (values.size() - 1) * pct / 100;
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+int receiverBench(int argc, char** argv) {
+  uint32_t frames = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_FRAMES;
+  uint32_t period_us = argc > 2 ? (uint32_t)atol(argv[2]) : DEFAULT_PERIOD_US;
+  if (frames == 0 || period_us == 0) {
+    fprintf(stderr, "usage: %s [frames] [period_us]\n", argv[0]);
+    return 1;
+  }
+
+  ReceiverSettings settings;
+  defaultReceiverSettings(settings);
+  settings.hopping = 0;
+  ReceiverEndpoint endpoint;
+  endpoint.bind(BASE_PIPES[0]);
+  DeltaEncoder encoder;
+
+  started = Clock::now();
+  std::thread output(outputThread);
+  latencies.reserve(frames);
+  ready_times.reserve(frames);
+
+  Clock::time_point next = Clock::now();
+  uint32_t last_arrival_us = 0;
+  for (uint32_t i = 0; i < frames; i++) {
+    ChannelData data = {};
+    data.throttle = (int16_t)(i % 1024) - 511;
+    data.pitch = (int16_t)((i * 7) % 1024) - 511;
+    data.aux3 = (i / 500) & 1;
+
+    uint8_t frame[FRAME_SIZE];
+    uint8_t length = encoder.encode(data, (uint8_t)i, frame);
+    encoder.acknowledge();
+
+    next += std::chrono::microseconds(period_us);
+    std::this_thread::sleep_until(next);
+
+    // Stamped where the IRQ would be
+    uint32_t arrival_us = elapsedUs();
+    uint8_t events = endpoint.onFrame(frame, length, arrival_us, arrival_us / 1000);
+    events |= endpoint.poll(settings, arrival_us / 1000);
+    if (events & RECEIVER_DATA) publish(endpoint, settings, arrival_us);
+    last_arrival_us = arrival_us;
+  }
+
+  // Silence: the radio task keeps polling once a millisecond
+  while (endpoint.state() != RECEIVER_IN_FAILSAFE) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (endpoint.poll(settings, elapsedUs() / 1000) & RECEIVER_FAILSAFE) {
+      publish(endpoint, settings, 0);
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  stopping = true;
+  output_notifier.give();
+  output.join();
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < latencies.size(); i++) total += latencies[i];
+  uint32_t worst = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+  printf("%u frames %u us apart, %u reached the outputs\n", frames, period_us, (unsigned)latencies.size());
+  printf("frame->output  mean=%.1f p99=%u max=%u us\n",
+         latencies.empty() ? 0 : (double)total / latencies.size(), percentile(latencies, 99), worst);
+
+  // A new duty takes effect at the next period boundary
+  for (size_t r = 0; r < sizeof(OUTPUT_RATES_HZ) / sizeof(OUTPUT_RATES_HZ[0]); r++) {
+    uint32_t output_period_us = 1000000UL / OUTPUT_RATES_HZ[r];
+    std::vector<uint32_t> starts;
+    starts.reserve(latencies.size());
+    for (size_t i = 0; i < latencies.size(); i++) {
+      starts.push_back(latencies[i] + output_period_us - ready_times[i] % output_period_us);
+    }
+    uint64_t start_total = 0;
+    for (size_t i = 0; i < starts.size(); i++) start_total += starts[i];
+    printf("pulse start @%3u Hz  mean=%.0f p99=%u max=%u us\n", OUTPUT_RATES_HZ[r],
+           starts.empty() ? 0 : (double)start_total / starts.size(), percentile(starts, 99),
+           starts.empty() ? 0 : *std::max_element(starts.begin(), starts.end()));
+  }
+
+  printf("failsafe after %.1f ms of silence (timeout %u ms)\n",
+         failsafe_seen_us ? (failsafe_seen_us - last_arrival_us) / 1000.0 : -1.0, settings.failsafe_ms);
+  return failsafe_seen_us ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// Counts PCF8575 reads by the interrupt-driven trim-button reader
+// (trim_buttons.h) on a virtual millisecond clock, with the reader
+// serviced at the UI task's 10 ms period: while the buttons rest
+// (default 60 s), while one is held, and against reading every UI step.
+//
+//   program trim [idle_seconds]
+//
+// The bounce, repeat and queue checks are unit tests in test/test_trim_buttons.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "trim_buttons.h"
+#include "bench.h"
+
+static const uint32_t SERVICE_MS = 10;       // UI task period
+static const uint32_t DEFAULT_IDLE_S = 60;
+
+// PCF8575 stand-in: pins idle high, INT fires on every change and a read
+// returns all 16 pins
+class MockExpander {
+private:
+  uint16_t levels;
+  uint32_t read_count;
+
+public:
+  TrimButtonReader<MockExpander>* reader;
+
+  MockExpander() : levels(0xFFFF), read_count(0), reader(NULL) {}
+
+  uint16_t readAll() {
+    read_count++;
+    return levels;
+  }
+
+  void set(uint8_t pin, bool pressed) {
+    uint16_t next = pressed ? levels & ~(1 << pin) : levels | (1 << pin);
+    if (next == levels) return;
+    levels = next;
+    if (reader) reader->notify();
+  }
+
+  uint32_t reads() const { return read_count; }
+};
+
+// One pin change at a millisecond
+struct Edge {
+  uint32_t at_ms;
+  uint8_t pin;
+  bool pressed;
+};
+
+struct Run {
+  std::vector<TrimEvent> events;
+  std::vector<uint32_t> times;
+  uint32_t reads;
+};
+
+static bool edgeBefore(const Edge& a, const Edge& b) { return a.at_ms < b.at_ms; }
+
+// Replays edges for duration_ms, servicing the reader every SERVICE_MS
+static Run replay(std::vector<Edge> edges, uint32_t duration_ms) {
+  std::stable_sort(edges.begin(), edges.end(), edgeBefore);
+  MockExpander expander;
+  TrimEventQueue queue;
+  TrimButtonReader<MockExpander> reader(expander, queue);
+  expander.reader = &reader;
+
+  Run run;
+  size_t next = 0;
+  for (uint32_t now = 0; now <= duration_ms; now++) {
+    while (next < edges.size() && edges[next].at_ms == now) {
+      expander.set(edges[next].pin, edges[next].pressed);
+      next++;
+    }
+    if (now % SERVICE_MS == 0) {
+      reader.service(now);
+      TrimEvent event;
+      while (queue.pop(event)) {
+        run.events.push_back(event);
+        run.times.push_back(now);
+      }
+    }
+  }
+  run.reads = expander.reads();
+  return run;
+}
+
+// Contact bounce: toggles every millisecond for bounce_ms, settling on pressed
+static void addEdge(std::vector<Edge>& edges, uint32_t at_ms, uint8_t pin, bool pressed, uint32_t bounce_ms) {
+  for (uint32_t t = 0; t < bounce_ms; t++) {
+    Edge edge = { at_ms + t, pin, (t % 2 == 0) == pressed };
+    edges.push_back(edge);
+  }
+  Edge edge = { at_ms + bounce_ms, pin, pressed };
+  edges.push_back(edge);
+}
+
+int trimBench(int argc, char** argv) {
+  uint32_t idle_s = argc > 1 ? (uint32_t)atol(argv[1]) : DEFAULT_IDLE_S;
+  if (idle_s == 0) {
+    fprintf(stderr, "usage: %s [idle_seconds]\n", argv[0]);
+    return 1;
+  }
+
+  // The first service reads once to learn the resting levels
+  std::vector<Edge> none;
+  Run idle = replay(none, idle_s * 1000);
+  std::vector<Edge> hold;
+  addEdge(hold, 0, TRIM_PITCH_UP, true, 5);
+  Run held = replay(hold, idle_s * 1000);
+  double polled = 1000.0 / SERVICE_MS;
+  printf("expander reads over %u s:\n", idle_s);
+  printf("  idle        %5u reads  %6.2f/s\n", idle.reads, (double)idle.reads / idle_s);
+  printf("  one held    %5u reads  %6.2f/s\n", held.reads, (double)held.reads / idle_s);
+  printf("  polling     %5u reads  %6.2f/s\n", (uint32_t)(polled * idle_s), polled);
+  return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Minimal Arduino API for the native simulator. Time comes from a virtual
+// clock that only moves when the simulation advances it; pins read back
+// whatever the simulation drove onto them (idle high, as with pull-ups).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define HIGH 0x1
+#define LOW 0x0
+
+#define IRAM_ATTR
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef uint8_t byte;
+
+class VirtualClock {
+private:
+  uint64_t now_us;
+
+public:
+  VirtualClock() : now_us(0) {}
+  uint64_t now() const { return now_us; }
+  void set(uint64_t us) { if (us > now_us) now_us = us; }
+  void advance(uint64_t us) { now_us += us; }
+};
+
+extern VirtualClock sim_clock;
+
+inline unsigned long millis() { return (unsigned long)(sim_clock.now() / 1000); }
+inline unsigned long micros() { return (unsigned long)sim_clock.now(); }
+inline void delay(unsigned long ms) { sim_clock.advance((uint64_t)ms * 1000); }
+inline void delayMicroseconds(unsigned int us) { sim_clock.advance(us); }
+
+const uint8_t SIM_PIN_COUNT = 40;
+extern uint8_t sim_pins[SIM_PIN_COUNT];
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline int digitalRead(uint8_t pin) { return pin < SIM_PIN_COUNT ? sim_pins[pin] : HIGH; }
+inline void digitalWrite(uint8_t pin, uint8_t value) { if (pin < SIM_PIN_COUNT) sim_pins[pin] = value; }
+
+class String {
+private:
+  std::string text;
+
+public:
+  String(const char* value = "") : text(value) {}
+  const char* c_str() const { return text.c_str(); }
+  size_t length() const { return text.size(); }
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+
+  size_t write(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) write(data[i]);
+    return length;
+  }
+
+  size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+  size_t print(const String& text) { return print(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value) { return printf("%d", value); }
+  size_t print(unsigned value) { return printf("%u", value); }
+  size_t print(long value) { return printf("%ld", value); }
+  size_t print(unsigned long value) { return printf("%lu", value); }
+  size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+  template <typename T>
+  size_t println(const T& value) { size_t n = print(value); return n + write('\n'); }
+  size_t println(double value, int digits) { size_t n = print(value, digits); return n + write('\n'); }
+  size_t println() { return write('\n'); }
+
+  size_t printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0) return 0;
+    if (length >= (int)sizeof(buffer)) length = sizeof(buffer) - 1;
+    return write((const uint8_t*)buffer, length);
+  }
+};
+
+// Serial goes to stdout; input is whatever the simulation injected
+class SimSerial : public Print {
+private:
+  std::string input;
+
+public:
+  void begin(unsigned long baud) {}
+  size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+  int available() { return (int)input.size(); }
+
+  int read() {
+    if (input.empty()) return -1;
+    int c = (uint8_t)input[0];
+    input.erase(0, 1);
+    return c;
+  }
+
+  void inject(const char* text) { input += text; }
+};
+
+extern SimSerial Serial;
+
+#endif
@@ -0,0 +1,884 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include <math.h>
+#include <telemetry_codec.h>
+#include <receiver_endpoint.h>
+
+#include "config.h"
+#include "pin_definitions.h"
+#include "interval_histogram.h"
+#include "task_layout.h"
+#include "bus_arbiter.h"
+#include "mpu6050_fifo.h"
+
+// Deterministic generator shared by the mock peripherals
+class SimRandom {
+private:
+  uint32_t state;
+
+public:
+  explicit SimRandom(uint32_t seed = 1) : state(seed) {}
+
+  uint32_t next() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  }
+
+  // Uniform in [0, 100)
+  uint8_t percent() { return next() % 100; }
+};
+
+// ======================== Radio ========================
+
+typedef enum { RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX } rf24_pa_dbm_e;
+typedef enum { RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS } rf24_datarate_e;
+typedef enum { RF24_CRC_DISABLED = 0, RF24_CRC_8, RF24_CRC_16 } rf24_crclength_e;
+
+// One writeFast() call as seen by the mock radio
+struct RadioWrite {
+  uint64_t address;
+  uint8_t channel;
+  uint64_t time_us;
+};
+
+// Writes per TX address, with the spacing between consecutive ones, and
+// how long the receiver took to hear a frame again after each blackout
+struct RadioPipeStats {
+  uint64_t address;
+  uint32_t writes;
+  uint32_t delivered;
+  uint32_t bytes;
+  uint32_t undecodable;     // Delivered data frames the receiver could not decode
+  uint32_t failsafes;
+  uint64_t last_us;
+  uint64_t min_interval_us;
+  uint64_t max_interval_us;
+  uint32_t resyncs;
+  uint64_t resync_total_us;
+  uint64_t resync_max_us;
+};
+
+// Receiver behind one TX address, running the receiver firmware's link
+// state machine. A receiver that does not hop is taken to sit on whatever
+// channel the transmitter uses for it.
+struct SimReceiver {
+  ReceiverEndpoint link;
+  ReceiverSettings settings;
+  bool resync_pending;      // Not heard from since the last blackout
+
+  SimReceiver() : resync_pending(false) {
+    defaultReceiverSettings(settings);
+    settings.hopping = 0;
+  }
+};
+
+// nRF24L01 stand-in. Each transmit attempt is lost with a probability set
+// by a link-margin model: setLossPercent() gives the loss at 2 Mbps and
+// max power, lower PA levels cost margin and slower rates gain it (roughly
+// the nRF24L01+ sensitivity figures). Each RF channel can add interference
+// on top, and a blackout drops everything. Frames sent at a data rate or on
+// a channel other than the ones the receiver follows are never heard.
+// Auto-retransmit
+// follows the setRetries() count and the outcome is reported through
+// whatHappened() like the status register, at once or, with
+// setAttemptTime(), once the attempts would have finished on air.
+// The address, channel and time of every write are recorded, the most
+// recent ones in a log and all of them in per-address totals. With ACK
+// payloads enabled each delivered frame returns receiver telemetry.
+class RadioDriver {
+public:
+  static const uint16_t LOG_SIZE = 256;
+  static const uint8_t MAX_PIPES = 8;
+
+private:
+  SimRandom random;
+  double reference_margin_db;
+  uint8_t data_rate;
+  uint8_t pa_level;
+  uint8_t retry_count;
+  uint8_t channel;
+  uint64_t address;
+  bool pending;
+  bool pending_ok;
+  uint8_t last_arc;
+  uint32_t attempt_us;
+  uint64_t done_us;
+  uint32_t write_count;
+  uint32_t address_changes;
+  uint32_t channel_changes;
+  RadioWrite log[LOG_SIZE];
+  RadioPipeStats pipes[MAX_PIPES];
+  SimReceiver receivers[MAX_PIPES];
+  uint8_t pipe_count;
+  uint8_t channel_loss[126];    // Extra per-attempt loss, %
+  bool hopping[MAX_RECEIVERS];  // By BASE_PIPES index
+  bool blackout;
+  uint64_t blackout_end_us;
+  bool ack_payloads;
+  uint8_t ack_payload[TELEMETRY_MAX_SIZE];
+  uint8_t ack_length;
+
+  // Returns the pipe index of the current address, MAX_PIPES if untracked
+  uint8_t recordWrite() {
+    uint64_t now = sim_clock.now();
+    RadioWrite& entry = log[write_count % LOG_SIZE];
+    entry.address = address;
+    entry.channel = channel;
+    entry.time_us = now;
+
+    uint8_t index = 0;
+    while (index < pipe_count && pipes[index].address != address) index++;
+    if (index == pipe_count) {
+      if (pipe_count == MAX_PIPES) return MAX_PIPES;
+      RadioPipeStats fresh = { address, 0, 0, 0, 0, 0, 0, UINT64_MAX, 0, 0, 0, 0 };
+      pipes[pipe_count] = fresh;
+      receivers[pipe_count] = SimReceiver();
+      for (uint8_t id = 0; id < MAX_RECEIVERS; id++) {
+        if (BASE_PIPES[id] == address) receivers[pipe_count].settings.hopping = hopping[id];
+      }
+      receivers[pipe_count].link.bind(address);
+      pipe_count++;
+    }
+
+    RadioPipeStats& pipe = pipes[index];
+    if (pipe.writes > 0) {
+      uint64_t interval = now - pipe.last_us;
+      if (interval < pipe.min_interval_us) pipe.min_interval_us = interval;
+      if (interval > pipe.max_interval_us) pipe.max_interval_us = interval;
+    }
+    pipe.writes++;
+    pipe.last_us = now;
+    return index;
+  }
+
+  // Probability in 0..1 that a single attempt is lost
+  double attemptLoss() const {
+    static const double PA_OFFSET_DB[] = { -18, -12, -6, 0 };
+    static const double RATE_OFFSET_DB[] = { 3, 0, 12 };   // 1M, 2M, 250K
+    if (blackout) return 1.0;
+    double margin = reference_margin_db + PA_OFFSET_DB[pa_level & 3] + RATE_OFFSET_DB[data_rate % 3];
+    double link = 1.0 / (1.0 + ::exp(margin / 3.0));
+    double interference = channel < sizeof(channel_loss) ? channel_loss[channel] / 100.0 : 0;
+    return 1.0 - (1.0 - link) * (1.0 - interference);
+  }
+
+  void loadAckPayload(uint8_t index) {
+    const SimReceiver& receiver = receivers[index];
+    double hours = sim_clock.now() / 3600e6;
+
+    TelemetrySample sample = {};
+    sample.battery_mv = (uint16_t)(8400 - 600 * hours > 6000 ? 8400 - 600 * hours : 6000);
+    receiver.link.fillTelemetry(sample);
+    sample.sensor_count = 2;
+    sample.sensors[0] = (int16_t)(250 + index);   // e.g. temperature, 0.1 C
+    sample.sensors[1] = (int16_t)(pipes[index].writes & 0x7FFF);
+    ack_length = encodeTelemetry(sample, ack_payload);
+  }
+
+public:
+  RadioDriver(uint16_t ce_pin, uint16_t csn_pin)
+    : random(0x5EED), reference_margin_db(100), data_rate(RF24_2MBPS), pa_level(RF24_PA_MAX),
+      retry_count(15), channel(76), address(0),
+      pending(false), pending_ok(false), last_arc(0), attempt_us(0), done_us(0), write_count(0),
+      address_changes(0), channel_changes(0), pipe_count(0), blackout(false), blackout_end_us(0),
+      ack_payloads(false), ack_length(0) {
+    memset(channel_loss, 0, sizeof(channel_loss));
+    memset(hopping, 0, sizeof(hopping));
+  }
+
+  bool begin() { return true; }
+  void setPALevel(uint8_t level, bool lna_enable = true) { pa_level = level; }
+  bool setDataRate(rf24_datarate_e rate) { data_rate = rate; return true; }
+  void setChannel(uint8_t value) { channel = value; channel_changes++; }
+  void setRetries(uint8_t delay, uint8_t count) { retry_count = count; }
+  void setCRCLength(rf24_crclength_e length) {}
+  void setPayloadSize(uint8_t size) {}
+  void openWritingPipe(uint64_t value) { address = value; address_changes++; }
+  void stopListening() {}
+  void enableDynamicPayloads() {}
+  void enableAckPayload() { ack_payloads = true; }
+
+  bool writeFast(const void* buffer, uint8_t length) {
+    uint8_t index = recordWrite();
+    write_count++;
+    if (index < MAX_PIPES) pipes[index].bytes += length;
+    uint32_t now_us = (uint32_t)sim_clock.now();
+    uint32_t now_ms = sim_clock.now() / 1000;
+
+    // The receiver only hears frames sent at the rate and on the channel it is tuned to
+    bool audible = true;
+    if (index < MAX_PIPES) {
+      SimReceiver& receiver = receivers[index];
+      if (receiver.link.poll(receiver.settings, now_ms) & RECEIVER_FAILSAFE) pipes[index].failsafes++;
+      audible = LINK_PROFILES[receiver.link.profile()].data_rate == data_rate;
+      if (receiver.settings.hopping && receiver.link.channel(receiver.settings, now_us) != channel) {
+        audible = false;
+      }
+    }
+
+    uint32_t loss_threshold = (uint32_t)(attemptLoss() * 0xFFFFFF);
+    uint8_t attempts = 0;
+    bool delivered = false;
+    while (!delivered && attempts <= retry_count) {
+      delivered = audible && random.next() >= loss_threshold;
+      attempts++;
+    }
+    pending = true;
+    pending_ok = delivered;
+    last_arc = attempts - 1;
+    done_us = sim_clock.now() + (uint64_t)attempts * attempt_us;
+
+    if (index < MAX_PIPES && delivered) {
+      SimReceiver& receiver = receivers[index];
+      const uint8_t* frame = static_cast<const uint8_t*>(buffer);
+      RadioPipeStats& pipe = pipes[index];
+      pipe.delivered++;
+      if (receiver.resync_pending) {
+        uint64_t resync_us = sim_clock.now() - blackout_end_us;
+        pipe.resyncs++;
+        pipe.resync_total_us += resync_us;
+        if (resync_us > pipe.resync_max_us) pipe.resync_max_us = resync_us;
+        receiver.resync_pending = false;
+      }
+      if (receiver.link.onFrame(frame, length, now_us, now_ms) & RECEIVER_UNDECODABLE) {
+        pipe.undecodable++;
+      }
+      if (ack_payloads) loadAckPayload(index);
+    }
+    return true;
+  }
+
+  bool available() { return ack_length > 0; }
+  uint8_t getDynamicPayloadSize() { return ack_length; }
+
+  void read(void* buffer, uint8_t length) {
+    memcpy(buffer, ack_payload, length < ack_length ? length : ack_length);
+    ack_length = 0;
+  }
+
+  void whatHappened(bool& tx_ok, bool& tx_fail, bool& rx_ready) {
+    bool finished = sim_clock.now() >= done_us;
+    tx_ok = pending && finished && pending_ok;
+    tx_fail = pending && finished && !pending_ok;
+    rx_ready = finished && ack_length > 0;
+    if (finished) pending = false;
+  }
+
+  uint8_t getARC() { return last_arc; }
+  void flush_tx() { pending = false; }
+
+  // Simulation controls
+  // Per-attempt loss at 2 Mbps and max power
+  void setLossPercent(double percent) {
+    if (percent <= 0) {
+      reference_margin_db = 100;
+    } else if (percent >= 100) {
+      reference_margin_db = -100;
+    } else {
+      reference_margin_db = 3.0 * ::log((100 - percent) / percent);
+    }
+  }
+
+  // Air time of one attempt, ACK wait and retransmit delay included; 0
+  // makes every outcome known as soon as the frame is written
+  void setAttemptTime(uint32_t us) { attempt_us = us; }
+
+  // Extra per-attempt loss on RF channels first..last
+  void setChannelLoss(uint8_t first, uint8_t last, uint8_t percent) {
+    for (uint16_t c = first; c <= last && c < sizeof(channel_loss); c++) {
+      channel_loss[c] = percent > 100 ? 100 : percent;
+    }
+  }
+
+  void setBlackout(bool on) {
+    if (blackout && !on) {
+      blackout_end_us = sim_clock.now();
+      for (uint8_t i = 0; i < pipe_count; i++) receivers[i].resync_pending = true;
+    }
+    blackout = on;
+  }
+
+  // Whether the receiver at BASE_PIPES[receiver_id] follows the hop sequence
+  void setReceiverHopping(uint8_t receiver_id, bool on) {
+    hopping[receiver_id] = on;
+    for (uint8_t i = 0; i < pipe_count; i++) {
+      if (pipes[i].address == BASE_PIPES[receiver_id]) receivers[i].settings.hopping = on;
+    }
+  }
+
+  bool blackedOut() const { return blackout; }
+  uint8_t receiverProfile(uint8_t index) const { return receivers[index].link.profile(); }
+  const ChannelData& receiverChannels(uint8_t index) const { return receivers[index].link.channelData(); }
+  uint32_t writes() const { return write_count; }
+  uint32_t addressChanges() const { return address_changes; }
+  uint32_t channelChanges() const { return channel_changes; }
+  uint8_t pipeCount() const { return pipe_count; }
+  const RadioPipeStats& pipe(uint8_t index) const { return pipes[index]; }
+
+  // index 0 is the most recent write
+  const RadioWrite& recentWrite(uint16_t index) const {
+    return log[(write_count - 1 - index) % LOG_SIZE];
+  }
+};
+
+// ======================== Analog inputs ========================
+
+// Synthetic sticks: each slot sweeps a slow sine around mid-scale with a
+// little uniform noise, evaluated at the current virtual time. hold() pins
+// a slot to a fixed raw value instead.
+class AnalogInputs {
+private:
+  static const uint32_t SAMPLE_RATE = 20000;
+  static const int32_t SWEEP = -1;
+  mutable SimRandom random;
+  uint16_t noise_counts;
+  int32_t held[ANALOG_CHANNEL_COUNT];
+
+public:
+  AnalogInputs() : random(0xADC), noise_counts(8) {
+    for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) held[i] = SWEEP;
+  }
+
+  bool begin() { return true; }
+
+  uint16_t readSlot(uint8_t slot) const {
+    double seconds = sim_clock.now() / 1e6;
+    double period = 2.0 + slot;
+    int32_t value = held[slot] != SWEEP ? held[slot] : 2048 + (int32_t)(1800 * sin(2 * M_PI * seconds / period));
+    value += (int32_t)(random.next() % (2 * noise_counts + 1)) - noise_counts;
+    return (uint16_t)constrain(value, 0, 4095);
+  }
+
+  // Values are evaluated when read, so they are never older than that
+  uint32_t sampledAt() const { return micros(); }
+  uint32_t sampleRate() const { return SAMPLE_RATE; }
+  float noise(uint8_t slot) const { return noise_counts / sqrtf(3.0f); }
+
+  void setNoise(uint16_t counts) { noise_counts = counts; }
+  void hold(uint8_t slot, uint16_t raw) { held[slot] = raw; }
+  void sweep(uint8_t slot) { held[slot] = SWEEP; }
+};
+
+// ======================== I2C bus ========================
+
+// Steps run one at a time here, so the bus is always free when asked for;
+// only the transaction counts mean anything, bus time is not modelled
+class SharedBus {
+private:
+  BusArbiter arbiter;
+
+public:
+  bool begin() { return true; }
+  void acquire(uint8_t device) { arbiter.request(device, micros()); }
+  void release(uint8_t device) { arbiter.release(device, micros()); }
+  BusDeviceStats stats(uint8_t device) { return arbiter.stats(device); }
+  void resetStats() { arbiter.resetStats(); }
+};
+
+// ======================== I/O expander ========================
+
+enum { P0, P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11, P12, P13, P14, P15 };
+
+class IoExpander {
+private:
+  SharedBus& bus;
+  uint16_t levels;
+  void (*on_change)();
+
+public:
+  IoExpander(SharedBus& shared_bus, uint8_t address, uint8_t interrupt_pin, void (*handler)())
+    : bus(shared_bus), levels(0xFFFF), on_change(handler) {}
+
+  bool begin() { return true; }
+  void pinMode(uint8_t pin, uint8_t mode) {}
+  uint8_t digitalRead(uint8_t pin) { return (levels >> pin) & 1; }
+  uint16_t digitalReadAll() { return levels; }
+
+  uint16_t readAll() {
+    bus.acquire(BUS_EXPANDER);
+    bus.release(BUS_EXPANDER);
+    return levels;
+  }
+
+  // Raises INT, as the chip does, when an input changes
+  void setLevels(uint16_t value) {
+    bool changed = value != levels;
+    levels = value;
+    if (changed && on_change) on_change();
+  }
+};
+
+// ======================== IMU ========================
+
+// Synthetic MPU6050: the transmitter rocks in pitch and roll on slow sines
+// around level, sampled at IMU_SAMPLE_RATE on the virtual clock with a
+// fixed gyro bias and a little noise. Samples wait in a FIFO of the chip's
+// size between reads and overflow it the same way.
+class ImuSensor {
+private:
+  static const int16_t ACCEL_NOISE = 40;
+  static const int16_t GYRO_NOISE = 20;
+
+  SharedBus& bus;
+  SimRandom random;
+  uint64_t next_sample_us;   // Virtual time of the oldest sample not yet read
+  ImuFifoStats fifo_stats;
+
+  int16_t noise(int16_t amplitude) {
+    return (int16_t)(random.next() % (2 * amplitude + 1)) - amplitude;
+  }
+
+  ImuSample synthesize(uint64_t at_us) {
+    const double PITCH_AMPLITUDE_DEG = 20.0;
+    const double PITCH_PERIOD_S = 7.0;
+    const double ROLL_AMPLITUDE_DEG = 12.0;
+    const double ROLL_PERIOD_S = 5.0;
+    const double GYRO_BIAS_DPS[3] = { 1.5, -0.8, 0.3 };
+
+    double seconds = at_us / 1e6;
+    double pitch_phase = 2 * M_PI * seconds / PITCH_PERIOD_S;
+    double roll_phase = 2 * M_PI * seconds / ROLL_PERIOD_S;
+    double pitch = PITCH_AMPLITUDE_DEG * M_PI / 180 * sin(pitch_phase);
+    double roll = ROLL_AMPLITUDE_DEG * M_PI / 180 * sin(roll_phase);
+    double rates[3] = {
+      ROLL_AMPLITUDE_DEG * 2 * M_PI / ROLL_PERIOD_S * cos(roll_phase),
+      PITCH_AMPLITUDE_DEG * 2 * M_PI / PITCH_PERIOD_S * cos(pitch_phase),
+      0
+    };
+    double accel[3] = { -sin(pitch), sin(roll) * cos(pitch), cos(roll) * cos(pitch) };
+
+    ImuSample sample;
+    for (uint8_t i = 0; i < 3; i++) {
+      sample.accel[i] = (int16_t)(accel[i] * AttitudeFilter::ACCEL_LSB_PER_G) + noise(ACCEL_NOISE);
+      sample.gyro[i] = (int16_t)((rates[i] + GYRO_BIAS_DPS[i]) * AttitudeFilter::GYRO_LSB_PER_DPS_X10 / 10) +
+                       noise(GYRO_NOISE);
+    }
+    return sample;
+  }
+
+public:
+  ImuSensor(SharedBus& shared_bus, uint8_t address) : bus(shared_bus), random(0x1A0), next_sample_us(0) {
+    resetStats();
+  }
+
+  bool begin() {
+    next_sample_us = sim_clock.now();
+    return true;
+  }
+
+  uint8_t read(ImuSample* samples, uint8_t max_samples) {
+    const uint64_t period_us = 1000000 / IMU_SAMPLE_RATE;
+    uint64_t now = sim_clock.now();
+    bus.acquire(BUS_IMU);
+    bus.release(BUS_IMU);
+    uint32_t waiting = now >= next_sample_us ? (uint32_t)((now - next_sample_us) / period_us) + 1 : 0;
+    uint32_t bytes = waiting * IMU_SAMPLE_BYTES;
+    if (fifoSamples(bytes > IMU_FIFO_SIZE ? IMU_FIFO_SIZE : bytes) < 0) {
+      fifo_stats.overflows++;
+      next_sample_us = now + period_us;
+      return 0;
+    }
+
+    uint8_t taken = waiting < max_samples ? waiting : max_samples;
+    for (uint8_t i = 0; i < taken; i++) {
+      if (i % IMU_BURST_SAMPLES == 0) {
+        bus.acquire(BUS_IMU);
+        bus.release(BUS_IMU);
+        fifo_stats.bursts++;
+      }
+      samples[i] = synthesize(next_sample_us);
+      next_sample_us += period_us;
+    }
+    if (taken > 0) {
+      fifo_stats.batches++;
+      fifo_stats.samples += taken;
+      if (taken > fifo_stats.max_batch) fifo_stats.max_batch = taken;
+    }
+    return taken;
+  }
+
+  const ImuFifoStats& stats() const { return fifo_stats; }
+
+  void resetStats() {
+    ImuFifoStats cleared = {};
+    fifo_stats = cleared;
+  }
+};
+
+// ======================== Display ========================
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define OLED_CHUNK_SIZE 31
+
+// Framebuffer with the SSD1306 page layout. Text is rastered as 6-column
+// glyphs derived from the character code, so changed text dirties the same
+// pages and columns real glyphs would. Flushes are counted, not sent.
+class DisplayDriver : public Print {
+private:
+  uint8_t buffer[SCREEN_WIDTH * SCREEN_HEIGHT / 8];
+  int16_t cursor_x;
+  int16_t cursor_y;
+  SharedBus* bus;
+  uint32_t bus_bytes;
+
+  void setPixel(int16_t x, int16_t y) {
+    if (x < 0 || x >= SCREEN_WIDTH || y < 0 || y >= SCREEN_HEIGHT) return;
+    buffer[x + (y / 8) * SCREEN_WIDTH] |= 1 << (y & 7);
+  }
+
+public:
+  using Print::write;
+
+  DisplayDriver() : cursor_x(0), cursor_y(0), bus(NULL), bus_bytes(0) {
+    clearDisplay();
+  }
+
+  bool begin() { return true; }
+  void setBus(SharedBus* shared_bus) { bus = shared_bus; }
+  void clearDisplay() { memset(buffer, 0, sizeof(buffer)); }
+  void setTextColor(uint16_t color) {}
+  void setTextSize(uint8_t size) {}
+  void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+  uint8_t* getBuffer() { return buffer; }
+
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    int16_t steps = max(abs(x1 - x0), abs(y1 - y0));
+    for (int16_t i = 0; i <= steps; i++) {
+      int16_t x = steps ? x0 + (x1 - x0) * i / steps : x0;
+      int16_t y = steps ? y0 + (y1 - y0) * i / steps : y0;
+      setPixel(x, y);
+    }
+  }
+
+  size_t write(uint8_t c) {
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y += 8;
+      return 1;
+    }
+    for (uint8_t column = 0; column < 5; column++) {
+      uint8_t bits = (uint8_t)(c * (column + 3)) | 0x01;
+      for (uint8_t row = 0; row < 7; row++) {
+        if (bits & (1 << row)) setPixel(cursor_x + column, cursor_y + row);
+      }
+    }
+    cursor_x += 6;
+    return 1;
+  }
+
+  // Accounts for the bytes the I2C path would push for this window
+  void sendWindow(uint8_t page, uint8_t first, uint8_t last, const uint8_t* data) {
+    uint16_t length = last - first + 1;
+    uint16_t chunks = (length + OLED_CHUNK_SIZE - 1) / OLED_CHUNK_SIZE;
+    bus_bytes += 8 + length + chunks * 2;
+    if (!bus) return;
+    for (uint16_t i = 0; i <= chunks; i++) {
+      bus->acquire(BUS_OLED);
+      bus->release(BUS_OLED);
+    }
+  }
+
+  uint32_t busBytes() const { return bus_bytes; }
+
+private:
+  static int16_t abs(int16_t value) { return value < 0 ? -value : value; }
+  static int16_t max(int16_t a, int16_t b) { return a > b ? a : b; }
+};
+
+// ======================== Flash ========================
+
+// NOR-flash model: erase sets a sector to 0xFF, programming can only clear bits
+class FlashStorage {
+private:
+  static const uint16_t SECTOR_SIZE = 4096;
+  static const uint16_t SECTOR_COUNT = 4;
+  std::vector<uint8_t> memory;
+  uint32_t erase_count;
+
+public:
+  FlashStorage() : memory((size_t)SECTOR_SIZE * SECTOR_COUNT, 0xFF), erase_count(0) {}
+
+  bool begin(const char* label) { return true; }
+  uint16_t sectorSize() const { return SECTOR_SIZE; }
+  uint16_t sectorCount() const { return SECTOR_COUNT; }
+
+  void read(uint32_t offset, uint8_t* data, uint16_t length) const {
+    memcpy(data, &memory[offset], length);
+  }
+
+  void write(uint32_t offset, const uint8_t* data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+      memory[offset + i] &= data[i];
+    }
+  }
+
+  void erase(uint16_t sector) {
+    memset(&memory[(size_t)sector * SECTOR_SIZE], 0xFF, SECTOR_SIZE);
+    erase_count++;
+  }
+
+  uint32_t erases() const { return erase_count; }
+};
+
+// Host nanoseconds stand in for the CPU cycle counter
+inline uint32_t cycleCount() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t cyclesPerMicrosecond() {
+  return 1000;
+}
+
+// No EEPROM blob from older firmware in the simulator
+inline bool loadLegacySettings(SystemSettings& settings) {
+  return false;
+}
+
+// ======================== Runtime ========================
+
+// Runs the three steps on the virtual clock. Each loop() jumps straight to
+// the next due step, so simulated time passes as fast as the host can run
+// the control code. Host CPU time per control and UI step is recorded.
+// Steps take no virtual time unless setControlLoad() or setUiLoad() give
+// them a cost. The tasks sit on the cores and priorities of task_layout.h,
+// and a step that is due while a task it cannot preempt holds the core
+// waits for it, so a control task placed behind the UI shows up as frame
+// jitter and missed frames. Input and IMU steps stay free.
+class Runtime {
+public:
+  typedef void (*Step)();
+  typedef uint32_t (*UiStep)();     // Returns the ms it may sleep for
+  static const uint32_t NO_DEADLINE = 0xFFFFFFFF;
+
+private:
+  static const uint64_t NEVER = ~0ULL;
+  static const uint32_t TICK_US = 1000;     // FreeRTOS tick, 1 kHz
+
+  uint32_t frame_us;
+  uint32_t ui_us;
+  uint32_t settings_us;
+  uint32_t timer_us;
+  uint64_t next_frame;
+  uint64_t next_ui;
+  uint64_t next_settings;
+  uint64_t next_timer;
+  uint64_t next_input;
+  uint64_t next_imu;
+  uint64_t last_frame;
+  Step control_step;
+  UiStep ui_step;
+  Step settings_step;
+  Step timer_step;
+  UiStep input_step;
+  UiStep imu_step;
+  uint32_t ui_wakes;
+  int8_t control_core;
+  uint8_t control_priority;
+  uint32_t control_load_us;
+  uint32_t ui_load_us;
+  uint64_t control_busy_until;
+  uint64_t ui_core_busy_until;
+  IntervalHistogram frame_stats;
+  uint32_t missed_frames;
+
+  uint32_t control_steps;
+  uint64_t control_ns_total;
+  uint64_t control_ns_max;
+  uint32_t ui_steps;
+  uint64_t ui_ns_total;
+  uint64_t ui_ns_max;
+
+  // An unpinned task finds the app core free, nothing else lives there
+  bool controlSharesUiCore() const { return control_core == UI_TASK_CORE; }
+
+  // When the control step due at due gets its core
+  uint64_t controlStart(uint64_t due) const {
+    if (control_busy_until > due) due = control_busy_until;
+    if (!controlSharesUiCore() || ui_core_busy_until <= due ||
+        control_priority > UI_TASK_PRIORITY) {
+      return due;
+    }
+    if (control_priority == UI_TASK_PRIORITY) {
+      // Round robin: the UI step is switched out on the next tick
+      uint64_t tick = (due / TICK_US + 1) * TICK_US;
+      return tick < ui_core_busy_until ? tick : ui_core_busy_until;
+    }
+    return ui_core_busy_until;
+  }
+
+  // Steps on the UI core do not start under a control step running there
+  uint64_t uiCoreStart(uint64_t due) const {
+    if (controlSharesUiCore() && control_busy_until > due) return control_busy_until;
+    return due;
+  }
+
+  void runControl(uint64_t now) {
+    // Ticks that fell due while the task could not run fold into this step
+    while (next_frame + frame_us <= now) {
+      next_frame += frame_us;
+      missed_frames++;
+    }
+    if (control_steps > 0) {
+      frame_stats.record((uint32_t)(now - last_frame));
+    }
+    last_frame = now;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    control_step();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - begin).count();
+
+    control_steps++;
+    control_ns_total += ns;
+    if (ns > control_ns_max) control_ns_max = ns;
+    control_busy_until = now + control_load_us;
+    if (controlSharesUiCore() && ui_core_busy_until > now) {
+      // The UI step was switched out for the control step
+      ui_core_busy_until += control_load_us;
+      next_ui += control_load_us;
+    }
+    next_frame += frame_us;
+  }
+
+  void runUi(uint64_t now) {
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    uint64_t sleep_us = (uint64_t)ui_step() * 1000;
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - begin).count();
+
+    ui_steps++;
+    ui_ns_total += ns;
+    if (ns > ui_ns_max) ui_ns_max = ns;
+    if (sleep_us > ui_us) sleep_us = ui_us;
+    if (sleep_us == 0 || ui_load_us > 0) sleep_us = TICK_US;
+    ui_core_busy_until = now + ui_load_us;
+    next_ui = ui_core_busy_until + sleep_us;
+    ui_wakes++;
+  }
+
+public:
+  Runtime(uint32_t frame_period_us, uint32_t jitter_bucket_us, uint32_t ui_ms, uint32_t settings_ms)
+    : frame_us(frame_period_us), ui_us(ui_ms * 1000), settings_us(settings_ms * 1000), timer_us(0),
+      next_frame(0), next_ui(0), next_settings(0), next_timer(NEVER), next_input(NEVER),
+      next_imu(NEVER), last_frame(0), control_step(NULL), ui_step(NULL), settings_step(NULL),
+      timer_step(NULL), input_step(NULL), imu_step(NULL), ui_wakes(0),
+      control_core(CONTROL_TASK_CORE), control_priority(CONTROL_TASK_PRIORITY),
+      control_load_us(0), ui_load_us(0), control_busy_until(0), ui_core_busy_until(0),
+      frame_stats(frame_period_us, jitter_bucket_us), missed_frames(0),
+      control_steps(0), control_ns_total(0), control_ns_max(0),
+      ui_steps(0), ui_ns_total(0), ui_ns_max(0) {}
+
+  void start(Step control, UiStep ui, Step settings) {
+    control_step = control;
+    ui_step = ui;
+    settings_step = settings;
+    next_frame = next_ui = next_settings = sim_clock.now();
+  }
+
+  void loop() {
+    uint64_t frame_at = controlStart(next_frame);
+    uint64_t ui_at = uiCoreStart(next_ui);
+    uint64_t settings_at = uiCoreStart(next_settings);
+    if (ui_core_busy_until > settings_at) settings_at = ui_core_busy_until;
+
+    uint64_t next = frame_at;
+    if (ui_at < next) next = ui_at;
+    if (settings_at < next) next = settings_at;
+    if (next_timer < next) next = next_timer;
+    if (next_input < next) next = next_input;
+    if (next_imu < next) next = next_imu;
+    sim_clock.set(next);
+
+    if (next == frame_at) {
+      runControl(next);
+    } else if (next == ui_at) {
+      runUi(next);
+    } else if (next == next_input) {
+      uint32_t sleep_ms = input_step();
+      if (sleep_ms == 0) sleep_ms = 1;
+      next_input = sleep_ms == NO_DEADLINE ? NEVER : next + (uint64_t)sleep_ms * 1000;
+    } else if (next == next_imu) {
+      next_imu = next + (uint64_t)imu_step() * 1000;
+    } else if (next == next_timer) {
+      timer_step();
+      next_timer += timer_us;
+    } else {
+      settings_step();
+      next_settings = next + settings_us;
+    }
+  }
+
+  // Every control step holds its core for step_us
+  void setControlLoad(uint32_t step_us) {
+    control_load_us = step_us;
+  }
+
+  // Every UI step holds the UI core for step_us, then sleeps only the one
+  // tick minimum, as a UI task that is always busy; 0 goes back to instant
+  // steps
+  void setUiLoad(uint32_t step_us) {
+    ui_load_us = step_us;
+  }
+
+  // Moves the control task, for the placement tests; core may be
+  // TASK_NO_AFFINITY
+  void placeControl(int8_t core, uint8_t priority) {
+    control_core = core;
+    control_priority = priority;
+  }
+
+  bool startTimer(uint32_t period_ms, Step step) {
+    timer_step = step;
+    timer_us = period_ms * 1000;
+    next_timer = sim_clock.now() + timer_us;
+    return true;
+  }
+
+  void startInput(UiStep step) {
+    input_step = step;
+    next_input = sim_clock.now();
+  }
+
+  void startImu(UiStep step) {
+    imu_step = step;
+    next_imu = sim_clock.now();
+  }
+
+  void wakeInputFromIsr() {
+    if (input_step && next_input > sim_clock.now()) next_input = sim_clock.now();
+  }
+
+  // The UI step runs next, at the current virtual time or as soon as the
+  // step in progress is done
+  void wakeUi() {
+    uint64_t now = sim_clock.now();
+    if (now < ui_core_busy_until) now = ui_core_busy_until;
+    if (next_ui > now) next_ui = now;
+  }
+
+  void wakeUiFromIsr() { wakeUi(); }
+
+  uint32_t uiWakes() const { return ui_wakes; }
+
+  const IntervalHistogram& frameStats() const { return frame_stats; }
+  uint32_t missedFrames() const { return missed_frames; }
+  void resetStats() {
+    frame_stats.reset();
+    missed_frames = 0;
+  }
+
+  uint32_t controlSteps() const { return control_steps; }
+  uint64_t controlNsAverage() const { return control_steps ? control_ns_total / control_steps : 0; }
+  uint64_t controlNsMax() const { return control_ns_max; }
+  uint32_t uiSteps() const { return ui_steps; }
+  uint64_t uiNsAverage() const { return ui_steps ? ui_ns_total / ui_steps : 0; }
+  uint64_t uiNsMax() const { return ui_ns_max; }
+};
+
+#endif
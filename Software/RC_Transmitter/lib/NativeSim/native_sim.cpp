@@ -0,0 +1,260 @@
+// Entry point for the native simulator: runs the firmware's setup() and
+// loop() against the mock HAL for a given span of simulated time.
+//
+//   program [hours] [loss_percent] [serial_commands] [step_loss_percent]
+//           [interference]
+//
+// serial_commands are fed to the firmware before the run, with ';'
+// standing for a newline, e.g. "F0 50 2;F1 50 1;F2 25;". With
+// step_loss_percent the loss changes to it halfway through. The link report
+// shows how long each receiver took to react to the step, and for the last
+// quarter of the run the number of profile changes and the share of time
+// spent on the dominant profile, i.e. whether the policy has settled.
+//
+// interference adds per-channel loss as "first-last:percent,...", e.g.
+// "61-83:70" for a busy Wi-Fi channel 13, and a blackout every minute,
+// 0.5 to 2.5 s long in turn.
+// The hop report gives each receiver's delivery ratio, how often its
+// outputs went to failsafe and how long it took to hear a frame again
+// after a blackout; run it once more with "H0 0;" in
+// serial_commands for the fixed-channel baseline.
+//
+// The first lines give host time per control and UI step, how long static
+// initialisation took and the operator new traffic of static init, setup()
+// and the run. Apart from the flash model, the firmware is expected to
+// allocate nothing at all.
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string>
+#include <new>
+#include <chrono>
+#include "hal.h"
+#include "link_quality.h"
+#include "channel_blacklist.h"
+
+VirtualClock sim_clock;
+uint8_t sim_pins[SIM_PIN_COUNT];
+SimSerial Serial;
+
+// Unit tests in test/ bring their own main() and drive the firmware
+// themselves, they only share the clock, pins and serial above
+#ifndef PIO_UNIT_TESTING
+
+// Heap traffic through operator new, split into static initialisation,
+// setup() and the run
+static uint32_t heap_allocations = 0;
+static uint64_t heap_bytes = 0;
+
+void* operator new(size_t size) {
+  heap_allocations++;
+  heap_bytes += size;
+  void* block = malloc(size > 0 ? size : 1);
+  if (block == NULL) throw std::bad_alloc();
+  return block;
+}
+
+void operator delete(void* block) noexcept {
+  free(block);
+}
+
+struct HeapMark {
+  uint32_t allocations;
+  uint64_t bytes;
+};
+
+static HeapMark heapMark() {
+  HeapMark mark = { heap_allocations, heap_bytes };
+  return mark;
+}
+
+// Constructed ahead of every other global, so main() can tell how long
+// static initialisation took
+struct StaticInitStart {
+  std::chrono::steady_clock::time_point at;
+  StaticInitStart() : at(std::chrono::steady_clock::now()) {}
+};
+static StaticInitStart static_init_start __attribute__((init_priority(101)));
+
+void setup();
+void loop();
+
+extern Runtime runtime;
+extern RadioDriver radio;
+extern LinkPolicy link_policies[MAX_RECEIVERS];
+extern ChannelBlacklist channel_blacklists[MAX_RECEIVERS];
+extern SystemSettings system_settings;
+
+// Time each receiver spent on each profile since the last reset
+static uint64_t profile_us[MAX_RECEIVERS][LINK_PROFILE_COUNT];
+
+// First profile change after the loss step
+static bool stepped = false;
+static uint32_t changes_at_step[MAX_RECEIVERS];
+static uint64_t reaction_us[MAX_RECEIVERS];
+
+// Periodic blackouts, on while an interference spec is given
+static const uint64_t OUTAGE_EVERY_US = 60000000;
+static const uint64_t OUTAGE_STEP_US = 500000;
+static bool outages = false;
+static uint32_t outage_count = 0;
+static uint64_t next_outage_us;
+
+static void runUntil(uint64_t end_us) {
+  while (sim_clock.now() < end_us) {
+    uint64_t before = sim_clock.now();
+    if (outages && before >= next_outage_us) {
+      bool starting = !radio.blackedOut();
+      uint64_t outage_us = OUTAGE_STEP_US * (1 + outage_count % 5);
+      radio.setBlackout(starting);
+      if (starting) {
+        next_outage_us += outage_us;
+      } else {
+        next_outage_us += OUTAGE_EVERY_US - outage_us;
+        outage_count++;
+      }
+    }
+    loop();
+    for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+      profile_us[i][link_policies[i].profile()] += sim_clock.now() - before;
+      if (stepped && reaction_us[i] == 0 && link_policies[i].changes() != changes_at_step[i]) {
+        reaction_us[i] = sim_clock.now();
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  double hours = argc > 1 ? atof(argv[1]) : 1.0;
+  double loss_percent = argc > 2 ? atof(argv[2]) : 0;
+  double step_loss_percent = argc > 4 ? atof(argv[4]) : loss_percent;
+  double static_init_us = std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - static_init_start.at).count();
+  HeapMark at_main = heapMark();
+
+  memset(sim_pins, HIGH, sizeof(sim_pins));
+  setup();
+  HeapMark after_setup = heapMark();
+  radio.setLossPercent(loss_percent);
+
+  if (argc > 3) {
+    std::string commands(argv[3]);
+    for (size_t i = 0; i < commands.size(); i++) {
+      if (commands[i] == ';') commands[i] = '\n';
+    }
+    Serial.inject(commands.c_str());
+  }
+  if (argc > 5) {
+    // "first-last:percent" entries separated by commas
+    const char* spec = argv[5];
+    unsigned first, last, percent;
+    int used;
+    while (sscanf(spec, "%u-%u:%u%n", &first, &last, &percent, &used) == 3) {
+      radio.setChannelLoss(first, last, percent);
+      spec += used;
+      if (*spec == ',') spec++;
+    }
+  }
+
+  // Let the commands through, then tune the mock receivers to match
+  runUntil(sim_clock.now() + 50000);
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    radio.setReceiverHopping(i, system_settings.fleet[i].hopping != 0);
+  }
+
+  uint64_t start_us = sim_clock.now();
+  outages = argc > 5;
+  next_outage_us = start_us + OUTAGE_EVERY_US;
+  uint64_t span_us = (uint64_t)(hours * 3600e6);
+  uint64_t step_us = start_us + span_us / 2;
+  uint64_t last_quarter_us = start_us + span_us * 3 / 4;
+  uint32_t changes_at_last_quarter[MAX_RECEIVERS];
+
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  HeapMark run_start = heapMark();
+  runUntil(step_us);
+  radio.setLossPercent(step_loss_percent);
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    changes_at_step[i] = link_policies[i].changes();
+  }
+  stepped = true;
+  runUntil(last_quarter_us);
+  memset(profile_us, 0, sizeof(profile_us));
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    changes_at_last_quarter[i] = link_policies[i].changes();
+  }
+  runUntil(start_us + span_us);
+  HeapMark run_end = heapMark();
+  double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  printf("simulated %.2f h in %.2f s (%.0fx real time)\n",
+         hours, wall_seconds, hours * 3600 / (wall_seconds > 0 ? wall_seconds : 1e-9));
+  printf("control steps=%u avg=%llu ns max=%llu ns\n", runtime.controlSteps(),
+         (unsigned long long)runtime.controlNsAverage(), (unsigned long long)runtime.controlNsMax());
+  printf("ui steps=%u avg=%llu ns max=%llu ns\n", runtime.uiSteps(),
+         (unsigned long long)runtime.uiNsAverage(), (unsigned long long)runtime.uiNsMax());
+  printf("static init=%.1f us heap: static %u allocs %llu B, setup %u allocs %llu B, run %u allocs %llu B\n",
+         static_init_us, at_main.allocations, (unsigned long long)at_main.bytes,
+         after_setup.allocations - at_main.allocations, (unsigned long long)(after_setup.bytes - at_main.bytes),
+         run_end.allocations - run_start.allocations, (unsigned long long)(run_end.bytes - run_start.bytes));
+
+  printf("radio writes=%u address changes=%u channel changes=%u\n",
+         radio.writes(), radio.addressChanges(), radio.channelChanges());
+  for (uint8_t i = 0; i < radio.pipeCount(); i++) {
+    const RadioPipeStats& pipe = radio.pipe(i);
+    printf("pipe %010llX writes=%u interval=%llu..%llu us\n", (unsigned long long)pipe.address,
+           pipe.writes, (unsigned long long)pipe.min_interval_us, (unsigned long long)pipe.max_interval_us);
+  }
+
+  printf("loss %.1f%% -> %.1f%% at %.0f s\n", loss_percent, step_loss_percent, (step_us - start_us) / 1e6);
+  for (uint8_t i = 0; i < radio.pipeCount(); i++) {
+    uint8_t receiver = 0;
+    while (receiver < MAX_RECEIVERS && BASE_PIPES[receiver] != radio.pipe(i).address) receiver++;
+    if (receiver == MAX_RECEIVERS) continue;
+
+    const LinkPolicy& policy = link_policies[receiver];
+    uint8_t dominant = 0;
+    for (uint8_t p = 1; p < LINK_PROFILE_COUNT; p++) {
+      if (profile_us[receiver][p] > profile_us[receiver][dominant]) dominant = p;
+    }
+    printf("rx%u profile tx=%u rx=%u changes=%u", receiver, policy.profile(),
+           radio.receiverProfile(i), policy.changes());
+    if (reaction_us[receiver] > 0) {
+      printf(" reacted in %.1f s", (reaction_us[receiver] - step_us) / 1e6);
+    }
+    printf(" | last quarter: changes=%u profile %u for %.1f%%\n",
+           policy.changes() - changes_at_last_quarter[receiver], dominant,
+           100.0 * profile_us[receiver][dominant] / (start_us + span_us - last_quarter_us));
+  }
+
+  for (uint8_t i = 0; i < radio.pipeCount(); i++) {
+    const RadioPipeStats& pipe = radio.pipe(i);
+    uint8_t receiver = 0;
+    while (receiver < MAX_RECEIVERS && BASE_PIPES[receiver] != pipe.address) receiver++;
+    if (receiver == MAX_RECEIVERS) continue;
+
+    printf("rx%u %s delivered=%.2f%% bytes/frame=%.2f undecodable=%u failsafes=%u", receiver,
+           system_settings.fleet[receiver].hopping ? "hopping" : "fixed",
+           pipe.writes ? 100.0 * pipe.delivered / pipe.writes : 0,
+           pipe.writes ? (double)pipe.bytes / pipe.writes : 0, pipe.undecodable, pipe.failsafes);
+    if (system_settings.fleet[receiver].hopping) {
+      printf(" blocked=%u mask changes=%u", channel_blacklists[receiver].blocked(),
+             channel_blacklists[receiver].changes());
+    }
+    if (pipe.resyncs > 0) {
+      printf(" resync n=%u avg=%.0f max=%.0f ms", pipe.resyncs,
+             pipe.resync_total_us / 1e3 / pipe.resyncs, pipe.resync_max_us / 1e3);
+    }
+    printf("\n");
+  }
+
+  // Let the UI step answer the usual serial report commands
+  Serial.inject("hlaspftqcdmkbig");
+  runtime.wakeUi();
+  for (int i = 0; i < 10; i++) {
+    loop();
+  }
+  return 0;
+}
+
+#endif
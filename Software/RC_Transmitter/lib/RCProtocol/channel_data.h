@@ -0,0 +1,24 @@
+#ifndef CHANNEL_DATA_H
+#define CHANNEL_DATA_H
+
+#include <stdint.h>
+
+// Channel Configuration
+struct ChannelData {
+  int16_t throttle;
+  int16_t pitch;
+  int16_t roll;
+  int16_t yaw;
+  int16_t aux1;
+  int16_t aux2;
+  uint8_t aux3 : 1;
+  uint8_t aux4 : 1;
+  uint8_t aux5 : 1;
+  uint8_t aux6 : 1;
+  int8_t aux7;
+  int8_t aux8;
+  uint8_t receiver_id;
+  uint32_t timestamp;       // micros() when the inputs were read
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef DELTA_CODEC_H
+#define DELTA_CODEC_H
+
+#include <stdint.h>
+#include "frame_codec.h"
+
+// Delta frames carry only what changed since a base frame the receiver is
+// known to hold:
+//
+//   byte 0      FRAME_DELTA (keyframes are plain version 1 frames)
+//   byte 1      sequence counter
+//   byte 2      sequence of the base frame
+//   byte 3      change bitmap: bits 0-5 throttle..aux2, bit 6 switches
+//               and receiver id, bit 7 reserved
+//   bits ..     each changed analog channel in order: '0' and a 5-bit
+//               signed difference from the base, or '1' and the 11-bit
+//               value as in a keyframe; then, if flagged, aux3..aux6,
+//               aux7, aux8 and the receiver id as in a keyframe; zero
+//               padded to a whole byte
+//
+// The base is the newest frame the receiver has acknowledged, so it is
+// held unless the receiver restarted. The receiver keeps the last
+// DELTA_HISTORY frames it decoded, and the transmitter sends a keyframe
+// whenever its base is older than that. After DELTA_KEYFRAME_INTERVAL
+// deltas it sends keyframes until one is acknowledged, which bounds
+// recovery from anything else.
+// A delta that would not be shorter than a keyframe is sent as a keyframe.
+
+const uint8_t FRAME_DELTA = 0x02;
+const uint8_t DELTA_HEADER_SIZE = 4;
+const uint8_t DELTA_SWITCHES = 6;             // Bitmap bit of the switch group
+const uint8_t DELTA_SMALL_BITS = 5;
+const int16_t DELTA_SMALL_MIN = -(1 << (DELTA_SMALL_BITS - 1));
+const int16_t DELTA_SMALL_MAX = (1 << (DELTA_SMALL_BITS - 1)) - 1;
+const uint8_t DELTA_MAX_SIZE = DELTA_HEADER_SIZE + (6 * (1 + FRAME_CHANNEL_BITS) + 11 + 7) / 8;
+const uint8_t DELTA_HISTORY = 8;
+const uint8_t DELTA_KEYFRAME_INTERVAL = 50;
+
+inline void analogChannels(const ChannelData& data, int16_t* out) {
+  out[0] = data.throttle;
+  out[1] = data.pitch;
+  out[2] = data.roll;
+  out[3] = data.yaw;
+  out[4] = data.aux1;
+  out[5] = data.aux2;
+}
+
+inline bool sameSwitches(const ChannelData& a, const ChannelData& b) {
+  return a.aux3 == b.aux3 && a.aux4 == b.aux4 && a.aux5 == b.aux5 && a.aux6 == b.aux6 &&
+         a.aux7 == b.aux7 && a.aux8 == b.aux8 && a.receiver_id == b.receiver_id;
+}
+
+// Writes a delta frame against base to out (DELTA_MAX_SIZE bytes) and
+// returns its length
+inline uint8_t encodeDelta(const ChannelData& data, const ChannelData& base,
+                           uint8_t sequence, uint8_t base_sequence, uint8_t* out) {
+  for (uint8_t i = 0; i < DELTA_MAX_SIZE; i++) {
+    out[i] = 0;
+  }
+  out[0] = FRAME_DELTA;
+  out[1] = sequence;
+  out[2] = base_sequence;
+
+  int16_t values[6], previous[6];
+  analogChannels(data, values);
+  analogChannels(base, previous);
+
+  uint8_t bitmap = 0;
+  uint16_t bits = 0;
+  FrameBitWriter writer(out + DELTA_HEADER_SIZE);
+  for (uint8_t i = 0; i < 6; i++) {
+    uint32_t value = packChannel(values[i]);
+    int16_t difference = (int16_t)value - (int16_t)packChannel(previous[i]);
+    if (difference == 0) continue;
+
+    bitmap |= 1 << i;
+    if (difference >= DELTA_SMALL_MIN && difference <= DELTA_SMALL_MAX) {
+      writer.write(0, 1);
+      writer.write((uint32_t)difference, DELTA_SMALL_BITS);
+      bits += 1 + DELTA_SMALL_BITS;
+    } else {
+      writer.write(1, 1);
+      writer.write(value, FRAME_CHANNEL_BITS);
+      bits += 1 + FRAME_CHANNEL_BITS;
+    }
+  }
+  if (!sameSwitches(data, base)) {
+    bitmap |= 1 << DELTA_SWITCHES;
+    writer.write(data.aux3, 1);
+    writer.write(data.aux4, 1);
+    writer.write(data.aux5, 1);
+    writer.write(data.aux6, 1);
+    writer.write(pack3Way(data.aux7), 2);
+    writer.write(pack3Way(data.aux8), 2);
+    writer.write(data.receiver_id, 3);
+    bits += 11;
+  }
+  out[3] = bitmap;
+  return DELTA_HEADER_SIZE + (bits + 7) / 8;
+}
+
+// Applies a delta frame to base. Returns false if it is truncated or not a
+// delta frame; the caller checks base_sequence.
+inline bool decodeDelta(const uint8_t* in, uint8_t length, const ChannelData& base,
+                        ChannelData& data, uint8_t& sequence, uint8_t& base_sequence) {
+  if (length < DELTA_HEADER_SIZE || length > DELTA_MAX_SIZE || in[0] != FRAME_DELTA) {
+    return false;
+  }
+  // Read from a zero-padded copy, the length is checked once all is parsed
+  uint8_t padded[DELTA_MAX_SIZE] = {};
+  for (uint8_t i = 0; i < length; i++) {
+    padded[i] = in[i];
+  }
+
+  uint8_t bitmap = padded[3];
+  int16_t values[6];
+  analogChannels(base, values);
+  ChannelData result = base;
+  uint16_t bits = 0;
+
+  FrameBitReader reader(padded + DELTA_HEADER_SIZE);
+  for (uint8_t i = 0; i < 6; i++) {
+    if (!(bitmap & (1 << i))) continue;
+    if (reader.read(1) == 0) {
+      // Sign-extend the small difference
+      int16_t difference = (int16_t)reader.read(DELTA_SMALL_BITS);
+      if (difference > DELTA_SMALL_MAX) difference -= 1 << DELTA_SMALL_BITS;
+      values[i] = unpackChannel(packChannel(values[i]) + difference);
+      bits += 1 + DELTA_SMALL_BITS;
+    } else {
+      values[i] = unpackChannel(reader.read(FRAME_CHANNEL_BITS));
+      bits += 1 + FRAME_CHANNEL_BITS;
+    }
+  }
+  if (bitmap & (1 << DELTA_SWITCHES)) {
+    result.aux3 = reader.read(1);
+    result.aux4 = reader.read(1);
+    result.aux5 = reader.read(1);
+    result.aux6 = reader.read(1);
+    result.aux7 = unpack3Way(reader.read(2));
+    result.aux8 = unpack3Way(reader.read(2));
+    result.receiver_id = reader.read(3);
+    bits += 11;
+  }
+  if (length < DELTA_HEADER_SIZE + (bits + 7) / 8) {
+    return false;
+  }
+
+  result.throttle = values[0];
+  result.pitch = values[1];
+  result.roll = values[2];
+  result.yaw = values[3];
+  result.aux1 = values[4];
+  result.aux2 = values[5];
+  result.timestamp = 0;
+  data = result;
+  sequence = padded[1];
+  base_sequence = padded[2];
+  return true;
+}
+
+// Transmitter side, one per receiver. encode() picks keyframe or delta;
+// acknowledge() is called when the frame it produced last was ACKed.
+class DeltaEncoder {
+private:
+  ChannelData base;
+  ChannelData sent;
+  uint8_t base_sequence;
+  uint8_t sent_sequence;
+  bool has_base;
+  bool sent_delta;
+  uint8_t since_keyframe;   // Deltas since a keyframe was ACKed
+
+public:
+  DeltaEncoder()
+    : base(), sent(), base_sequence(0), sent_sequence(0), has_base(false), sent_delta(false),
+      since_keyframe(0) {}
+
+  // Writes up to FRAME_SIZE bytes to out and returns the length
+  uint8_t encode(const ChannelData& data, uint8_t sequence, uint8_t* out) {
+    sent = data;
+    sent_sequence = sequence;
+
+    uint8_t age = sequence - base_sequence;
+    uint8_t delta[DELTA_MAX_SIZE];
+    uint8_t length = FRAME_SIZE;
+    if (has_base && age <= DELTA_HISTORY && since_keyframe < DELTA_KEYFRAME_INTERVAL) {
+      length = encodeDelta(data, base, sequence, base_sequence, delta);
+    }
+
+    sent_delta = length < FRAME_SIZE;
+    if (!sent_delta) {
+      return encodeFrame(data, sequence, out);
+    }
+    since_keyframe++;
+    for (uint8_t i = 0; i < length; i++) {
+      out[i] = delta[i];
+    }
+    return length;
+  }
+
+  void acknowledge() {
+    if (!sent_delta) since_keyframe = 0;
+    base = sent;
+    base_sequence = sent_sequence;
+    has_base = true;
+  }
+
+  // Forgets the base, so the next frame is a keyframe
+  void reset() {
+    has_base = false;
+  }
+
+  bool lastWasDelta() const { return sent_delta; }
+};
+
+// Receiver side: decodes keyframes and deltas whose base it still holds
+class DeltaDecoder {
+private:
+  ChannelData states[DELTA_HISTORY];
+  uint8_t sequences[DELTA_HISTORY];
+  uint8_t count;
+  uint8_t newest;
+
+  // Newest first, in case an older frame had the same sequence number
+  const ChannelData* find(uint8_t sequence) const {
+    for (uint8_t i = 0; i < count; i++) {
+      uint8_t index = (newest + DELTA_HISTORY - i) % DELTA_HISTORY;
+      if (sequences[index] == sequence) return &states[index];
+    }
+    return 0;
+  }
+
+public:
+  DeltaDecoder() : count(0), newest(0) {}
+
+  void reset() {
+    count = 0;
+  }
+
+  // Returns false for control frames, corrupt frames and deltas whose
+  // base has been lost; the frame is then ignored
+  bool decode(const uint8_t* in, uint8_t length, ChannelData& data, uint8_t& sequence) {
+    if (length > 0 && in[0] == FRAME_DELTA) {
+      uint8_t base_sequence = length > 2 ? in[2] : 0;
+      const ChannelData* base = find(base_sequence);
+      if (!base || !decodeDelta(in, length, *base, data, sequence, base_sequence)) {
+        return false;
+      }
+    } else if (!decodeFrame(in, length, data, sequence)) {
+      return false;
+    }
+
+    newest = count < DELTA_HISTORY ? count++ : (newest + 1) % DELTA_HISTORY;
+    states[newest] = data;
+    sequences[newest] = sequence;
+    return true;
+  }
+};
+
+#endif
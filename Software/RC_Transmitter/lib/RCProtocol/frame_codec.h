@@ -0,0 +1,152 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <stdint.h>
+#include "channel_data.h"
+
+// Over-the-air frame format (version 1), little-endian bit order:
+//
+//   byte 0      protocol version
+//   byte 1      sequence counter
+//   bits 0-65   throttle, pitch, roll, yaw, aux1, aux2 (11 bits each,
+//               stored with a +1024 offset)
+//   bits 66-69  aux3..aux6 switches
+//   bits 70-73  aux7, aux8 3-way switches (2 bits each, stored +1)
+//   bits 74-76  receiver id
+//   bits 77-79  reserved, zero
+//
+// The layout is defined bit by bit so transmitter and receiver agree
+// regardless of compiler padding or bitfield ordering.
+
+const uint8_t FRAME_PROTOCOL_VERSION = 1;
+const uint8_t FRAME_HEADER_SIZE = 2;
+const uint8_t FRAME_BODY_SIZE = 10;
+const uint8_t FRAME_SIZE = FRAME_HEADER_SIZE + FRAME_BODY_SIZE;
+
+const uint8_t FRAME_CHANNEL_BITS = 11;
+const int16_t FRAME_CHANNEL_OFFSET = 1 << (FRAME_CHANNEL_BITS - 1);
+const int16_t FRAME_CHANNEL_MIN = -FRAME_CHANNEL_OFFSET;
+const int16_t FRAME_CHANNEL_MAX = FRAME_CHANNEL_OFFSET - 1;
+
+// Sequential bit writer over a zero-initialised buffer
+class FrameBitWriter {
+private:
+  uint8_t* buffer;
+  uint16_t position;
+
+public:
+  explicit FrameBitWriter(uint8_t* out) : buffer(out), position(0) {}
+
+  void write(uint32_t value, uint8_t bits) {
+    while (bits > 0) {
+      uint8_t shift = position & 7;
+      uint8_t room = 8 - shift;
+      uint8_t take = bits < room ? bits : room;
+      buffer[position >> 3] |= (uint8_t)((value & ((1u << take) - 1)) << shift);
+      value >>= take;
+      bits -= take;
+      position += take;
+    }
+  }
+};
+
+// Sequential bit reader matching FrameBitWriter
+class FrameBitReader {
+private:
+  const uint8_t* buffer;
+  uint16_t position;
+
+public:
+  explicit FrameBitReader(const uint8_t* in) : buffer(in), position(0) {}
+
+  uint32_t read(uint8_t bits) {
+    uint32_t value = 0;
+    uint8_t filled = 0;
+    while (bits > 0) {
+      uint8_t shift = position & 7;
+      uint8_t room = 8 - shift;
+      uint8_t take = bits < room ? bits : room;
+      uint32_t chunk = (buffer[position >> 3] >> shift) & ((1u << take) - 1);
+      value |= chunk << filled;
+      filled += take;
+      bits -= take;
+      position += take;
+    }
+    return value;
+  }
+};
+
+inline uint32_t packChannel(int16_t value) {
+  if (value < FRAME_CHANNEL_MIN) value = FRAME_CHANNEL_MIN;
+  if (value > FRAME_CHANNEL_MAX) value = FRAME_CHANNEL_MAX;
+  return (uint32_t)(value + FRAME_CHANNEL_OFFSET);
+}
+
+inline int16_t unpackChannel(uint32_t bits) {
+  return (int16_t)((int16_t)bits - FRAME_CHANNEL_OFFSET);
+}
+
+inline uint32_t pack3Way(int8_t value) {
+  if (value < 0) return 0;
+  if (value > 0) return 2;
+  return 1;
+}
+
+inline int8_t unpack3Way(uint32_t bits) {
+  if (bits == 0) return -1;
+  if (bits == 2) return 1;
+  return 0;
+}
+
+// Writes FRAME_SIZE bytes to out and returns the number of bytes written
+inline uint8_t encodeFrame(const ChannelData& data, uint8_t sequence, uint8_t* out) {
+  for (uint8_t i = 0; i < FRAME_SIZE; i++) {
+    out[i] = 0;
+  }
+  out[0] = FRAME_PROTOCOL_VERSION;
+  out[1] = sequence;
+
+  FrameBitWriter writer(out + FRAME_HEADER_SIZE);
+  writer.write(packChannel(data.throttle), FRAME_CHANNEL_BITS);
+  writer.write(packChannel(data.pitch), FRAME_CHANNEL_BITS);
+  writer.write(packChannel(data.roll), FRAME_CHANNEL_BITS);
+  writer.write(packChannel(data.yaw), FRAME_CHANNEL_BITS);
+  writer.write(packChannel(data.aux1), FRAME_CHANNEL_BITS);
+  writer.write(packChannel(data.aux2), FRAME_CHANNEL_BITS);
+  writer.write(data.aux3, 1);
+  writer.write(data.aux4, 1);
+  writer.write(data.aux5, 1);
+  writer.write(data.aux6, 1);
+  writer.write(pack3Way(data.aux7), 2);
+  writer.write(pack3Way(data.aux8), 2);
+  writer.write(data.receiver_id, 3);
+  return FRAME_SIZE;
+}
+
+// Returns false if the frame is too short or from another protocol version.
+// The timestamp is not carried on air and is left at zero.
+inline bool decodeFrame(const uint8_t* in, uint8_t length, ChannelData& data, uint8_t& sequence) {
+  if (length < FRAME_SIZE || in[0] != FRAME_PROTOCOL_VERSION) {
+    return false;
+  }
+  sequence = in[1];
+
+  FrameBitReader reader(in + FRAME_HEADER_SIZE);
+  data.throttle = unpackChannel(reader.read(FRAME_CHANNEL_BITS));
+  data.pitch = unpackChannel(reader.read(FRAME_CHANNEL_BITS));
+  data.roll = unpackChannel(reader.read(FRAME_CHANNEL_BITS));
+  data.yaw = unpackChannel(reader.read(FRAME_CHANNEL_BITS));
+  data.aux1 = unpackChannel(reader.read(FRAME_CHANNEL_BITS));
+  data.aux2 = unpackChannel(reader.read(FRAME_CHANNEL_BITS));
+  data.aux3 = reader.read(1);
+  data.aux4 = reader.read(1);
+  data.aux5 = reader.read(1);
+  data.aux6 = reader.read(1);
+  data.aux7 = unpack3Way(reader.read(2));
+  data.aux8 = unpack3Way(reader.read(2));
+  data.receiver_id = reader.read(3);
+  data.timestamp = 0;
+  return true;
+}
+
+#endif
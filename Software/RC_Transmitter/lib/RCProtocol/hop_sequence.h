@@ -0,0 +1,166 @@
+#ifndef HOP_SEQUENCE_H
+#define HOP_SEQUENCE_H
+
+#include <stdint.h>
+#include <link_control.h>
+
+// Frequency hopping shared by both ends of a link. Each receiver hops over
+// HOP_CHANNEL_COUNT channels in an order derived from its pipe address, so
+// receivers sharing the band rarely sit on the same channel. The frame
+// sequence number selects the position in the order, so there is no hop
+// clock to keep in sync: a frame carries its own channel index. Channels
+// can be masked out by agreement (see LINK_COMMAND_SET_HOP_MASK); a masked
+// position is served by the next allowed channel in the order.
+
+const uint8_t HOP_CHANNEL_COUNT = 32;     // Divides 256, so sequence wraps line up
+const uint32_t HOP_ALL_CHANNELS = 0xFFFFFFFF;
+const uint8_t HOP_MIN_CHANNELS = 16;      // Masks never go below this many
+
+// RF channel of hop channel index, 2.5 MHz apart over 2402-2479 MHz so
+// neighbours never overlap even at 2 Mbps
+inline uint8_t hopChannel(uint8_t index) {
+  return 2 + index * 5 / 2;
+}
+
+inline uint8_t hopMaskCount(uint32_t mask) {
+  uint8_t count = 0;
+  for (; mask; mask &= mask - 1) count++;
+  return count;
+}
+
+class HopSequence {
+private:
+  uint8_t order[HOP_CHANNEL_COUNT];   // Channel index at each position
+  uint32_t mask;
+
+public:
+  HopSequence() : mask(HOP_ALL_CHANNELS) {
+    for (uint8_t i = 0; i < HOP_CHANNEL_COUNT; i++) order[i] = i;
+  }
+
+  // Shuffles the order with a generator seeded from the pipe address
+  void bind(uint64_t address) {
+    uint32_t state = (uint32_t)address ^ ((uint32_t)(address >> 32) * 0x9E3779B9u);
+    if (state == 0) state = 1;
+
+    for (uint8_t i = 0; i < HOP_CHANNEL_COUNT; i++) order[i] = i;
+    for (uint8_t i = HOP_CHANNEL_COUNT - 1; i > 0; i--) {
+      // xorshift32
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      uint8_t j = state % (i + 1);
+      uint8_t swap = order[i];
+      order[i] = order[j];
+      order[j] = swap;
+    }
+  }
+
+  // Ignored unless it leaves at least HOP_MIN_CHANNELS
+  void setMask(uint32_t value) {
+    if (hopMaskCount(value) >= HOP_MIN_CHANNELS) mask = value;
+  }
+
+  uint32_t channelMask() const { return mask; }
+
+  // Hop channel index used for the frame with this sequence number
+  uint8_t channelIndex(uint8_t sequence) const {
+    for (uint8_t step = 0; step < HOP_CHANNEL_COUNT; step++) {
+      uint8_t index = order[(sequence + step) % HOP_CHANNEL_COUNT];
+      if (mask & (1UL << index)) return index;
+    }
+    return order[sequence % HOP_CHANNEL_COUNT];
+  }
+
+  uint8_t channel(uint8_t sequence) const {
+    return hopChannel(channelIndex(sequence));
+  }
+};
+
+// Receiver side. Pass every received frame to onFrame() and tune to
+// channel() before each expected frame. Once two frame spacings agree,
+// frames that do not arrive are stepped over on that spacing, for
+// LINK_LOST_MS or HOP_TRACK_FRAMES frames, whichever is longer. Until then
+// the receiver waits on the channel of the next sequence number, which the
+// transmitter comes back to once per pass through the order even if that
+// frame is lost.
+//
+// Past that the link counts as lost and both ends go back to all channels.
+// The receiver then alternates, one pass through the order each: stepping
+// on as before, which picks the link up at once if the transmitter kept its
+// rate, and parking on one channel. Each parking pass tries the next
+// channel in case the last one was jammed.
+
+const uint8_t HOP_TRACK_FRAMES = 8;
+const uint32_t HOP_MIN_PERIOD_US = 5000;        // One TDMA slot
+const uint32_t HOP_MAX_PERIOD_US = 200000;      // One slot per TDMA cycle
+
+class HopFollower {
+private:
+  HopSequence hops;
+  bool heard;
+  bool steady;                  // The last two spacings agreed
+  uint8_t last_sequence;
+  uint32_t last_frame_us;
+  uint32_t period_us;           // Smoothed spacing between frames
+
+public:
+  HopFollower() : heard(false), steady(false), last_sequence(0), last_frame_us(0), period_us(0) {}
+
+  void bind(uint64_t address) {
+    hops.bind(address);
+  }
+
+  // Returns true if the frame changed the channel mask
+  bool onFrame(const uint8_t* in, uint8_t length, uint32_t now_us) {
+    if (length < 2) return false;
+    uint8_t sequence = in[1];
+
+    // The sequence cannot have wrapped in less than 256 of the fastest frames
+    uint8_t frames = sequence - last_sequence;
+    uint32_t elapsed_us = now_us - last_frame_us;
+    if (heard && frames > 0 && elapsed_us < 256 * HOP_MIN_PERIOD_US) {
+      uint32_t spacing = elapsed_us / frames;
+      uint32_t difference = spacing > period_us ? spacing - period_us : period_us - spacing;
+      steady = difference <= period_us / 4;
+      period_us = steady ? period_us - period_us / 4 + spacing / 4 : spacing;
+    }
+    heard = true;
+    last_sequence = sequence;
+    last_frame_us = now_us;
+
+    uint32_t mask;
+    if (decodeHopMask(in, length, mask) && mask != hops.channelMask()) {
+      hops.setMask(mask);
+      return true;
+    }
+    return false;
+  }
+
+  // Channel the next frame is expected on
+  uint8_t channel(uint32_t now_us) {
+    uint32_t silent_us = now_us - last_frame_us;
+    uint32_t frames = steady ? (silent_us + period_us / 2) / period_us : 0;
+    if (frames == 0) frames = 1;
+
+    if (heard && silent_us < LINK_LOST_MS * 1000) {
+      return hops.channel(last_sequence + frames);
+    }
+    if (heard && steady && frames <= HOP_TRACK_FRAMES) {
+      return hops.channel(last_sequence + frames);
+    }
+
+    hops.setMask(HOP_ALL_CHANNELS);
+    uint32_t lost_us = heard ? silent_us - LINK_LOST_MS * 1000 : now_us;
+    uint32_t pass_us = (HOP_CHANNEL_COUNT + 1) * (steady ? period_us : HOP_MAX_PERIOD_US);
+    uint32_t passes = lost_us / pass_us;
+    if (steady && passes % 2 == 0) {
+      return hops.channel(last_sequence + frames);
+    }
+    return hops.channel(last_sequence + 1 + passes / 2);
+  }
+
+  const HopSequence& sequence() const { return hops; }
+};
+
+#endif
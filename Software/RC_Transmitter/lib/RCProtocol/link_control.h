@@ -0,0 +1,167 @@
+#ifndef LINK_CONTROL_H
+#define LINK_CONTROL_H
+
+#include <stdint.h>
+
+// Radio settings both ends of a link must agree on, ordered from the
+// cheapest in air time and power to the most robust. Rate and PA values
+// match the RF24 library enums; retry delay is in 250 us steps past 250 us.
+struct LinkProfile {
+  uint8_t data_rate;        // 0 = 1 Mbps, 1 = 2 Mbps, 2 = 250 kbps
+  uint8_t pa_level;         // 0 = min .. 3 = max
+  uint8_t retry_delay;
+  uint8_t retry_count;
+};
+
+const uint8_t LINK_PROFILE_COUNT = 5;
+const LinkProfile LINK_PROFILES[LINK_PROFILE_COUNT] = {
+  { 1, 1, 1, 3 },           // 2 Mbps, low power
+  { 1, 2, 1, 5 },           // 2 Mbps, high power
+  { 1, 3, 1, 5 },           // 2 Mbps, max power
+  { 0, 3, 2, 3 },           // 1 Mbps, max power
+  { 2, 3, 5, 1 },           // 250 kbps, max power
+};
+const uint8_t LINK_DEFAULT_PROFILE = 2;
+const uint8_t LINK_FALLBACK_PROFILE = LINK_PROFILE_COUNT - 1;
+
+// Both ends drop to the fallback profile after this long without traffic
+const uint32_t LINK_LOST_MS = 1000;
+// A receiver undoes a switch if nothing arrives on the new profile in time
+const uint32_t LINK_SWITCH_TIMEOUT_MS = 500;
+
+// In-band control frame, sent in place of a data frame:
+//
+//   byte 0      LINK_CONTROL_FRAME (data frames carry the protocol version)
+//   byte 1      sequence counter, shared with data frames
+//   byte 2      command
+//   bytes 3..   argument: profile index (SET_PROFILE), the hop channel
+//               mask, little-endian uint32 (SET_HOP_MASK), or the
+//               transmitter's micros() when it was queued (PROBE)
+//
+// The receiver switches right after its auto-ACK has gone out; the
+// transmitter switches once that ACK arrives, so both change in lock-step.
+// A probe changes nothing; the receiver echoes its stamp in the telemetry
+// of the next ACK, which goes out with the frame after the probe.
+
+const uint8_t LINK_CONTROL_FRAME = 0x80;
+const uint8_t LINK_CONTROL_SIZE = 4;
+const uint8_t LINK_HOP_MASK_SIZE = 7;
+const uint8_t LINK_PROBE_SIZE = 7;
+const uint8_t LINK_COMMAND_SET_PROFILE = 1;
+const uint8_t LINK_COMMAND_SET_HOP_MASK = 2;
+const uint8_t LINK_COMMAND_PROBE = 3;
+
+inline uint8_t encodeLinkControl(uint8_t profile, uint8_t sequence, uint8_t* out) {
+  out[0] = LINK_CONTROL_FRAME;
+  out[1] = sequence;
+  out[2] = LINK_COMMAND_SET_PROFILE;
+  out[3] = profile;
+  return LINK_CONTROL_SIZE;
+}
+
+// Returns false unless in is a valid set-profile control frame
+inline bool decodeLinkControl(const uint8_t* in, uint8_t length, uint8_t& profile) {
+  if (length < LINK_CONTROL_SIZE || in[0] != LINK_CONTROL_FRAME ||
+      in[2] != LINK_COMMAND_SET_PROFILE || in[3] >= LINK_PROFILE_COUNT) {
+    return false;
+  }
+  profile = in[3];
+  return true;
+}
+
+inline uint8_t encodeHopMask(uint32_t mask, uint8_t sequence, uint8_t* out) {
+  out[0] = LINK_CONTROL_FRAME;
+  out[1] = sequence;
+  out[2] = LINK_COMMAND_SET_HOP_MASK;
+  for (uint8_t i = 0; i < 4; i++) {
+    out[3 + i] = (mask >> (8 * i)) & 0xFF;
+  }
+  return LINK_HOP_MASK_SIZE;
+}
+
+// Returns false unless in is a valid set-hop-mask control frame
+inline bool decodeHopMask(const uint8_t* in, uint8_t length, uint32_t& mask) {
+  if (length < LINK_HOP_MASK_SIZE || in[0] != LINK_CONTROL_FRAME || in[2] != LINK_COMMAND_SET_HOP_MASK) {
+    return false;
+  }
+  mask = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    mask |= (uint32_t)in[3 + i] << (8 * i);
+  }
+  return true;
+}
+
+inline uint8_t encodeProbe(uint32_t stamp_us, uint8_t sequence, uint8_t* out) {
+  out[0] = LINK_CONTROL_FRAME;
+  out[1] = sequence;
+  out[2] = LINK_COMMAND_PROBE;
+  for (uint8_t i = 0; i < 4; i++) {
+    out[3 + i] = (stamp_us >> (8 * i)) & 0xFF;
+  }
+  return LINK_PROBE_SIZE;
+}
+
+// Returns false unless in is a valid latency probe
+inline bool decodeProbe(const uint8_t* in, uint8_t length, uint32_t& stamp_us) {
+  if (length < LINK_PROBE_SIZE || in[0] != LINK_CONTROL_FRAME || in[2] != LINK_COMMAND_PROBE) {
+    return false;
+  }
+  stamp_us = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    stamp_us |= (uint32_t)in[3 + i] << (8 * i);
+  }
+  return true;
+}
+
+// Receiver side of the profile handshake. Feed every received frame to
+// onFrame() and call poll() regularly; apply profile() to the radio
+// whenever either returns true.
+class LinkFollower {
+private:
+  uint8_t current;
+  uint8_t previous;
+  bool confirmed;           // A frame arrived since the last switch
+  uint32_t last_frame_ms;
+  uint32_t switched_ms;
+
+public:
+  LinkFollower()
+    : current(LINK_DEFAULT_PROFILE), previous(LINK_DEFAULT_PROFILE), confirmed(true),
+      last_frame_ms(0), switched_ms(0) {}
+
+  bool onFrame(const uint8_t* in, uint8_t length, uint32_t now_ms) {
+    last_frame_ms = now_ms;
+    confirmed = true;
+
+    uint8_t requested;
+    if (!decodeLinkControl(in, length, requested) || requested == current) {
+      return false;
+    }
+    previous = current;
+    current = requested;
+    confirmed = false;
+    switched_ms = now_ms;
+    return true;
+  }
+
+  bool poll(uint32_t now_ms) {
+    if (!confirmed && now_ms - switched_ms >= LINK_SWITCH_TIMEOUT_MS) {
+      // The transmitter never followed, go back
+      current = previous;
+      confirmed = true;
+      last_frame_ms = now_ms;
+      return true;
+    }
+    if (current != LINK_FALLBACK_PROFILE && now_ms - last_frame_ms >= LINK_LOST_MS) {
+      previous = current;
+      current = LINK_FALLBACK_PROFILE;
+      last_frame_ms = now_ms;
+      return true;
+    }
+    return false;
+  }
+
+  uint8_t profile() const { return current; }
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef PIPE_ADDRESSES_H
+#define PIPE_ADDRESSES_H
+
+#include <stdint.h>
+
+// Receiver slots and the pipe address each one listens on. Receiver
+// firmware is built for one slot (RECEIVER_ID) and the transmitter
+// addresses it by the same index.
+const uint8_t MAX_RECEIVERS = 8;
+const uint64_t BASE_PIPES[MAX_RECEIVERS] = {
+  0xF0F0F0F0E1LL, 0xF0F0F0F0E2LL, 0xF0F0F0F0E3LL, 0xF0F0F0F0E4LL,
+  0xF0F0F0F0E5LL, 0xF0F0F0F0E6LL, 0xF0F0F0F0E7LL, 0xF0F0F0F0E8LL
+};
+
+// Channel used by receivers that do not hop, unless configured otherwise
+const uint8_t RADIO_CHANNEL = 76;
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef RECEIVER_ENDPOINT_H
+#define RECEIVER_ENDPOINT_H
+
+#include <stdint.h>
+#include "channel_data.h"
+#include "delta_codec.h"
+#include "link_control.h"
+#include "hop_sequence.h"
+#include "telemetry_codec.h"
+#include "pipe_addresses.h"
+
+// Receiver end of one link with no hardware behind it: frames go in with
+// their arrival time, servo pulse widths and the radio settings to apply
+// come out. The receiver firmware and the native simulator's mock receivers
+// both run it.
+//
+// Outputs follow the newest decoded data frame. When none has arrived for
+// the failsafe timeout, each output moves to its failsafe pulse, or keeps
+// its last pulse if it has none; the first decodable frame ends failsafe.
+// Before any frame has arrived outputs with no failsafe pulse stay off.
+
+const uint8_t RECEIVER_MAX_OUTPUTS = 16;
+const uint8_t RECEIVER_SOURCE_COUNT = 12;   // throttle..aux2, aux3..aux6, aux7, aux8
+const uint8_t RECEIVER_NO_SOURCE = 0xFF;
+
+const uint16_t PULSE_MIN_US = 1000;
+const uint16_t PULSE_MID_US = 1500;
+const uint16_t PULSE_MAX_US = 2000;
+const uint16_t PULSE_OFF = 0;               // No pulses on the output
+const uint16_t FAILSAFE_HOLD = 0;           // Keep the last pulse on failsafe
+
+const uint16_t RECEIVER_FAILSAFE_MS = 500;
+const uint16_t RECEIVER_MIN_FAILSAFE_MS = 100;
+const uint16_t RECEIVER_MAX_FAILSAFE_MS = 10000;
+
+// onFrame() and poll() results
+const uint8_t RECEIVER_DATA = 0x01;         // Outputs follow a new frame
+const uint8_t RECEIVER_PROFILE = 0x02;      // Apply profile() to the radio
+const uint8_t RECEIVER_HOP_MASK = 0x04;     // The hop channel mask changed
+const uint8_t RECEIVER_UNDECODABLE = 0x08;  // A data frame whose base is gone
+const uint8_t RECEIVER_FAILSAFE = 0x10;     // Outputs went to failsafe
+
+enum ReceiverState { RECEIVER_WAITING, RECEIVER_ACTIVE, RECEIVER_IN_FAILSAFE };
+
+struct ReceiverSettings {
+  uint16_t failsafe_ms;
+  uint8_t hopping;                                  // Follow the hop sequence
+  uint8_t channel;                                  // RF channel when not hopping
+  uint8_t sources[RECEIVER_MAX_OUTPUTS];            // Channel each output follows
+  uint16_t failsafe_us[RECEIVER_MAX_OUTPUTS];       // FAILSAFE_HOLD keeps the last pulse
+};
+
+// One output per channel in ChannelData order. Throttle cuts to the bottom
+// of its range and the sticks centre; bidirectional ESCs want the throttle
+// failsafe at PULSE_MID_US instead. Pots and switches hold.
+inline void defaultReceiverSettings(ReceiverSettings& settings) {
+  settings.failsafe_ms = RECEIVER_FAILSAFE_MS;
+  settings.hopping = 1;
+  settings.channel = RADIO_CHANNEL;
+  for (uint8_t i = 0; i < RECEIVER_MAX_OUTPUTS; i++) {
+    settings.sources[i] = i < RECEIVER_SOURCE_COUNT ? i : RECEIVER_NO_SOURCE;
+    settings.failsafe_us[i] = FAILSAFE_HOLD;
+  }
+  settings.failsafe_us[0] = PULSE_MIN_US;
+  settings.failsafe_us[1] = PULSE_MID_US;
+  settings.failsafe_us[2] = PULSE_MID_US;
+  settings.failsafe_us[3] = PULSE_MID_US;
+}
+
+// Sticks and pots (-511..512) span PULSE_MIN_US..PULSE_MAX_US
+inline uint16_t analogPulse(int16_t value) {
+  int32_t pulse = PULSE_MID_US + (int32_t)value * (PULSE_MAX_US - PULSE_MID_US) / 512;
+  if (pulse < PULSE_MIN_US) return PULSE_MIN_US;
+  if (pulse > PULSE_MAX_US) return PULSE_MAX_US;
+  return (uint16_t)pulse;
+}
+
+inline uint16_t switchPulse(int8_t position) {
+  return position < 0 ? PULSE_MIN_US : (position > 0 ? PULSE_MAX_US : PULSE_MID_US);
+}
+
+// Pulse width for one ChannelData channel, by source index
+inline uint16_t channelPulse(const ChannelData& data, uint8_t source) {
+  switch (source) {
+    case 0: return analogPulse(data.throttle);
+    case 1: return analogPulse(data.pitch);
+    case 2: return analogPulse(data.roll);
+    case 3: return analogPulse(data.yaw);
+    case 4: return analogPulse(data.aux1);
+    case 5: return analogPulse(data.aux2);
+    case 6: return data.aux3 ? PULSE_MAX_US : PULSE_MIN_US;
+    case 7: return data.aux4 ? PULSE_MAX_US : PULSE_MIN_US;
+    case 8: return data.aux5 ? PULSE_MAX_US : PULSE_MIN_US;
+    case 9: return data.aux6 ? PULSE_MAX_US : PULSE_MIN_US;
+    case 10: return switchPulse(data.aux7);
+    case 11: return switchPulse(data.aux8);
+    default: return PULSE_OFF;
+  }
+}
+
+class ReceiverEndpoint {
+private:
+  LinkFollower follower;
+  HopFollower hop;
+  DeltaDecoder decoder;
+  ChannelData channels;         // Newest decoded data frame
+  ReceiverState current;
+  bool heard;
+  uint8_t last_sequence;
+  uint32_t last_data_ms;
+  uint32_t frame_count;
+  uint16_t frames_lost;
+  uint16_t quality;             // % x256 of frames received, smoothed
+  uint32_t failsafe_count;
+  bool echo_pending;            // The last frame was a latency probe
+  uint32_t probe_us;
+
+public:
+  ReceiverEndpoint()
+    : channels(), current(RECEIVER_WAITING), heard(false), last_sequence(0), last_data_ms(0),
+      frame_count(0), frames_lost(0), quality(100 * 256), failsafe_count(0),
+      echo_pending(false), probe_us(0) {}
+
+  void bind(uint64_t address) {
+    hop.bind(address);
+  }
+
+  // Every frame the radio delivers, data or control
+  uint8_t onFrame(const uint8_t* in, uint8_t length, uint32_t now_us, uint32_t now_ms) {
+    if (length < 2) return 0;
+    uint8_t events = 0;
+
+    // Sequence gaps are frames that never arrived
+    uint8_t missed = heard ? (uint8_t)(in[1] - last_sequence - 1) : 0;
+    for (uint8_t i = 0; i < missed; i++) {
+      quality -= quality / 32;
+    }
+    quality = quality - quality / 32 + 100 * 256 / 32;
+    frames_lost += missed;
+    last_sequence = in[1];
+    heard = true;
+    frame_count++;
+    echo_pending = decodeProbe(in, length, probe_us);
+
+    if (in[0] != LINK_CONTROL_FRAME) {
+      ChannelData data;
+      uint8_t sequence;
+      if (decoder.decode(in, length, data, sequence)) {
+        channels = data;
+        last_data_ms = now_ms;
+        current = RECEIVER_ACTIVE;
+        events |= RECEIVER_DATA;
+      } else {
+        events |= RECEIVER_UNDECODABLE;
+      }
+    }
+
+    // Switches apply once the ACK for this frame has gone out
+    if (follower.onFrame(in, length, now_ms)) events |= RECEIVER_PROFILE;
+    if (hop.onFrame(in, length, now_us)) events |= RECEIVER_HOP_MASK;
+    return events;
+  }
+
+  // Call at least once per millisecond or so between frames
+  uint8_t poll(const ReceiverSettings& settings, uint32_t now_ms) {
+    uint8_t events = 0;
+    if (follower.poll(now_ms)) events |= RECEIVER_PROFILE;
+    if (current == RECEIVER_ACTIVE && now_ms - last_data_ms >= settings.failsafe_ms) {
+      current = RECEIVER_IN_FAILSAFE;
+      failsafe_count++;
+      events |= RECEIVER_FAILSAFE;
+    }
+    return events;
+  }
+
+  // Pulse width for every output, PULSE_OFF for none
+  void outputs(const ReceiverSettings& settings, uint16_t* pulse_us) const {
+    for (uint8_t i = 0; i < RECEIVER_MAX_OUTPUTS; i++) {
+      uint16_t live = current == RECEIVER_WAITING ? PULSE_OFF : channelPulse(channels, settings.sources[i]);
+      bool failed = current != RECEIVER_ACTIVE && settings.failsafe_us[i] != FAILSAFE_HOLD;
+      pulse_us[i] = failed ? settings.failsafe_us[i] : live;
+    }
+  }
+
+  // Radio channel to listen on for the next frame
+  uint8_t channel(const ReceiverSettings& settings, uint32_t now_us) {
+    return settings.hopping ? hop.channel(now_us) : settings.channel;
+  }
+
+  // Link fields of the next ACK payload, and the probe stamp to echo after
+  // a probe; battery, sensors and the receiver's own timings are the caller's
+  void fillTelemetry(TelemetrySample& sample) const {
+    sample.link_quality = (uint8_t)((quality + 128) / 256);
+    sample.frames_lost = frames_lost;
+    sample.last_sequence = last_sequence;
+    sample.echo = echo_pending;
+    sample.probe_us = probe_us;
+  }
+
+  ReceiverState state() const { return current; }
+  uint8_t profile() const { return follower.profile(); }
+  const ChannelData& channelData() const { return channels; }
+  const HopSequence& hopSequence() const { return hop.sequence(); }
+  uint32_t frames() const { return frame_count; }
+  uint16_t framesLost() const { return frames_lost; }
+  uint32_t failsafes() const { return failsafe_count; }
+};
+
+#endif
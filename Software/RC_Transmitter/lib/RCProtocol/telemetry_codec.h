@@ -0,0 +1,121 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdint.h>
+
+// Receiver-to-transmitter telemetry carried in auto-ACK payloads
+// (version 1), little-endian:
+//
+//   byte 0      protocol version
+//   byte 1      bits 0-2 sensor word count, bit 3 echo block follows,
+//               bits 4-7 reserved
+//   bytes 2-3   battery voltage, mV
+//   byte 4      link quality, % of frames received over the receiver's
+//               recent window (stands in for RSSI, which the nRF24 lacks)
+//   bytes 5-6   frames lost, counted by the receiver from sequence gaps
+//   byte 7      sequence of the last frame the receiver got
+//   bytes 8..   sensor words, int16 each
+//
+// Echo block, after the sensor words, in answer to a latency probe:
+//
+//   bytes 0-3   stamp of the probe, the transmitter's micros()
+//   bytes 4-5   frame IRQ to decoded, us, newest data frame
+//   bytes 6-7   frame IRQ to servo outputs written, us, newest data frame
+//
+// The receiver preloads the payload for the next ACK, so each sample
+// describes the state up to the previous frame.
+
+const uint8_t TELEMETRY_PROTOCOL_VERSION = 1;
+const uint8_t TELEMETRY_HEADER_SIZE = 8;
+const uint8_t TELEMETRY_MAX_SENSORS = 4;
+const uint8_t TELEMETRY_ECHO = 0x08;
+const uint8_t TELEMETRY_ECHO_SIZE = 8;
+const uint8_t TELEMETRY_MAX_SIZE = TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_SENSORS * 2 + TELEMETRY_ECHO_SIZE;
+
+struct TelemetrySample {
+  uint16_t battery_mv;
+  uint8_t link_quality;
+  uint16_t frames_lost;
+  uint8_t last_sequence;
+  uint8_t sensor_count;
+  int16_t sensors[TELEMETRY_MAX_SENSORS];
+  bool echo;                // The fields below answer a probe
+  uint32_t probe_us;
+  uint16_t rx_decode_us;
+  uint16_t rx_output_us;
+  uint32_t timestamp;       // Local arrival time, not carried on air
+};
+
+// Writes the payload to out and returns its length
+inline uint8_t encodeTelemetry(const TelemetrySample& sample, uint8_t* out) {
+  uint8_t count = sample.sensor_count < TELEMETRY_MAX_SENSORS ? sample.sensor_count : TELEMETRY_MAX_SENSORS;
+
+  out[0] = TELEMETRY_PROTOCOL_VERSION;
+  out[1] = count | (sample.echo ? TELEMETRY_ECHO : 0);
+  out[2] = sample.battery_mv & 0xFF;
+  out[3] = sample.battery_mv >> 8;
+  out[4] = sample.link_quality;
+  out[5] = sample.frames_lost & 0xFF;
+  out[6] = sample.frames_lost >> 8;
+  out[7] = sample.last_sequence;
+  for (uint8_t i = 0; i < count; i++) {
+    uint16_t word = (uint16_t)sample.sensors[i];
+    out[TELEMETRY_HEADER_SIZE + i * 2] = word & 0xFF;
+    out[TELEMETRY_HEADER_SIZE + i * 2 + 1] = word >> 8;
+  }
+  uint8_t length = TELEMETRY_HEADER_SIZE + count * 2;
+  if (!sample.echo) return length;
+
+  uint8_t* echo = out + length;
+  for (uint8_t i = 0; i < 4; i++) {
+    echo[i] = (sample.probe_us >> (8 * i)) & 0xFF;
+  }
+  echo[4] = sample.rx_decode_us & 0xFF;
+  echo[5] = sample.rx_decode_us >> 8;
+  echo[6] = sample.rx_output_us & 0xFF;
+  echo[7] = sample.rx_output_us >> 8;
+  return length + TELEMETRY_ECHO_SIZE;
+}
+
+// Returns false if the payload is truncated or from another version.
+// The timestamp is left untouched.
+inline bool decodeTelemetry(const uint8_t* in, uint8_t length, TelemetrySample& sample) {
+  if (length < TELEMETRY_HEADER_SIZE || in[0] != TELEMETRY_PROTOCOL_VERSION) {
+    return false;
+  }
+  uint8_t count = in[1] & 0x07;
+  bool echo = (in[1] & TELEMETRY_ECHO) != 0;
+  if (count > TELEMETRY_MAX_SENSORS ||
+      length < TELEMETRY_HEADER_SIZE + count * 2 + (echo ? TELEMETRY_ECHO_SIZE : 0)) {
+    return false;
+  }
+
+  sample.battery_mv = (uint16_t)in[2] | ((uint16_t)in[3] << 8);
+  sample.link_quality = in[4];
+  sample.frames_lost = (uint16_t)in[5] | ((uint16_t)in[6] << 8);
+  sample.last_sequence = in[7];
+  sample.sensor_count = count;
+  for (uint8_t i = 0; i < TELEMETRY_MAX_SENSORS; i++) {
+    uint16_t word = 0;
+    if (i < count) {
+      word = (uint16_t)in[TELEMETRY_HEADER_SIZE + i * 2] | ((uint16_t)in[TELEMETRY_HEADER_SIZE + i * 2 + 1] << 8);
+    }
+    sample.sensors[i] = (int16_t)word;
+  }
+
+  sample.echo = echo;
+  sample.probe_us = 0;
+  sample.rx_decode_us = 0;
+  sample.rx_output_us = 0;
+  if (echo) {
+    const uint8_t* block = in + TELEMETRY_HEADER_SIZE + count * 2;
+    for (uint8_t i = 0; i < 4; i++) {
+      sample.probe_us |= (uint32_t)block[i] << (8 * i);
+    }
+    sample.rx_decode_us = (uint16_t)block[4] | ((uint16_t)block[5] << 8);
+    sample.rx_output_us = (uint16_t)block[6] | ((uint16_t)block[7] << 8);
+  }
+  return true;
+}
+
+#endif
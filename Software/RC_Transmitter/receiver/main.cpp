@@ -0,0 +1,383 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include <nRF24L01.h>
+#include <RF24.h>
+#include <Preferences.h>
+#include <receiver_endpoint.h>
+#include <telemetry_codec.h>
+
+#include "receiver_config.h"
+#include "servo_outputs.h"
+#include "latest_value.h"
+
+// Reference receiver: one nRF24L01 listening on BASE_PIPES[RECEIVER_ID]
+// and up to RECEIVER_MAX_OUTPUTS servo/ESC outputs.
+//
+// The radio IRQ wakes the radio task, which drains the RX FIFO through the
+// ReceiverEndpoint, preloads telemetry for the next ACK, follows profile
+// and hop changes, and publishes the resulting pulse widths. The output
+// task takes the newest pulses and writes them to LEDC. Between frames the
+// radio task wakes every millisecond to retune for the next hop and to run
+// the failsafe timeout. Serial and battery sampling stay in loop().
+
+// Global Objects
+RF24 radio(RX_CE_PIN, RX_CSN_PIN);
+ServoOutputs servo_outputs;
+Preferences preferences;
+
+// Link state, owned by the radio task
+ReceiverEndpoint endpoint;
+ReceiverSettings receiver_settings;
+uint8_t tuned_channel = 0;
+uint8_t applied_profile = LINK_PROFILE_COUNT;
+
+// Pulses handed from the radio task to the output task, with the IRQ time
+// of the frame they follow (0 if they follow a failsafe or a setting)
+struct OutputFrame {
+  uint16_t pulse_us[RECEIVER_MAX_OUTPUTS];
+  uint32_t arrival_us;
+};
+LatestValue<OutputFrame> latest_outputs;
+
+// Frame IRQ to LEDC write, measured by the output task. The pulse itself
+// starts with the next output period, up to 1000000 / OUTPUT_RATE_HZ later.
+struct LatencyStats {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+};
+LatencyStats output_latency;
+volatile bool latency_reset = false;
+
+// Newest frame IRQ to decoded and to LEDC write, echoed to latency probes
+uint32_t decode_us = 0;
+volatile uint32_t output_us = 0;
+
+volatile uint32_t irq_us = 0;
+volatile uint16_t battery_mv = 0;
+volatile bool settings_dirty = false;    // Saved by loop()
+volatile bool settings_applied = true;   // Outputs republished by the radio task
+TaskHandle_t radio_task = NULL;
+TaskHandle_t output_task = NULL;
+
+// Tasks
+const BaseType_t RADIO_TASK_CORE = 1;
+const UBaseType_t RADIO_TASK_PRIORITY = configMAX_PRIORITIES - 2;
+const UBaseType_t OUTPUT_TASK_PRIORITY = configMAX_PRIORITIES - 3;
+const uint32_t RADIO_TASK_STACK = 4096;
+const uint32_t OUTPUT_TASK_STACK = 3072;
+const uint32_t BATTERY_INTERVAL_MS = 100;
+
+// Partial command line collected across calls
+char command_line[24];
+uint8_t command_length = 0;
+
+//Function Prototypes
+bool initializeRadio();
+void applyLinkProfile(uint8_t profile);
+void loadAckPayload();
+void publishOutputs(uint32_t arrival_us);
+void radioStep();
+void radioTask(void* param);
+void outputTask(void* param);
+void onRadioIrq();
+void loadSettings();
+void saveSettings();
+void handleSerialCommands();
+void printStatus();
+void printOutputs();
+void captureFailsafe();
+void collectCommandLine(char c);
+void applyCommandLine(const char* line);
+
+void setup() {
+  Serial.begin(115200);
+
+  loadSettings();
+  endpoint.bind(BASE_PIPES[RECEIVER_ID]);
+
+  // Outputs stay quiet until a frame or a failsafe pulse sets them
+  if (!servo_outputs.begin(OUTPUT_PINS, OUTPUT_COUNT, OUTPUT_RATE_HZ)) {
+    Serial.println("Servo output initialization failed!");
+  }
+
+  if (!initializeRadio()) {
+    Serial.println("Radio initialization failed!");
+    while(1);
+  }
+
+  xTaskCreatePinnedToCore(outputTask, "outputs", OUTPUT_TASK_STACK, NULL,
+                          OUTPUT_TASK_PRIORITY, &output_task, RADIO_TASK_CORE);
+  xTaskCreatePinnedToCore(radioTask, "radio", RADIO_TASK_STACK, NULL,
+                          RADIO_TASK_PRIORITY, &radio_task, RADIO_TASK_CORE);
+  pinMode(RX_IRQ_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(RX_IRQ_PIN), onRadioIrq, FALLING);
+
+  Serial.printf("Receiver %u initialized on %010llX\n", RECEIVER_ID,
+                (unsigned long long)BASE_PIPES[RECEIVER_ID]);
+}
+
+void loop() {
+  static uint32_t last_battery_ms = 0;
+  uint32_t now = millis();
+  if (now - last_battery_ms >= BATTERY_INTERVAL_MS) {
+    battery_mv = (uint16_t)(analogReadMilliVolts(BATTERY_PIN) * BATTERY_DIVIDER);
+    last_battery_ms = now;
+  }
+
+  if (settings_dirty) {
+    settings_dirty = false;
+    saveSettings();
+  }
+
+  handleSerialCommands();
+  delay(10);
+}
+
+bool initializeRadio() {
+  if (!radio.begin()) {
+    return false;
+  }
+
+  // Same framing as the transmitter: dynamic payloads, telemetry on the ACKs
+  applyLinkProfile(LINK_DEFAULT_PROFILE);
+  radio.setCRCLength(RF24_CRC_16);
+  radio.enableDynamicPayloads();
+  radio.enableAckPayload();
+  radio.openReadingPipe(1, BASE_PIPES[RECEIVER_ID]);
+
+  tuned_channel = endpoint.channel(receiver_settings, micros());
+  radio.setChannel(tuned_channel);
+
+  // Only received frames raise the IRQ line
+  radio.maskIRQ(true, true, false);
+  radio.startListening();
+  loadAckPayload();
+  return true;
+}
+
+// Only the data rate matters for receiving; the PA level applies to the ACKs
+void applyLinkProfile(uint8_t profile) {
+  const LinkProfile& link = LINK_PROFILES[profile];
+  radio.setDataRate((rf24_datarate_e)link.data_rate);
+  radio.setPALevel(link.pa_level);
+  applied_profile = profile;
+}
+
+// Replaces whatever ACK payload is still queued with the current state
+void loadAckPayload() {
+  TelemetrySample sample = {};
+  sample.battery_mv = battery_mv;
+  endpoint.fillTelemetry(sample);
+  sample.rx_decode_us = decode_us < UINT16_MAX ? decode_us : UINT16_MAX;
+  uint32_t output = output_us;
+  sample.rx_output_us = output < UINT16_MAX ? output : UINT16_MAX;
+
+  uint8_t payload[TELEMETRY_MAX_SIZE];
+  uint8_t length = encodeTelemetry(sample, payload);
+  radio.flush_tx();
+  radio.writeAckPayload(1, payload, length);
+}
+
+void publishOutputs(uint32_t arrival_us) {
+  OutputFrame frame;
+  endpoint.outputs(receiver_settings, frame.pulse_us);
+  frame.arrival_us = arrival_us;
+  latest_outputs.publish(frame);
+  xTaskNotifyGive(output_task);
+}
+
+void radioStep() {
+  uint32_t arrival_us = irq_us;
+  uint8_t events = 0;
+
+  // Clear the IRQ flags, then take every frame waiting in the FIFO
+  bool tx_ok, tx_fail, rx_ready;
+  radio.whatHappened(tx_ok, tx_fail, rx_ready);
+  while (radio.available()) {
+    uint8_t frame[32];
+    uint8_t length = radio.getDynamicPayloadSize();
+    if (length == 0) continue;    // Corrupt length, the FIFO has been flushed
+    radio.read(frame, length);
+    uint8_t frame_events = endpoint.onFrame(frame, length, arrival_us, millis());
+    if (frame_events & RECEIVER_DATA) decode_us = micros() - arrival_us;
+    events |= frame_events;
+    loadAckPayload();
+  }
+
+  events |= endpoint.poll(receiver_settings, millis());
+  if ((events & RECEIVER_PROFILE) && endpoint.profile() != applied_profile) {
+    applyLinkProfile(endpoint.profile());
+  }
+
+  // The nRF24 retunes in RX mode within its PLL settling time
+  uint8_t channel = endpoint.channel(receiver_settings, micros());
+  if (channel != tuned_channel) {
+    radio.setChannel(channel);
+    tuned_channel = channel;
+  }
+
+  if (events & RECEIVER_DATA) {
+    publishOutputs(arrival_us);
+  } else if (events & RECEIVER_FAILSAFE) {
+    publishOutputs(0);
+  }
+}
+
+void radioTask(void* param) {
+  // Show failsafe pulses until the first frame arrives
+  publishOutputs(0);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1));
+    radioStep();
+    if (!settings_applied) {
+      settings_applied = true;
+      publishOutputs(0);
+    }
+  }
+}
+
+void outputTask(void* param) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    OutputFrame frame;
+    if (!latest_outputs.read(frame)) continue;
+    servo_outputs.write(frame.pulse_us);
+
+    if (latency_reset) {
+      memset(&output_latency, 0, sizeof(output_latency));
+      latency_reset = false;
+    }
+    if (frame.arrival_us != 0) {
+      uint32_t latency_us = micros() - frame.arrival_us;
+      output_us = latency_us;
+      LatencyStats& stats = output_latency;
+      if (stats.count == 0 || latency_us < stats.min_us) stats.min_us = latency_us;
+      if (latency_us > stats.max_us) stats.max_us = latency_us;
+      stats.total_us += latency_us;
+      stats.count++;
+    }
+  }
+}
+
+void IRAM_ATTR onRadioIrq() {
+  irq_us = micros();
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(radio_task, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+void loadSettings() {
+  defaultReceiverSettings(receiver_settings);
+
+  ReceiverSettings stored;
+  preferences.begin("receiver", true);
+  size_t length = preferences.getBytes("settings", &stored, sizeof(stored));
+  preferences.end();
+
+  // Anything from a build with a different layout is ignored
+  if (length == sizeof(stored) && stored.failsafe_ms >= RECEIVER_MIN_FAILSAFE_MS &&
+      stored.failsafe_ms <= RECEIVER_MAX_FAILSAFE_MS) {
+    receiver_settings = stored;
+  }
+}
+
+void saveSettings() {
+  ReceiverSettings snapshot = receiver_settings;
+  preferences.begin("receiver", false);
+  preferences.putBytes("settings", &snapshot, sizeof(snapshot));
+  preferences.end();
+}
+
+void handleSerialCommands() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (command_length > 0) {
+      collectCommandLine(c);
+      continue;
+    }
+
+    switch (c) {
+      case 's': printStatus(); break;
+      case 'o': printOutputs(); break;
+      case 'r': latency_reset = true; break;
+      case 'F': captureFailsafe(); break;
+      case 'T':
+      case 'H':
+      case 'C':
+      case 'O':
+        collectCommandLine(c);
+        break;
+    }
+  }
+}
+
+void printStatus() {
+  static const char* STATES[] = { "waiting", "active", "failsafe" };
+  LatencyStats stats = output_latency;
+
+  Serial.printf("rx%u %s profile=%u ch=%u %s frames=%lu lost=%u failsafes=%lu timeout=%ums batt=%umV\n",
+                RECEIVER_ID, STATES[endpoint.state()], endpoint.profile(), tuned_channel,
+                receiver_settings.hopping ? "hopping" : "fixed",
+                (unsigned long)endpoint.frames(), endpoint.framesLost(),
+                (unsigned long)endpoint.failsafes(), receiver_settings.failsafe_ms, battery_mv);
+  Serial.printf("irq->output n=%lu min=%lu mean=%lu max=%lu us, +0..%lu us to the pulse\n",
+                (unsigned long)stats.count, (unsigned long)stats.min_us,
+                (unsigned long)(stats.count ? stats.total_us / stats.count : 0),
+                (unsigned long)stats.max_us, (unsigned long)servo_outputs.periodUs());
+}
+
+void printOutputs() {
+  for (uint8_t i = 0; i < servo_outputs.outputCount(); i++) {
+    Serial.printf("out%u gpio%u src=%u pulse=%u failsafe=%u\n", i, OUTPUT_PINS[i],
+                  receiver_settings.sources[i], servo_outputs.pulse(i),
+                  receiver_settings.failsafe_us[i]);
+  }
+}
+
+// Current pulses become the failsafe positions
+void captureFailsafe() {
+  if (endpoint.state() != RECEIVER_ACTIVE) {
+    Serial.println("no link, failsafe unchanged");
+    return;
+  }
+  for (uint8_t i = 0; i < servo_outputs.outputCount(); i++) {
+    receiver_settings.failsafe_us[i] = servo_outputs.pulse(i);
+  }
+  settings_dirty = true;
+  settings_applied = false;
+}
+
+void collectCommandLine(char c) {
+  if (c == '\n' || c == '\r') {
+    command_line[command_length] = '\0';
+    applyCommandLine(command_line);
+    command_length = 0;
+  } else if (command_length < sizeof(command_line) - 1) {
+    command_line[command_length++] = c;
+  }
+}
+
+// T<ms>: failsafe timeout, H<0|1>: hopping, C<channel>: fixed channel,
+// O<output> <source 0-11|255> <failsafe us|0 = hold>: output mapping
+void applyCommandLine(const char* line) {
+  unsigned a, b, c;
+  if (sscanf(line, "T%u", &a) == 1 && a >= RECEIVER_MIN_FAILSAFE_MS && a <= RECEIVER_MAX_FAILSAFE_MS) {
+    receiver_settings.failsafe_ms = a;
+  } else if (sscanf(line, "H%u", &a) == 1 && a <= 1) {
+    receiver_settings.hopping = a;
+  } else if (sscanf(line, "C%u", &a) == 1 && a <= 125) {
+    receiver_settings.channel = a;
+  } else if (sscanf(line, "O%u %u %u", &a, &b, &c) == 3 && a < RECEIVER_MAX_OUTPUTS &&
+             (b < RECEIVER_SOURCE_COUNT || b == RECEIVER_NO_SOURCE) &&
+             (c == FAILSAFE_HOLD || (c >= PULSE_MIN_US && c <= PULSE_MAX_US))) {
+    receiver_settings.sources[a] = b;
+    receiver_settings.failsafe_us[a] = c;
+  } else {
+    Serial.println("usage: T<ms 100-10000> | H<0|1> | C<0-125> | O<output> <source|255> <us|0>");
+    return;
+  }
+  settings_dirty = true;
+  settings_applied = false;
+}
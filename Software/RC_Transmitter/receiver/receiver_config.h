@@ -0,0 +1,30 @@
+#ifndef RECEIVER_CONFIG_H
+#define RECEIVER_CONFIG_H
+
+#include <stdint.h>
+#include <receiver_endpoint.h>
+
+// Receiver slot this build answers to, BASE_PIPES[RECEIVER_ID]
+#ifndef RECEIVER_ID
+#define RECEIVER_ID 0
+#endif
+
+// NRF24L01 on VSPI (SCK 18, MISO 19, MOSI 23)
+#define RX_CE_PIN 4
+#define RX_CSN_PIN 5
+#define RX_IRQ_PIN 34           // Active low, input-only pin is fine
+
+// Battery sense through a 3:1 divider, enough for a 2S pack
+#define BATTERY_PIN 35
+const uint8_t BATTERY_DIVIDER = 3;
+
+// Servo/ESC outputs, one LEDC channel each. 50 Hz suits analog servos;
+// ESCs and digital servos that accept it can run at up to 400 Hz, which
+// cuts the time a new pulse width waits for the next period.
+const uint8_t OUTPUT_COUNT = 12;
+const uint8_t OUTPUT_PINS[OUTPUT_COUNT] = {
+  13, 14, 15, 16, 17, 21, 22, 25, 26, 27, 32, 33
+};
+const uint16_t OUTPUT_RATE_HZ = 50;
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SERVO_OUTPUTS_H
+#define SERVO_OUTPUTS_H
+
+#include <Arduino.h>
+#include <receiver_endpoint.h>
+
+// Servo pulses from the LEDC peripheral, one channel per output. A new
+// duty only takes effect when the running period ends, so changing a
+// pulse width mid-pulse never produces a runt or a doubled pulse.
+class ServoOutputs {
+private:
+  static const uint8_t RESOLUTION_BITS = 16;
+
+  const uint8_t* pins;
+  uint8_t count;
+  uint32_t period_us;
+  uint16_t pulses[RECEIVER_MAX_OUTPUTS];
+
+  uint32_t duty(uint16_t pulse_us) const {
+    return (uint32_t)(((uint64_t)pulse_us << RESOLUTION_BITS) / period_us);
+  }
+
+public:
+  ServoOutputs() : pins(NULL), count(0), period_us(20000) {
+    memset(pulses, 0, sizeof(pulses));
+  }
+
+  // Outputs start low, with no pulses
+  bool begin(const uint8_t* output_pins, uint8_t output_count, uint16_t rate_hz) {
+    if (output_count > RECEIVER_MAX_OUTPUTS) return false;
+    pins = output_pins;
+    count = output_count;
+    period_us = 1000000UL / rate_hz;
+    for (uint8_t i = 0; i < count; i++) {
+      if (ledcSetup(i, rate_hz, RESOLUTION_BITS) == 0) return false;
+      ledcAttachPin(pins[i], i);
+      ledcWrite(i, 0);
+    }
+    return true;
+  }
+
+  // Pulse width per output, PULSE_OFF to stop pulsing; only changes are written
+  void write(const uint16_t* pulse_us) {
+    for (uint8_t i = 0; i < count; i++) {
+      if (pulse_us[i] == pulses[i]) continue;
+      ledcWrite(i, duty(pulse_us[i]));
+      pulses[i] = pulse_us[i];
+    }
+  }
+
+  uint8_t outputCount() const { return count; }
+  uint32_t periodUs() const { return period_us; }
+  uint16_t pulse(uint8_t index) const { return pulses[index]; }
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <Arduino.h>
+#include <driver/adc.h>
+#include "pin_definitions.h"
+#include "oversampler.h"
+
+const uint8_t ADC1_SLOT_COUNT = 4;   // Sticks, sampled by DMA
+const uint8_t ADC2_FIRST_SLOT = 4;   // Pots, ADC2 cannot use DMA on ESP32
+
+// Background sampling engine. The four stick channels on ADC1 run in
+// continuous DMA mode; the sampling task drains the driver's ring buffer
+// and feeds each channel's oversampler. ADC2 does not support DMA on the
+// ESP32, so the two pots are read one-shot from the same task after each
+// DMA batch. Readers only ever load the latest decimated value.
+class AdcSampler {
+private:
+  static const uint32_t DMA_SAMPLE_RATE = 20000;   // Hz, all ADC1 channels
+  static const uint16_t DMA_BATCH_BYTES = 256;
+  static const uint16_t DMA_STORE_BYTES = 1024;
+  static const uint16_t ADC1_DECIMATION = 32;
+  static const uint16_t ADC2_DECIMATION = 4;
+  static const uint8_t ADC2_READS_PER_BATCH = 4;
+  static const uint32_t RATE_WINDOW_MS = 1000;
+  static const BaseType_t TASK_CORE = 0;
+  static const UBaseType_t TASK_PRIORITY = 3;
+
+  Oversampler channels[ANALOG_CHANNEL_COUNT];
+  int8_t adc1_slots[8];            // ADC1 channel number -> slot
+  TaskHandle_t task;
+
+  unsigned long rate_window_start;
+  uint32_t rate_window_samples;
+  volatile uint32_t sample_rate;
+  volatile uint32_t batch_us;      // micros() when the newest DMA batch arrived
+
+  static void taskEntry(void* param) {
+    static_cast<AdcSampler*>(param)->run();
+  }
+
+  uint32_t totalSamples() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) {
+      total += channels[i].samples();
+    }
+    return total;
+  }
+
+  void updateRate() {
+    unsigned long now = millis();
+    if (now - rate_window_start < RATE_WINDOW_MS) return;
+
+    uint32_t total = totalSamples();
+    sample_rate = (uint32_t)((uint64_t)(total - rate_window_samples) * 1000 / (now - rate_window_start));
+    rate_window_samples = total;
+    rate_window_start = now;
+  }
+
+  void run() {
+    uint8_t buffer[DMA_BATCH_BYTES];
+
+    for (;;) {
+      uint32_t length = 0;
+      esp_err_t result = adc_digi_read_bytes(buffer, DMA_BATCH_BYTES, &length, ADC_MAX_DELAY);
+      batch_us = micros();
+
+      // ESP_ERR_INVALID_STATE only means the driver buffer overflowed
+      if (result == ESP_OK || result == ESP_ERR_INVALID_STATE) {
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+          const adc_digi_output_data_t* sample = reinterpret_cast<const adc_digi_output_data_t*>(&buffer[i]);
+          uint8_t channel = sample->type1.channel;
+          if (channel < 8 && adc1_slots[channel] >= 0) {
+            channels[adc1_slots[channel]].push(sample->type1.data);
+          }
+        }
+      }
+
+      for (uint8_t n = 0; n < ADC2_READS_PER_BATCH; n++) {
+        for (uint8_t slot = ADC2_FIRST_SLOT; slot < ANALOG_CHANNEL_COUNT; slot++) {
+          channels[slot].push(analogRead(ANALOG_PINS[slot]));
+        }
+      }
+
+      updateRate();
+    }
+  }
+
+public:
+  AdcSampler()
+    : task(NULL), rate_window_start(0), rate_window_samples(0), sample_rate(0), batch_us(0) {
+    for (uint8_t i = 0; i < 8; i++) {
+      adc1_slots[i] = -1;
+    }
+  }
+
+  bool begin() {
+    adc_digi_pattern_config_t patterns[ADC1_SLOT_COUNT] = {};
+    uint16_t channel_mask = 0;
+
+    for (uint8_t slot = 0; slot < ANALOG_CHANNEL_COUNT; slot++) {
+      if (slot < ADC1_SLOT_COUNT) {
+        int8_t channel = digitalPinToAnalogChannel(ANALOG_PINS[slot]);
+        if (channel < 0 || channel >= 8) return false;
+
+        adc1_slots[channel] = slot;
+        channel_mask |= 1 << channel;
+        patterns[slot].atten = ADC_ATTEN_DB_11;
+        patterns[slot].channel = channel;
+        patterns[slot].unit = 0;   // ADC1
+        patterns[slot].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        channels[slot].setDecimation(ADC1_DECIMATION);
+      } else {
+        channels[slot].setDecimation(ADC2_DECIMATION);
+      }
+    }
+
+    adc_digi_init_config_t init_config = {};
+    init_config.max_store_buf_size = DMA_STORE_BYTES;
+    init_config.conv_num_each_intr = DMA_BATCH_BYTES;
+    init_config.adc1_chan_mask = channel_mask;
+    init_config.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&init_config) != ESP_OK) {
+      return false;
+    }
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = true;
+    config.conv_limit_num = 250;
+    config.pattern_num = ADC1_SLOT_COUNT;
+    config.adc_pattern = patterns;
+    config.sample_freq_hz = DMA_SAMPLE_RATE;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+      return false;
+    }
+
+    rate_window_start = millis();
+    return xTaskCreatePinnedToCore(taskEntry, "adc", 3072, this, TASK_PRIORITY, &task, TASK_CORE) == pdPASS;
+  }
+
+  // Latest oversampled value for a slot, 0-4095
+  uint16_t readSlot(uint8_t slot) const {
+    return channels[slot].latest();
+  }
+
+  // micros() of the newest DMA batch, the freshest samples behind readSlot()
+  uint32_t sampledAt() const { return batch_us; }
+
+  // Raw samples per second across all channels
+  uint32_t sampleRate() const { return sample_rate; }
+
+  // Standard deviation of the last decimation block, in ADC counts
+  float noise(uint8_t slot) const { return channels[slot].noise(); }
+};
+
+#endif
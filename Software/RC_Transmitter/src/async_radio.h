@@ -0,0 +1,167 @@
+#ifndef ASYNC_RADIO_H
+#define ASYNC_RADIO_H
+
+#include <telemetry_codec.h>
+
+#include "config.h"
+#include "hal.h"
+#include "telemetry_buffer.h"
+
+// Delivery counters kept per receiver
+struct LinkStats {
+  uint32_t sent;        // Frames loaded into the TX FIFO
+  uint32_t bytes;       // Payload bytes of those frames
+  uint32_t acked;       // Frames acknowledged by the receiver
+  uint32_t failed;      // Frames dropped after the last auto-retransmit
+  uint32_t retries;     // Auto-retransmits spent on finished frames
+  uint32_t overruns;    // Frames still pending when the next one was queued
+  uint32_t telemetry;   // ACK payloads decoded into telemetry samples
+};
+
+// Outcome of one queued frame
+struct FrameResult {
+  uint8_t receiver;
+  bool delivered;
+  uint8_t retries;
+  uint8_t control;      // Link control command, 0 for channel data
+};
+
+// Non-blocking TX path on top of the RF24 FIFO. queue() loads a frame with
+// writeFast() and returns at once; the outcome of the previous frame is
+// collected by poll() from the status register on the next tick.
+// Receivers may attach telemetry to the auto-ACK; it arrives with the ACK
+// itself, so the downlink costs no extra air time.
+class AsyncRadio {
+public:
+  typedef void (*ResultHandler)(const FrameResult& result);
+  typedef void (*EchoHandler)(uint8_t receiver, const TelemetrySample& sample, uint32_t now_us);
+
+private:
+  static const uint32_t AWAIT_POLL_US = 10;
+
+  RadioDriver& radio;
+  TelemetryStore& telemetry;
+  ResultHandler on_result;
+  EchoHandler on_echo;
+  bool in_flight;
+  bool last_delivered;
+  uint8_t in_flight_control;
+  uint8_t in_flight_receiver;
+  LinkStats stats[MAX_RECEIVERS];
+
+  void report(bool delivered, uint8_t retries) {
+    if (!on_result) return;
+    FrameResult result = { in_flight_receiver, delivered, retries, in_flight_control };
+    on_result(result);
+  }
+
+  void finish(bool delivered) {
+    LinkStats& s = stats[in_flight_receiver];
+    uint8_t arc = radio.getARC();
+    s.retries += arc;
+    last_delivered = delivered;
+    if (delivered) {
+      s.acked++;
+    } else {
+      s.failed++;
+      // MAX_RT leaves the payload in the FIFO and blocks further sends
+      radio.flush_tx();
+    }
+    in_flight = false;
+    report(delivered, arc);
+  }
+
+  // Moves every ACK payload out of the RX FIFO
+  void drainAckPayloads() {
+    while (radio.available()) {
+      uint8_t payload[32];
+      uint8_t length = radio.getDynamicPayloadSize();
+      if (length == 0) break; // Corrupt length, the driver flushed the FIFO
+      radio.read(payload, length);
+      
+      TelemetrySample sample;
+      if (decodeTelemetry(payload, length, sample)) {
+        sample.timestamp = millis();
+        telemetry.push(in_flight_receiver, sample);
+        stats[in_flight_receiver].telemetry++;
+        if (sample.echo && on_echo) on_echo(in_flight_receiver, sample, micros());
+      }
+    }
+  }
+
+public:
+  AsyncRadio(RadioDriver& driver, TelemetryStore& store)
+    : radio(driver), telemetry(store), on_result(NULL), on_echo(NULL), in_flight(false),
+      last_delivered(false), in_flight_control(0), in_flight_receiver(0), stats() {}
+
+  // Called with the outcome of every frame, from poll(), queue() or cancel()
+  void setResultHandler(ResultHandler handler) {
+    on_result = handler;
+  }
+
+  // Called from poll() with every ACK payload that answers a latency probe
+  void setEchoHandler(EchoHandler handler) {
+    on_echo = handler;
+  }
+
+  // Collects the result of the frame in flight, if it has finished
+  void poll() {
+    if (!in_flight) return;
+
+    bool tx_ok, tx_fail, rx_ready;
+    radio.whatHappened(tx_ok, tx_fail, rx_ready);
+    if (rx_ready) {
+      drainAckPayloads();
+    }
+    if (tx_ok || tx_fail) {
+      finish(tx_ok);
+    }
+  }
+
+  // Drops the frame in flight, e.g. before the pipe address changes
+  void cancel() {
+    if (!in_flight) return;
+    stats[in_flight_receiver].overruns++;
+    radio.flush_tx();
+    in_flight = false;
+    report(false, 0);
+  }
+
+  // Collects the frame in flight or drops it if it is still going, so its
+  // result has been reported before the next frame is built
+  void settle() {
+    poll();
+    // Previous frame is stale by now, drop it in favour of fresh data
+    cancel();
+  }
+
+  // Queues a frame without waiting for the air link
+  void queue(const uint8_t* frame, uint8_t length, uint8_t receiver_id, uint8_t control = 0) {
+    settle();
+
+    radio.writeFast(frame, length);
+    in_flight = true;
+    in_flight_control = control;
+    in_flight_receiver = receiver_id;
+    stats[receiver_id].sent++;
+    stats[receiver_id].bytes += length;
+  }
+
+  // Polls until the frame in flight has finished, for up to timeout_us.
+  // Holds the calling task for the whole exchange, so only the latency
+  // measurement mode uses it. Returns true if the frame was delivered.
+  bool await(uint32_t timeout_us) {
+    uint32_t start = micros();
+    poll();
+    while (in_flight && micros() - start < timeout_us) {
+      delayMicroseconds(AWAIT_POLL_US);
+      poll();
+    }
+    return !in_flight && last_delivered;
+  }
+
+  bool busy() const { return in_flight; }
+  const LinkStats& linkStats(uint8_t receiver_id) const { return stats[receiver_id]; }
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef ATTITUDE_FILTER_H
+#define ATTITUDE_FILTER_H
+
+#include <stdint.h>
+#include "channel_mapper.h"
+
+// Raw MPU6050 readings of one FIFO sample, in sensor axes
+struct ImuSample {
+  int16_t accel[3];           // x, y, z
+  int16_t gyro[3];
+};
+
+// Angles are binary fractions of a turn: 65536 per turn in int16 (so
+// +-180 degrees is the whole range and wraps for free), 2^32 per turn in
+// the filter's state
+const int32_t ANGLE_QUARTER_TURN = 16384;
+
+inline int16_t angleDecidegrees(int16_t angle) {
+  return (int16_t)((int32_t)angle * 3600 / 65536);
+}
+
+// atan(z) for z in 0..1 as Q15, within 0.1 degree:
+// pi/4 z + z (1 - z) (0.2447 + 0.0663 z), coefficients in angle units
+inline int32_t atanUnit(int32_t z) {
+  int32_t shape = 2552 + ((692 * z) >> 15);
+  return ((8192 * z) >> 15) + ((((z * (32768 - z)) >> 15) * shape) >> 15);
+}
+
+// atan2(y, x) as an int16 angle, for |y| and |x| up to 2^16
+inline int16_t atan2Angle(int32_t y, int32_t x) {
+  uint32_t abs_y = y < 0 ? -y : y;
+  uint32_t abs_x = x < 0 ? -x : x;
+  if (abs_x == 0 && abs_y == 0) return 0;
+
+  int32_t angle;
+  if (abs_y <= abs_x) {
+    angle = atanUnit((int32_t)((abs_y << 15) / abs_x));
+  } else {
+    angle = ANGLE_QUARTER_TURN - atanUnit((int32_t)((abs_x << 15) / abs_y));
+  }
+  if (x < 0) angle = 2 * ANGLE_QUARTER_TURN - angle;
+  if (y < 0) angle = -angle;
+  return (int16_t)angle;     // +180 wraps to -180, the same direction
+}
+
+inline uint32_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value) bit >>= 2;
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Pitch and roll of the transmitter from the MPU6050, in integer
+// arithmetic only. A complementary filter with Mahony's proportional and
+// integral feedback, run per axis: every sample integrates the gyro rate,
+// then pulls the angle towards the accelerometer's tilt by 1/2^KP_SHIFT of
+// the difference, and the integral of the difference learns the gyro
+// bias. Samples whose acceleration is far from 1 g (a shake, a swing)
+// only integrate. Pitch turns about y, roll about x, level reads 0/0.
+class AttitudeFilter {
+public:
+  static const int32_t ACCEL_LSB_PER_G = 8192;          // +-4 g range
+  static const uint32_t GYRO_LSB_PER_DPS_X10 = 655;      // +-500 dps range
+  static const uint8_t KP_SHIFT = 7;                    // 0.64 s at 200 Hz
+  static const uint8_t KI_SHIFT = 15;                   // Damping ratio ~0.7
+  static const uint32_t MAX_BIAS_DPS = 25;
+
+private:
+  // Accepted |a|^2 window, 0.75 g to 1.25 g
+  static const uint32_t ACCEL_MIN_SQ = (uint32_t)ACCEL_LSB_PER_G * ACCEL_LSB_PER_G / 16 * 9;
+  static const uint32_t ACCEL_MAX_SQ = (uint32_t)ACCEL_LSB_PER_G * ACCEL_LSB_PER_G / 16 * 25;
+
+  int32_t gyro_step;          // Angle (2^32 per turn) per gyro LSB per sample
+  int32_t max_bias;
+  int32_t pitch_angle;
+  int32_t roll_angle;
+  int32_t pitch_bias;         // Per sample, same units as the angle
+  int32_t roll_bias;
+  bool aligned;
+  uint32_t sample_count;
+  uint32_t rejected_count;
+
+  void correct(int32_t& angle, int32_t& bias, int32_t rate, int32_t measured) {
+    int32_t error = (int32_t)((uint32_t)measured - (uint32_t)angle);
+    bias += error >> KI_SHIFT;
+    if (bias > max_bias) bias = max_bias;
+    if (bias < -max_bias) bias = -max_bias;
+    angle = (int32_t)((uint32_t)angle + (uint32_t)(rate + bias + (error >> KP_SHIFT)));
+  }
+
+  // The correction cancels the bias, so it has the opposite sign
+  int32_t biasCentidps(int32_t correction) const {
+    return (int32_t)(-(int64_t)correction * 1000 / ((int64_t)gyro_step * GYRO_LSB_PER_DPS_X10));
+  }
+
+public:
+  explicit AttitudeFilter(uint32_t sample_rate_hz)
+    : gyro_step((int32_t)((10ULL << 32) / (360ULL * GYRO_LSB_PER_DPS_X10 * sample_rate_hz))),
+      max_bias((int32_t)(gyro_step * GYRO_LSB_PER_DPS_X10 * MAX_BIAS_DPS / 10)) {
+    reset();
+  }
+
+  // Forgets the attitude; the next trusted sample sets it outright
+  void reset() {
+    pitch_angle = roll_angle = 0;
+    pitch_bias = roll_bias = 0;
+    aligned = false;
+    sample_count = 0;
+    rejected_count = 0;
+  }
+
+  void update(const ImuSample& sample) {
+    int32_t ax = sample.accel[0];
+    int32_t ay = sample.accel[1];
+    int32_t az = sample.accel[2];
+    int32_t pitch_rate = sample.gyro[1] * gyro_step;
+    int32_t roll_rate = sample.gyro[0] * gyro_step;
+    sample_count++;
+
+    uint32_t yz_sq = (uint32_t)(ay * ay) + (uint32_t)(az * az);
+    uint32_t norm_sq = yz_sq + (uint32_t)(ax * ax);
+    if (norm_sq < ACCEL_MIN_SQ || norm_sq > ACCEL_MAX_SQ) {
+      rejected_count++;
+      if (!aligned) return;
+      pitch_angle = (int32_t)((uint32_t)pitch_angle + (uint32_t)(pitch_rate + pitch_bias));
+      roll_angle = (int32_t)((uint32_t)roll_angle + (uint32_t)(roll_rate + roll_bias));
+      return;
+    }
+
+    int32_t pitch_measured = (int32_t)((uint32_t)(uint16_t)atan2Angle(-ax, isqrt(yz_sq)) << 16);
+    int32_t roll_measured = (int32_t)((uint32_t)(uint16_t)atan2Angle(ay, az) << 16);
+    if (!aligned) {
+      pitch_angle = pitch_measured;
+      roll_angle = roll_measured;
+      aligned = true;
+      return;
+    }
+    correct(pitch_angle, pitch_bias, pitch_rate, pitch_measured);
+    correct(roll_angle, roll_bias, roll_rate, roll_measured);
+  }
+
+  int16_t pitch() const { return (int16_t)(pitch_angle >> 16); }
+  int16_t roll() const { return (int16_t)(roll_angle >> 16); }
+  bool isAligned() const { return aligned; }
+
+  // Gyro bias learned by the integral term, in 0.01 dps
+  int32_t pitchBias() const { return biasCentidps(pitch_bias); }
+  int32_t rollBias() const { return biasCentidps(roll_bias); }
+
+  uint32_t samples() const { return sample_count; }
+  uint32_t rejected() const { return rejected_count; }
+};
+
+// Tilt as a channel value: +-full_scale spans the channel range and
+// larger angles saturate
+inline int16_t tiltChannel(int16_t angle, int16_t full_scale) {
+  int32_t value = (int32_t)angle * ChannelMapper::OUTPUT_MAX / full_scale;
+  if (value < ChannelMapper::OUTPUT_MIN) value = ChannelMapper::OUTPUT_MIN;
+  if (value > ChannelMapper::OUTPUT_MAX) value = ChannelMapper::OUTPUT_MAX;
+  return (int16_t)value;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef BUS_ARBITER_H
+#define BUS_ARBITER_H
+
+#include <stdint.h>
+
+// Devices on the shared I2C bus, highest priority first
+enum BusDevice { BUS_IMU, BUS_EXPANDER, BUS_OLED };
+const uint8_t BUS_DEVICE_COUNT = 3;
+const uint8_t BUS_FREE = 0xFF;
+
+struct BusDeviceStats {
+  uint32_t transactions;
+  uint64_t busy_us;          // Time holding the bus
+  uint32_t hold_max_us;
+  uint64_t wait_total_us;    // Time from request to grant
+  uint32_t wait_max_us;
+};
+
+// Grant logic for the shared I2C bus. A device asks for the bus before
+// each transaction and hands it back after; when the bus is released it
+// goes to the highest-priority device waiting, so a short input read
+// queued behind the display waits for at most the chunk in flight. Each
+// device has at most one outstanding request. Not thread-safe on its own,
+// the HAL's SharedBus serialises the calls and does the blocking.
+class BusArbiter {
+private:
+  uint8_t owner;
+  uint8_t waiting;                          // Bit per device
+  uint32_t requested_us[BUS_DEVICE_COUNT];
+  uint32_t granted_us;
+  BusDeviceStats device_stats[BUS_DEVICE_COUNT];
+
+  void grant(uint8_t device, uint32_t now_us) {
+    owner = device;
+    waiting &= ~(1 << device);
+    granted_us = now_us;
+
+    BusDeviceStats& stats = device_stats[device];
+    uint32_t wait = now_us - requested_us[device];
+    stats.transactions++;
+    stats.wait_total_us += wait;
+    if (wait > stats.wait_max_us) stats.wait_max_us = wait;
+  }
+
+public:
+  BusArbiter() : owner(BUS_FREE), waiting(0), granted_us(0) {
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      requested_us[i] = 0;
+    }
+    resetStats();
+  }
+
+  // Returns true if the bus was free and is now the device's; otherwise
+  // the device is queued and will be returned by a later release()
+  bool request(uint8_t device, uint32_t now_us) {
+    requested_us[device] = now_us;
+    waiting |= 1 << device;
+    if (owner != BUS_FREE) return false;
+    grant(device, now_us);
+    return true;
+  }
+
+  // Frees the bus and grants it to the highest-priority waiter, which is
+  // returned (BUS_FREE if none)
+  uint8_t release(uint8_t device, uint32_t now_us) {
+    BusDeviceStats& stats = device_stats[device];
+    uint32_t hold = now_us - granted_us;
+    stats.busy_us += hold;
+    if (hold > stats.hold_max_us) stats.hold_max_us = hold;
+    owner = BUS_FREE;
+
+    for (uint8_t next = 0; next < BUS_DEVICE_COUNT; next++) {
+      if (waiting & (1 << next)) {
+        grant(next, now_us);
+        return next;
+      }
+    }
+    return BUS_FREE;
+  }
+
+  uint8_t currentOwner() const { return owner; }
+  bool contended() const { return waiting != 0; }
+  const BusDeviceStats& stats(uint8_t device) const { return device_stats[device]; }
+
+  void resetStats() {
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      device_stats[i].transactions = 0;
+      device_stats[i].busy_us = 0;
+      device_stats[i].hold_max_us = 0;
+      device_stats[i].wait_total_us = 0;
+      device_stats[i].wait_max_us = 0;
+    }
+  }
+};
+
+#endif
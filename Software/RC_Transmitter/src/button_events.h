@@ -0,0 +1,98 @@
+#ifndef BUTTON_EVENTS_H
+#define BUTTON_EVENTS_H
+
+#include <stdint.h>
+#include "spsc_queue.h"
+
+// Menu buttons, in the bit order of the mask passed to ButtonDebouncer
+enum MenuButton { BUTTON_UP, BUTTON_DOWN, BUTTON_SELECT };
+const uint8_t MENU_BUTTON_COUNT = 3;
+
+enum ButtonEventType { BUTTON_PRESS, BUTTON_LONG_PRESS, BUTTON_REPEAT, BUTTON_RELEASE };
+
+struct ButtonEvent {
+  uint8_t button;
+  uint8_t type;
+};
+
+typedef SpscQueue<ButtonEvent, 16> ButtonEventQueue;
+
+// Integrating debouncer for the menu buttons, run from a periodic timer.
+// Every tick moves a button's integrator one step towards its raw level;
+// the debounced state only flips when the integrator reaches either end,
+// so bounce shorter than INTEGRATOR_MAX ticks never gets through and a
+// press is accepted INTEGRATOR_MAX ticks after the contact settles. Each
+// button is independent. A held button sends LONG_PRESS after
+// LONG_PRESS_MS, then REPEAT every REPEAT_MS until it is released.
+class ButtonDebouncer {
+public:
+  static const uint32_t TICK_MS = 2;
+  static const uint8_t INTEGRATOR_MAX = 5;
+  static const uint32_t LONG_PRESS_MS = 500;
+  static const uint32_t REPEAT_MS = 100;
+
+private:
+  struct Button {
+    uint8_t integrator;
+    bool pressed;
+    bool long_sent;
+    uint16_t countdown;       // Ticks to the next LONG_PRESS or REPEAT
+  };
+
+  ButtonEventQueue& queue;
+  Button buttons[MENU_BUTTON_COUNT];
+  uint32_t event_count;
+
+  void emit(uint8_t button, uint8_t type) {
+    ButtonEvent event = { button, type };
+    queue.push(event);
+    event_count++;
+  }
+
+public:
+  explicit ButtonDebouncer(ButtonEventQueue& events) : queue(events), event_count(0) {
+    for (uint8_t i = 0; i < MENU_BUTTON_COUNT; i++) {
+      buttons[i].integrator = 0;
+      buttons[i].pressed = false;
+      buttons[i].long_sent = false;
+      buttons[i].countdown = 0;
+    }
+  }
+
+  // One timer tick; bit i of down is set while button i reads pressed.
+  // Returns true if the tick queued any event.
+  bool tick(uint8_t down) {
+    uint32_t before = event_count;
+
+    for (uint8_t i = 0; i < MENU_BUTTON_COUNT; i++) {
+      Button& button = buttons[i];
+      if ((down >> i) & 1) {
+        if (button.integrator < INTEGRATOR_MAX) button.integrator++;
+      } else if (button.integrator > 0) {
+        button.integrator--;
+      }
+
+      if (!button.pressed) {
+        if (button.integrator == INTEGRATOR_MAX) {
+          button.pressed = true;
+          button.long_sent = false;
+          button.countdown = LONG_PRESS_MS / TICK_MS;
+          emit(i, BUTTON_PRESS);
+        }
+      } else if (button.integrator == 0) {
+        button.pressed = false;
+        emit(i, BUTTON_RELEASE);
+      } else if (--button.countdown == 0) {
+        emit(i, button.long_sent ? BUTTON_REPEAT : BUTTON_LONG_PRESS);
+        button.long_sent = true;
+        button.countdown = REPEAT_MS / TICK_MS;
+      }
+    }
+    return event_count != before;
+  }
+
+  bool pressed(uint8_t button) const { return buttons[button].pressed; }
+  uint32_t events() const { return event_count; }
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef CHANNEL_BLACKLIST_H
+#define CHANNEL_BLACKLIST_H
+
+#include <stdint.h>
+#include <string.h>
+#include <hop_sequence.h>
+
+// Picks the hop channels one receiver should skip. Every frame adds its
+// per-attempt loss to a smoothed figure for the channel it went out on; a
+// channel is masked once that figure is both high and well above the band
+// average, so a weak link as a whole masks nothing. Masked channels get
+// another chance after a probation that doubles each time the same channel
+// is masked again soon after coming back.
+//
+// Like link profiles, masks go through the receiver: the blacklist asks for
+// a control frame and only adopts the mask when its ACK arrives. When the
+// link is lost both ends fall back to all channels; the mask is announced
+// again once the receiver answers.
+class ChannelBlacklist {
+public:
+  static const uint8_t MIN_SAMPLES = 32;          // Frames before a channel is judged
+  static const uint16_t BLOCK_LOSS = 30 * 256;    // % x256, per attempt
+  static const uint16_t EXCESS_LOSS = 20 * 256;   // % x256 above the band average
+  static const uint32_t PROBATION_MS = 60000;
+  static const uint8_t MAX_STRIKES = 6;           // Probation up to 64x
+  static const uint32_t RELAPSE_MS = 300000;      // Masked again within this is a strike
+
+private:
+  uint16_t loss[HOP_CHANNEL_COUNT];
+  uint8_t samples[HOP_CHANNEL_COUNT];
+  uint8_t strikes[HOP_CHANNEL_COUNT];
+  uint32_t changed_ms[HOP_CHANNEL_COUNT];
+  uint32_t mask;                // Agreed with the receiver
+  uint32_t target;              // Being announced, == mask if none
+  bool confirmed;               // The receiver has acknowledged mask
+  bool restoring;               // target is the mask in use before a link loss
+  uint32_t last_ack_ms;
+  uint32_t change_count;
+
+  uint16_t bandAverage() const {
+    uint32_t total = 0;
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < HOP_CHANNEL_COUNT; i++) {
+      if ((mask & (1UL << i)) && samples[i] >= MIN_SAMPLES) {
+        total += loss[i];
+        count++;
+      }
+    }
+    return count ? (uint16_t)(total / count) : 0;
+  }
+
+  uint32_t probation(uint8_t index) const {
+    return PROBATION_MS << strikes[index];
+  }
+
+  // Next mask change worth announcing, mask itself if none
+  uint32_t proposal(uint8_t index, uint32_t now_ms) const {
+    for (uint8_t i = 0; i < HOP_CHANNEL_COUNT; i++) {
+      if (!(mask & (1UL << i)) && now_ms - changed_ms[i] >= probation(i)) {
+        return mask | (1UL << i);
+      }
+    }
+
+    bool allowed = mask & (1UL << index);
+    if (allowed && samples[index] >= MIN_SAMPLES && loss[index] >= BLOCK_LOSS &&
+        loss[index] >= bandAverage() + EXCESS_LOSS && hopMaskCount(mask) > HOP_MIN_CHANNELS) {
+      return mask & ~(1UL << index);
+    }
+    return mask;
+  }
+
+  void adopt(uint32_t now_ms) {
+    for (uint8_t i = 0; i < HOP_CHANNEL_COUNT && !restoring; i++) {
+      uint32_t bit = 1UL << i;
+      if ((mask ^ target) & bit) {
+        if (target & bit) {
+          // Back on probation, judged afresh
+          loss[i] = 0;
+          samples[i] = 0;
+        } else if (now_ms - changed_ms[i] < RELAPSE_MS) {
+          if (strikes[i] < MAX_STRIKES) strikes[i]++;
+        } else {
+          strikes[i] = 0;
+        }
+        changed_ms[i] = now_ms;
+      }
+    }
+    if (mask != target) change_count++;
+    mask = target;
+    confirmed = true;
+    restoring = false;
+  }
+
+public:
+  ChannelBlacklist() {
+    reset();
+  }
+
+  // All channels back in use, announced again on the next frame
+  void reset() {
+    memset(loss, 0, sizeof(loss));
+    memset(samples, 0, sizeof(samples));
+    memset(strikes, 0, sizeof(strikes));
+    memset(changed_ms, 0, sizeof(changed_ms));
+    mask = HOP_ALL_CHANNELS;
+    target = HOP_ALL_CHANNELS;
+    confirmed = false;
+    restoring = false;
+    last_ack_ms = 0;
+    change_count = 0;
+  }
+
+  // Outcome of any frame sent on hop channel index
+  void record(uint8_t index, bool delivered, uint8_t arc, uint32_t now_ms) {
+    uint16_t attempts = arc + 1;
+    uint16_t failures = delivered ? arc : attempts;
+    uint32_t sample = (uint32_t)failures * 100 * 256 / attempts;
+    loss[index] = (uint16_t)(loss[index] - loss[index] / 32 + sample / 32);
+    if (samples[index] < 255) samples[index]++;
+
+    if (delivered) {
+      last_ack_ms = now_ms;
+    } else if (now_ms - last_ack_ms >= LINK_LOST_MS) {
+      // The receiver has gone back to all channels by now
+      if (!restoring) target = mask;
+      mask = HOP_ALL_CHANNELS;
+      confirmed = false;
+      restoring = target != mask;
+      last_ack_ms = now_ms;
+      return;
+    }
+
+    if (target == mask) target = proposal(index, now_ms);
+  }
+
+  // Outcome of the control frame announcing announced
+  void recordControl(bool delivered, uint32_t announced, uint32_t now_ms) {
+    if (!delivered) return;
+    last_ack_ms = now_ms;
+    if (announced == target) adopt(now_ms);
+  }
+
+  // True while a mask still has to be sent to the receiver
+  bool pendingMask(uint32_t& value) const {
+    value = target;
+    return !confirmed || target != mask;
+  }
+
+  uint32_t channelMask() const { return mask; }
+  uint8_t blocked() const { return HOP_CHANNEL_COUNT - hopMaskCount(mask); }
+  uint32_t changes() const { return change_count; }
+  uint8_t lossPercent(uint8_t index) const { return loss[index] / 256; }
+  uint8_t sampleCount(uint8_t index) const { return samples[index]; }
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef CHANNEL_MAPPER_H
+#define CHANNEL_MAPPER_H
+
+#include <stdint.h>
+
+// One linear piece of a stick mapping, equivalent to Arduino's
+// map(raw, in_min, in_max, out_min, out_max). The integer division is
+// replaced by a precomputed reciprocal: for |delta * rise| < 2^NUMERATOR_BITS,
+// (n * multiplier) >> shift is exactly n / run, so results match map()
+// bit for bit, including truncation toward zero for out-of-range input.
+class MapSegment {
+private:
+  static const uint8_t NUMERATOR_BITS = 26;
+
+  int32_t in_min;
+  int32_t rise;
+  int32_t offset;
+  uint64_t multiplier;
+  uint8_t shift;
+  bool degenerate;
+
+public:
+  MapSegment() : in_min(0), rise(0), offset(0), multiplier(0), shift(0), degenerate(true) {}
+
+  void configure(int32_t from_min, int32_t from_max, int32_t to_min, int32_t to_max) {
+    int32_t run = from_max - from_min;
+    in_min = from_min;
+    rise = to_max - to_min;
+    offset = to_min;
+    degenerate = (run == 0);
+    if (degenerate) return;
+
+    // n / -d == -n / d, keep the divisor positive
+    if (run < 0) {
+      run = -run;
+      rise = -rise;
+    }
+
+    uint8_t log2_run = 0;
+    while ((1UL << log2_run) < (uint32_t)run) log2_run++;
+    shift = NUMERATOR_BITS + log2_run;
+    multiplier = ((1ULL << shift) + run - 1) / run;
+  }
+
+  int32_t map(int32_t raw) const {
+    // map() reports an empty input range as -1
+    if (degenerate) return -1;
+
+    int32_t numerator = (raw - in_min) * rise;
+    if (numerator >= 0) {
+      return (int32_t)(((uint64_t)numerator * multiplier) >> shift) + offset;
+    }
+    return offset - (int32_t)(((uint64_t)(-numerator) * multiplier) >> shift);
+  }
+};
+
+// Per-channel mapping from a raw 12-bit ADC value to the -511..512 channel
+// range, with trim folded in. Rebuilt only when calibration, trim or the
+// throttle mode changes; the per-sample cost is a compare and a multiply.
+class ChannelMapper {
+private:
+  int32_t split;
+  int16_t trim;
+  MapSegment lower;
+  MapSegment upper;
+
+public:
+  static const int16_t OUTPUT_MIN = -511;
+  static const int16_t OUTPUT_MID = 0;
+  static const int16_t OUTPUT_MAX = 512;
+
+  ChannelMapper() : split(0), trim(0) {}
+
+  // Centred stick: min..mid maps to -511..0, mid..max to 0..512
+  void configure(int16_t min_val, int16_t mid_val, int16_t max_val, int16_t trim_val) {
+    split = mid_val;
+    trim = trim_val;
+    lower.configure(min_val, mid_val, OUTPUT_MIN, OUTPUT_MID);
+    upper.configure(mid_val, max_val, OUTPUT_MID, OUTPUT_MAX);
+  }
+
+  // Single linear range over the whole input
+  void configureLinear(int16_t in_min, int16_t in_max, int16_t trim_val) {
+    split = in_min;
+    trim = trim_val;
+    lower.configure(in_min, in_max, OUTPUT_MIN, OUTPUT_MAX);
+    upper = lower;
+  }
+
+  // Trim buttons move the trim alone, the segments stay as they are
+  void setTrim(int16_t trim_val) { trim = trim_val; }
+
+  int16_t map(uint16_t raw) const {
+    int16_t mapped = (int16_t)(raw < split ? lower.map(raw) : upper.map(raw));
+    return (int16_t)(mapped + trim);
+  }
+};
+
+#endif
@@ -2,39 +2,20 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include <channel_data.h>
+#include <pipe_addresses.h>
+#include "pin_definitions.h"
+#include "input_filter.h"
 
-// NRF24L01 Configuration
+// NRF24L01 Configuration, pipe addresses are shared with the receivers
 const int CHANNEL_COUNT = 12;
-const uint8_t MAX_RECEIVERS = 8;
-const uint64_t BASE_PIPES[MAX_RECEIVERS] = {
-  0xF0F0F0F0E1LL, 0xF0F0F0F0E2LL, 0xF0F0F0F0E3LL, 0xF0F0F0F0E4LL,
-  0xF0F0F0F0E5LL, 0xF0F0F0F0E6LL, 0xF0F0F0F0E7LL, 0xF0F0F0F0E8LL
-};
 
-// Receiver Names
-const String RECEIVER_NAMES[MAX_RECEIVERS] = {
-  "Hexapod-1", "Hexapod-2", "RC Car-1", "RC Car-2", 
+// Receiver names, a constant table that stays in flash
+constexpr const char* RECEIVER_NAMES[MAX_RECEIVERS] = {
+  "Hexapod-1", "Hexapod-2", "RC Car-1", "RC Car-2",
   "Drone-1", "Boat-1", "Tank-1", "Custom-1"
 };
 
-// Channel Configuration
-struct ChannelData {
-  int16_t throttle;
-  int16_t pitch;
-  int16_t roll;
-  int16_t yaw;
-  int16_t aux1;
-  int16_t aux2;
-  uint8_t aux3 : 1;
-  uint8_t aux4 : 1;
-  uint8_t aux5 : 1;
-  uint8_t aux6 : 1;
-  int8_t aux7;
-  int8_t aux8;
-  uint8_t receiver_id;
-  uint32_t timestamp;
-};
-
 // Trim Settings
 struct TrimSettings {
   int16_t pitch_trim;
@@ -52,13 +33,40 @@ struct CalibrationData {
   int16_t aux2_min, aux2_max, aux2_mid;
 };
 
+// Per-receiver slot request for multi-receiver (TDMA) mode
+struct ReceiverLink {
+  uint8_t enabled;      // Driven alongside the other enabled receivers
+  uint8_t rate_hz;      // Requested frame rate
+  uint8_t priority;     // Higher keeps its slots when the cycle is full
+  uint8_t channel;      // RF channel this receiver listens on when not hopping
+  uint8_t hopping;      // Follows the hop sequence bound to its pipe address
+};
+
+// Model memory: everything that belongs to the model rather than to the
+// transmitter, one per receiver. Journaled as a single record, so it has
+// to stay within the journal payload (52 bytes).
+struct ModelProfile {
+  TrimSettings trim;
+  uint8_t throttle_bidirectional;
+  uint8_t mix;                                   // MixPreset
+  ChannelFilter filters[ANALOG_CHANNEL_COUNT];   // By analog slot
+};
+
 // System Settings
 struct SystemSettings {
   uint8_t current_receiver;
-  bool throttle_bidirectional;
-  TrimSettings trim;
   CalibrationData calibration;
   bool save_settings;
+  ReceiverLink fleet[MAX_RECEIVERS];
+  ModelProfile models[MAX_RECEIVERS];            // By receiver, as BASE_PIPES
 };
 
+inline ModelProfile& activeModel(SystemSettings& settings) {
+  return settings.models[settings.current_receiver];
+}
+
+inline const ModelProfile& activeModel(const SystemSettings& settings) {
+  return settings.models[settings.current_receiver];
+}
+
 #endif
\ No newline at end of file
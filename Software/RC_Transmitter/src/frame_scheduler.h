@@ -0,0 +1,77 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "interval_histogram.h"
+
+// Drives the control task from a periodic esp_timer. The timer fires on a
+// fixed microsecond grid, so time spent sampling and transmitting never
+// shifts the next frame. Every wake-up is recorded in a histogram.
+class FrameScheduler {
+private:
+  esp_timer_handle_t timer;
+  TaskHandle_t task;
+  uint32_t period_us;
+  int64_t last_frame_us;
+  uint32_t missed_frames;
+  volatile bool reset_requested;
+  IntervalHistogram histogram;
+
+  static void onTimer(void* arg) {
+    FrameScheduler* scheduler = static_cast<FrameScheduler*>(arg);
+    xTaskNotifyGive(scheduler->task);
+  }
+
+public:
+  FrameScheduler(uint32_t period, uint32_t bucket_width)
+    : timer(NULL), task(NULL), period_us(period), last_frame_us(0),
+      missed_frames(0), reset_requested(false), histogram(period, bucket_width) {}
+
+  // Must be called from the task that will wait for frames
+  bool begin() {
+    task = xTaskGetCurrentTaskHandle();
+
+    esp_timer_create_args_t args = {};
+    args.callback = &FrameScheduler::onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "frame";
+
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+      return false;
+    }
+    return esp_timer_start_periodic(timer, period_us) == ESP_OK;
+  }
+
+  // Blocks until the next frame tick, returns the wake-up time in us
+  int64_t waitForFrame() {
+    uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+
+    if (reset_requested) {
+      histogram.reset();
+      missed_frames = 0;
+      last_frame_us = 0;
+      reset_requested = false;
+    }
+    if (ticks > 1) {
+      missed_frames += ticks - 1;
+    }
+    if (last_frame_us != 0) {
+      histogram.record((uint32_t)(now - last_frame_us));
+    }
+    last_frame_us = now;
+    return now;
+  }
+
+  const IntervalHistogram& stats() const { return histogram; }
+  uint32_t missedFrames() const { return missed_frames; }
+
+  // Safe to call from any task, applied on the next frame
+  void resetStats() {
+    reset_requested = true;
+  }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef FRAMEBUFFER_DIFF_H
+#define FRAMEBUFFER_DIFF_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Shadow copy of what the SSD1306 is currently showing. For each 8-row
+// page it reports the column range that differs from the new framebuffer,
+// so only that window has to be pushed over I2C.
+template <uint8_t WIDTH, uint8_t HEIGHT>
+class FramebufferDiff {
+public:
+  static const uint8_t PAGE_COUNT = HEIGHT / 8;
+
+private:
+  uint8_t shadow[PAGE_COUNT * WIDTH];
+  bool valid;
+
+public:
+  FramebufferDiff() : valid(false) {}
+
+  // Forces the next pass to report every page as dirty
+  void invalidate() {
+    valid = false;
+  }
+
+  // Returns false if the page is unchanged. Otherwise sets the first and
+  // last differing column and updates the shadow copy of that range.
+  bool takeDirtyRange(const uint8_t* frame, uint8_t page, uint8_t& first, uint8_t& last) {
+    const uint8_t* row = frame + page * WIDTH;
+    uint8_t* copy = shadow + page * WIDTH;
+
+    if (!valid) {
+      first = 0;
+      last = WIDTH - 1;
+    } else {
+      int16_t start = 0;
+      while (start < WIDTH && row[start] == copy[start]) start++;
+      if (start == WIDTH) return false;
+
+      int16_t end = WIDTH - 1;
+      while (end > start && row[end] == copy[end]) end--;
+
+      first = (uint8_t)start;
+      last = (uint8_t)end;
+    }
+
+    memcpy(copy + first, row + first, last - first + 1);
+    if (page == PAGE_COUNT - 1) {
+      valid = true;
+    }
+    return true;
+  }
+};
+
+#endif
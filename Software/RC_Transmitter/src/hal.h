@@ -0,0 +1,33 @@
+#ifndef HAL_H
+#define HAL_H
+
+// Hardware abstraction layer. Each backend provides the same set of types
+// with identical method names, so the application code binds to them at
+// compile time with no virtual dispatch:
+//
+//   RadioDriver    nRF24L01 (RF24 subset used by AsyncRadio)
+//   AnalogInputs   oversampled stick/pot channels by AnalogSlot
+//   SharedBus      priority arbitration of the shared I2C bus
+//   IoExpander     PCF8575 trim-button expander
+//   ImuSensor      MPU6050 sampling into its FIFO, read in bursts
+//   DisplayDriver  SSD1306 drawing plus windowed framebuffer flush
+//   FlashStorage   raw sectors for the settings journal
+//   Runtime        runs the control, UI and settings steps on schedule
+//
+// cycleCount() and cyclesPerMicrosecond() expose the CPU cycle counter for
+// profiling.
+//
+// GPIO and the clock are the Arduino digitalRead()/millis()/micros() calls,
+// which the native backend serves from simulated pins and a virtual clock.
+
+// Display geometry shared by all backends
+#define SCREEN_WIDTH 128
+#define SCREEN_HEIGHT 64
+
+#ifdef ARDUINO_ARCH_ESP32
+#include "hal_esp32.h"
+#else
+#include <native_hal.h>
+#endif
+
+#endif
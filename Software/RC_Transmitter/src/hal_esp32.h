@@ -0,0 +1,498 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <nRF24L01.h>
+#include <RF24.h>
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+#include <PCF8575.h>
+#include <EEPROM.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+
+#include "config.h"
+#include "adc_sampler.h"
+#include "frame_scheduler.h"
+#include "task_layout.h"
+#include "bus_arbiter.h"
+#include "mpu6050_fifo.h"
+
+#define OLED_RESET -1
+#define OLED_ADDRESS 0x3C
+#define OLED_I2C_CLOCK 400000UL
+#define OLED_CHUNK_SIZE 31          // Data bytes per I2C transaction
+
+typedef RF24 RadioDriver;
+typedef AdcSampler AnalogInputs;
+
+// The I2C bus shared by the OLED, the PCF8575 and the MPU6050. Every
+// transaction is bracketed by acquire() and release(); a device that finds
+// the bus taken blocks on its own semaphore until BusArbiter hands it over.
+// Devices are used from one task each.
+class SharedBus {
+private:
+  BusArbiter arbiter;
+  portMUX_TYPE lock;
+  SemaphoreHandle_t granted[BUS_DEVICE_COUNT];
+
+public:
+  SharedBus() : lock(portMUX_INITIALIZER_UNLOCKED) {
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      granted[i] = NULL;
+    }
+  }
+
+  bool begin() {
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      granted[i] = xSemaphoreCreateBinary();
+      if (granted[i] == NULL) return false;
+    }
+    return true;
+  }
+
+  void acquire(uint8_t device) {
+    portENTER_CRITICAL(&lock);
+    bool idle = arbiter.request(device, micros());
+    portEXIT_CRITICAL(&lock);
+    if (!idle) xSemaphoreTake(granted[device], portMAX_DELAY);
+  }
+
+  void release(uint8_t device) {
+    portENTER_CRITICAL(&lock);
+    uint8_t next = arbiter.release(device, micros());
+    portEXIT_CRITICAL(&lock);
+    if (next != BUS_FREE) xSemaphoreGive(granted[next]);
+  }
+
+  BusDeviceStats stats(uint8_t device) {
+    portENTER_CRITICAL(&lock);
+    BusDeviceStats copy = arbiter.stats(device);
+    portEXIT_CRITICAL(&lock);
+    return copy;
+  }
+
+  void resetStats() {
+    portENTER_CRITICAL(&lock);
+    arbiter.resetStats();
+    portEXIT_CRITICAL(&lock);
+  }
+};
+
+// PCF8575 whose INT line calls on_change, with a read of all 16 pins in
+// a single 2-byte transaction
+class IoExpander : public PCF8575 {
+private:
+  SharedBus& bus;
+  uint8_t i2c_address;
+
+public:
+  IoExpander(SharedBus& shared_bus, uint8_t address, uint8_t interrupt_pin, void (*on_change)())
+    : PCF8575(address, interrupt_pin, on_change), bus(shared_bus), i2c_address(address) {}
+
+  // Reading releases INT; a failed read reports every pin high (released)
+  uint16_t readAll() {
+    bus.acquire(BUS_EXPANDER);
+    uint16_t levels = 0xFFFF;
+    if (Wire.requestFrom(i2c_address, (uint8_t)2) == 2) {
+      levels = Wire.read();
+      levels |= (uint16_t)Wire.read() << 8;
+    }
+    bus.release(BUS_EXPANDER);
+    return levels;
+  }
+};
+
+// MPU6050 sampling into its FIFO. A read takes FIFO_COUNT, then drains
+// the whole samples in bursts of up to IMU_BURST_SAMPLES, each burst one
+// bus transaction; an overflowed FIFO is reset and its contents dropped.
+class ImuSensor {
+private:
+  SharedBus& bus;
+  uint8_t i2c_address;
+  ImuFifoStats fifo_stats;
+
+  bool writeRegister(uint8_t reg, uint8_t value) {
+    bus.acquire(BUS_IMU);
+    Wire.beginTransmission(i2c_address);
+    Wire.write(reg);
+    Wire.write(value);
+    bool ok = Wire.endTransmission() == 0;
+    bus.release(BUS_IMU);
+    return ok;
+  }
+
+  bool readRegisters(uint8_t reg, uint8_t* out, uint8_t count) {
+    bus.acquire(BUS_IMU);
+    Wire.beginTransmission(i2c_address);
+    Wire.write(reg);
+    bool ok = Wire.endTransmission(false) == 0 && Wire.requestFrom(i2c_address, count) == count;
+    for (uint8_t i = 0; ok && i < count; i++) {
+      out[i] = Wire.read();
+    }
+    bus.release(BUS_IMU);
+    if (!ok) fifo_stats.errors++;
+    return ok;
+  }
+
+public:
+  ImuSensor(SharedBus& shared_bus, uint8_t address) : bus(shared_bus), i2c_address(address) {
+    resetStats();
+  }
+
+  bool begin() {
+    uint8_t who_am_i = 0;
+    if (!readRegisters(MPU6050_WHO_AM_I, &who_am_i, 1) || who_am_i != MPU6050_ADDRESS) return false;
+    for (uint8_t i = 0; i < MPU6050_SETUP_COUNT; i++) {
+      if (!writeRegister(MPU6050_SETUP[i].reg, MPU6050_SETUP[i].value)) return false;
+    }
+    return true;
+  }
+
+  // Takes up to max_samples of the oldest samples waiting
+  uint8_t read(ImuSample* samples, uint8_t max_samples) {
+    uint8_t count_bytes[2];
+    if (!readRegisters(MPU6050_FIFO_COUNT_H, count_bytes, 2)) return 0;
+    int16_t waiting = fifoSamples(((uint16_t)count_bytes[0] << 8) | count_bytes[1]);
+    if (waiting < 0) {
+      fifo_stats.overflows++;
+      writeRegister(MPU6050_USER_CTRL, MPU6050_USER_FIFO_RESET | MPU6050_USER_FIFO_EN);
+      return 0;
+    }
+    if (waiting > max_samples) waiting = max_samples;
+
+    uint8_t taken = 0;
+    uint8_t burst[IMU_BURST_SAMPLES * IMU_SAMPLE_BYTES];
+    while (taken < waiting) {
+      uint8_t count = waiting - taken < IMU_BURST_SAMPLES ? waiting - taken : IMU_BURST_SAMPLES;
+      if (!readRegisters(MPU6050_FIFO_R_W, burst, count * IMU_SAMPLE_BYTES)) break;
+      fifo_stats.bursts++;
+      for (uint8_t i = 0; i < count; i++) {
+        parseFifoSample(&burst[i * IMU_SAMPLE_BYTES], samples[taken++]);
+      }
+    }
+    if (taken > 0) {
+      fifo_stats.batches++;
+      fifo_stats.samples += taken;
+      if (taken > fifo_stats.max_batch) fifo_stats.max_batch = taken;
+    }
+    return taken;
+  }
+
+  const ImuFifoStats& stats() const { return fifo_stats; }
+
+  void resetStats() {
+    ImuFifoStats cleared = {};
+    fifo_stats = cleared;
+  }
+};
+
+// SSD1306 with a flush path that pushes a single page window over I2C.
+// Each transaction takes the shared bus on its own, so input reads get in
+// between chunks; a chunk holds the bus for about 0.75 ms at 400 kHz.
+// The frame buffer is a member, so begin() finds it set and skips the
+// library's malloc.
+class DisplayDriver : public Adafruit_SSD1306 {
+private:
+  SharedBus* bus;
+  uint32_t bus_bytes;
+  uint8_t frame[SCREEN_WIDTH * SCREEN_HEIGHT / 8];
+
+public:
+  DisplayDriver()
+    : Adafruit_SSD1306(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET, OLED_I2C_CLOCK, OLED_I2C_CLOCK),
+      bus(NULL), bus_bytes(0) {
+    buffer = frame;
+  }
+
+  // Keeps the library's destructor from freeing the member buffer
+  ~DisplayDriver() { buffer = NULL; }
+
+  void setBus(SharedBus* shared_bus) { bus = shared_bus; }
+
+  bool begin() {
+    return Adafruit_SSD1306::begin(SSD1306_SWITCHCAPVCC, OLED_ADDRESS);
+  }
+
+  // Sends columns first..last of one 8-row page
+  void sendWindow(uint8_t page, uint8_t first, uint8_t last, const uint8_t* data) {
+    if (bus) bus->acquire(BUS_OLED);
+    Wire.beginTransmission(OLED_ADDRESS);
+    Wire.write((uint8_t)0x00); // Command stream
+    Wire.write((uint8_t)SSD1306_PAGEADDR);
+    Wire.write(page);
+    Wire.write(page);
+    Wire.write((uint8_t)SSD1306_COLUMNADDR);
+    Wire.write(first);
+    Wire.write(last);
+    Wire.endTransmission();
+    if (bus) bus->release(BUS_OLED);
+    bus_bytes += 8;
+
+    uint16_t remaining = last - first + 1;
+    while (remaining > 0) {
+      uint8_t chunk = remaining < OLED_CHUNK_SIZE ? remaining : OLED_CHUNK_SIZE;
+      if (bus) bus->acquire(BUS_OLED);
+      Wire.beginTransmission(OLED_ADDRESS);
+      Wire.write((uint8_t)0x40); // Data stream
+      Wire.write(data, chunk);
+      Wire.endTransmission();
+      if (bus) bus->release(BUS_OLED);
+      bus_bytes += chunk + 2;
+      data += chunk;
+      remaining -= chunk;
+    }
+  }
+
+  // Bytes pushed over I2C by all flushes so far
+  uint32_t busBytes() const { return bus_bytes; }
+};
+
+// Raw access to the "settings" data partition
+class FlashStorage {
+private:
+  const esp_partition_t* partition;
+
+public:
+  FlashStorage() : partition(NULL) {}
+
+  bool begin(const char* label) {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    return partition != NULL;
+  }
+
+  uint16_t sectorSize() const { return SPI_FLASH_SEC_SIZE; }
+  uint16_t sectorCount() const { return partition->size / SPI_FLASH_SEC_SIZE; }
+
+  void read(uint32_t offset, uint8_t* data, uint16_t length) const {
+    esp_partition_read(partition, offset, data, length);
+  }
+
+  void write(uint32_t offset, const uint8_t* data, uint16_t length) {
+    esp_partition_write(partition, offset, data, length);
+  }
+
+  void erase(uint16_t sector) {
+    esp_partition_erase_range(partition, (uint32_t)sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+  }
+};
+
+// CPU cycle counter of the calling core
+inline uint32_t cycleCount() {
+  return ESP.getCycleCount();
+}
+
+inline uint32_t cyclesPerMicrosecond() {
+  return getCpuFrequencyMhz();
+}
+
+// Settings blob written by firmware before the flash journal existed
+struct LegacySettings {
+  uint8_t current_receiver;
+  bool throttle_bidirectional;
+  TrimSettings trim;
+  CalibrationData calibration;
+  bool save_settings;
+};
+
+// The blob held one trim and throttle mode for all receivers, every
+// model starts from them
+inline bool loadLegacySettings(SystemSettings& settings) {
+  LegacySettings legacy;
+
+  EEPROM.begin(512);
+  EEPROM.get(0, legacy);
+  EEPROM.end();
+
+  if (legacy.current_receiver >= MAX_RECEIVERS) {
+    return false;
+  }
+  settings.current_receiver = legacy.current_receiver;
+  settings.calibration = legacy.calibration;
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    settings.models[i].throttle_bidirectional = legacy.throttle_bidirectional;
+    settings.models[i].trim = legacy.trim;
+  }
+  return true;
+}
+
+// FreeRTOS runtime - radio timing runs alone on the app core, UI and
+// flash work share the protocol core at low priority. The UI task sleeps
+// for as long as its step asks, at most ui_interval_ms, or until woken;
+// the input task likewise, but with no upper bound. The IMU task runs its
+// step on a fixed cadence, the period being whatever the step returns.
+class Runtime {
+public:
+  typedef void (*Step)();
+  typedef uint32_t (*UiStep)();     // Returns the ms it may sleep for
+  static const uint32_t NO_DEADLINE = 0xFFFFFFFF;
+
+private:
+  static_assert(CONTROL_TASK_PRIORITY < configMAX_PRIORITIES, "control task priority out of range");
+
+  static const uint32_t CONTROL_TASK_STACK = 4096;
+  static const uint32_t UI_TASK_STACK = 4096;
+  static const uint32_t INPUT_TASK_STACK = 3072;
+  static const uint32_t IMU_TASK_STACK = 3072;
+  static const uint32_t SETTINGS_TASK_STACK = 3072;
+
+  FrameScheduler frame_scheduler;
+  uint32_t ui_interval_ms;
+  uint32_t settings_interval_ms;
+  Step control_step;
+  UiStep ui_step;
+  Step settings_step;
+  Step timer_step;
+  UiStep input_step;
+  UiStep imu_step;
+  TaskHandle_t ui_task;
+  TaskHandle_t input_task;
+  esp_timer_handle_t timer;
+  volatile uint32_t ui_wakes;
+
+  static BaseType_t coreId(int8_t core) {
+    return core == TASK_NO_AFFINITY ? tskNO_AFFINITY : core;
+  }
+
+  static void controlTask(void* param) {
+    Runtime* runtime = static_cast<Runtime*>(param);
+    if (!runtime->frame_scheduler.begin()) {
+      Serial.println("Frame timer initialization failed!");
+      vTaskDelete(NULL);
+    }
+
+    for (;;) {
+      runtime->frame_scheduler.waitForFrame();
+      runtime->control_step();
+    }
+  }
+
+  static void uiTask(void* param) {
+    Runtime* runtime = static_cast<Runtime*>(param);
+    for (;;) {
+      uint32_t sleep_ms = runtime->ui_step();
+      if (sleep_ms > runtime->ui_interval_ms) sleep_ms = runtime->ui_interval_ms;
+      if (sleep_ms == 0) sleep_ms = 1;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep_ms));
+      runtime->ui_wakes++;
+    }
+  }
+
+  static void inputTask(void* param) {
+    Runtime* runtime = static_cast<Runtime*>(param);
+    for (;;) {
+      uint32_t sleep_ms = runtime->input_step();
+      if (sleep_ms == 0) sleep_ms = 1;
+      ulTaskNotifyTake(pdTRUE, sleep_ms == NO_DEADLINE ? portMAX_DELAY : pdMS_TO_TICKS(sleep_ms));
+    }
+  }
+
+  static void imuTask(void* param) {
+    Runtime* runtime = static_cast<Runtime*>(param);
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+      uint32_t period_ms = runtime->imu_step();
+      vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(period_ms));
+    }
+  }
+
+  static void settingsTask(void* param) {
+    Runtime* runtime = static_cast<Runtime*>(param);
+    for (;;) {
+      runtime->settings_step();
+      vTaskDelay(pdMS_TO_TICKS(runtime->settings_interval_ms));
+    }
+  }
+
+public:
+  Runtime(uint32_t frame_us, uint32_t jitter_bucket_us, uint32_t ui_ms, uint32_t settings_ms)
+    : frame_scheduler(frame_us, jitter_bucket_us), ui_interval_ms(ui_ms),
+      settings_interval_ms(settings_ms), control_step(NULL), ui_step(NULL), settings_step(NULL),
+      timer_step(NULL), input_step(NULL), imu_step(NULL), ui_task(NULL), input_task(NULL), timer(NULL), ui_wakes(0) {}
+
+  void start(Step control, UiStep ui, Step settings) {
+    control_step = control;
+    ui_step = ui;
+    settings_step = settings;
+
+    xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, this,
+                            CONTROL_TASK_PRIORITY, NULL, coreId(CONTROL_TASK_CORE));
+    xTaskCreatePinnedToCore(uiTask, "ui", UI_TASK_STACK, this,
+                            UI_TASK_PRIORITY, &ui_task, coreId(UI_TASK_CORE));
+    xTaskCreatePinnedToCore(settingsTask, "settings", SETTINGS_TASK_STACK, this,
+                            SETTINGS_TASK_PRIORITY, NULL, coreId(UI_TASK_CORE));
+  }
+
+  void loop() {
+    // All work happens in the pinned tasks started from setup()
+    vTaskDelete(NULL);
+  }
+
+  // Runs step every period_ms from the esp_timer task
+  bool startTimer(uint32_t period_ms, Step step) {
+    timer_step = step;
+
+    esp_timer_create_args_t args = {};
+    args.callback = &Runtime::onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "buttons";
+
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+      return false;
+    }
+    return esp_timer_start_periodic(timer, (uint64_t)period_ms * 1000) == ESP_OK;
+  }
+
+  // Runs step in a task of its own on the UI core, above the UI
+  void startInput(UiStep step) {
+    input_step = step;
+    xTaskCreatePinnedToCore(inputTask, "input", INPUT_TASK_STACK, this,
+                            INPUT_TASK_PRIORITY, &input_task, coreId(UI_TASK_CORE));
+  }
+
+  // Runs step in a task of its own on the UI core, above the input task,
+  // every time the period it returns has passed
+  void startImu(UiStep step) {
+    imu_step = step;
+    xTaskCreatePinnedToCore(imuTask, "imu", IMU_TASK_STACK, this,
+                            IMU_TASK_PRIORITY, NULL, coreId(UI_TASK_CORE));
+  }
+
+  void IRAM_ATTR wakeInputFromIsr() {
+    if (input_task == NULL) return;
+    BaseType_t higher_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(input_task, &higher_woken);
+    if (higher_woken) portYIELD_FROM_ISR();
+  }
+
+  // Ends the UI task's sleep early, from a task or from an interrupt
+  void wakeUi() {
+    if (ui_task != NULL) xTaskNotifyGive(ui_task);
+  }
+
+  void IRAM_ATTR wakeUiFromIsr() {
+    if (ui_task == NULL) return;
+    BaseType_t higher_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(ui_task, &higher_woken);
+    if (higher_woken) portYIELD_FROM_ISR();
+  }
+
+  // UI task iterations since boot
+  uint32_t uiWakes() const { return ui_wakes; }
+
+  const IntervalHistogram& frameStats() const { return frame_scheduler.stats(); }
+  uint32_t missedFrames() const { return frame_scheduler.missedFrames(); }
+  void resetStats() { frame_scheduler.resetStats(); }
+
+private:
+  static void onTimer(void* arg) {
+    static_cast<Runtime*>(arg)->timer_step();
+  }
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef INPUT_FILTER_H
+#define INPUT_FILTER_H
+
+#include <stdint.h>
+#include "channel_mapper.h"
+
+// Per-channel filter settings, in channel units (-511..512)
+struct ChannelFilter {
+  uint8_t median;           // 1 = median of the last three values
+  uint8_t smoothing;        // First-order low-pass, 0 = off .. 255 = heaviest
+  uint8_t deadband;         // Values this close to centre read as centre
+  uint8_t reserved;
+  uint16_t slew_per_s;      // Largest change per second, 0 = unlimited
+};
+
+// Filter stages run on mapped channel values in integer arithmetic. Each
+// takes its parameters from ChannelFilter, and a stage whose parameter is
+// zero passes values through. reset() primes a stage's state so a constant
+// input comes straight out, and returns that output.
+
+// Median of the last N values, rejects single-sample spikes at the cost of
+// (N - 1) / 2 samples of delay on a step
+template <uint8_t N>
+class MedianStage {
+private:
+  int16_t window[N];
+  uint8_t next;
+  bool enabled;
+
+  static int16_t median(const int16_t* values) {
+    int16_t sorted[N];
+    for (uint8_t i = 0; i < N; i++) {
+      int16_t value = values[i];
+      uint8_t j = i;
+      for (; j > 0 && sorted[j - 1] > value; j--) sorted[j] = sorted[j - 1];
+      sorted[j] = value;
+    }
+    return sorted[N / 2];
+  }
+
+public:
+  MedianStage() : next(0), enabled(false) {
+    for (uint8_t i = 0; i < N; i++) window[i] = 0;
+  }
+
+  void configure(const ChannelFilter& settings, uint32_t period_us) {
+    enabled = settings.median != 0;
+  }
+
+  int16_t reset(int16_t value) {
+    for (uint8_t i = 0; i < N; i++) window[i] = value;
+    next = 0;
+    return value;
+  }
+
+  int16_t apply(int16_t value) {
+    window[next] = value;
+    next = next + 1 < N ? next + 1 : 0;
+    return enabled ? median(window) : value;
+  }
+};
+
+// Three values need no sort
+template <>
+inline int16_t MedianStage<3>::median(const int16_t* values) {
+  int16_t low = values[0] < values[1] ? values[0] : values[1];
+  int16_t high = values[0] < values[1] ? values[1] : values[0];
+  int16_t upper = high < values[2] ? high : values[2];
+  return low > upper ? low : upper;
+}
+
+// y += (x - y) * (256 - smoothing) / 256, state kept with 8 fractional bits
+// so small steps still settle exactly
+class IirStage {
+private:
+  int32_t state;
+  int32_t alpha;
+
+public:
+  IirStage() : state(0), alpha(256) {}
+
+  void configure(const ChannelFilter& settings, uint32_t period_us) {
+    alpha = 256 - settings.smoothing;
+  }
+
+  int16_t reset(int16_t value) {
+    state = (int32_t)value * 256;
+    return value;
+  }
+
+  int16_t apply(int16_t value) {
+    int32_t target = (int32_t)value * 256;
+    state += (target - state) * alpha / 256;
+    return (int16_t)((state + (state >= 0 ? 128 : -128)) / 256);
+  }
+};
+
+// Zeroes values within deadband of centre and stretches the rest so the
+// ends of the range are still reached
+class DeadbandStage {
+private:
+  int16_t band;
+  uint32_t upper_scale;     // 16 fractional bits
+  uint32_t lower_scale;
+
+public:
+  DeadbandStage() : band(0), upper_scale(1UL << 16), lower_scale(1UL << 16) {}
+
+  void configure(const ChannelFilter& settings, uint32_t period_us) {
+    int16_t high = ChannelMapper::OUTPUT_MAX;
+    int16_t low = -ChannelMapper::OUTPUT_MIN;
+    band = settings.deadband;
+    // Rounded up, so the ends of the range come out exact
+    upper_scale = (((uint32_t)high << 16) + high - band - 1) / (high - band);
+    lower_scale = (((uint32_t)low << 16) + low - band - 1) / (low - band);
+  }
+
+  int16_t reset(int16_t value) { return apply(value); }
+
+  int16_t apply(int16_t value) {
+    if (band == 0) return value;
+    if (value > band) return (int16_t)(((uint32_t)(value - band) * upper_scale) >> 16);
+    if (value < -band) return -(int16_t)(((uint32_t)(-value - band) * lower_scale) >> 16);
+    return 0;
+  }
+};
+
+// Limits the change per sample to slew_per_s scaled to the sample period,
+// with 8 fractional bits so slow rates still move
+class SlewStage {
+private:
+  int32_t state;
+  int32_t limit;            // Per sample, 0 = unlimited
+
+public:
+  SlewStage() : state(0), limit(0) {}
+
+  void configure(const ChannelFilter& settings, uint32_t period_us) {
+    limit = (int32_t)((uint64_t)settings.slew_per_s * 256 * period_us / 1000000UL);
+    if (settings.slew_per_s > 0 && limit == 0) limit = 1;
+  }
+
+  int16_t reset(int16_t value) {
+    state = (int32_t)value * 256;
+    return value;
+  }
+
+  int16_t apply(int16_t value) {
+    int32_t target = (int32_t)value * 256;
+    if (limit == 0) {
+      state = target;
+      return value;
+    }
+    int32_t delta = target - state;
+    if (delta > limit) delta = limit;
+    if (delta < -limit) delta = -limit;
+    state += delta;
+    return (int16_t)((state + (state >= 0 ? 128 : -128)) / 256);
+  }
+};
+
+// Chain of stages fixed at compile time; apply() inlines into straight-line
+// code and a stage left out of the list costs nothing
+template <class... Stages>
+class FilterStages;
+
+template <>
+class FilterStages<> {
+public:
+  void configure(const ChannelFilter& settings, uint32_t period_us) {}
+  int16_t reset(int16_t value) { return value; }
+  int16_t apply(int16_t value) { return value; }
+};
+
+template <class First, class... Rest>
+class FilterStages<First, Rest...> {
+private:
+  First first;
+  FilterStages<Rest...> rest;
+
+public:
+  void configure(const ChannelFilter& settings, uint32_t period_us) {
+    first.configure(settings, period_us);
+    rest.configure(settings, period_us);
+  }
+
+  int16_t reset(int16_t value) { return rest.reset(first.reset(value)); }
+  int16_t apply(int16_t value) { return rest.apply(first.apply(value)); }
+};
+
+// One channel's filter. The first value after construction or restart()
+// primes every stage, so filtering starts without a ramp from zero.
+template <class... Stages>
+class FilterPipeline {
+private:
+  FilterStages<Stages...> stages;
+  bool primed;
+
+public:
+  FilterPipeline() : primed(false) {}
+
+  // Keeps the filter state, new parameters apply from the next value
+  void configure(const ChannelFilter& settings, uint32_t period_us) {
+    stages.configure(settings, period_us);
+  }
+
+  void restart() { primed = false; }
+
+  int16_t apply(int16_t value) {
+    if (!primed) {
+      primed = true;
+      return stages.reset(value);
+    }
+    return stages.apply(value);
+  }
+};
+
+// Spikes go first so they never reach the low-pass; the deadband sees the
+// smoothed value and the slew limit has the last word
+typedef FilterPipeline<MedianStage<3>, IirStage, DeadbandStage, SlewStage> InputFilter;
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef INTERVAL_HISTOGRAM_H
+#define INTERVAL_HISTOGRAM_H
+
+#include <stdint.h>
+
+// Fixed-bucket histogram of inter-frame intervals in microseconds.
+// Buckets are centred on the nominal period; the first and last bucket
+// collect everything below/above the covered range.
+class IntervalHistogram {
+public:
+  static const uint8_t BUCKET_COUNT = 41;
+
+private:
+  uint32_t nominal_us;
+  uint32_t bucket_width_us;
+  uint32_t buckets[BUCKET_COUNT];
+  uint32_t samples;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+
+public:
+  IntervalHistogram(uint32_t nominal, uint32_t bucket_width)
+    : nominal_us(nominal), bucket_width_us(bucket_width) {
+    reset();
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+      buckets[i] = 0;
+    }
+    samples = 0;
+    min_us = UINT32_MAX;
+    max_us = 0;
+    total_us = 0;
+  }
+
+  void record(uint32_t interval_us) {
+    int32_t offset = (int32_t)(interval_us - nominal_us);
+    int32_t half_width = (int32_t)bucket_width_us / 2;
+    int32_t index = (offset >= 0 ? offset + half_width : offset - half_width) / (int32_t)bucket_width_us;
+    index += BUCKET_COUNT / 2;
+    if (index < 0) index = 0;
+    if (index >= BUCKET_COUNT) index = BUCKET_COUNT - 1;
+
+    buckets[index]++;
+    samples++;
+    total_us += interval_us;
+    if (interval_us < min_us) min_us = interval_us;
+    if (interval_us > max_us) max_us = interval_us;
+  }
+
+  uint32_t count() const { return samples; }
+  uint32_t minimum() const { return samples ? min_us : 0; }
+  uint32_t maximum() const { return max_us; }
+  uint32_t mean() const { return samples ? (uint32_t)(total_us / samples) : 0; }
+  uint32_t nominal() const { return nominal_us; }
+  uint32_t bucketWidth() const { return bucket_width_us; }
+  uint32_t bucket(uint8_t index) const { return buckets[index]; }
+
+  // Centre of a bucket in microseconds
+  int32_t bucketCentre(uint8_t index) const {
+    return (int32_t)nominal_us + ((int32_t)index - BUCKET_COUNT / 2) * (int32_t)bucket_width_us;
+  }
+
+  // Largest deviation from the nominal period seen so far
+  uint32_t peakJitter() const {
+    if (samples == 0) return 0;
+    uint32_t low = nominal_us > min_us ? nominal_us - min_us : 0;
+    uint32_t high = max_us > nominal_us ? max_us - nominal_us : 0;
+    return low > high ? low : high;
+  }
+
+  // Bucket-resolution percentile (0-100)
+  int32_t percentile(uint8_t pct) const {
+    if (samples == 0) return 0;
+    uint32_t target = (uint32_t)(((uint64_t)samples * pct + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+      seen += buckets[i];
+      if (seen >= target) return bucketCentre(i);
+    }
+    return bucketCentre(BUCKET_COUNT - 1);
+  }
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef LATENCY_MONITOR_H
+#define LATENCY_MONITOR_H
+
+#include <stdint.h>
+#include <telemetry_codec.h>
+
+#include "interval_histogram.h"
+
+// Stages of the input-to-servo path timed by the latency measurement mode
+enum LatencyStage {
+  LATENCY_SAMPLE,       // Newest ADC batch to inputs read
+  LATENCY_ENCODE,       // Inputs read to frame encoded, incl. retuning
+  LATENCY_QUEUE,        // Frame loaded into the TX FIFO
+  LATENCY_AIR,          // Queued to ACK received, retries included
+  LATENCY_ONE_WAY,      // Half of the above, the frame's share
+  LATENCY_RX_DECODE,    // Receiver: frame IRQ to decoded, echoed
+  LATENCY_RX_OUTPUT,    // Receiver: frame IRQ to outputs written, echoed
+  LATENCY_ECHO,         // Probe queued to its echo received
+  LATENCY_TOTAL,        // ADC batch to receiver outputs, estimated
+  LATENCY_STAGE_COUNT
+};
+
+// micros() at each step of one data frame
+struct LatencyStamps {
+  uint32_t sampled_us;
+  uint32_t read_us;
+  uint32_t encoded_us;
+  uint32_t queued_us;
+  uint32_t done_us;
+};
+
+// One histogram per stage. The two clocks are never compared: one-way air
+// time is taken as half the round trip, and the receiver's figures come
+// back as durations on its own clock. The total adds the newest echoed
+// receiver figure to the transmitter's stages of each frame.
+class LatencyMonitor {
+private:
+  // Histograms start at zero: the nominal sits in the middle bucket
+  static uint32_t firstCentre(uint32_t bucket_width) {
+    return bucket_width * (IntervalHistogram::BUCKET_COUNT / 2);
+  }
+
+  IntervalHistogram stages[LATENCY_STAGE_COUNT];
+  uint32_t rx_output_us;
+  bool echoed;
+
+public:
+  LatencyMonitor()
+    : stages{
+        IntervalHistogram(firstCentre(100), 100),
+        IntervalHistogram(firstCentre(5), 5),
+        IntervalHistogram(firstCentre(5), 5),
+        IntervalHistogram(firstCentre(50), 50),
+        IntervalHistogram(firstCentre(25), 25),
+        IntervalHistogram(firstCentre(5), 5),
+        IntervalHistogram(firstCentre(10), 10),
+        IntervalHistogram(firstCentre(250), 250),
+        IntervalHistogram(firstCentre(100), 100),
+      },
+      rx_output_us(0), echoed(false) {}
+
+  void reset() {
+    for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+      stages[i].reset();
+    }
+    echoed = false;
+  }
+
+  // Air, one-way and total only count for delivered frames
+  void recordFrame(const LatencyStamps& stamps, bool delivered) {
+    stages[LATENCY_SAMPLE].record(stamps.read_us - stamps.sampled_us);
+    stages[LATENCY_ENCODE].record(stamps.encoded_us - stamps.read_us);
+    stages[LATENCY_QUEUE].record(stamps.queued_us - stamps.encoded_us);
+    if (!delivered) return;
+
+    uint32_t air_us = stamps.done_us - stamps.queued_us;
+    stages[LATENCY_AIR].record(air_us);
+    stages[LATENCY_ONE_WAY].record(air_us / 2);
+    if (echoed) {
+      stages[LATENCY_TOTAL].record(stamps.queued_us - stamps.sampled_us + air_us / 2 + rx_output_us);
+    }
+  }
+
+  void recordEcho(const TelemetrySample& sample, uint32_t now_us) {
+    stages[LATENCY_RX_DECODE].record(sample.rx_decode_us);
+    stages[LATENCY_RX_OUTPUT].record(sample.rx_output_us);
+    stages[LATENCY_ECHO].record(now_us - sample.probe_us);
+    rx_output_us = sample.rx_output_us;
+    echoed = true;
+  }
+
+  const IntervalHistogram& stage(uint8_t index) const { return stages[index]; }
+
+  static const char* stageName(uint8_t index) {
+    static const char* const NAMES[LATENCY_STAGE_COUNT] = {
+      "sample", "encode", "queue", "air", "oneway", "rx_decode", "rx_output", "echo", "total"
+    };
+    return index < LATENCY_STAGE_COUNT ? NAMES[index] : "?";
+  }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef LATEST_VALUE_H
+#define LATEST_VALUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free single-producer / single-consumer mailbox holding the most
+// recent value (triple buffer). The writer never waits for the reader, so
+// the control task can publish every frame no matter how slow the UI is.
+template <typename T>
+class LatestValue {
+private:
+  static const uint32_t INDEX_MASK = 0x03;
+  static const uint32_t FRESH_FLAG = 0x04;
+
+  T buffers[3];
+  std::atomic<uint32_t> middle;   // Index of the shared buffer + fresh flag
+  uint32_t write_index;           // Owned by the producer
+  uint32_t read_index;            // Owned by the consumer
+
+public:
+  LatestValue() : buffers(), middle(1), write_index(0), read_index(2) {}
+
+  // Producer side: copy a value in and make it visible to the reader
+  void publish(const T& value) {
+    buffers[write_index] = value;
+    uint32_t previous = middle.exchange(write_index | FRESH_FLAG, std::memory_order_acq_rel);
+    write_index = previous & INDEX_MASK;
+  }
+
+  // Consumer side: returns true if a value newer than the last read was taken
+  bool read(T& out) {
+    bool fresh = (middle.load(std::memory_order_acquire) & FRESH_FLAG) != 0;
+    if (fresh) {
+      uint32_t previous = middle.exchange(read_index, std::memory_order_acq_rel);
+      read_index = previous & INDEX_MASK;
+    }
+    out = buffers[read_index];
+    return fresh;
+  }
+};
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stdint.h>
+#include <string.h>
+#include <link_control.h>
+
+// Outcome of the last WINDOW frames sent to one receiver
+class LinkQuality {
+public:
+  static const uint8_t WINDOW = 64;
+  static const uint16_t AVERAGE_FRAMES = 512;
+
+private:
+  uint64_t delivered_bits;      // Bit i set if frame i (0 = newest) got through
+  uint8_t retries[WINDOW];
+  uint8_t position;
+  uint8_t samples;
+  uint8_t delivered;
+  uint16_t retry_total;
+  uint16_t burst;               // Current run of consecutive losses
+  uint16_t worst_burst;
+  int32_t retry_average;        // Retransmits per frame x1000, in 1/256
+  uint16_t average_samples;
+
+public:
+  LinkQuality() {
+    reset();
+  }
+
+  void reset() {
+    delivered_bits = 0;
+    memset(retries, 0, sizeof(retries));
+    position = 0;
+    samples = 0;
+    delivered = 0;
+    retry_total = 0;
+    burst = 0;
+    worst_burst = 0;
+    retry_average = 0;
+    average_samples = 0;
+  }
+
+  void record(bool ok, uint8_t arc) {
+    if (samples == WINDOW) {
+      if (delivered_bits & (1ULL << (WINDOW - 1))) delivered--;
+      retry_total -= retries[position];
+    } else {
+      samples++;
+    }
+    delivered_bits = (delivered_bits << 1) | (ok ? 1 : 0);
+    if (ok) delivered++;
+    retries[position] = arc;
+    retry_total += arc;
+    position = (position + 1) % WINDOW;
+
+    burst = ok ? 0 : burst + 1;
+    if (burst > worst_burst) worst_burst = burst;
+
+    if (average_samples < AVERAGE_FRAMES) average_samples++;
+    retry_average += ((int32_t)arc * 256000 - retry_average) / average_samples;
+  }
+
+  uint8_t count() const { return samples; }
+  uint16_t lossBurst() const { return burst; }
+  uint16_t worstBurst() const { return worst_burst; }
+
+  // Delivered frames, % of the window
+  uint8_t deliveryRatio() const {
+    return samples ? (uint8_t)((uint16_t)delivered * 100 / samples) : 100;
+  }
+
+  // Auto-retransmits per frame, x100
+  uint16_t meanRetries() const {
+    return samples ? (uint16_t)((uint32_t)retry_total * 100 / samples) : 0;
+  }
+
+  // Auto-retransmits per frame x1000, averaged over about AVERAGE_FRAMES;
+  // steadier than the window, for comparing conditions over minutes
+  uint16_t averageRetries() const { return (uint16_t)(retry_average >> 8); }
+  bool averageSettled() const { return average_samples == AVERAGE_FRAMES; }
+};
+
+// Picks the link profile for one receiver. A full window below the
+// delivery target, or a burst of losses, steps towards the robust end at
+// once. Stepping back down needs a clean window and a long-run retransmit
+// average low enough that the cheaper profile, with less margin, should
+// still hold. Each profile also has a hold-off that doubles whenever it
+// fails within MAX_HOLD_DOWN_MS of being switched to, so a marginal link
+// settles instead of flapping. The hold-off starts over once the
+// retransmit average has stayed below a quarter of what it was when the
+// profile was last tried: the link has improved, and the cheaper profile
+// is worth another go.
+//
+// Changes go through the receiver: the policy asks for a control frame,
+// and only switches when that frame's ACK arrives.
+class LinkPolicy {
+public:
+  static const uint8_t DELIVERY_TARGET = 97;          // %
+  static const uint8_t STEP_DOWN_DELIVERY = 100;      // %
+  static const uint16_t STEP_DOWN_RETRIES = 80;       // per frame x1000, averaged
+  static const uint8_t MIN_SAMPLES = LinkQuality::WINDOW / 2;
+  static const uint8_t BURST_LIMIT = 4;
+  static const uint32_t HOLD_DOWN_MS = 2000;
+  static const uint32_t MAX_HOLD_DOWN_MS = 600000;
+
+private:
+  LinkQuality quality;
+  uint8_t current;
+  uint8_t target;               // Profile being announced, == current if none
+  uint32_t changed_ms;
+  uint32_t last_ack_ms;
+  uint32_t hold_down_ms[LINK_PROFILE_COUNT];      // Before trying each profile again
+  uint16_t tried_retries[LINK_PROFILE_COUNT];     // Average retries when it was last tried
+  uint16_t improved_frames;
+  uint32_t change_count;
+
+  // True if it gave up on the receiver and dropped to the fallback profile.
+  // Every profile goes quiet in a blackout, so no hold-off grows.
+  bool checkLost(uint32_t now_ms) {
+    if (now_ms - last_ack_ms < LINK_LOST_MS || current == LINK_FALLBACK_PROFILE) {
+      return false;
+    }
+    // The receiver has dropped to the fallback profile by now
+    switchTo(LINK_FALLBACK_PROFILE, now_ms);
+    last_ack_ms = now_ms;
+    return true;
+  }
+
+  void switchTo(uint8_t profile, uint32_t now_ms) {
+    current = profile;
+    target = profile;
+    changed_ms = now_ms;
+    change_count++;
+    improved_frames = 0;
+    quality.reset();
+  }
+
+public:
+  LinkPolicy()
+    : current(LINK_DEFAULT_PROFILE), target(LINK_DEFAULT_PROFILE),
+      changed_ms(0), last_ack_ms(0), improved_frames(0), change_count(0) {
+    for (uint8_t i = 0; i < LINK_PROFILE_COUNT; i++) {
+      hold_down_ms[i] = HOLD_DOWN_MS;
+      tried_retries[i] = 0;
+    }
+  }
+
+  // Outcome of a data frame
+  void record(bool delivered, uint8_t arc, uint32_t now_ms) {
+    quality.record(delivered, arc);
+    if (delivered) {
+      last_ack_ms = now_ms;
+    } else if (checkLost(now_ms)) {
+      return;
+    }
+
+    if (target != current) return;
+
+    bool failing = quality.lossBurst() >= BURST_LIMIT ||
+                   (quality.count() >= MIN_SAMPLES && quality.deliveryRatio() < DELIVERY_TARGET);
+    if (failing && current < LINK_FALLBACK_PROFILE) {
+      uint32_t& hold_ms = hold_down_ms[current];
+      if (now_ms - changed_ms >= MAX_HOLD_DOWN_MS) {
+        // It served for a long time, conditions have changed
+        hold_ms = HOLD_DOWN_MS;
+      } else {
+        hold_ms = hold_ms * 2 < MAX_HOLD_DOWN_MS ? hold_ms * 2 : MAX_HOLD_DOWN_MS;
+      }
+      target = current + 1;
+      return;
+    }
+
+    bool clean = quality.count() >= MIN_SAMPLES &&
+                 quality.deliveryRatio() >= STEP_DOWN_DELIVERY &&
+                 quality.averageSettled() &&
+                 quality.averageRetries() <= STEP_DOWN_RETRIES;
+    if (current == 0) return;
+
+    // Retransmits down to a quarter of what they were when the cheaper
+    // profile was last tried, for a whole averaging span
+    uint8_t cheaper = current - 1;
+    bool improved = quality.averageSettled() && quality.averageRetries() * 4 < tried_retries[cheaper];
+    improved_frames = improved ? improved_frames + 1 : 0;
+    if (improved_frames >= LinkQuality::AVERAGE_FRAMES) {
+      hold_down_ms[cheaper] = HOLD_DOWN_MS;
+    }
+
+    if (clean && now_ms - changed_ms >= hold_down_ms[cheaper]) {
+      tried_retries[cheaper] = quality.averageRetries();
+      target = cheaper;
+    }
+  }
+
+  // Outcome of the control frame announcing target
+  void recordControl(bool delivered, uint8_t profile, uint32_t now_ms) {
+    if (delivered) {
+      last_ack_ms = now_ms;
+      if (profile == target) switchTo(profile, now_ms);
+    } else {
+      quality.record(false, 0);
+      checkLost(now_ms);
+    }
+  }
+
+  // True while a profile change still has to be sent to the receiver
+  bool pendingChange(uint8_t& profile) const {
+    profile = target;
+    return target != current;
+  }
+
+  uint8_t profile() const { return current; }
+  const LinkQuality& stats() const { return quality; }
+  uint32_t changes() const { return change_count; }
+  uint32_t lastChange() const { return changed_ms; }
+  // Hold-off before the next cheaper profile is tried
+  uint32_t holdDown() const { return current > 0 ? hold_down_ms[current - 1] : 0; }
+};
+
+#endif
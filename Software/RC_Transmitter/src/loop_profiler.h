@@ -0,0 +1,245 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+// Build with -DLOOP_PROFILER to time the main phases. Without it
+// PROFILE_PHASE() expands to nothing and none of the profiler is compiled
+// in; bench/profiler_bench.cpp measures what it costs per frame.
+
+#ifdef LOOP_PROFILER
+
+#include "hal.h"
+
+// Phases timed by the firmware
+enum ProfilePhase {
+  PHASE_CONTROL,        // Whole control step
+  PHASE_INPUTS,         // readInputs()
+  PHASE_TRANSMIT,       // transmitData()
+  PHASE_UI,             // ui_controller->update()
+  PHASE_SETTINGS,       // saveSettings()
+  PHASE_COUNT
+};
+
+const char* const PHASE_NAMES[PHASE_COUNT] = {
+  "control", "inputs", "transmit", "ui", "settings"
+};
+
+// Log-scale histogram of durations in CPU cycles. Each power of two is
+// split into four buckets, so any percentile is within 25% of the true
+// value across the whole 32-bit range with a fixed 124-bucket table.
+class CycleHistogram {
+public:
+  static const uint8_t SUB_BUCKETS = 4;
+  static const uint8_t BUCKET_COUNT = 124;
+
+private:
+  uint32_t buckets[BUCKET_COUNT];
+  uint32_t samples;
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+  uint64_t total_cycles;
+
+public:
+  CycleHistogram() {
+    reset();
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+      buckets[i] = 0;
+    }
+    samples = 0;
+    min_cycles = UINT32_MAX;
+    max_cycles = 0;
+    total_cycles = 0;
+  }
+
+  static uint8_t bucketIndex(uint32_t cycles) {
+    if (cycles < SUB_BUCKETS) return cycles;
+    uint8_t octave = 31 - __builtin_clz(cycles);
+    return (octave - 1) * SUB_BUCKETS + ((cycles >> (octave - 2)) & (SUB_BUCKETS - 1));
+  }
+
+  // Smallest value that falls into a bucket
+  static uint32_t bucketFloor(uint8_t index) {
+    if (index < SUB_BUCKETS) return index;
+    uint8_t octave = index / SUB_BUCKETS + 1;
+    return (uint32_t)(SUB_BUCKETS + index % SUB_BUCKETS) << (octave - 2);
+  }
+
+  void record(uint32_t cycles) {
+    buckets[bucketIndex(cycles)]++;
+    samples++;
+    total_cycles += cycles;
+    if (cycles < min_cycles) min_cycles = cycles;
+    if (cycles > max_cycles) max_cycles = cycles;
+  }
+
+  uint32_t count() const { return samples; }
+  uint32_t minimum() const { return samples ? min_cycles : 0; }
+  uint32_t maximum() const { return max_cycles; }
+  uint32_t mean() const { return samples ? (uint32_t)(total_cycles / samples) : 0; }
+  uint32_t bucket(uint8_t index) const { return buckets[index]; }
+
+  // Bucket-resolution percentile (0-100), reported as the bucket midpoint
+  uint32_t percentile(uint8_t pct) const {
+    if (samples == 0) return 0;
+    uint32_t target = (uint32_t)(((uint64_t)samples * pct + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKET_COUNT; i++) {
+      seen += buckets[i];
+      if (seen >= target) {
+        uint32_t floor = bucketFloor(i);
+        uint32_t next = i + 1 < BUCKET_COUNT ? bucketFloor(i + 1) : UINT32_MAX;
+        uint32_t centre = floor + (next - floor) / 2;
+        return centre < max_cycles ? centre : max_cycles;
+      }
+    }
+    return max_cycles;
+  }
+};
+
+// Per-phase cycle histograms. Each phase is recorded by a single task;
+// readers on other tasks may see a sample half-applied, which only skews
+// the live readout by one sample.
+class LoopProfiler {
+public:
+  static const uint8_t DUMP_VERSION = 1;
+
+private:
+  CycleHistogram phases[PHASE_COUNT];
+  volatile bool reset_requested[PHASE_COUNT];
+  uint32_t cycles_per_us;
+  uint32_t read_cost;         // Cycles between two back-to-back counter reads
+  uint32_t timer_cost;        // Cycles one scoped timer adds to the caller
+
+  static uint16_t crc16(const uint8_t* data, uint16_t length, uint16_t crc) {
+    for (uint16_t i = 0; i < length; i++) {
+      crc ^= (uint16_t)data[i] << 8;
+      for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  static void put(Print& out, uint16_t& crc, const void* data, uint8_t length) {
+    out.write(static_cast<const uint8_t*>(data), length);
+    crc = crc16(static_cast<const uint8_t*>(data), length, crc);
+  }
+
+public:
+  LoopProfiler() : cycles_per_us(1), read_cost(0), timer_cost(0) {
+    for (uint8_t i = 0; i < PHASE_COUNT; i++) {
+      reset_requested[i] = false;
+    }
+  }
+
+  // Measures the profiler's own cost; call once before the tasks start
+  void begin() {
+    cycles_per_us = cyclesPerMicrosecond();
+
+    CycleHistogram scratch;
+    read_cost = UINT32_MAX;
+    timer_cost = UINT32_MAX;
+    for (uint8_t i = 0; i < 32; i++) {
+      uint32_t a = cycleCount();
+      uint32_t b = cycleCount();
+      if (b - a < read_cost) read_cost = b - a;
+
+      uint32_t outer = cycleCount();
+      uint32_t start = cycleCount();
+      scratch.record(cycleCount() - start);
+      uint32_t cost = cycleCount() - outer;
+      if (cost < timer_cost) timer_cost = cost;
+    }
+    timer_cost = timer_cost > read_cost ? timer_cost - read_cost : 0;
+  }
+
+  void record(ProfilePhase phase, uint32_t cycles) {
+    if (reset_requested[phase]) {
+      phases[phase].reset();
+      reset_requested[phase] = false;
+    }
+    phases[phase].record(cycles > read_cost ? cycles - read_cost : 0);
+  }
+
+  // Safe to call from any task, applied by each phase's next sample
+  void resetStats() {
+    for (uint8_t i = 0; i < PHASE_COUNT; i++) {
+      reset_requested[i] = true;
+    }
+  }
+
+  const CycleHistogram& phase(uint8_t index) const { return phases[index]; }
+  uint32_t cyclesPerMicro() const { return cycles_per_us; }
+  uint32_t timerCost() const { return timer_cost; }
+
+  uint32_t toMicros(uint32_t cycles) const {
+    return (cycles + cycles_per_us / 2) / cycles_per_us;
+  }
+
+  // Binary dump, little-endian:
+  //   "PF" version phase_count cycles_per_us:u16 timer_cost:u16
+  //   per phase: count min mean max p99 (u32 cycles) nonzero:u8
+  //              nonzero x (bucket:u8 count:u32)
+  //   crc16-ccitt:u16 over everything after "PF"
+  void dump(Print& out) const {
+    uint16_t crc = 0xFFFF;
+    out.write('P');
+    out.write('F');
+
+    uint8_t header[6] = {
+      DUMP_VERSION, PHASE_COUNT,
+      (uint8_t)(cycles_per_us & 0xFF), (uint8_t)(cycles_per_us >> 8),
+      (uint8_t)(timer_cost & 0xFF), (uint8_t)(timer_cost >> 8)
+    };
+    put(out, crc, header, sizeof(header));
+
+    for (uint8_t i = 0; i < PHASE_COUNT; i++) {
+      const CycleHistogram& h = phases[i];
+      uint32_t summary[5] = { h.count(), h.minimum(), h.mean(), h.maximum(), h.percentile(99) };
+      put(out, crc, summary, sizeof(summary));
+
+      uint8_t nonzero = 0;
+      for (uint8_t b = 0; b < CycleHistogram::BUCKET_COUNT; b++) {
+        if (h.bucket(b) > 0) nonzero++;
+      }
+      put(out, crc, &nonzero, 1);
+
+      for (uint8_t b = 0; b < CycleHistogram::BUCKET_COUNT; b++) {
+        uint32_t n = h.bucket(b);
+        if (n == 0) continue;
+        put(out, crc, &b, 1);
+        put(out, crc, &n, sizeof(n));
+      }
+    }
+
+    uint8_t trailer[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+    out.write(trailer, sizeof(trailer));
+  }
+};
+
+extern LoopProfiler loop_profiler;
+
+// Records the cycles spent from construction to the end of the scope
+class ScopedPhaseTimer {
+private:
+  ProfilePhase phase;
+  uint32_t start;
+
+public:
+  explicit ScopedPhaseTimer(ProfilePhase timed_phase) : phase(timed_phase), start(cycleCount()) {}
+  ~ScopedPhaseTimer() { loop_profiler.record(phase, cycleCount() - start); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_PHASE(phase) ScopedPhaseTimer PROFILE_CONCAT(phase_timer_, __LINE__)(phase)
+
+#else
+
+#define PROFILE_PHASE(phase) do {} while (0)
+
+#endif
+
+#endif
@@ -1,54 +1,247 @@
-#include <SPI.h>
-#include <nRF24L01.h>
-#include <RF24.h>
-#include <Wire.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
-#include <PCF8575.h>
-#include <EEPROM.h>
+#include <frame_codec.h>
+#include <delta_codec.h>
+#include <link_control.h>
+#include <hop_sequence.h>
 
 #include "pin_definitions.h"
 #include "config.h"
+#include "hal.h"
 #include "ui_controller.h"
+#include "latest_value.h"
+#include "async_radio.h"
+#include "channel_mapper.h"
+#include "settings_store.h"
+#include "loop_profiler.h"
+#include "tdma_scheduler.h"
+#include "link_quality.h"
+#include "channel_blacklist.h"
+#include "latency_monitor.h"
+#include "mixer.h"
+#include "trim_buttons.h"
+#include "button_events.h"
+#include "attitude_filter.h"
+
+void onExpanderInterrupt();
 
 // Global Objects
-RF24 radio(CE_PIN, CSN_PIN);
-PCF8575 pcf8575(PCF8575_ADDRESS);
-UIController* ui_controller;
+RadioDriver radio(CE_PIN, CSN_PIN);
+TelemetryStore telemetry;
+AsyncRadio async_radio(radio, telemetry);
+AnalogInputs adc_sampler;
+SettingsStore settings_store;
+SharedBus i2c_bus;
+IoExpander pcf8575(i2c_bus, PCF8575_ADDRESS, PCF8575_INT_PIN, onExpanderInterrupt);
+ImuSensor imu(i2c_bus, MPU6050_ADDRESS);
+#ifdef LOOP_PROFILER
+LoopProfiler loop_profiler;
+#endif
 
 // System State
+// system_settings belongs to the UI task: the menu, serial commands and
+// trim buttons all edit it there. Each change goes out as a whole copy,
+// one mailbox for the control task and one for the settings task, so
+// neither ever sees a half-applied edit.
 SystemSettings system_settings;
+SystemSettings published_settings;
+LatestValue<SystemSettings> settings_for_control;
+LatestValue<SystemSettings> settings_for_store;
+SystemSettings control_settings;      // The control task's copy
+UIController ui_controller(&system_settings);
 ChannelData channel_data;
-bool settings_modified = false;
+uint8_t frame_sequence[MAX_RECEIVERS] = {};
+DeltaEncoder delta_encoders[MAX_RECEIVERS];
+bool tracing = false;
+uint32_t inputs_sampled_us = 0;   // ADC batch behind channel_data
+
+// Latency measurement mode: every data frame waits for its ACK so each
+// stage can be stamped, and every LATENCY_PROBE_FRAMES-th frame is a probe
+const uint8_t LATENCY_PROBE_FRAMES = 20;
+const uint32_t LATENCY_AWAIT_US = 4000;
+volatile bool latency_mode = false;
+LatencyMonitor latency_monitor;
+uint8_t probe_countdown[MAX_RECEIVERS] = {};
+
+// Each receiver's model inputs: the precomputed raw-to-channel mapping and
+// the input filters behind it, rebuilt or reconfigured when their model
+// changes. Every step runs the raw inputs through the set of each
+// scheduled receiver, so the filters keep the slot period whichever
+// receiver gets the slot.
+struct ModelInputs {
+  ChannelMapper mappers[ANALOG_CHANNEL_COUNT];
+  CalibrationData mapped_calibration;
+  TrimSettings mapped_trim;
+  bool mapped_bidirectional;
+  bool mappers_valid;
+  InputFilter filters[ANALOG_CHANNEL_COUNT];
+  ChannelFilter applied_filters[ANALOG_CHANNEL_COUNT];
+  bool filters_valid;
+  bool running;                             // Filtered on the last step
+  int16_t values[ANALOG_CHANNEL_COUNT];     // This step's channels by slot
+};
+ModelInputs model_inputs[MAX_RECEIVERS];
+
+// Each receiver's mix, compiled when its preset is first used or changed
+MixProgram mix_programs[MAX_RECEIVERS];
+uint8_t compiled_mix[MAX_RECEIVERS] = {};   // Preset + 1, 0 until compiled
+
+// Model memory: the control task follows the selected receiver's profile
+// from one step to the next. A switch is timed from the step that picks
+// it up, through rebuilding the mappers, filters and mix, to the first
+// frame sent to the new receiver.
+uint8_t active_receiver = MAX_RECEIVERS;    // None before the first step
+uint32_t switch_started_us = 0;
+bool switch_pending = false;
+uint32_t model_switches = 0;
+uint32_t switch_rebuild_us = 0, switch_rebuild_max_us = 0;
+uint32_t switch_frame_us = 0, switch_frame_max_us = 0;
+
+// Trim buttons: the input task reads the expander when INT reports a
+// change, the UI task applies the debounced presses to the model
+TrimEventQueue trim_events;
+TrimButtonReader<IoExpander> trim_reader(pcf8575, trim_events);
+uint32_t trim_reads_reported = 0;
+uint32_t trim_reported_ms = 0;
+
+// Menu buttons: a timer tick debounces the pins and wakes the UI task,
+// which takes the events
+ButtonEventQueue button_events;
+ButtonDebouncer menu_buttons(button_events);
+uint32_t ui_wakes_reported = 0;
+uint32_t buttons_reported_ms = 0;
+
+// I2C bus statistics cover the time since this millis()
+uint32_t bus_stats_ms = 0;
+
+// IMU: its task drains the MPU6050 FIFO and filters the batch, the control
+// task turns the latest attitude into the mixer's tilt sources. Tilt older
+// than IMU_STALE_US reads level.
+struct Attitude {
+  int16_t pitch;
+  int16_t roll;
+  uint32_t timestamp;       // micros() of the batch, 0 before the first
+};
+const uint8_t IMU_BATCH_MAX = 20;            // 100 ms of samples per step
+const int16_t TILT_FULL_SCALE = ANGLE_QUARTER_TURN / 2;   // 45 degrees
+const uint32_t IMU_STALE_US = 100000;
+AttitudeFilter attitude_filter(IMU_SAMPLE_RATE);
+LatestValue<Attitude> latest_attitude;
+int16_t tilt_pitch = 0, tilt_roll = 0;       // Channel units
+uint64_t imu_filter_cycles = 0;
+uint32_t imu_filtered = 0;
+
+// Latest frame handed from the control task to the UI task
+LatestValue<ChannelData> latest_channel_data;
 
 // Timing
-unsigned long last_transmit_time = 0;
-const unsigned long TRANSMIT_INTERVAL = 20; // 50Hz
+const unsigned long SLOT_INTERVAL = 5; // 200 slots/s shared by all receivers
+const uint32_t SLOT_INTERVAL_US = SLOT_INTERVAL * 1000;
+const uint8_t SINGLE_RECEIVER_RATE = 50; // Hz when no fleet is configured
+const uint32_t JITTER_BUCKET_US = 100;
+const unsigned long UI_INTERVAL = 50;        // Longest UI sleep, bounds serial command latency
+const unsigned long UI_BUSY_INTERVAL = 10;   // While a trace is on
+const unsigned long INPUT_BUSY_INTERVAL = 10; // While trim debounce or repeat timers run
+const unsigned long IMU_INTERVAL = 20;        // 4 FIFO samples per burst
+const unsigned long SETTINGS_INTERVAL = 500;
+
+Runtime runtime(SLOT_INTERVAL_US, JITTER_BUCKET_US, UI_INTERVAL, SETTINGS_INTERVAL);
+
+// Slot schedule, rebuilt when the fleet or the selected receiver changes
+TdmaScheduler tdma(1000 / SLOT_INTERVAL);
+ReceiverLink scheduled_links[MAX_RECEIVERS];
+bool schedule_valid = false;
+
+// Per-receiver link profile, and the one currently programmed into the radio
+LinkPolicy link_policies[MAX_RECEIVERS];
+uint8_t announced_profile[MAX_RECEIVERS];
+uint8_t applied_profile = LINK_PROFILE_COUNT;
+
+// Per-receiver hop order and channel blacklist, and the hop channel each
+// receiver's last frame went out on
+const uint8_t NO_HOP = 0xFF;
+HopSequence hop_sequences[MAX_RECEIVERS];
+ChannelBlacklist channel_blacklists[MAX_RECEIVERS];
+uint8_t sent_hop[MAX_RECEIVERS];
+uint32_t announced_mask[MAX_RECEIVERS];
+
+// Partial 'F' command line collected across calls
+char command_line[24];
+uint8_t command_length = 0;
 
 //Function Prototypes
 void loadSettings();
 void initializePins();
 bool initializeRadio();
 void setReceiverAddress(uint8_t receiver_id);
+void applyLinkProfile(uint8_t profile);
+void onFrameResult(const FrameResult& result);
+void sendLinkControl(uint8_t receiver_id, uint8_t profile);
+void sendHopMask(uint8_t receiver_id, uint32_t mask);
+void sendProbe(uint8_t receiver_id);
+void onProbeEcho(uint8_t receiver, const TelemetrySample& sample, uint32_t now_us);
 void readInputs();
-int16_t readAndMapAnalog(uint8_t pin, int16_t min_val, int16_t max_val, int16_t mid_val);
+bool updateActiveModel();
+void updateChannelMappers(uint8_t receiver_id);
+bool applyTrimEvents();
+void publishSettings();
+void updateChannelFilters(uint8_t receiver_id);
+void readAnalog(uint8_t receiver_id, const uint16_t* raw);
+void setAnalogChannels(ChannelData& data, const int16_t* values);
+const MixProgram& mixProgram(uint8_t receiver_id);
+void updateSchedule();
 int8_t read3WaySwitch(uint8_t pin1, uint8_t pin2);
-void transmitData();
+void transmitData(uint8_t receiver_id);
 void saveSettings();
 void initializeDefaultSettings();
+void controlStep();
+uint32_t uiStep();
+uint32_t inputStep();
+uint32_t imuStep();
+void buttonTick();
+void settingsStep();
+void handleSerialCommands();
+void printFrameStats();
+void printLinkStats();
+void printAdcStats();
+void printSettingsStats();
+void printProfile();
+void printFleetStats();
+void printTelemetry();
+void printLinkQuality();
+void printTrace(const ChannelData& data);
+void printChannelLoss();
+void printLatency();
+void printModels();
+void printTrimStats();
+void printButtonStats();
+void printBusStats();
+void printImuStats();
+void toggleLatencyMode();
+void collectCommandLine(char c);
+void applyFleetCommand(const char* line);
+void applyHopCommand(const char* line);
+void applyFilterCommand(const char* line);
+void applyMixCommand(const char* line);
+void applySelectCommand(const char* line);
 
 void setup() {
   Serial.begin(115200);
   
-  // Initialize EEPROM
-  EEPROM.begin(512);
-  
-  // Load settings from EEPROM
+  // Load settings from the flash journal
   loadSettings();
   
   // Initialize pins
   initializePins();
   
+  // OLED, PCF8575 and MPU6050 share one I2C bus
+  if (!i2c_bus.begin()) {
+    Serial.println("I2C bus arbiter initialization failed!");
+  }
+  
+  // Start background ADC sampling
+  if (!adc_sampler.begin()) {
+    Serial.println("ADC sampler initialization failed!");
+  }
+  
   // Initialize radio
   if (!initializeRadio()) {
     Serial.println("Radio initialization failed!");
@@ -56,12 +249,18 @@ void setup() {
   }
   
   // Initialize OLED
-  ui_controller = new UIController(&system_settings);
-  if (!ui_controller->begin()) {
+  ui_controller.setFrameStats(&runtime.frameStats());
+  ui_controller.setTelemetry(&telemetry);
+  ui_controller.setBus(&i2c_bus);
+#ifdef LOOP_PROFILER
+  loop_profiler.begin();
+  ui_controller.setProfiler(&loop_profiler);
+#endif
+  if (!ui_controller.begin()) {
     Serial.println("OLED initialization failed!");
   }
   
-  // Initialize PCF8575
+  // Initialize PCF8575, which also attaches its INT handler
   if (!pcf8575.begin()) {
     Serial.println("PCF8575 initialization failed!");
   }
@@ -73,33 +272,552 @@ void setup() {
   pcf8575.pinMode(P4, INPUT);
   pcf8575.pinMode(P5, INPUT);
   
+  // MPU6050 sampling into its FIFO, drained by the IMU task
+  bool imu_ready = imu.begin();
+  if (!imu_ready) {
+    Serial.println("MPU6050 initialization failed!");
+  }
+  
   Serial.println("Transmitter initialized successfully!");
-  ui_controller->update(false, false, false);
+  ui_controller.update();
+  publishSettings();
+  
+  runtime.start(controlStep, uiStep, settingsStep);
+  runtime.startInput(inputStep);
+  if (imu_ready) runtime.startImu(imuStep);
+  if (!runtime.startTimer(ButtonDebouncer::TICK_MS, buttonTick)) {
+    Serial.println("Button timer initialization failed!");
+  }
 }
 
 void loop() {
-  // Read all inputs
-  readInputs();
+  runtime.loop();
+}
+
+// Runs once per slot on the slot clock
+void controlStep() {
+  PROFILE_PHASE(PHASE_CONTROL);
+  
+  // Settings as of the UI task's last change
+  settings_for_control.read(control_settings);
+  
+  // Collect the previous frame's ACK before touching the pipe
+  async_radio.poll();
+  
+  // Follow fleet and receiver changes made from the menu or serial
+  updateSchedule();
+  TdmaSlot slot = tdma.next();
+  tdma.updateRates(micros(), async_radio);
+  
+  {
+    PROFILE_PHASE(PHASE_INPUTS);
+    readInputs();
+  }
+  
+  if (slot.receiver != TdmaScheduler::IDLE) {
+    PROFILE_PHASE(PHASE_TRANSMIT);
+    LinkPolicy& policy = link_policies[slot.receiver];
+    bool switch_profile = policy.profile() != applied_profile;
+    
+    // Hopping receivers take the channel from the sequence number the frame will carry
+    uint8_t hop = NO_HOP;
+    uint8_t channel = slot.channel;
+    if (slot.hopping) {
+      hop = hop_sequences[slot.receiver].channelIndex(frame_sequence[slot.receiver]);
+      channel = hopChannel(hop);
+    }
+    
+    // Only reprogram what the schedule or the link policy says has changed
+    if (slot.switch_address || slot.switch_channel || switch_profile) {
+      async_radio.cancel();
+    }
+    if (switch_profile) {
+      applyLinkProfile(policy.profile());
+    }
+    if (slot.switch_channel) {
+      radio.setChannel(channel);
+    }
+    if (slot.switch_address) {
+      radio.openWritingPipe(BASE_PIPES[slot.receiver]);
+    }
+    // Hopping slots always retune, so the previous frame has been reported by now
+    sent_hop[slot.receiver] = hop;
+    
+    // Pending profile and mask changes replace the data frame until ACKed
+    uint8_t profile;
+    uint32_t mask;
+    if (policy.pendingChange(profile)) {
+      sendLinkControl(slot.receiver, profile);
+    } else if (slot.hopping && channel_blacklists[slot.receiver].pendingMask(mask)) {
+      sendHopMask(slot.receiver, mask);
+    } else if (latency_mode && probe_countdown[slot.receiver]-- == 0) {
+      probe_countdown[slot.receiver] = LATENCY_PROBE_FRAMES - 1;
+      sendProbe(slot.receiver);
+    } else {
+      transmitData(slot.receiver);
+    }
+  }
+  latest_channel_data.publish(channel_data);
+}
+
+uint32_t uiStep() {
+  ChannelData ui_channel_data;
+  if (latest_channel_data.read(ui_channel_data)) {
+    ui_controller.setChannelData(ui_channel_data);
+    if (tracing) printTrace(ui_channel_data);
+  }
+  
+  {
+    PROFILE_PHASE(PHASE_UI);
+    ButtonEvent event;
+    while (button_events.pop(event)) {
+      ui_controller.handleEvent(event);
+    }
+    if (applyTrimEvents()) ui_controller.trimChanged();
+    ui_controller.update();
+  }
+  
+  handleSerialCommands();
+  publishSettings();
+  
+  // Sleep until the next redraw unless a button event or INT comes first
+  uint32_t sleep_ms = ui_controller.msUntilRedraw();
+  if (tracing && sleep_ms > UI_BUSY_INTERVAL) {
+    sleep_ms = UI_BUSY_INTERVAL;
+  }
+  return sleep_ms;
+}
+
+// Expander read only if INT fired, then the debounce timers. This task
+// runs above the UI, so the read gets the bus between display chunks.
+uint32_t inputStep() {
+  trim_reader.service(millis());
+  if (!trim_events.empty()) runtime.wakeUi();
+  return trim_reader.busy() ? INPUT_BUSY_INTERVAL : Runtime::NO_DEADLINE;
+}
+
+// Drains the samples waiting in the MPU6050 FIFO through the attitude
+// filter and publishes where it ended up. Above the input task, so the
+// FIFO never waits behind a display chunk for long.
+uint32_t imuStep() {
+  ImuSample samples[IMU_BATCH_MAX];
+  uint8_t count = imu.read(samples, IMU_BATCH_MAX);
+  if (count == 0) return IMU_INTERVAL;
+  
+  uint32_t started = cycleCount();
+  for (uint8_t i = 0; i < count; i++) {
+    attitude_filter.update(samples[i]);
+  }
+  imu_filter_cycles += cycleCount() - started;
+  imu_filtered += count;
+  
+  if (attitude_filter.isAligned()) {
+    Attitude attitude = { attitude_filter.pitch(), attitude_filter.roll(), (uint32_t)micros() };
+    if (attitude.timestamp == 0) attitude.timestamp = 1;
+    latest_attitude.publish(attitude);
+  }
+  return IMU_INTERVAL;
+}
+
+// Menu button timer, the pins are pulled up and read LOW while pressed
+void buttonTick() {
+  uint8_t down = 0;
+  if (digitalRead(BTN_UP_PIN) == LOW) down |= 1 << BUTTON_UP;
+  if (digitalRead(BTN_DOWN_PIN) == LOW) down |= 1 << BUTTON_DOWN;
+  if (digitalRead(BTN_SELECT_PIN) == LOW) down |= 1 << BUTTON_SELECT;
+  if (menu_buttons.tick(down)) runtime.wakeUi();
+}
+
+void settingsStep() {
+  PROFILE_PHASE(PHASE_SETTINGS);
+  
+  // Persist changed field groups once they stop changing
+  saveSettings();
+}
+
+// Serial commands: 'h' prints frame timing, 'r' resets it,
+// 'l' prints per-receiver link counters, 'a' prints ADC rate and noise,
+// 's' prints settings journal usage, 'p' prints per-phase timing and
+// 'P' dumps it in binary (see LoopProfiler::dump), 'f' prints the TDMA
+// schedule and achieved rates, "F<id> <rate> [priority] [channel]\n" sets
+// a fleet entry (rate 0 removes it), "H<id> <0|1>\n" turns frequency
+// hopping off or on for a receiver, 't' prints the newest telemetry,
+// 'q' prints link quality and the active link profile per receiver,
+// 'c' prints per-channel loss of hopping receivers, 'T' starts or stops
+// a stick trace for bench/delta_bench.cpp, 'm' prints every model and
+// switch timing, "R<id>\n" selects a receiver and its model, 'k' prints
+// trim-button expander reads and events, 'b' prints menu-button events
+// and how often the UI task woke up, 'i' prints I2C bus time and waits
+// per device
+void handleSerialCommands() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (command_length > 0) {
+      collectCommandLine(c);
+      continue;
+    }
+    
+    switch (c) {
+      case 'h': printFrameStats(); break;
+      case 'r':
+        runtime.resetStats();
+        i2c_bus.resetStats();
+        bus_stats_ms = millis();
+#ifdef LOOP_PROFILER
+        loop_profiler.resetStats();
+#endif
+        break;
+      case 'l': printLinkStats(); break;
+      case 'a': printAdcStats(); break;
+      case 's': printSettingsStats(); break;
+      case 'f': printFleetStats(); break;
+      case 't': printTelemetry(); break;
+      case 'q': printLinkQuality(); break;
+      case 'c': printChannelLoss(); break;
+      case 'T': tracing = !tracing; break;
+      case 'L': toggleLatencyMode(); break;
+      case 'd': printLatency(); break;
+      case 'm': printModels(); break;
+      case 'k': printTrimStats(); break;
+      case 'b': printButtonStats(); break;
+      case 'i': printBusStats(); break;
+      case 'g': printImuStats(); break;
+      case 'F':
+      case 'H':
+      case 'S':
+      case 'M':
+      case 'R':
+        collectCommandLine(c);
+        break;
+#ifdef LOOP_PROFILER
+      case 'p': printProfile(); break;
+      case 'P': loop_profiler.dump(Serial); break;
+#endif
+    }
+  }
+}
+
+void printFrameStats() {
+  const IntervalHistogram& stats = runtime.frameStats();
+  
+  Serial.printf("frames=%lu missed=%lu min=%lu mean=%lu max=%lu p99=%ld us\n",
+                (unsigned long)stats.count(), (unsigned long)runtime.missedFrames(),
+                (unsigned long)stats.minimum(), (unsigned long)stats.mean(),
+                (unsigned long)stats.maximum(), (long)stats.percentile(99));
+  
+  for (uint8_t i = 0; i < IntervalHistogram::BUCKET_COUNT; i++) {
+    if (stats.bucket(i) > 0) {
+      Serial.printf("%6ld %lu\n", (long)stats.bucketCentre(i), (unsigned long)stats.bucket(i));
+    }
+  }
+}
+
+void printLinkStats() {
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    const LinkStats& stats = async_radio.linkStats(i);
+    if (stats.sent == 0) continue;
+    
+    Serial.printf("rx%u sent=%lu acked=%lu failed=%lu retries=%lu overruns=%lu bytes/frame=%.2f\n", i,
+                  (unsigned long)stats.sent, (unsigned long)stats.acked,
+                  (unsigned long)stats.failed, (unsigned long)stats.retries,
+                  (unsigned long)stats.overruns, (float)stats.bytes / stats.sent);
+  }
+}
+
+void printAdcStats() {
+  Serial.printf("adc rate=%lu samples/s\n", (unsigned long)adc_sampler.sampleRate());
+  for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) {
+    const ChannelFilter& filter = activeModel(system_settings).filters[i];
+    Serial.printf("ch%u value=%u noise=%.2f median=%u smoothing=%u deadband=%u slew=%u/s\n", i,
+                  adc_sampler.readSlot(i), adc_sampler.noise(i), filter.median, filter.smoothing,
+                  filter.deadband, filter.slew_per_s);
+  }
+}
+
+void printSettingsStats() {
+  Serial.printf("settings records=%lu erases=%lu\n",
+                (unsigned long)settings_store.records(), (unsigned long)settings_store.erases());
+}
+
+void printProfile() {
+#ifdef LOOP_PROFILER
+  Serial.printf("profiler timer=%lu cycles @ %lu MHz\n",
+                (unsigned long)loop_profiler.timerCost(), (unsigned long)loop_profiler.cyclesPerMicro());
+  for (uint8_t i = 0; i < PHASE_COUNT; i++) {
+    const CycleHistogram& phase = loop_profiler.phase(i);
+    Serial.printf("%-8s n=%lu min=%lu avg=%lu max=%lu p99=%lu us\n", PHASE_NAMES[i],
+                  (unsigned long)phase.count(),
+                  (unsigned long)loop_profiler.toMicros(phase.minimum()),
+                  (unsigned long)loop_profiler.toMicros(phase.mean()),
+                  (unsigned long)loop_profiler.toMicros(phase.maximum()),
+                  (unsigned long)loop_profiler.toMicros(phase.percentile(99)));
+  }
+#endif
+}
+
+void printFleetStats() {
+  char layout[TdmaScheduler::SLOT_COUNT + 1];
+  for (uint8_t i = 0; i < TdmaScheduler::SLOT_COUNT; i++) {
+    uint8_t receiver = tdma.slot(i).receiver;
+    layout[i] = receiver == TdmaScheduler::IDLE ? '.' : '0' + receiver;
+  }
+  layout[TdmaScheduler::SLOT_COUNT] = '\0';
+  Serial.printf("tdma %s @ %lu slots/s\n", layout, (unsigned long)(1000 / SLOT_INTERVAL));
   
-  // Update UI
-  bool btn_up = digitalRead(BTN_UP_PIN);
-  bool btn_down = digitalRead(BTN_DOWN_PIN);
-  bool btn_select = digitalRead(BTN_SELECT_PIN);
-  ui_controller->update(btn_up, btn_down, btn_select);
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    if (tdma.grantedSlots(i) == 0) continue;
+    const ReceiverRate& rate = tdma.rate(i);
+    Serial.printf("rx%u slots=%u target=%u sent=%u acked=%u Hz prio=%u ch=%u mix=%s\n", i,
+                  tdma.grantedSlots(i), tdma.grantedRate(i), rate.sent_hz, rate.acked_hz,
+                  scheduled_links[i].priority, scheduled_links[i].channel,
+                  MIX_PRESETS[system_settings.models[i].mix < MIX_PRESET_COUNT ? system_settings.models[i].mix : 0].name);
+  }
+}
+
+void printTelemetry() {
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    const TelemetryRing<TELEMETRY_HISTORY>& ring = telemetry.receiver(i);
+    if (ring.available() == 0) continue;
+    
+    const TelemetrySample& sample = ring.at(0);
+    Serial.printf("rx%u samples=%lu age=%lums batt=%umV lq=%u%% lost=%u seq=%u", i,
+                  (unsigned long)ring.total(), (unsigned long)(millis() - sample.timestamp),
+                  sample.battery_mv, sample.link_quality, sample.frames_lost, sample.last_sequence);
+    for (uint8_t s = 0; s < sample.sensor_count; s++) {
+      Serial.printf(" s%u=%d", s, sample.sensors[s]);
+    }
+    Serial.println();
+  }
+}
+
+void printLinkQuality() {
+  static const char* const RATE_NAMES[] = { "1M", "2M", "250K" };
+  
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    const LinkPolicy& policy = link_policies[i];
+    const LinkQuality& quality = policy.stats();
+    if (async_radio.linkStats(i).sent == 0) continue;
+    
+    const LinkProfile& profile = LINK_PROFILES[policy.profile()];
+    Serial.printf("rx%u profile=%u %s pa=%u retries=%u delivery=%u%% arc=%u.%02u burst=%u/%u changes=%lu hold=%lums",
+                  i, policy.profile(), RATE_NAMES[profile.data_rate], profile.pa_level, profile.retry_count,
+                  quality.deliveryRatio(), quality.meanRetries() / 100, quality.meanRetries() % 100,
+                  quality.lossBurst(), quality.worstBurst(),
+                  (unsigned long)policy.changes(), (unsigned long)policy.holdDown());
+    if (scheduled_links[i].hopping) {
+      const ChannelBlacklist& blacklist = channel_blacklists[i];
+      Serial.printf(" hop mask=%08lX blocked=%u mask changes=%lu\n", (unsigned long)blacklist.channelMask(),
+                    blacklist.blocked(), (unsigned long)blacklist.changes());
+    } else {
+      Serial.printf(" ch=%u\n", scheduled_links[i].channel);
+    }
+  }
+}
+
+void printChannelLoss() {
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    if (!scheduled_links[i].hopping || async_radio.linkStats(i).sent == 0) continue;
+    
+    // Loss per attempt in %, 'x' where masked, '-' where not judged yet
+    const ChannelBlacklist& blacklist = channel_blacklists[i];
+    Serial.printf("rx%u", i);
+    for (uint8_t c = 0; c < HOP_CHANNEL_COUNT; c++) {
+      if (!(blacklist.channelMask() & (1UL << c))) {
+        Serial.printf(" %u:x", hopChannel(c));
+      } else if (blacklist.sampleCount(c) < ChannelBlacklist::MIN_SAMPLES) {
+        Serial.printf(" %u:-", hopChannel(c));
+      } else {
+        Serial.printf(" %u:%u", hopChannel(c), blacklist.lossPercent(c));
+      }
+    }
+    Serial.println();
+  }
+}
+
+// Fresh histograms each time the mode is switched on
+void toggleLatencyMode() {
+  if (!latency_mode) {
+    latency_monitor.reset();
+  }
+  latency_mode = !latency_mode;
+  Serial.printf("latency mode %s\n", latency_mode ? "on" : "off");
+}
+
+// One summary line and the non-empty buckets per measured stage, all in
+// us; the format tools/latency_plot.py reads
+void printLatency() {
+  for (uint8_t i = 0; i < LATENCY_STAGE_COUNT; i++) {
+    const IntervalHistogram& stats = latency_monitor.stage(i);
+    if (stats.count() == 0) continue;
+    
+    const char* name = LatencyMonitor::stageName(i);
+    Serial.printf("lat,%s,%lu,%lu,%lu,%lu,%ld,%ld,%lu\n", name, (unsigned long)stats.bucketWidth(),
+                  (unsigned long)stats.count(), (unsigned long)stats.minimum(),
+                  (unsigned long)stats.mean(), (long)stats.percentile(50),
+                  (long)stats.percentile(99), (unsigned long)stats.maximum());
+    for (uint8_t b = 0; b < IntervalHistogram::BUCKET_COUNT; b++) {
+      if (stats.bucket(b) > 0) {
+        Serial.printf("latb,%s,%ld,%lu\n", name, (long)stats.bucketCentre(b), (unsigned long)stats.bucket(b));
+      }
+    }
+  }
+}
+
+// One line per receiver's model, '*' marking the active one, then how
+// long the last and slowest switches took
+void printModels() {
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    const ModelProfile& model = system_settings.models[i];
+    Serial.printf("%c rx%u %-9s throttle=%s trim=%d/%d/%d mix=%s\n", i == active_receiver ? '*' : ' ', i,
+                  RECEIVER_NAMES[i], model.throttle_bidirectional ? "bi" : "uni",
+                  model.trim.pitch_trim, model.trim.roll_trim, model.trim.yaw_trim,
+                  MIX_PRESETS[model.mix < MIX_PRESET_COUNT ? model.mix : 0].name);
+  }
+  Serial.printf("model switches=%lu rebuild=%lu max=%lu us first frame=%lu max=%lu us\n",
+                (unsigned long)model_switches, (unsigned long)switch_rebuild_us,
+                (unsigned long)switch_rebuild_max_us, (unsigned long)switch_frame_us,
+                (unsigned long)switch_frame_max_us);
+}
+
+// Expander reads per second since the last report; zero while no button
+// moves
+void printTrimStats() {
+  uint32_t now = millis();
+  uint32_t reads = trim_reader.reads();
+  uint32_t elapsed = now - trim_reported_ms;
+  Serial.printf("trim reads=%lu rate=%lu/s events=%lu dropped=%lu\n", (unsigned long)reads,
+                (unsigned long)(elapsed > 0 ? (uint64_t)(reads - trim_reads_reported) * 1000 / elapsed : 0),
+                (unsigned long)trim_reader.events(), (unsigned long)trim_events.dropped());
+  trim_reads_reported = reads;
+  trim_reported_ms = now;
+}
+
+void printButtonStats() {
+  uint32_t now = millis();
+  uint32_t wakes = runtime.uiWakes();
+  uint32_t elapsed = now - buttons_reported_ms;
+  Serial.printf("buttons events=%lu dropped=%lu ui wakes=%lu rate=%lu/s\n",
+                (unsigned long)menu_buttons.events(), (unsigned long)button_events.dropped(), (unsigned long)wakes,
+                (unsigned long)(elapsed > 0 ? (uint64_t)(wakes - ui_wakes_reported) * 1000 / elapsed : 0));
+  ui_wakes_reported = wakes;
+  buttons_reported_ms = now;
+}
+
+void printBusStats() {
+  static const char* const DEVICE_NAMES[BUS_DEVICE_COUNT] = { "imu", "expander", "oled" };
+  uint64_t elapsed_us = (uint64_t)(millis() - bus_stats_ms) * 1000;
   
-  // Transmit data
-  if (millis() - last_transmit_time >= TRANSMIT_INTERVAL) {
-    transmitData();
-    last_transmit_time = millis();
+  for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+    BusDeviceStats stats = i2c_bus.stats(i);
+    Serial.printf("i2c %-8s n=%lu busy=%.2f%% hold max=%lu us wait avg=%lu max=%lu us\n", DEVICE_NAMES[i],
+                  (unsigned long)stats.transactions,
+                  elapsed_us > 0 ? 100.0 * stats.busy_us / elapsed_us : 0.0,
+                  (unsigned long)stats.hold_max_us,
+                  (unsigned long)(stats.transactions > 0 ? stats.wait_total_us / stats.transactions : 0),
+                  (unsigned long)stats.wait_max_us);
+  }
+}
+
+void printImuStats() {
+  // The attitude is read from the filter, latest_attitude has one reader
+  const ImuFifoStats& stats = imu.stats();
+  Serial.printf("imu samples=%lu batches=%lu avg=%.1f max=%u bursts=%lu overflows=%lu errors=%lu rejected=%lu\n",
+                (unsigned long)stats.samples, (unsigned long)stats.batches,
+                stats.batches > 0 ? (double)stats.samples / stats.batches : 0.0, stats.max_batch,
+                (unsigned long)stats.bursts, (unsigned long)stats.overflows, (unsigned long)stats.errors,
+                (unsigned long)attitude_filter.rejected());
+  Serial.printf("imu pitch=%d roll=%d (0.1 deg) gyro bias=%ld/%ld (0.01 dps) tilt=%d/%d filter=%lu ns/sample\n",
+                angleDecidegrees(attitude_filter.pitch()), angleDecidegrees(attitude_filter.roll()),
+                (long)attitude_filter.pitchBias(), (long)attitude_filter.rollBias(), tilt_pitch, tilt_roll,
+                (unsigned long)(imu_filtered > 0 ? imu_filter_cycles * 1000 / cyclesPerMicrosecond() / imu_filtered : 0));
+}
+
+// One line per frame seen by the UI task, in the order of ChannelData
+void printTrace(const ChannelData& data) {
+  Serial.printf("trace,%lu,%d,%d,%d,%d,%d,%d,%u,%u,%u,%u,%d,%d\n", (unsigned long)(data.timestamp / 1000),
+                data.throttle, data.pitch, data.roll, data.yaw, data.aux1, data.aux2,
+                data.aux3, data.aux4, data.aux5, data.aux6, data.aux7, data.aux8);
+}
+
+void collectCommandLine(char c) {
+  if (c == '\n' || c == '\r') {
+    command_line[command_length] = '\0';
+    if (command_line[0] == 'H') {
+      applyHopCommand(command_line);
+    } else if (command_line[0] == 'S') {
+      applyFilterCommand(command_line);
+    } else if (command_line[0] == 'M') {
+      applyMixCommand(command_line);
+    } else if (command_line[0] == 'R') {
+      applySelectCommand(command_line);
+    } else {
+      applyFleetCommand(command_line);
+    }
+    command_length = 0;
+  } else if (command_length < sizeof(command_line) - 1) {
+    command_line[command_length++] = c;
+  }
+}
+
+// Serial edits run in the UI task, which owns system_settings; the fleet
+// table reaches the control task with the next published copy
+void applyFleetCommand(const char* line) {
+  unsigned id, rate, priority = 0, channel = RADIO_CHANNEL;
+  if (sscanf(line, "F%u %u %u %u", &id, &rate, &priority, &channel) < 2 ||
+      id >= MAX_RECEIVERS || rate > 1000 / SLOT_INTERVAL || priority > 255 || channel > 125) {
+    Serial.println("usage: F<receiver 0-7> <rate Hz> [priority] [channel]");
+    return;
   }
   
-  // Save settings if modified
-  if (settings_modified) {
-    saveSettings();
-    settings_modified = false;
+  ReceiverLink& link = system_settings.fleet[id];
+  link.enabled = rate > 0;
+  link.rate_hz = rate > 0 ? rate : SINGLE_RECEIVER_RATE;
+  link.priority = priority;
+  link.channel = channel;
+}
+
+void applyHopCommand(const char* line) {
+  unsigned id, hopping;
+  if (sscanf(line, "H%u %u", &id, &hopping) < 2 || id >= MAX_RECEIVERS || hopping > 1) {
+    Serial.println("usage: H<receiver 0-7> <0|1>");
+    return;
+  }
+  system_settings.fleet[id].hopping = hopping;
+}
+
+// Edits the selected model's filters in the UI task's settings
+void applyFilterCommand(const char* line) {
+  unsigned slot, median, smoothing, deadband, slew = 0;
+  if (sscanf(line, "S%u %u %u %u %u", &slot, &median, &smoothing, &deadband, &slew) < 4 ||
+      slot >= ANALOG_CHANNEL_COUNT || median > 1 || smoothing > 255 || deadband > 100 || slew > 65535) {
+    Serial.println("usage: S<slot 0-5> <median 0|1> <smoothing 0-255> <deadband 0-100> [slew units/s]");
+    return;
   }
   
-  delay(10);
+  ChannelFilter& filter = activeModel(system_settings).filters[slot];
+  filter.median = median;
+  filter.smoothing = smoothing;
+  filter.deadband = deadband;
+  filter.slew_per_s = slew;
+}
+
+// Takes effect once the UI task publishes its settings after the command
+void applyMixCommand(const char* line) {
+  unsigned id, preset;
+  if (sscanf(line, "M%u %u", &id, &preset) < 2 || id >= MAX_RECEIVERS || preset >= MIX_PRESET_COUNT) {
+    Serial.println("usage: M<receiver 0-7> <0 none|1 elevon|2 vtail|3 differential|4 gyro>");
+    return;
+  }
+  system_settings.models[id].mix = preset;
+}
+
+void applySelectCommand(const char* line) {
+  unsigned id;
+  if (sscanf(line, "R%u", &id) < 1 || id >= MAX_RECEIVERS) {
+    Serial.println("usage: R<receiver 0-7>");
+    return;
+  }
+  system_settings.current_receiver = id;
 }
 
 void initializePins() {
@@ -135,47 +853,283 @@ bool initializeRadio() {
     return false;
   }
   
-  radio.setPALevel(RF24_PA_MAX);
-  radio.setDataRate(RF24_2MBPS);
-  radio.setChannel(76);
-  radio.setRetries(3, 5);
+  // Rate, power and retries are set per receiver from its link profile;
+  // every profile keeps a frame's worst case inside one slot
+  applyLinkProfile(LINK_DEFAULT_PROFILE);
+  radio.setChannel(RADIO_CHANNEL);
   radio.setCRCLength(RF24_CRC_16);
   
+  // Frames go out at their encoded length, telemetry rides on the ACKs
+  radio.enableDynamicPayloads();
+  radio.enableAckPayload();
+  
   // Set initial pipe address
   setReceiverAddress(system_settings.current_receiver);
   
   radio.stopListening();
+  
+  // Each receiver's hop order follows from its address
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    hop_sequences[i].bind(BASE_PIPES[i]);
+    sent_hop[i] = NO_HOP;
+  }
+  async_radio.setResultHandler(onFrameResult);
+  async_radio.setEchoHandler(onProbeEcho);
   return true;
 }
 
+void applyLinkProfile(uint8_t profile) {
+  const LinkProfile& link = LINK_PROFILES[profile];
+  radio.setDataRate((rf24_datarate_e)link.data_rate);
+  radio.setPALevel(link.pa_level);
+  radio.setRetries(link.retry_delay, link.retry_count);
+  applied_profile = profile;
+}
+
+// Feeds every ACK or loss into the receiver's link policy and, for
+// hopping receivers, the blacklist of the channel it went out on
+void onFrameResult(const FrameResult& result) {
+  uint8_t receiver = result.receiver;
+  uint32_t now = millis();
+  LinkPolicy& policy = link_policies[receiver];
+  ChannelBlacklist& blacklist = channel_blacklists[receiver];
+  
+  if (result.control == LINK_COMMAND_SET_HOP_MASK) {
+    blacklist.recordControl(result.delivered, announced_mask[receiver], now);
+  }
+  if (sent_hop[receiver] != NO_HOP) {
+    blacklist.record(sent_hop[receiver], result.delivered, result.retries, now);
+    hop_sequences[receiver].setMask(blacklist.channelMask());
+  }
+  
+  if (result.control == LINK_COMMAND_SET_PROFILE) {
+    policy.recordControl(result.delivered, announced_profile[receiver], now);
+  } else {
+    policy.record(result.delivered, result.retries, now);
+  }
+  
+  // The receiver holds every ACKed data frame, deltas can build on it
+  if (!result.control && result.delivered) {
+    delta_encoders[receiver].acknowledge();
+  }
+}
+
+void sendLinkControl(uint8_t receiver_id, uint8_t profile) {
+  uint8_t frame[LINK_CONTROL_SIZE];
+  uint8_t length = encodeLinkControl(profile, frame_sequence[receiver_id]++, frame);
+  announced_profile[receiver_id] = profile;
+  async_radio.queue(frame, length, receiver_id, LINK_COMMAND_SET_PROFILE);
+}
+
+void sendHopMask(uint8_t receiver_id, uint32_t mask) {
+  uint8_t frame[LINK_HOP_MASK_SIZE];
+  uint8_t length = encodeHopMask(mask, frame_sequence[receiver_id]++, frame);
+  announced_mask[receiver_id] = mask;
+  async_radio.queue(frame, length, receiver_id, LINK_COMMAND_SET_HOP_MASK);
+}
+
+void sendProbe(uint8_t receiver_id) {
+  // Settle first so the stamp is taken right before the frame is loaded
+  async_radio.settle();
+  uint8_t frame[LINK_PROBE_SIZE];
+  uint8_t length = encodeProbe(micros(), frame_sequence[receiver_id]++, frame);
+  async_radio.queue(frame, length, receiver_id, LINK_COMMAND_PROBE);
+}
+
+// The echo comes back on the ACK of the frame after the probe
+void onProbeEcho(uint8_t receiver, const TelemetrySample& sample, uint32_t now_us) {
+  if (latency_mode) latency_monitor.recordEcho(sample, now_us);
+}
+
+// INT from the PCF8575: flag the change, the input task does the read
+void IRAM_ATTR onExpanderInterrupt() {
+  trim_reader.notify();
+  runtime.wakeInputFromIsr();
+}
+
 void setReceiverAddress(uint8_t receiver_id) {
   if (receiver_id < MAX_RECEIVERS) {
     radio.openWritingPipe(BASE_PIPES[receiver_id]);
     system_settings.current_receiver = receiver_id;
-    settings_modified = true;
   }
 }
 
+// Follows the selected receiver, returns true on the step that switches
+bool updateActiveModel() {
+  uint8_t selected = control_settings.current_receiver;
+  if (selected == active_receiver) return false;
+  
+  // Booting into a model is not a switch
+  switch_pending = active_receiver < MAX_RECEIVERS;
+  switch_started_us = micros();
+  active_receiver = selected;
+  return switch_pending;
+}
+
+void updateChannelMappers(uint8_t receiver_id) {
+  ModelInputs& inputs = model_inputs[receiver_id];
+  const CalibrationData& cal = control_settings.calibration;
+  const ModelProfile& model = control_settings.models[receiver_id];
+  const TrimSettings& trim = model.trim;
+  bool bidirectional = model.throttle_bidirectional != 0;
+  ChannelMapper* mappers = inputs.mappers;
+  
+  if (inputs.mappers_valid &&
+      memcmp(&inputs.mapped_calibration, &cal, sizeof(cal)) == 0 &&
+      inputs.mapped_bidirectional == bidirectional) {
+    // A trim step only moves the trim of the cached mappers
+    if (memcmp(&inputs.mapped_trim, &trim, sizeof(trim)) != 0) {
+      mappers[SLOT_PITCH].setTrim(trim.pitch_trim);
+      mappers[SLOT_ROLL].setTrim(trim.roll_trim);
+      mappers[SLOT_YAW].setTrim(trim.yaw_trim);
+      inputs.mapped_trim = trim;
+    }
+    return;
+  }
+  
+  if (bidirectional) {
+    mappers[SLOT_THROTTLE].configureLinear(0, 4095, 0);
+  } else {
+    mappers[SLOT_THROTTLE].configure(cal.throttle_min, cal.throttle_mid, cal.throttle_max, 0);
+  }
+  mappers[SLOT_PITCH].configure(cal.pitch_min, cal.pitch_mid, cal.pitch_max, trim.pitch_trim);
+  mappers[SLOT_ROLL].configure(cal.roll_min, cal.roll_mid, cal.roll_max, trim.roll_trim);
+  mappers[SLOT_YAW].configure(cal.yaw_min, cal.yaw_mid, cal.yaw_max, trim.yaw_trim);
+  mappers[SLOT_AUX1].configure(cal.aux1_min, cal.aux1_mid, cal.aux1_max, 0);
+  mappers[SLOT_AUX2].configure(cal.aux2_min, cal.aux2_mid, cal.aux2_max, 0);
+  
+  inputs.mapped_calibration = cal;
+  inputs.mapped_trim = trim;
+  inputs.mapped_bidirectional = bidirectional;
+  inputs.mappers_valid = true;
+}
+
+// Applies trim presses and repeats to the selected model, returns whether
+// the trim changed
+bool applyTrimEvents() {
+  TrimSettings& trim = activeModel(system_settings).trim;
+  bool stepped = false;
+  TrimEvent event;
+  while (trim_events.pop(event)) {
+    if (event.type == TRIM_RELEASE) continue;
+    stepTrim(trim, event.button);
+    stepped = true;
+  }
+  return stepped;
+}
+
+// Hands the control and settings tasks a copy after every change
+void publishSettings() {
+  if (memcmp(&published_settings, &system_settings, sizeof(system_settings)) == 0) return;
+  
+  memcpy(&published_settings, &system_settings, sizeof(system_settings));
+  settings_for_control.publish(published_settings);
+  settings_for_store.publish(published_settings);
+}
+
+// Filters keep their state across a change, only the parameters move.
+// They come from the control task's settings copy, never from a filter
+// command still being applied.
+void updateChannelFilters(uint8_t receiver_id) {
+  ModelInputs& inputs = model_inputs[receiver_id];
+  const ChannelFilter* filters = control_settings.models[receiver_id].filters;
+  if (inputs.filters_valid && memcmp(inputs.applied_filters, filters, sizeof(inputs.applied_filters)) == 0) {
+    return;
+  }
+  
+  for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) {
+    inputs.filters[i].configure(filters[i], SLOT_INTERVAL_US);
+  }
+  memcpy(inputs.applied_filters, filters, sizeof(inputs.applied_filters));
+  inputs.filters_valid = true;
+}
+
+// Calibrated, trimmed and filtered values of every analog slot through
+// one receiver's model. A receiver that sat out the last step starts its
+// filters over rather than from stale state.
+void readAnalog(uint8_t receiver_id, const uint16_t* raw) {
+  ModelInputs& inputs = model_inputs[receiver_id];
+  for (uint8_t slot = 0; slot < ANALOG_CHANNEL_COUNT; slot++) {
+    if (!inputs.running) inputs.filters[slot].restart();
+    inputs.values[slot] = inputs.filters[slot].apply(inputs.mappers[slot].map(raw[slot]));
+  }
+  inputs.running = true;
+}
+
+void setAnalogChannels(ChannelData& data, const int16_t* values) {
+  data.throttle = values[SLOT_THROTTLE];
+  data.pitch = values[SLOT_PITCH];
+  data.roll = values[SLOT_ROLL];
+  data.yaw = values[SLOT_YAW];
+  data.aux1 = values[SLOT_AUX1];
+  data.aux2 = values[SLOT_AUX2];
+}
+
+// Recompiles the receiver's mix only when its preset in the control
+// task's settings copy has changed
+const MixProgram& mixProgram(uint8_t receiver_id) {
+  uint8_t preset = control_settings.models[receiver_id].mix;
+  if (preset >= MIX_PRESET_COUNT) preset = MIX_PRESET_NONE;
+  if (compiled_mix[receiver_id] != preset + 1) {
+    const MixModel& model = MIX_PRESETS[preset];
+    mix_programs[receiver_id].compile(model.rules, model.rule_count);
+    compiled_mix[receiver_id] = preset + 1;
+  }
+  return mix_programs[receiver_id];
+}
+
+// Builds from the control task's copy of the fleet table, so a fleet or
+// hop edit is only ever picked up complete
+void updateSchedule() {
+  ReceiverLink links[MAX_RECEIVERS];
+  memcpy(links, control_settings.fleet, sizeof(links));
+  
+  bool fleet = false;
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    if (links[i].enabled) fleet = true;
+  }
+  
+  // Without a fleet the selected receiver gets the whole link
+  if (!fleet) {
+    uint8_t selected = control_settings.current_receiver;
+    links[selected].enabled = 1;
+    links[selected].rate_hz = SINGLE_RECEIVER_RATE;
+  }
+  
+  if (schedule_valid && memcmp(links, scheduled_links, sizeof(links)) == 0) {
+    return;
+  }
+  
+  tdma.build(links);
+  memcpy(scheduled_links, links, sizeof(links));
+  schedule_valid = true;
+}
+
 void readInputs() {
-  // Read analog inputs
-  channel_data.throttle = readAndMapAnalog(THROTTLE_PIN, system_settings.calibration.throttle_min, 
-                                          system_settings.calibration.throttle_max, 
-                                          system_settings.calibration.throttle_mid);
-  channel_data.pitch = readAndMapAnalog(PITCH_PIN, system_settings.calibration.pitch_min,
-                                       system_settings.calibration.pitch_max,
-                                       system_settings.calibration.pitch_mid) + system_settings.trim.pitch_trim;
-  channel_data.roll = readAndMapAnalog(ROLL_PIN, system_settings.calibration.roll_min,
-                                      system_settings.calibration.roll_max,
-                                      system_settings.calibration.roll_mid) + system_settings.trim.roll_trim;
-  channel_data.yaw = readAndMapAnalog(YAW_PIN, system_settings.calibration.yaw_min,
-                                     system_settings.calibration.yaw_max,
-                                     system_settings.calibration.yaw_mid) + system_settings.trim.yaw_trim;
-  channel_data.aux1 = readAndMapAnalog(AUX1_PIN, system_settings.calibration.aux1_min,
-                                      system_settings.calibration.aux1_max,
-                                      system_settings.calibration.aux1_mid);
-  channel_data.aux2 = readAndMapAnalog(AUX2_PIN, system_settings.calibration.aux2_min,
-                                      system_settings.calibration.aux2_max,
-                                      system_settings.calibration.aux2_mid);
+  // A newly selected model takes over from this frame on
+  bool switched = updateActiveModel();
+  
+  // Every receiver in the schedule maps the same raw inputs through its
+  // own model, the active one also feeds the display
+  uint16_t raw[ANALOG_CHANNEL_COUNT];
+  for (uint8_t slot = 0; slot < ANALOG_CHANNEL_COUNT; slot++) {
+    raw[slot] = adc_sampler.readSlot(slot);
+  }
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    if (!scheduled_links[i].enabled && i != active_receiver) {
+      model_inputs[i].running = false;
+      continue;
+    }
+    updateChannelMappers(i);
+    updateChannelFilters(i);
+    readAnalog(i, raw);
+  }
+  if (switched) {
+    mixProgram(active_receiver);
+    switch_rebuild_us = micros() - switch_started_us;
+    if (switch_rebuild_us > switch_rebuild_max_us) switch_rebuild_max_us = switch_rebuild_us;
+  }
+  setAnalogChannels(channel_data, model_inputs[active_receiver].values);
   
   // Read digital switches
   channel_data.aux3 = !digitalRead(AUX3_PIN);
@@ -187,25 +1141,17 @@ void readInputs() {
   channel_data.aux7 = read3WaySwitch(AUX7_PIN1, AUX7_PIN2);
   channel_data.aux8 = read3WaySwitch(AUX8_PIN1, AUX8_PIN2);
   
-  // Set receiver ID
-  channel_data.receiver_id = system_settings.current_receiver;
-  channel_data.timestamp = millis();
-}
-
-int16_t readAndMapAnalog(uint8_t pin, int16_t min_val, int16_t max_val, int16_t mid_val) {
-  int raw = analogRead(pin);
+  // Transmitter tilt for the mixer, level without a recent IMU batch
+  Attitude attitude;
+  latest_attitude.read(attitude);
+  bool current = attitude.timestamp != 0 && micros() - attitude.timestamp < IMU_STALE_US;
+  tilt_pitch = current ? tiltChannel(attitude.pitch, TILT_FULL_SCALE) : 0;
+  tilt_roll = current ? tiltChannel(attitude.roll, TILT_FULL_SCALE) : 0;
   
-  if (system_settings.throttle_bidirectional && pin == THROTTLE_PIN) {
-    // Map from 0-4095 to -511 to 512
-    return map(raw, 0, 4095, -511, 512);
-  } else {
-    // Map from 0-4095 to custom range
-    if (raw < mid_val) {
-      return map(raw, min_val, mid_val, -511, 0);
-    } else {
-      return map(raw, mid_val, max_val, 0, 512);
-    }
-  }
+  // Set receiver ID
+  channel_data.receiver_id = active_receiver;
+  channel_data.timestamp = micros();
+  inputs_sampled_us = adc_sampler.sampledAt();
 }
 
 int8_t read3WaySwitch(uint8_t pin1, uint8_t pin2) {
@@ -217,36 +1163,64 @@ int8_t read3WaySwitch(uint8_t pin1, uint8_t pin2) {
   return 0;
 }
 
-void transmitData() {
-  bool success = radio.write(&channel_data, sizeof(channel_data));
+void transmitData(uint8_t receiver_id) {
+  // The previous frame's ACK decides the delta base
+  async_radio.settle();
   
-  if (!success) {
-    Serial.println("Transmission failed!");
+  // Each receiver gets the sticks through its own model's mapping,
+  // filters and mix
+  uint8_t frame[FRAME_SIZE];
+  channel_data.receiver_id = receiver_id;
+  ChannelData mixed = channel_data;
+  setAnalogChannels(mixed, model_inputs[receiver_id].values);
+  mixProgram(receiver_id).apply(mixed, tilt_pitch, tilt_roll);
+  uint8_t length = delta_encoders[receiver_id].encode(mixed, frame_sequence[receiver_id]++, frame);
+  if (switch_pending && receiver_id == active_receiver) {
+    switch_pending = false;
+    model_switches++;
+    switch_frame_us = micros() - switch_started_us;
+    if (switch_frame_us > switch_frame_max_us) switch_frame_max_us = switch_frame_us;
   }
+  if (!latency_mode) {
+    async_radio.queue(frame, length, receiver_id);
+    return;
+  }
+  
+  LatencyStamps stamps;
+  stamps.sampled_us = inputs_sampled_us;
+  stamps.read_us = channel_data.timestamp;
+  stamps.encoded_us = micros();
+  async_radio.queue(frame, length, receiver_id);
+  stamps.queued_us = micros();
+  bool delivered = async_radio.await(LATENCY_AWAIT_US);
+  stamps.done_us = micros();
+  latency_monitor.recordFrame(stamps, delivered);
 }
 
 void loadSettings() {
-  EEPROM.get(0, system_settings);
+  // Start from defaults, stored field groups override them
+  initializeDefaultSettings();
   
-  // If EEPROM is empty, initialize with default values
-  if (system_settings.current_receiver >= MAX_RECEIVERS) {
-    initializeDefaultSettings();
+  if (!settings_store.begin()) {
+    Serial.println("Settings partition not found!");
+    return;
+  }
+  
+  if (settings_store.load(system_settings) == 0) {
+    // First boot on the journal: carry over the old EEPROM settings
+    loadLegacySettings(system_settings);
+    settings_store.commit(system_settings);
   }
 }
 
 void saveSettings() {
-  EEPROM.put(0, system_settings);
-  EEPROM.commit();
+  SystemSettings snapshot;
+  settings_for_store.read(snapshot);
+  settings_store.saveWhenSettled(snapshot);
 }
 
 void initializeDefaultSettings() {
   system_settings.current_receiver = 0;
-  system_settings.throttle_bidirectional = false;
-  
-  // Initialize trim
-  system_settings.trim.pitch_trim = 0;
-  system_settings.trim.roll_trim = 0;
-  system_settings.trim.yaw_trim = 0;
   
   // Initialize calibration with typical ESP32 ADC ranges
   system_settings.calibration.throttle_min = 0;
@@ -273,5 +1247,37 @@ void initializeDefaultSettings() {
   system_settings.calibration.aux2_max = 4095;
   system_settings.calibration.aux2_mid = 2048;
   
-  saveSettings();
+  // Every model starts untrimmed with a unidirectional throttle
+  ModelProfile model;
+  memset(&model, 0, sizeof(model));
+  
+  // Spike rejection and light smoothing everywhere, a small deadband
+  // around the centre of the three self-centring sticks
+  for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) {
+    ChannelFilter& filter = model.filters[i];
+    filter.median = 1;
+    filter.smoothing = 64;
+    filter.deadband = (i == SLOT_PITCH || i == SLOT_ROLL || i == SLOT_YAW) ? 2 : 0;
+    filter.reserved = 0;
+    filter.slew_per_s = 0;
+  }
+  
+  // Mixes for the models the receiver names suggest
+  static const uint8_t DEFAULT_MIXES[MAX_RECEIVERS] = {
+    MIX_PRESET_NONE, MIX_PRESET_NONE, MIX_PRESET_NONE, MIX_PRESET_NONE,
+    MIX_PRESET_ELEVON, MIX_PRESET_DIFFERENTIAL, MIX_PRESET_DIFFERENTIAL, MIX_PRESET_NONE
+  };
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    system_settings.models[i] = model;
+    system_settings.models[i].mix = DEFAULT_MIXES[i];
+  }
+  
+  // No fleet: only the selected receiver is driven
+  for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+    system_settings.fleet[i].enabled = 0;
+    system_settings.fleet[i].rate_hz = SINGLE_RECEIVER_RATE;
+    system_settings.fleet[i].priority = 0;
+    system_settings.fleet[i].channel = RADIO_CHANNEL;
+    system_settings.fleet[i].hopping = 1;
+  }
 }
\ No newline at end of file
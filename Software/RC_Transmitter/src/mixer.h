@@ -0,0 +1,242 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <channel_data.h>
+#include "channel_mapper.h"
+
+// Mixer between input mapping and frame encoding. A model's mix is a
+// sparse list of rules, each adding weight% of a source, optionally shaped
+// by a curve, plus an offset to one output. Outputs are the six
+// proportional channels and saturate at the channel range; an output no
+// rule writes passes its own input through.
+
+// Sources in ChannelData order: throttle..aux2, aux3..aux6, aux7, aux8,
+// then the transmitter's own tilt from the IMU. Switches read as the ends
+// of the range (3-way switches also the centre).
+const uint8_t MIX_SOURCE_COUNT = 14;
+const uint8_t MIX_TILT_PITCH = 12;
+const uint8_t MIX_TILT_ROLL = 13;
+// Outputs: throttle, pitch, roll, yaw, aux1, aux2
+const uint8_t MIX_OUTPUT_COUNT = 6;
+const uint8_t MIX_MAX_TERMS = MIX_SOURCE_COUNT * MIX_OUTPUT_COUNT;
+
+enum MixChannel { MIX_THROTTLE, MIX_PITCH, MIX_ROLL, MIX_YAW, MIX_AUX1, MIX_AUX2 };
+
+// Piecewise-linear curve through five points at inputs -512, -256, 0, 256
+// and 512
+struct MixCurve {
+  int16_t points[5];
+};
+
+const uint8_t MIX_NO_CURVE = 0xFF;
+const uint8_t MIX_CURVE_COUNT = 3;
+const MixCurve MIX_CURVES[MIX_CURVE_COUNT] = {
+  {{ -511, -154, 0, 154, 512 }},    // Soft centre, full throw at the ends
+  {{ 0, 0, 0, 256, 512 }},          // Positive half only
+  {{ -511, -256, 0, 0, 0 }},        // Negative half only
+};
+
+struct MixRule {
+  uint8_t source;
+  uint8_t output;
+  int8_t weight;            // %, -125..125
+  uint8_t curve;            // MIX_CURVES index or MIX_NO_CURVE
+  int16_t offset;           // Channel units added to the output
+};
+
+// Built-in mixes, selected per receiver
+enum MixPreset {
+  MIX_PRESET_NONE,
+  MIX_PRESET_ELEVON,        // Flying wing: pitch and roll on two surfaces
+  MIX_PRESET_VTAIL,         // V-tail: pitch and yaw on two surfaces
+  MIX_PRESET_DIFFERENTIAL,  // Tank/boat: throttle and yaw on two motors
+  MIX_PRESET_GYRO,          // Gyro-assist: transmitter tilt adds to pitch and roll
+  MIX_PRESET_COUNT
+};
+
+// Elevons on the pitch (left) and roll (right) outputs, half throw each
+// so full pitch and full roll together still fit
+const MixRule MIX_ELEVON_RULES[] = {
+  { MIX_PITCH, MIX_PITCH, 50, MIX_NO_CURVE, 0 },
+  { MIX_ROLL, MIX_PITCH, 50, MIX_NO_CURVE, 0 },
+  { MIX_PITCH, MIX_ROLL, 50, MIX_NO_CURVE, 0 },
+  { MIX_ROLL, MIX_ROLL, -50, MIX_NO_CURVE, 0 },
+};
+
+// Ruddervators on the pitch (left) and yaw (right) outputs
+const MixRule MIX_VTAIL_RULES[] = {
+  { MIX_PITCH, MIX_PITCH, 50, MIX_NO_CURVE, 0 },
+  { MIX_YAW, MIX_PITCH, 50, MIX_NO_CURVE, 0 },
+  { MIX_PITCH, MIX_YAW, 50, MIX_NO_CURVE, 0 },
+  { MIX_YAW, MIX_YAW, -50, MIX_NO_CURVE, 0 },
+};
+
+// Left motor on the throttle output, right motor on yaw. Meant for the
+// bidirectional throttle mode; the inner motor slows as the outer one
+// saturates.
+const MixRule MIX_DIFFERENTIAL_RULES[] = {
+  { MIX_THROTTLE, MIX_THROTTLE, 100, MIX_NO_CURVE, 0 },
+  { MIX_YAW, MIX_THROTTLE, 100, MIX_NO_CURVE, 0 },
+  { MIX_THROTTLE, MIX_YAW, 100, MIX_NO_CURVE, 0 },
+  { MIX_YAW, MIX_YAW, -100, MIX_NO_CURVE, 0 },
+};
+
+// Tilting the transmitter moves pitch and roll as the sticks would, on
+// top of them
+const MixRule MIX_GYRO_RULES[] = {
+  { MIX_PITCH, MIX_PITCH, 100, MIX_NO_CURVE, 0 },
+  { MIX_TILT_PITCH, MIX_PITCH, 100, MIX_NO_CURVE, 0 },
+  { MIX_ROLL, MIX_ROLL, 100, MIX_NO_CURVE, 0 },
+  { MIX_TILT_ROLL, MIX_ROLL, 100, MIX_NO_CURVE, 0 },
+};
+
+struct MixModel {
+  const char* name;
+  const MixRule* rules;
+  uint8_t rule_count;
+};
+
+const MixModel MIX_PRESETS[MIX_PRESET_COUNT] = {
+  { "none", NULL, 0 },
+  { "elevon", MIX_ELEVON_RULES, sizeof(MIX_ELEVON_RULES) / sizeof(MixRule) },
+  { "vtail", MIX_VTAIL_RULES, sizeof(MIX_VTAIL_RULES) / sizeof(MixRule) },
+  { "differential", MIX_DIFFERENTIAL_RULES, sizeof(MIX_DIFFERENTIAL_RULES) / sizeof(MixRule) },
+  { "gyro", MIX_GYRO_RULES, sizeof(MIX_GYRO_RULES) / sizeof(MixRule) },
+};
+
+// Sources of one frame in channel units
+inline void mixSources(const ChannelData& data, int16_t tilt_pitch, int16_t tilt_roll, int16_t* sources) {
+  sources[0] = data.throttle;
+  sources[1] = data.pitch;
+  sources[2] = data.roll;
+  sources[3] = data.yaw;
+  sources[4] = data.aux1;
+  sources[5] = data.aux2;
+  sources[6] = data.aux3 ? ChannelMapper::OUTPUT_MAX : ChannelMapper::OUTPUT_MIN;
+  sources[7] = data.aux4 ? ChannelMapper::OUTPUT_MAX : ChannelMapper::OUTPUT_MIN;
+  sources[8] = data.aux5 ? ChannelMapper::OUTPUT_MAX : ChannelMapper::OUTPUT_MIN;
+  sources[9] = data.aux6 ? ChannelMapper::OUTPUT_MAX : ChannelMapper::OUTPUT_MIN;
+  sources[10] = data.aux7 < 0 ? ChannelMapper::OUTPUT_MIN : (data.aux7 > 0 ? ChannelMapper::OUTPUT_MAX : 0);
+  sources[11] = data.aux8 < 0 ? ChannelMapper::OUTPUT_MIN : (data.aux8 > 0 ? ChannelMapper::OUTPUT_MAX : 0);
+  sources[MIX_TILT_PITCH] = tilt_pitch;
+  sources[MIX_TILT_ROLL] = tilt_roll;
+}
+
+inline int16_t evaluateCurve(const MixCurve& curve, int16_t value) {
+  int32_t position = (int32_t)value + 512;     // 1..1024 over the channel range
+  uint8_t segment = position >> 8;
+  int32_t fraction = position & 0xFF;
+  if (segment >= 4) {
+    segment = 3;
+    fraction = 256;
+  }
+  int32_t low = curve.points[segment];
+  int32_t high = curve.points[segment + 1];
+  return (int16_t)(low + (high - low) * fraction / 256);
+}
+
+// A model's rules compiled into one flat run of terms per output, weights
+// in 8 fractional bits and offsets summed, so a frame is a single pass
+// over contiguous memory. Compiled when the model is selected, applied
+// every frame.
+class MixProgram {
+private:
+  struct Term {
+    uint8_t source;
+    uint8_t curve;
+    int16_t weight;         // 256 = 100%
+  };
+
+  struct Output {
+    uint8_t first;
+    uint8_t count;
+    int16_t offset;
+  };
+
+  // Room for an identity term on every output the rules leave alone
+  Term terms[MIX_MAX_TERMS + MIX_OUTPUT_COUNT];
+  Output outputs[MIX_OUTPUT_COUNT];
+  uint8_t term_count;
+
+public:
+  MixProgram() : term_count(0) {
+    compile(NULL, 0);
+  }
+
+  // Returns false, leaving every output a pass-through, if a rule is out
+  // of range or there are more than MIX_MAX_TERMS
+  bool compile(const MixRule* rules, uint8_t count) {
+    uint8_t per_output[MIX_OUTPUT_COUNT] = {};
+    int32_t offsets[MIX_OUTPUT_COUNT] = {};
+    bool valid = count <= MIX_MAX_TERMS;
+    for (uint8_t i = 0; valid && i < count; i++) {
+      const MixRule& rule = rules[i];
+      valid = rule.source < MIX_SOURCE_COUNT && rule.output < MIX_OUTPUT_COUNT &&
+              (rule.curve == MIX_NO_CURVE || rule.curve < MIX_CURVE_COUNT);
+      if (valid) {
+        per_output[rule.output]++;
+        offsets[rule.output] += rule.offset;
+      }
+    }
+    if (!valid) count = 0;
+
+    // Outputs nothing writes to keep their own input
+    term_count = 0;
+    for (uint8_t out = 0; out < MIX_OUTPUT_COUNT; out++) {
+      outputs[out].first = term_count;
+      outputs[out].count = 0;
+      outputs[out].offset = (int16_t)(valid ? offsets[out] : 0);
+      if (count == 0 || per_output[out] == 0) {
+        Term identity = { out, MIX_NO_CURVE, 256 };
+        terms[term_count++] = identity;
+        outputs[out].count = 1;
+        continue;
+      }
+      for (uint8_t i = 0; i < count; i++) {
+        if (rules[i].output != out) continue;
+        Term term = { rules[i].source, rules[i].curve, (int16_t)(rules[i].weight * 256 / 100) };
+        terms[term_count++] = term;
+        outputs[out].count++;
+      }
+    }
+    return valid;
+  }
+
+  void apply(const int16_t* sources, int16_t* results) const {
+    for (uint8_t out = 0; out < MIX_OUTPUT_COUNT; out++) {
+      const Output& output = outputs[out];
+      int32_t total = (int32_t)output.offset * 256;
+      const Term* term = &terms[output.first];
+      for (uint8_t i = 0; i < output.count; i++, term++) {
+        int16_t value = sources[term->source];
+        if (term->curve != MIX_NO_CURVE) value = evaluateCurve(MIX_CURVES[term->curve], value);
+        total += (int32_t)value * term->weight;
+      }
+      total = (total + (total >= 0 ? 128 : -128)) / 256;
+      if (total < ChannelMapper::OUTPUT_MIN) total = ChannelMapper::OUTPUT_MIN;
+      if (total > ChannelMapper::OUTPUT_MAX) total = ChannelMapper::OUTPUT_MAX;
+      results[out] = (int16_t)total;
+    }
+  }
+
+  // Mixes the proportional channels of data in place, with the tilt
+  // channels (level if there is no IMU) as extra sources
+  void apply(ChannelData& data, int16_t tilt_pitch = 0, int16_t tilt_roll = 0) const {
+    int16_t sources[MIX_SOURCE_COUNT];
+    int16_t results[MIX_OUTPUT_COUNT];
+    mixSources(data, tilt_pitch, tilt_roll, sources);
+    apply(sources, results);
+    data.throttle = results[MIX_THROTTLE];
+    data.pitch = results[MIX_PITCH];
+    data.roll = results[MIX_ROLL];
+    data.yaw = results[MIX_YAW];
+    data.aux1 = results[MIX_AUX1];
+    data.aux2 = results[MIX_AUX2];
+  }
+
+  uint8_t termCount() const { return term_count; }
+};
+
+#endif
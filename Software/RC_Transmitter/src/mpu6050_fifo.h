@@ -0,0 +1,76 @@
+#ifndef MPU6050_FIFO_H
+#define MPU6050_FIFO_H
+
+#include <stdint.h>
+#include "attitude_filter.h"
+
+// MPU6050 set up to sample accel and gyro into its 1 KB FIFO at
+// IMU_SAMPLE_RATE, so the IMU task can drain a whole batch in one burst
+// read instead of polling the data registers for every sample.
+#define MPU6050_ADDRESS 0x68
+
+const uint8_t MPU6050_SMPLRT_DIV = 0x19;
+const uint8_t MPU6050_CONFIG = 0x1A;
+const uint8_t MPU6050_GYRO_CONFIG = 0x1B;
+const uint8_t MPU6050_ACCEL_CONFIG = 0x1C;
+const uint8_t MPU6050_FIFO_EN = 0x23;
+const uint8_t MPU6050_USER_CTRL = 0x6A;
+const uint8_t MPU6050_PWR_MGMT_1 = 0x6B;
+const uint8_t MPU6050_FIFO_COUNT_H = 0x72;
+const uint8_t MPU6050_FIFO_R_W = 0x74;
+const uint8_t MPU6050_WHO_AM_I = 0x75;
+
+const uint8_t MPU6050_USER_FIFO_EN = 0x40;
+const uint8_t MPU6050_USER_FIFO_RESET = 0x04;
+
+const uint32_t IMU_SAMPLE_RATE = 200;        // Hz
+const uint16_t IMU_FIFO_SIZE = 1024;
+const uint8_t IMU_SAMPLE_BYTES = 12;          // Accel x, y, z then gyro x, y, z
+const uint8_t IMU_BURST_SAMPLES = 10;         // 120 bytes, inside the Wire buffer
+
+struct Mpu6050Register {
+  uint8_t reg;
+  uint8_t value;
+};
+
+// Written in order by begin(); the FIFO is reset last so it starts empty
+const Mpu6050Register MPU6050_SETUP[] = {
+  { MPU6050_PWR_MGMT_1, 0x01 },                // Awake, clocked from the x gyro PLL
+  { MPU6050_CONFIG, 0x03 },                    // 44 Hz DLPF, 1 kHz internal rate
+  { MPU6050_SMPLRT_DIV, 1000 / IMU_SAMPLE_RATE - 1 },
+  { MPU6050_GYRO_CONFIG, 0x08 },               // +-500 dps
+  { MPU6050_ACCEL_CONFIG, 0x08 },              // +-4 g
+  { MPU6050_FIFO_EN, 0x78 },                   // Gyro x, y, z and accel
+  { MPU6050_USER_CTRL, MPU6050_USER_FIFO_RESET },
+  { MPU6050_USER_CTRL, MPU6050_USER_FIFO_EN },
+};
+const uint8_t MPU6050_SETUP_COUNT = sizeof(MPU6050_SETUP) / sizeof(Mpu6050Register);
+
+// FIFO_COUNT as whole samples, or -1 once the FIFO has overflowed: 85
+// samples fill 1020 bytes, and the chip makes room for the next by
+// dropping the oldest bytes, which leaves the count at the full 1024 and
+// the stream out of step with the sample boundary. A sample still being
+// written is left for the next read.
+inline int16_t fifoSamples(uint16_t count) {
+  if (count > IMU_FIFO_SIZE / IMU_SAMPLE_BYTES * IMU_SAMPLE_BYTES) return -1;
+  return count / IMU_SAMPLE_BYTES;
+}
+
+// One sample from the FIFO stream, big-endian words
+inline void parseFifoSample(const uint8_t* bytes, ImuSample& sample) {
+  for (uint8_t i = 0; i < 3; i++) {
+    sample.accel[i] = (int16_t)((bytes[2 * i] << 8) | bytes[2 * i + 1]);
+    sample.gyro[i] = (int16_t)((bytes[6 + 2 * i] << 8) | bytes[6 + 2 * i + 1]);
+  }
+}
+
+struct ImuFifoStats {
+  uint32_t batches;           // Reads that found samples waiting
+  uint32_t samples;
+  uint32_t bursts;            // FIFO_R_W reads
+  uint32_t overflows;
+  uint32_t errors;            // Failed or short I2C transfers
+  uint16_t max_batch;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef OVERSAMPLER_H
+#define OVERSAMPLER_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Averages raw ADC samples in blocks of `decimation` and publishes the block
+// mean. The spread of the last block is kept as a noise figure. push() runs
+// in the sampling task; latest() is a single aligned load for any reader.
+class Oversampler {
+private:
+  uint16_t decimation;
+  uint16_t count;
+  uint32_t sum;
+  uint64_t sum_squares;
+
+  volatile uint16_t latest_value;
+  volatile uint32_t block_variance;
+  volatile uint32_t total_samples;
+
+public:
+  explicit Oversampler(uint16_t factor = 16)
+    : decimation(factor > 0 ? factor : 1), count(0), sum(0), sum_squares(0),
+      latest_value(0), block_variance(0), total_samples(0) {}
+
+  void push(uint16_t sample) {
+    sum += sample;
+    sum_squares += (uint32_t)sample * sample;
+    count++;
+    total_samples++;
+
+    if (count >= decimation) {
+      uint32_t mean = (sum + decimation / 2) / decimation;
+      uint64_t mean_squares = sum_squares / decimation;
+      uint64_t square_mean = (uint64_t)sum * sum / ((uint32_t)decimation * decimation);
+      block_variance = mean_squares > square_mean ? (uint32_t)(mean_squares - square_mean) : 0;
+      latest_value = (uint16_t)mean;
+
+      count = 0;
+      sum = 0;
+      sum_squares = 0;
+    }
+  }
+
+  // Only safe before sampling starts
+  void setDecimation(uint16_t factor) {
+    decimation = factor > 0 ? factor : 1;
+    count = 0;
+    sum = 0;
+    sum_squares = 0;
+  }
+
+  uint16_t latest() const { return latest_value; }
+  uint32_t samples() const { return total_samples; }
+
+  // Standard deviation of the last block in raw ADC counts
+  float noise() const { return sqrtf((float)block_variance); }
+};
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef PIN_DEFINITIONS_H
 #define PIN_DEFINITIONS_H
 
+#include <stdint.h>
+
 // NRF24L01 Pins
 #define CE_PIN 4
 #define CSN_PIN 5
@@ -15,6 +17,15 @@
 #define AUX1_PIN 25        // ADC2_CH8
 #define AUX2_PIN 26        // ADC2_CH9
 
+// Analog channel slots, in ChannelData order
+enum AnalogSlot {
+  SLOT_THROTTLE, SLOT_PITCH, SLOT_ROLL, SLOT_YAW, SLOT_AUX1, SLOT_AUX2
+};
+const uint8_t ANALOG_CHANNEL_COUNT = 6;
+const uint8_t ANALOG_PINS[ANALOG_CHANNEL_COUNT] = {
+  THROTTLE_PIN, PITCH_PIN, ROLL_PIN, YAW_PIN, AUX1_PIN, AUX2_PIN
+};
+
 // 2-way Toggle Switches
 #define AUX3_PIN 15
 #define AUX4_PIN 2
@@ -27,13 +38,9 @@
 #define AUX8_PIN1 19
 #define AUX8_PIN2 21
 
-// Trim Buttons
-#define PITCH_UP_PIN 13
-#define PITCH_DOWN_PIN 12
-#define ROLL_UP_PIN 14
-#define ROLL_DOWN_PIN 27
-#define YAW_UP_PIN 22
-#define YAW_DOWN_PIN 23
+// Trim Buttons are on the PCF8575 (P0-P5, see trim_buttons.h); its
+// open-drain INT output pulls low on any input change
+#define PCF8575_INT_PIN 13
 
 // Menu Navigation Buttons
 #define BTN_UP_PIN 39
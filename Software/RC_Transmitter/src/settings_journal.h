@@ -0,0 +1,233 @@
+#ifndef SETTINGS_JOURNAL_H
+#define SETTINGS_JOURNAL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Append-only settings log over raw flash sectors.
+//
+// Flash is split into fixed 64-byte record slots. Each record carries one
+// field group, a schema version, a global sequence number and a CRC-16, so
+// a torn write is simply ignored on the next boot. Records are appended
+// until the active sector is full; the journal then erases the next sector
+// and copies the newest record of every group into it before continuing.
+// The newest record of every group therefore always lives in the active
+// sector, and the sector being erased never holds live data.
+//
+// Flash must provide sectorSize(), sectorCount(), read(offset, buf, len),
+// write(offset, buf, len) and erase(sector).
+template <class Flash>
+class SettingsJournal {
+public:
+  static const uint16_t RECORD_SIZE = 64;
+  static const uint8_t HEADER_SIZE = 12;
+  static const uint8_t MAX_PAYLOAD = RECORD_SIZE - HEADER_SIZE;
+  static const uint8_t MAX_GROUPS = 16;
+  static const uint8_t RECORD_MAGIC = 0xA5;
+  static const uint32_t NO_RECORD = 0xFFFFFFFF;
+
+private:
+  Flash& flash;
+  uint8_t schema_version;
+  uint32_t sequence;
+  uint16_t active_sector;
+  uint16_t next_slot;
+  uint32_t latest[MAX_GROUPS];     // Flash offset of each group's newest record
+  uint32_t erase_count;
+
+  static uint16_t crc16(const uint8_t* data, uint16_t length, uint16_t crc = 0xFFFF) {
+    for (uint16_t i = 0; i < length; i++) {
+      crc ^= (uint16_t)data[i] << 8;
+      for (uint8_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  uint16_t slotsPerSector() const { return flash.sectorSize() / RECORD_SIZE; }
+
+  uint32_t slotOffset(uint16_t sector, uint16_t slot) const {
+    return (uint32_t)sector * flash.sectorSize() + (uint32_t)slot * RECORD_SIZE;
+  }
+
+  bool isErased(uint32_t offset) const {
+    uint8_t record[RECORD_SIZE];
+    flash.read(offset, record, RECORD_SIZE);
+    for (uint16_t i = 0; i < RECORD_SIZE; i++) {
+      if (record[i] != 0xFF) return false;
+    }
+    return true;
+  }
+
+  // Validates the record at offset and returns its sequence and group
+  bool parse(uint32_t offset, uint8_t& group, uint32_t& record_sequence) const {
+    uint8_t record[RECORD_SIZE];
+    flash.read(offset, record, RECORD_SIZE);
+
+    if (record[0] != RECORD_MAGIC || record[1] >= MAX_GROUPS ||
+        record[2] != schema_version || record[3] > MAX_PAYLOAD) {
+      return false;
+    }
+    uint16_t stored_crc = (uint16_t)record[8] | ((uint16_t)record[9] << 8);
+    uint16_t crc = crc16(record, 8);
+    crc = crc16(record + HEADER_SIZE, record[3], crc);
+    if (crc != stored_crc) return false;
+
+    group = record[1];
+    record_sequence = readU32(record + 4);
+    return true;
+  }
+
+  void writeRecord(uint8_t group, const uint8_t* data, uint8_t length) {
+    uint8_t record[RECORD_SIZE];
+    memset(record, 0xFF, RECORD_SIZE);
+    sequence++;
+
+    record[0] = RECORD_MAGIC;
+    record[1] = group;
+    record[2] = schema_version;
+    record[3] = length;
+    record[4] = sequence & 0xFF;
+    record[5] = (sequence >> 8) & 0xFF;
+    record[6] = (sequence >> 16) & 0xFF;
+    record[7] = (sequence >> 24) & 0xFF;
+    memcpy(record + HEADER_SIZE, data, length);
+    uint16_t crc = crc16(record, 8);
+    crc = crc16(record + HEADER_SIZE, length, crc);
+    record[8] = crc & 0xFF;
+    record[9] = crc >> 8;
+
+    uint32_t offset = slotOffset(active_sector, next_slot);
+    flash.write(offset, record, RECORD_SIZE);
+    latest[group] = offset;
+    next_slot++;
+  }
+
+  // Moves to the next sector, carrying over every live group
+  void rotate() {
+    uint16_t target = (active_sector + 1) % flash.sectorCount();
+    flash.erase(target);
+    erase_count++;
+    active_sector = target;
+    next_slot = 0;
+
+    for (uint8_t group = 0; group < MAX_GROUPS; group++) {
+      if (latest[group] == NO_RECORD) continue;
+
+      uint8_t record[RECORD_SIZE];
+      flash.read(latest[group], record, RECORD_SIZE);
+      writeRecord(group, record + HEADER_SIZE, record[3]);
+    }
+  }
+
+public:
+  SettingsJournal(Flash& backing, uint8_t schema)
+    : flash(backing), schema_version(schema), sequence(0), active_sector(0),
+      next_slot(0), erase_count(0) {
+    for (uint8_t i = 0; i < MAX_GROUPS; i++) {
+      latest[i] = NO_RECORD;
+    }
+  }
+
+  // Scans all sectors and recovers the newest valid record of each group.
+  // Returns the number of groups found.
+  uint8_t mount() {
+    uint32_t latest_sequence[MAX_GROUPS];
+    uint32_t newest_offset = NO_RECORD;
+    sequence = 0;
+
+    for (uint8_t i = 0; i < MAX_GROUPS; i++) {
+      latest[i] = NO_RECORD;
+      latest_sequence[i] = 0;
+    }
+
+    for (uint16_t sector = 0; sector < flash.sectorCount(); sector++) {
+      for (uint16_t slot = 0; slot < slotsPerSector(); slot++) {
+        uint32_t offset = slotOffset(sector, slot);
+        uint8_t group;
+        uint32_t record_sequence;
+        if (!parse(offset, group, record_sequence)) continue;
+
+        if (latest[group] == NO_RECORD || record_sequence > latest_sequence[group]) {
+          latest[group] = offset;
+          latest_sequence[group] = record_sequence;
+        }
+        if (newest_offset == NO_RECORD || record_sequence > sequence) {
+          newest_offset = offset;
+          sequence = record_sequence;
+        }
+      }
+    }
+
+    if (newest_offset == NO_RECORD) {
+      // Empty or foreign data: start over on a clean sector
+      active_sector = 0;
+      next_slot = 0;
+      flash.erase(0);
+      erase_count++;
+      return 0;
+    }
+
+    // Resume after the newest record, skipping any torn slots
+    active_sector = newest_offset / flash.sectorSize();
+    next_slot = (newest_offset % flash.sectorSize()) / RECORD_SIZE + 1;
+    while (next_slot < slotsPerSector() && !isErased(slotOffset(active_sector, next_slot))) {
+      next_slot++;
+    }
+
+    // A rotation cut short by power loss leaves groups behind in the
+    // previous sector, which is the next one erased on a two-sector
+    // partition: finish carrying them over
+    for (uint8_t group = 0; group < MAX_GROUPS && next_slot < slotsPerSector(); group++) {
+      if (latest[group] == NO_RECORD || latest[group] / flash.sectorSize() == active_sector) continue;
+
+      uint8_t record[RECORD_SIZE];
+      flash.read(latest[group], record, RECORD_SIZE);
+      writeRecord(group, record + HEADER_SIZE, record[3]);
+    }
+
+    uint8_t found = 0;
+    for (uint8_t i = 0; i < MAX_GROUPS; i++) {
+      if (latest[i] != NO_RECORD) found++;
+    }
+    return found;
+  }
+
+  // Copies the newest payload of a group; false if missing or wrong size
+  bool read(uint8_t group, void* out, uint8_t length) const {
+    if (group >= MAX_GROUPS || latest[group] == NO_RECORD) return false;
+
+    uint8_t record[RECORD_SIZE];
+    flash.read(latest[group], record, RECORD_SIZE);
+    if (record[3] != length) return false;
+
+    memcpy(out, record + HEADER_SIZE, length);
+    return true;
+  }
+
+  bool append(uint8_t group, const void* data, uint8_t length) {
+    if (group >= MAX_GROUPS || length > MAX_PAYLOAD) return false;
+
+    if (next_slot >= slotsPerSector()) {
+      rotate();
+    }
+    writeRecord(group, static_cast<const uint8_t*>(data), length);
+    return true;
+  }
+
+  // Stops carrying a group into new sectors. Its records stay readable
+  // after a remount until their sectors are erased.
+  void forget(uint8_t group) {
+    if (group < MAX_GROUPS) latest[group] = NO_RECORD;
+  }
+
+  uint32_t erases() const { return erase_count; }
+  uint32_t lastSequence() const { return sequence; }
+};
+
+#endif
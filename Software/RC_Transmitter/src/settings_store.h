@@ -0,0 +1,186 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include "config.h"
+#include "hal.h"
+#include "settings_journal.h"
+
+const char* const SETTINGS_PARTITION = "settings";
+const uint8_t SETTINGS_SCHEMA_VERSION = 1;
+
+// Field groups, each journaled as its own record. Throttle, trim, filters
+// and mixes were shared by every receiver before model memory; they are
+// only read to seed models that are not on flash yet.
+enum SettingsGroup {
+  SETTINGS_GROUP_RECEIVER,
+  SETTINGS_GROUP_THROTTLE,
+  SETTINGS_GROUP_TRIM,
+  SETTINGS_GROUP_CALIBRATION,
+  SETTINGS_GROUP_FLEET,
+  SETTINGS_GROUP_FILTERS,
+  SETTINGS_GROUP_MIXES,
+  SETTINGS_GROUP_MODEL,       // First of MAX_RECEIVERS, one per receiver
+  SETTINGS_GROUP_COUNT = SETTINGS_GROUP_MODEL + MAX_RECEIVERS
+};
+
+const uint16_t SETTINGS_LEGACY_GROUPS = (1 << SETTINGS_GROUP_THROTTLE) | (1 << SETTINGS_GROUP_TRIM) |
+                                        (1 << SETTINGS_GROUP_FILTERS) | (1 << SETTINGS_GROUP_MIXES);
+const uint16_t SETTINGS_LIVE_GROUPS = ((1 << SETTINGS_GROUP_COUNT) - 1) & ~SETTINGS_LEGACY_GROUPS;
+
+// Persists SystemSettings as journaled field groups. Only groups whose
+// value differs from what is already on flash are written, and
+// saveWhenSettled() waits until a change has held for one call before
+// writing, so bursts of menu edits collapse into a single record.
+// Switching receivers rewrites only the receiver group.
+class SettingsStore {
+private:
+  FlashStorage flash;
+  SettingsJournal<FlashStorage> journal;
+  SystemSettings persisted;
+  SystemSettings pending;
+  uint16_t missing_groups;    // Groups not on flash yet
+  bool mounted;
+
+  static uint16_t changedGroups(const SystemSettings& a, const SystemSettings& b) {
+    uint16_t changed = 0;
+    if (a.current_receiver != b.current_receiver) changed |= 1 << SETTINGS_GROUP_RECEIVER;
+    if (memcmp(&a.calibration, &b.calibration, sizeof(a.calibration)) != 0) changed |= 1 << SETTINGS_GROUP_CALIBRATION;
+    if (memcmp(&a.fleet, &b.fleet, sizeof(a.fleet)) != 0) changed |= 1 << SETTINGS_GROUP_FLEET;
+    for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+      if (memcmp(&a.models[i], &b.models[i], sizeof(a.models[i])) != 0) changed |= 1 << (SETTINGS_GROUP_MODEL + i);
+    }
+    return changed;
+  }
+
+  void appendGroup(uint8_t group, const SystemSettings& settings) {
+    switch (group) {
+      case SETTINGS_GROUP_RECEIVER:
+        journal.append(group, &settings.current_receiver, sizeof(settings.current_receiver));
+        break;
+      case SETTINGS_GROUP_CALIBRATION:
+        journal.append(group, &settings.calibration, sizeof(settings.calibration));
+        break;
+      case SETTINGS_GROUP_FLEET:
+        journal.append(group, &settings.fleet, sizeof(settings.fleet));
+        break;
+      default: {
+        const ModelProfile& model = settings.models[group - SETTINGS_GROUP_MODEL];
+        journal.append(group, &model, sizeof(model));
+        break;
+      }
+    }
+  }
+
+  // Fills models missing from flash from the shared groups of older
+  // firmware, where present, on top of their defaults. Returns the number
+  // of shared groups found.
+  uint8_t migrateModels(SystemSettings& settings) {
+    uint8_t bidirectional;
+    TrimSettings trim;
+    ChannelFilter filters[ANALOG_CHANNEL_COUNT];
+    uint8_t mixes[MAX_RECEIVERS];
+    bool has_throttle = journal.read(SETTINGS_GROUP_THROTTLE, &bidirectional, sizeof(bidirectional));
+    bool has_trim = journal.read(SETTINGS_GROUP_TRIM, &trim, sizeof(trim));
+    bool has_filters = journal.read(SETTINGS_GROUP_FILTERS, filters, sizeof(filters));
+    bool has_mixes = journal.read(SETTINGS_GROUP_MIXES, mixes, sizeof(mixes));
+
+    for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+      if (!(missing_groups & (1 << (SETTINGS_GROUP_MODEL + i)))) continue;
+      ModelProfile& model = settings.models[i];
+      if (has_throttle) model.throttle_bidirectional = bidirectional != 0;
+      if (has_trim) model.trim = trim;
+      if (has_filters) memcpy(model.filters, filters, sizeof(filters));
+      if (has_mixes) model.mix = mixes[i];
+    }
+    return has_throttle + has_trim + has_filters + has_mixes;
+  }
+
+public:
+  SettingsStore() : journal(flash, SETTINGS_SCHEMA_VERSION), persisted(), pending(),
+                    missing_groups(SETTINGS_LIVE_GROUPS), mounted(false) {}
+
+  bool begin() {
+    if (!flash.begin(SETTINGS_PARTITION)) {
+      return false;
+    }
+    journal.mount();
+    mounted = true;
+    return true;
+  }
+
+  // Overlays every stored group onto settings, returns the number found.
+  // Groups missing from flash are written on the next commit.
+  uint8_t load(SystemSettings& settings) {
+    missing_groups = SETTINGS_LIVE_GROUPS;
+    uint8_t found = 0;
+
+    if (mounted) {
+      uint8_t receiver;
+      if (journal.read(SETTINGS_GROUP_RECEIVER, &receiver, sizeof(receiver)) && receiver < MAX_RECEIVERS) {
+        settings.current_receiver = receiver;
+        missing_groups &= ~(1 << SETTINGS_GROUP_RECEIVER);
+      }
+      if (journal.read(SETTINGS_GROUP_CALIBRATION, &settings.calibration, sizeof(settings.calibration))) {
+        missing_groups &= ~(1 << SETTINGS_GROUP_CALIBRATION);
+      }
+      if (journal.read(SETTINGS_GROUP_FLEET, &settings.fleet, sizeof(settings.fleet))) {
+        missing_groups &= ~(1 << SETTINGS_GROUP_FLEET);
+      }
+      for (uint8_t i = 0; i < MAX_RECEIVERS; i++) {
+        uint8_t group = SETTINGS_GROUP_MODEL + i;
+        if (journal.read(group, &settings.models[i], sizeof(settings.models[i]))) {
+          missing_groups &= ~(1 << group);
+        }
+      }
+      found = migrateModels(settings);
+    }
+
+    persisted = settings;
+    pending = settings;
+
+    for (uint8_t group = 0; group < SETTINGS_GROUP_COUNT; group++) {
+      if ((SETTINGS_LIVE_GROUPS & (1 << group)) && !(missing_groups & (1 << group))) found++;
+    }
+    return found;
+  }
+
+  // Writes every group that differs from flash, returns the number written
+  uint8_t commit(const SystemSettings& settings) {
+    if (!mounted) return 0;
+
+    uint16_t changed = changedGroups(settings, persisted) | missing_groups;
+
+    uint8_t written = 0;
+    for (uint8_t group = 0; group < SETTINGS_GROUP_COUNT; group++) {
+      if (changed & (1 << group)) {
+        appendGroup(group, settings);
+        written++;
+      }
+    }
+    // Every model is on flash now, the shared groups have served their turn
+    for (uint8_t group = 0; group < SETTINGS_GROUP_COUNT; group++) {
+      if (SETTINGS_LEGACY_GROUPS & (1 << group)) journal.forget(group);
+    }
+    persisted = settings;
+    pending = settings;
+    missing_groups = 0;
+    return written;
+  }
+
+  // Commits only once the settings have stopped changing between calls
+  uint8_t saveWhenSettled(const SystemSettings& settings) {
+    if (changedGroups(settings, pending) != 0) {
+      pending = settings;
+      return 0;
+    }
+    if ((changedGroups(settings, persisted) | missing_groups) == 0) {
+      return 0;
+    }
+    return commit(settings);
+  }
+
+  uint32_t erases() const { return journal.erases(); }
+  uint32_t records() const { return journal.lastSequence(); }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free single-producer / single-consumer ring holding up to N - 1
+// values, N a power of two. Either side may run in an interrupt. A push
+// onto a full ring is dropped and counted rather than waiting.
+template <typename T, uint8_t N>
+class SpscQueue {
+private:
+  static const uint8_t MASK = N - 1;
+
+  T items[N];
+  std::atomic<uint8_t> head;      // Next slot to fill, advanced by the producer
+  std::atomic<uint8_t> tail;      // Next slot to take, advanced by the consumer
+  uint32_t dropped_count;         // Producer side
+
+public:
+  SpscQueue() : items(), head(0), tail(0), dropped_count(0) {}
+
+  bool push(const T& value) {
+    uint8_t at = head.load(std::memory_order_relaxed);
+    uint8_t next = (at + 1) & MASK;
+    if (next == tail.load(std::memory_order_acquire)) {
+      dropped_count++;
+      return false;
+    }
+    items[at] = value;
+    head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& out) {
+    uint8_t at = tail.load(std::memory_order_relaxed);
+    if (at == head.load(std::memory_order_acquire)) return false;
+    out = items[at];
+    tail.store((at + 1) & MASK, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+  }
+
+  uint32_t dropped() const { return dropped_count; }
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef TASK_LAYOUT_H
+#define TASK_LAYOUT_H
+
+#include <stdint.h>
+
+// Core and FreeRTOS priority of every task. The ESP32 runtime creates its
+// tasks from these and the simulator's Runtime schedules its steps by
+// them, so moving a task shows up in the timing tests.
+const int8_t TASK_NO_AFFINITY = -1;          // Either core, as tskNO_AFFINITY
+const int8_t CONTROL_TASK_CORE = 1;          // The app core, alone
+const int8_t UI_TASK_CORE = 0;               // Input, IMU and settings too
+const uint8_t CONTROL_TASK_PRIORITY = 23;    // configMAX_PRIORITIES - 2
+const uint8_t IMU_TASK_PRIORITY = 4;         // First on the bus as well
+const uint8_t INPUT_TASK_PRIORITY = 3;       // Above the UI, for the bus
+const uint8_t UI_TASK_PRIORITY = 2;
+const uint8_t SETTINGS_TASK_PRIORITY = 1;
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef TDMA_SCHEDULER_H
+#define TDMA_SCHEDULER_H
+
+#include "config.h"
+#include "async_radio.h"
+
+// One transmit slot of the precomputed schedule
+struct TdmaSlot {
+  uint8_t receiver;         // TdmaScheduler::IDLE for an empty slot
+  uint8_t channel;
+  bool hopping;             // Channel comes from the hop sequence instead
+  bool switch_address;      // Pipe differs from the previous busy slot
+  bool switch_channel;      // RF channel may differ from the previous busy slot
+};
+
+// Frames per second sent and acknowledged over the last rate window
+struct ReceiverRate {
+  uint16_t sent_hz;
+  uint16_t acked_hz;
+};
+
+// Time-division schedule for driving several receivers from one radio.
+//
+// The control step runs on a fixed slot clock and each slot carries one
+// frame to one receiver. A cycle of SLOT_COUNT slots is built once from the
+// requested rates: receivers are placed in priority order, each spread
+// evenly over the cycle, and lower priorities lose slots when the cycle is
+// full. Address and channel changes are worked out at build time, so the
+// slot step only touches the radio registers that actually change; slots
+// on or after a hopping receiver always retune.
+class TdmaScheduler {
+public:
+  static const uint8_t SLOT_COUNT = 40;
+  static const uint8_t IDLE = 0xFF;
+  static const uint8_t RATE_WINDOW_CYCLES = 5;
+
+private:
+  TdmaSlot slots[SLOT_COUNT];
+  uint8_t granted[MAX_RECEIVERS];
+  uint32_t slot_rate_hz;
+  uint8_t position;
+  bool resync;
+
+  // Rate measurement
+  uint8_t window_cycles;
+  uint32_t window_start_us;
+  uint32_t window_sent[MAX_RECEIVERS];
+  uint32_t window_acked[MAX_RECEIVERS];
+  ReceiverRate rates[MAX_RECEIVERS];
+
+  uint8_t nearestFree(uint8_t ideal) const {
+    for (uint8_t step = 0; step < SLOT_COUNT; step++) {
+      uint8_t index = (ideal + step) % SLOT_COUNT;
+      if (slots[index].receiver == IDLE) return index;
+    }
+    return IDLE;
+  }
+
+  // Marks where the pipe or channel changes, wrapping around the cycle
+  void markSwitches() {
+    int16_t previous = -1;
+    for (int16_t i = SLOT_COUNT - 1; i >= 0 && previous < 0; i--) {
+      if (slots[i].receiver != IDLE) previous = i;
+    }
+    if (previous < 0) return;
+
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+      if (slots[i].receiver == IDLE) continue;
+      slots[i].switch_address = slots[i].receiver != slots[previous].receiver;
+      slots[i].switch_channel = slots[i].hopping || slots[previous].hopping ||
+                                slots[i].channel != slots[previous].channel;
+      previous = i;
+    }
+  }
+
+public:
+  explicit TdmaScheduler(uint32_t slot_rate)
+    : slot_rate_hz(slot_rate), position(0), resync(true), window_cycles(0), window_start_us(0) {
+    memset(granted, 0, sizeof(granted));
+    memset(window_sent, 0, sizeof(window_sent));
+    memset(window_acked, 0, sizeof(window_acked));
+    memset(rates, 0, sizeof(rates));
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+      slots[i].receiver = IDLE;
+    }
+  }
+
+  // Rebuilds the cycle from the enabled links, returns the slots in use
+  uint8_t build(const ReceiverLink* links) {
+    TdmaSlot empty = { IDLE, 0, false, false, false };
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+      slots[i] = empty;
+    }
+
+    // Receivers by descending priority, ties by id
+    uint8_t order[MAX_RECEIVERS];
+    uint8_t members = 0;
+    for (uint8_t id = 0; id < MAX_RECEIVERS; id++) {
+      granted[id] = 0;
+      if (!links[id].enabled || links[id].rate_hz == 0) continue;
+
+      uint8_t at = members++;
+      while (at > 0 && links[order[at - 1]].priority < links[id].priority) {
+        order[at] = order[at - 1];
+        at--;
+      }
+      order[at] = id;
+    }
+
+    uint8_t free_slots = SLOT_COUNT;
+    for (uint8_t m = 0; m < members && free_slots > 0; m++) {
+      uint8_t id = order[m];
+      uint32_t wanted = ((uint32_t)links[id].rate_hz * SLOT_COUNT + slot_rate_hz / 2) / slot_rate_hz;
+      if (wanted == 0) wanted = 1;
+      if (wanted > free_slots) wanted = free_slots;
+      granted[id] = wanted;
+      free_slots -= wanted;
+
+      // Spread evenly, starting at the first free slot to stagger receivers
+      uint8_t offset = nearestFree(0);
+      for (uint8_t k = 0; k < wanted; k++) {
+        uint8_t index = nearestFree((offset + (uint16_t)k * SLOT_COUNT / wanted) % SLOT_COUNT);
+        slots[index].receiver = id;
+        slots[index].channel = links[id].channel;
+        slots[index].hopping = links[id].hopping != 0;
+      }
+    }
+
+    markSwitches();
+    position = 0;
+    resync = true;
+    return SLOT_COUNT - free_slots;
+  }
+
+  // Advances to the next slot. The first busy slot after a rebuild always
+  // reprograms the radio, since its state is unknown at that point.
+  TdmaSlot next() {
+    TdmaSlot slot = slots[position];
+    position = (position + 1) % SLOT_COUNT;
+    if (position == 0 && window_cycles < RATE_WINDOW_CYCLES) window_cycles++;
+
+    if (slot.receiver != IDLE) {
+      window_sent[slot.receiver]++;
+      if (resync) {
+        slot.switch_address = true;
+        slot.switch_channel = true;
+        resync = false;
+      }
+    }
+    return slot;
+  }
+
+  // Closes the rate window every few cycles using the radio's ACK counters
+  void updateRates(uint32_t now_us, const AsyncRadio& radio) {
+    if (window_cycles < RATE_WINDOW_CYCLES) return;
+
+    uint32_t elapsed_us = now_us - window_start_us;
+    for (uint8_t id = 0; id < MAX_RECEIVERS; id++) {
+      uint32_t acked = radio.linkStats(id).acked;
+      if (window_start_us != 0 && elapsed_us > 0) {
+        rates[id].sent_hz = (uint16_t)(((uint64_t)window_sent[id] * 1000000 + elapsed_us / 2) / elapsed_us);
+        rates[id].acked_hz = (uint16_t)(((uint64_t)(acked - window_acked[id]) * 1000000 + elapsed_us / 2) / elapsed_us);
+      }
+      window_acked[id] = acked;
+      window_sent[id] = 0;
+    }
+    window_start_us = now_us;
+    window_cycles = 0;
+  }
+
+  const TdmaSlot& slot(uint8_t index) const { return slots[index]; }
+  uint8_t grantedSlots(uint8_t receiver_id) const { return granted[receiver_id]; }
+  const ReceiverRate& rate(uint8_t receiver_id) const { return rates[receiver_id]; }
+
+  // Rate the schedule gives a receiver, in frames per second
+  uint16_t grantedRate(uint8_t receiver_id) const {
+    return (uint16_t)((uint32_t)granted[receiver_id] * slot_rate_hz / SLOT_COUNT);
+  }
+};
+
+#endif
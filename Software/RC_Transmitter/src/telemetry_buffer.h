@@ -0,0 +1,69 @@
+#ifndef TELEMETRY_BUFFER_H
+#define TELEMETRY_BUFFER_H
+
+#include <atomic>
+#include <telemetry_codec.h>
+
+#include "config.h"
+
+// Single-producer ring of telemetry samples. The control task appends;
+// the UI and the serial logger read entries in place through at().
+// The slot after the newest sample is the only one being written, so an
+// entry up to CAPACITY - 2 samples old stays intact while it is read.
+template <uint8_t CAPACITY>
+class TelemetryRing {
+private:
+  TelemetrySample samples[CAPACITY];
+  std::atomic<uint32_t> written;
+
+public:
+  TelemetryRing() : samples(), written(0) {}
+
+  // Producer side
+  void push(const TelemetrySample& sample) {
+    uint32_t count = written.load(std::memory_order_relaxed);
+    samples[count % CAPACITY] = sample;
+    written.store(count + 1, std::memory_order_release);
+  }
+
+  // Samples that can be read, newest first
+  uint8_t available() const {
+    uint32_t count = written.load(std::memory_order_acquire);
+    return count < CAPACITY - 1 ? count : CAPACITY - 1;
+  }
+
+  // age 0 is the newest sample; age must be below available()
+  const TelemetrySample& at(uint8_t age) const {
+    uint32_t count = written.load(std::memory_order_acquire);
+    return samples[(count - 1 - age) % CAPACITY];
+  }
+
+  uint32_t total() const { return written.load(std::memory_order_acquire); }
+};
+
+const uint8_t TELEMETRY_HISTORY = 16;
+
+// Telemetry history for every receiver
+class TelemetryStore {
+private:
+  TelemetryRing<TELEMETRY_HISTORY> rings[MAX_RECEIVERS];
+
+public:
+  void push(uint8_t receiver_id, const TelemetrySample& sample) {
+    rings[receiver_id].push(sample);
+  }
+
+  const TelemetryRing<TELEMETRY_HISTORY>& receiver(uint8_t receiver_id) const {
+    return rings[receiver_id];
+  }
+
+  // Newest sample of a receiver, NULL if none arrived within max_age_ms
+  const TelemetrySample* latest(uint8_t receiver_id, uint32_t now_ms, uint32_t max_age_ms) const {
+    const TelemetryRing<TELEMETRY_HISTORY>& ring = rings[receiver_id];
+    if (ring.available() == 0) return NULL;
+    const TelemetrySample& sample = ring.at(0);
+    return now_ms - sample.timestamp <= max_age_ms ? &sample : NULL;
+  }
+};
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef TRIM_BUTTONS_H
+#define TRIM_BUTTONS_H
+
+#include <atomic>
+#include <stdint.h>
+#include "config.h"
+#include "spsc_queue.h"
+
+// Trim buttons on expander pins P0..P5, pulled up and low while pressed
+enum TrimButton {
+  TRIM_PITCH_UP, TRIM_PITCH_DOWN, TRIM_ROLL_UP, TRIM_ROLL_DOWN, TRIM_YAW_UP, TRIM_YAW_DOWN
+};
+const uint8_t TRIM_BUTTON_COUNT = 6;
+
+// Trimmed axes, in the order of the button pairs
+enum TrimAxis { TRIM_AXIS_PITCH, TRIM_AXIS_ROLL, TRIM_AXIS_YAW };
+const uint8_t TRIM_AXIS_COUNT = 3;
+
+// Same step and limit as the trim menu
+const int16_t TRIM_STEP = 4;
+const int16_t TRIM_LIMIT = 100;
+
+enum TrimEventType { TRIM_PRESS, TRIM_REPEAT, TRIM_RELEASE };
+
+struct TrimEvent {
+  uint8_t button;
+  uint8_t type;
+};
+
+typedef SpscQueue<TrimEvent, 16> TrimEventQueue;
+
+// Steps one axis up or down by TRIM_STEP, within TRIM_LIMIT
+inline void stepTrim(TrimSettings& trim, uint8_t axis, bool up) {
+  int16_t* value;
+  switch (axis) {
+    case TRIM_AXIS_PITCH: value = &trim.pitch_trim; break;
+    case TRIM_AXIS_ROLL: value = &trim.roll_trim; break;
+    default: value = &trim.yaw_trim; break;
+  }
+  *value = constrain(*value + (up ? TRIM_STEP : -TRIM_STEP), -TRIM_LIMIT, TRIM_LIMIT);
+}
+
+// Steps the trim a button acts on, the even button of a pair raising it
+inline void stepTrim(TrimSettings& trim, uint8_t button) {
+  stepTrim(trim, button / 2, button % 2 == 0);
+}
+
+// Turns the pin levels seen at each expander read into press, repeat and
+// release events. A level has to hold for DEBOUNCE_MS before it counts,
+// so bounce on either edge collapses into one event. A held button
+// repeats after REPEAT_DELAY_MS, then every REPEAT_INTERVAL_MS. Levels
+// only arrive with reads; tick() runs the timers in between.
+class TrimDebouncer {
+public:
+  static const uint32_t DEBOUNCE_MS = 20;
+  static const uint32_t REPEAT_DELAY_MS = 400;
+  static const uint32_t REPEAT_INTERVAL_MS = 100;
+
+private:
+  enum State { RELEASED, PRESSING, HELD, RELEASING };
+
+  struct Button {
+    uint8_t state;
+    uint32_t edge_ms;       // Last edge while PRESSING or RELEASING
+    uint32_t repeat_ms;     // Next repeat while HELD
+  };
+
+  TrimEventQueue& queue;
+  Button buttons[TRIM_BUTTON_COUNT];
+  uint8_t settling;         // Buttons not RELEASED
+  uint32_t event_count;
+
+  void emit(uint8_t button, uint8_t type) {
+    TrimEvent event = { button, type };
+    queue.push(event);
+    event_count++;
+  }
+
+public:
+  explicit TrimDebouncer(TrimEventQueue& events) : queue(events), settling(0), event_count(0) {
+    for (uint8_t i = 0; i < TRIM_BUTTON_COUNT; i++) {
+      buttons[i].state = RELEASED;
+      buttons[i].edge_ms = 0;
+      buttons[i].repeat_ms = 0;
+    }
+  }
+
+  void update(uint16_t levels, uint32_t now_ms) {
+    for (uint8_t i = 0; i < TRIM_BUTTON_COUNT; i++) {
+      Button& button = buttons[i];
+      bool pressed = !((levels >> i) & 1);
+      switch (button.state) {
+        case RELEASED:
+          if (pressed) {
+            button.state = PRESSING;
+            button.edge_ms = now_ms;
+            settling++;
+          }
+          break;
+        case PRESSING:
+          if (!pressed) {
+            button.state = RELEASED;
+            settling--;
+          }
+          break;
+        case HELD:
+          if (!pressed) {
+            button.state = RELEASING;
+            button.edge_ms = now_ms;
+          }
+          break;
+        case RELEASING:
+          if (pressed) button.state = HELD;
+          break;
+      }
+    }
+  }
+
+  void tick(uint32_t now_ms) {
+    if (settling == 0) return;
+
+    for (uint8_t i = 0; i < TRIM_BUTTON_COUNT; i++) {
+      Button& button = buttons[i];
+      switch (button.state) {
+        case PRESSING:
+          if (now_ms - button.edge_ms >= DEBOUNCE_MS) {
+            button.state = HELD;
+            button.repeat_ms = now_ms + REPEAT_DELAY_MS;
+            emit(i, TRIM_PRESS);
+          }
+          break;
+        case HELD:
+          if ((int32_t)(now_ms - button.repeat_ms) >= 0) {
+            emit(i, TRIM_REPEAT);
+            // A late tick skips repeats rather than bursting to catch up
+            button.repeat_ms += REPEAT_INTERVAL_MS;
+            if ((int32_t)(now_ms - button.repeat_ms) >= 0) button.repeat_ms = now_ms + REPEAT_INTERVAL_MS;
+          }
+          break;
+        case RELEASING:
+          if (now_ms - button.edge_ms >= DEBOUNCE_MS) {
+            button.state = RELEASED;
+            settling--;
+            emit(i, TRIM_RELEASE);
+          }
+          break;
+      }
+    }
+  }
+
+  bool idle() const { return settling == 0; }
+  uint32_t events() const { return event_count; }
+};
+
+// Reads the trim buttons only when the expander's INT line reports a
+// change, one transaction per change and none while the buttons rest.
+// notify() is all the interrupt handler does; service() runs in the task
+// that owns the I2C bus. Expander must provide readAll(), which returns
+// all 16 pins and releases INT.
+template <class Expander>
+class TrimButtonReader {
+private:
+  Expander& expander;
+  TrimDebouncer debouncer;
+  std::atomic<bool> changed;
+  uint32_t read_count;
+
+public:
+  // The first service() reads once to learn the resting levels
+  TrimButtonReader(Expander& io, TrimEventQueue& queue)
+    : expander(io), debouncer(queue), changed(true), read_count(0) {}
+
+  void notify() { changed.store(true, std::memory_order_release); }
+
+  void service(uint32_t now_ms) {
+    // Cleared before the read, so a change during it raises INT again
+    if (changed.exchange(false, std::memory_order_acq_rel)) {
+      debouncer.update(expander.readAll(), now_ms);
+      read_count++;
+    }
+    debouncer.tick(now_ms);
+  }
+
+  // A change is waiting to be read or a debounce or repeat timer runs
+  bool busy() const { return changed.load(std::memory_order_acquire) || !debouncer.idle(); }
+
+  uint32_t reads() const { return read_count; }
+  uint32_t events() const { return debouncer.events(); }
+};
+
+#endif
@@ -1,109 +1,189 @@
 #ifndef UI_CONTROLLER_H
 #define UI_CONTROLLER_H
 
-#include <Wire.h>
-#include <Adafruit_GFX.h>
-#include <Adafruit_SSD1306.h>
 #include "config.h"
+#include "hal.h"
+#include "button_events.h"
+#include "interval_histogram.h"
+#include "framebuffer_diff.h"
+#include "loop_profiler.h"
+#include "telemetry_buffer.h"
+#include "trim_buttons.h"
 
-#define SCREEN_WIDTH 128
-#define SCREEN_HEIGHT 64
-#define OLED_RESET -1
+#define UI_MAX_REFRESH_HZ 25
+#define UI_TELEMETRY_STALE_MS 1000
+
+// Main menu entries, in the order of the submenus they open
+constexpr const char* MAIN_MENU_ITEMS[] = {
+  "Receiver Select",
+  "Throttle Mode",
+  "Trim Settings",
+  "Calibration",
+  "Input Monitor",
+  "System Info",
+  "Save & Exit"
+};
+const uint8_t MAIN_MENU_COUNT = sizeof(MAIN_MENU_ITEMS) / sizeof(MAIN_MENU_ITEMS[0]);
 
 class UIController {
 private:
-  Adafruit_SSD1306 display;
+  DisplayDriver display;
   SystemSettings* settings;
+  ChannelData channel_data;
+  const IntervalHistogram* frame_stats;
+#ifdef LOOP_PROFILER
+  const LoopProfiler* profiler;
+#endif
+  const TelemetryStore* telemetry;
   
   // Menu state
   uint8_t current_menu;
   uint8_t menu_item;
   bool in_submenu;
   uint8_t submenu_level;
+  uint8_t trim_axis;        // Axis Up and Down step on the Trim screen
   
   // UI animation
   unsigned long last_animation;
   uint8_t animation_frame;
   
-  // Button states
-  bool btn_up_prev, btn_down_prev, btn_select_prev;
-  unsigned long last_button_press;
+  // Incremental rendering
+  FramebufferDiff<SCREEN_WIDTH, SCREEN_HEIGHT> frame_diff;
+  bool needs_redraw;
+  unsigned long last_render;
+  unsigned long min_render_interval;
+  
+  // Trim and throttle mode belong to the selected receiver's model
+  ModelProfile& model() { return activeModel(*settings); }
   
 public:
-  UIController(SystemSettings* settings_ptr) : display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET), settings(settings_ptr) {
+  UIController(SystemSettings* settings_ptr) : settings(settings_ptr), channel_data(), frame_stats(NULL), telemetry(NULL) {
     current_menu = 0;
     menu_item = 0;
     in_submenu = false;
     submenu_level = 0;
+    trim_axis = TRIM_AXIS_PITCH;
     animation_frame = 0;
     last_animation = 0;
-    last_button_press = 0;
+    needs_redraw = true;
+    last_render = 0;
+    min_render_interval = 1000 / UI_MAX_REFRESH_HZ;
+#ifdef LOOP_PROFILER
+    profiler = NULL;
+#endif
   }
   
   bool begin() {
-    if(!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
+    if(!display.begin()) {
       return false;
     }
     display.clearDisplay();
     display.setTextColor(SSD1306_WHITE);
     display.setTextSize(1);
+    frame_diff.invalidate();
+    needs_redraw = true;
     return true;
   }
   
-  void update(bool btn_up, bool btn_down, bool btn_select) {
-    handleInput(btn_up, btn_down, btn_select);
+  // Applies one debounced menu button event. Up and down also step on
+  // LONG_PRESS and REPEAT, so holding them scrolls; select only acts on
+  // the press itself.
+  void handleEvent(const ButtonEvent& event) {
+    if (event.type == BUTTON_RELEASE) return;
+    bool repeated = event.type != BUTTON_PRESS;
+    
+    switch (event.button) {
+      case BUTTON_UP:
+        if (in_submenu) {
+          handleSubmenuUp(repeated);
+        } else {
+          menu_item = (menu_item > 0) ? menu_item - 1 : MAIN_MENU_COUNT - 1;
+        }
+        break;
+      case BUTTON_DOWN:
+        if (in_submenu) {
+          handleSubmenuDown(repeated);
+        } else {
+          menu_item = (menu_item < MAIN_MENU_COUNT - 1) ? menu_item + 1 : 0;
+        }
+        break;
+      case BUTTON_SELECT:
+        if (repeated) return;
+        if (in_submenu) {
+          handleSubmenuSelect();
+        } else {
+          enterSubmenu();
+        }
+        break;
+    }
+    needs_redraw = true;
+  }
+  
+  void update() {
     render();
   }
   
-private:
-  void handleInput(bool btn_up, bool btn_down, bool btn_select) {
-    unsigned long current_time = millis();
-    
-    // Debounce
-    if (current_time - last_button_press < 200) return;
-    
-    if (btn_up && !btn_up_prev) {
-      last_button_press = current_time;
-      if (in_submenu) {
-        handleSubmenuUp();
-      } else {
-        menu_item = (menu_item > 0) ? menu_item - 1 : 6;
-      }
-    }
-    
-    if (btn_down && !btn_down_prev) {
-      last_button_press = current_time;
-      if (in_submenu) {
-        handleSubmenuDown();
-      } else {
-        menu_item = (menu_item < 6) ? menu_item + 1 : 0;
-      }
-    }
-    
-    if (btn_select && !btn_select_prev) {
-      last_button_press = current_time;
-      if (in_submenu) {
-        handleSubmenuSelect();
-      } else {
-        enterSubmenu();
-      }
-    }
-    
-    btn_up_prev = btn_up;
-    btn_down_prev = btn_down;
-    btn_select_prev = btn_select;
+  // The trim buttons stepped the model's trim, which the Trim screen shows
+  void trimChanged() {
+    needs_redraw = true;
+  }
+  
+  // Milliseconds until the screen has to be drawn again; with no input
+  // pending on a static screen there is no deadline
+  uint32_t msUntilRedraw() const {
+    if (!needs_redraw && !isLiveScreen()) return Runtime::NO_DEADLINE;
+    unsigned long elapsed = millis() - last_render;
+    return elapsed >= min_render_interval ? 0 : min_render_interval - elapsed;
+  }
+  
+  // Display traffic goes through the shared I2C bus
+  void setBus(SharedBus* bus) {
+    display.setBus(bus);
+  }
+  
+  // Latest transmitted frame, used by the input monitor
+  void setChannelData(const ChannelData& data) {
+    channel_data = data;
+  }
+  
+  // Caps how often the screen is redrawn and flushed
+  void setMaxRefreshRate(uint8_t hz) {
+    min_render_interval = hz > 0 ? 1000 / hz : 0;
+  }
+  
+  // Bytes pushed over I2C by all flushes so far
+  uint32_t busBytes() const {
+    return display.busBytes();
+  }
+  
+  // Frame interval histogram shown on the system info screen
+  void setFrameStats(const IntervalHistogram* stats) {
+    frame_stats = stats;
   }
   
-  void handleSubmenuUp() {
+#ifdef LOOP_PROFILER
+  // Per-phase timing shown on the system info screen
+  void setProfiler(const LoopProfiler* loop_profiler) {
+    profiler = loop_profiler;
+  }
+#endif
+  
+  // Receiver telemetry shown on the system info screen
+  void setTelemetry(const TelemetryStore* store) {
+    telemetry = store;
+  }
+  
+private:
+  void handleSubmenuUp(bool repeated) {
     switch(current_menu) {
       case 0: // Receiver Selection
         settings->current_receiver = (settings->current_receiver > 0) ? settings->current_receiver - 1 : MAX_RECEIVERS - 1;
         break;
       case 1: // Throttle Mode
-        settings->throttle_bidirectional = !settings->throttle_bidirectional;
+        if (!repeated) model().throttle_bidirectional = !model().throttle_bidirectional;
         break;
       case 2: // Trim Settings
-        adjustTrim();
+        stepTrim(model().trim, trim_axis, true);
         break;
       case 3: // Calibration
         handleCalibrationUp();
@@ -117,16 +197,16 @@ private:
     }
   }
   
-  void handleSubmenuDown() {
+  void handleSubmenuDown(bool repeated) {
     switch(current_menu) {
       case 0: // Receiver Selection
         settings->current_receiver = (settings->current_receiver < MAX_RECEIVERS - 1) ? settings->current_receiver + 1 : 0;
         break;
       case 1: // Throttle Mode
-        settings->throttle_bidirectional = !settings->throttle_bidirectional;
+        if (!repeated) model().throttle_bidirectional = !model().throttle_bidirectional;
         break;
       case 2: // Trim Settings
-        adjustTrim();
+        stepTrim(model().trim, trim_axis, false);
         break;
       case 3: // Calibration
         handleCalibrationDown();
@@ -147,6 +227,9 @@ private:
       if (submenu_level == 0) {
         in_submenu = false;
       }
+    } else if (current_menu == 2 && trim_axis < TRIM_AXIS_COUNT - 1) {
+      // On to the next axis, the last one leaves the screen
+      trim_axis++;
     } else {
       in_submenu = false;
     }
@@ -156,28 +239,13 @@ private:
     current_menu = menu_item;
     in_submenu = true;
     submenu_level = 0;
+    trim_axis = TRIM_AXIS_PITCH;
     
     if (current_menu == 3) {
       submenu_level = 1; // Enter calibration menu
     }
   }
   
-  void adjustTrim() {
-    switch(menu_item) {
-      case 0: settings->trim.pitch_trim += 4; break;
-      case 1: settings->trim.pitch_trim -= 4; break;
-      case 2: settings->trim.roll_trim += 4; break;
-      case 3: settings->trim.roll_trim -= 4; break;
-      case 4: settings->trim.yaw_trim += 4; break;
-      case 5: settings->trim.yaw_trim -= 4; break;
-    }
-    
-    // Limit trim values
-    settings->trim.pitch_trim = constrain(settings->trim.pitch_trim, -100, 100);
-    settings->trim.roll_trim = constrain(settings->trim.roll_trim, -100, 100);
-    settings->trim.yaw_trim = constrain(settings->trim.yaw_trim, -100, 100);
-  }
-  
   void handleCalibrationUp() {
     // Implementation for calibration up
   }
@@ -186,7 +254,16 @@ private:
     // Implementation for calibration down
   }
   
+  // Screens showing live data are refreshed even without input
+  bool isLiveScreen() const {
+    return in_submenu && (current_menu == 4 || current_menu == 5);
+  }
+  
   void render() {
+    unsigned long current_time = millis();
+    if (current_time - last_render < min_render_interval) return;
+    if (!needs_redraw && !isLiveScreen()) return;
+    
     display.clearDisplay();
     
     if (in_submenu) {
@@ -195,7 +272,21 @@ private:
       renderMainMenu();
     }
     
-    display.display();
+    flushDirtyPages();
+    needs_redraw = false;
+    last_render = current_time;
+  }
+  
+  // Sends only the changed column window of each page
+  void flushDirtyPages() {
+    const uint8_t* buffer = display.getBuffer();
+    
+    for (uint8_t page = 0; page < frame_diff.PAGE_COUNT; page++) {
+      uint8_t first, last;
+      if (!frame_diff.takeDirtyRange(buffer, page, first, last)) continue;
+      
+      display.sendWindow(page, first, last, buffer + page * SCREEN_WIDTH + first);
+    }
   }
   
   void renderMainMenu() {
@@ -203,23 +294,13 @@ private:
     display.println("MAIN MENU");
     display.drawLine(0, 10, 128, 10, SSD1306_WHITE);
     
-    const char* menu_items[] = {
-      "Receiver Select",
-      "Throttle Mode",
-      "Trim Settings",
-      "Calibration",
-      "Input Monitor",
-      "System Info",
-      "Save & Exit"
-    };
-    
-    for (int i = 0; i < 7; i++) {
+    for (int i = 0; i < MAIN_MENU_COUNT; i++) {
       if (i == menu_item) {
         display.print("> ");
       } else {
         display.print("  ");
       }
-      display.println(menu_items[i]);
+      display.println(MAIN_MENU_ITEMS[i]);
     }
   }
   
@@ -241,10 +322,12 @@ private:
     
     for (int i = 0; i < MAX_RECEIVERS; i++) {
       if (i == settings->current_receiver) {
-        display.print("> ");
+        display.print(">");
       } else {
-        display.print("  ");
+        display.print(" ");
       }
+      // Fleet members are driven together in multi-receiver mode
+      display.print(settings->fleet[i].enabled ? "*" : " ");
       display.print(RECEIVER_NAMES[i]);
       display.print(" (");
       display.print(i + 1);
@@ -259,7 +342,7 @@ private:
     
     display.setCursor(0, 20);
     display.print("Current: ");
-    display.println(settings->throttle_bidirectional ? "Bidirectional" : "Unidirectional");
+    display.println(model().throttle_bidirectional ? "Bidirectional" : "Unidirectional");
     
     display.setCursor(0, 35);
     display.println("Press UP/DOWN to toggle");
@@ -272,19 +355,19 @@ private:
     display.drawLine(0, 10, 128, 10, SSD1306_WHITE);
     
     display.setCursor(0, 15);
-    display.print("Pitch: ");
-    display.println(settings->trim.pitch_trim);
+    display.print(trim_axis == TRIM_AXIS_PITCH ? "> Pitch: " : "  Pitch: ");
+    display.println(model().trim.pitch_trim);
     
     display.setCursor(0, 25);
-    display.print("Roll:  ");
-    display.println(settings->trim.roll_trim);
+    display.print(trim_axis == TRIM_AXIS_ROLL ? "> Roll:  " : "  Roll:  ");
+    display.println(model().trim.roll_trim);
     
     display.setCursor(0, 35);
-    display.print("Yaw:   ");
-    display.println(settings->trim.yaw_trim);
+    display.print(trim_axis == TRIM_AXIS_YAW ? "> Yaw:   " : "  Yaw:   ");
+    display.println(model().trim.yaw_trim);
     
     display.setCursor(0, 50);
-    display.println("Use buttons to adjust");
+    display.println("SELECT: next axis");
   }
   
   void renderCalibrationMenu() {
@@ -303,10 +386,37 @@ private:
     display.println("INPUT MONITOR");
     display.drawLine(0, 10, 128, 10, SSD1306_WHITE);
     
-    // Implementation for input monitoring
-    display.setCursor(0, 20);
-    display.println("Monitor all inputs");
-    display.println("in real-time");
+    display.setCursor(0, 15);
+    display.print("THR ");
+    display.print(channel_data.throttle);
+    display.setCursor(64, 15);
+    display.print("YAW ");
+    display.println(channel_data.yaw);
+    
+    display.setCursor(0, 25);
+    display.print("PIT ");
+    display.print(channel_data.pitch);
+    display.setCursor(64, 25);
+    display.print("ROL ");
+    display.println(channel_data.roll);
+    
+    display.setCursor(0, 35);
+    display.print("AX1 ");
+    display.print(channel_data.aux1);
+    display.setCursor(64, 35);
+    display.print("AX2 ");
+    display.println(channel_data.aux2);
+    
+    display.setCursor(0, 45);
+    display.print("SW ");
+    display.print(channel_data.aux3);
+    display.print(channel_data.aux4);
+    display.print(channel_data.aux5);
+    display.print(channel_data.aux6);
+    display.print(" 3W ");
+    display.print(channel_data.aux7);
+    display.print("/");
+    display.println(channel_data.aux8);
   }
   
   void renderSystemInfo() {
@@ -314,20 +424,54 @@ private:
     display.println("SYSTEM INFO");
     display.drawLine(0, 10, 128, 10, SSD1306_WHITE);
     
-    display.setCursor(0, 15);
-    display.print("Battery: ");
-    // Add battery reading logic
-    display.println("4.2V");
-    
-    display.setCursor(0, 25);
-    display.print("Signal: ");
-    // Add signal strength logic
-    display.println("Strong");
+#ifdef LOOP_PROFILER
+    // Average and p99 time in us of the control step and UI update
+    if (profiler) {
+      renderPhase(15, "Ctrl: ", PHASE_CONTROL);
+      renderPhase(25, "UI: ", PHASE_UI);
+    }
+#endif
     
+    // Selected receiver's battery and link quality from its ACK payloads
+    const TelemetrySample* sample = NULL;
+    if (telemetry) {
+      sample = telemetry->latest(settings->current_receiver, millis(), UI_TELEMETRY_STALE_MS);
+    }
     display.setCursor(0, 35);
-    display.print("Receivers: ");
-    display.println(MAX_RECEIVERS);
+    if (sample) {
+      display.print("Batt: ");
+      display.print(sample->battery_mv / 1000.0, 2);
+      display.print("V LQ ");
+      display.print(sample->link_quality);
+      display.println("%");
+    } else {
+      display.println("Batt: --  LQ --");
+    }
+    
+    if (frame_stats && frame_stats->count() > 0) {
+      display.setCursor(0, 45);
+      display.print("Slot: ");
+      display.print(frame_stats->mean() / 1000.0, 2);
+      display.println("ms");
+      
+      display.setCursor(0, 55);
+      display.print("Jitter: +/-");
+      display.print(frame_stats->peakJitter());
+      display.println("us");
+    }
+  }
+  
+#ifdef LOOP_PROFILER
+  void renderPhase(int16_t y, const char* label, ProfilePhase phase) {
+    const CycleHistogram& stats = profiler->phase(phase);
+    display.setCursor(0, y);
+    display.print(label);
+    display.print(profiler->toMicros(stats.mean()));
+    display.print("/");
+    display.print(profiler->toMicros(stats.percentile(99)));
+    display.println("us");
   }
+#endif
 };
 
 #endif
\ No newline at end of file
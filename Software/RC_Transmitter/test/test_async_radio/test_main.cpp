@@ -0,0 +1,145 @@
+// Non-blocking TX path (async_radio.h) on the mock radio with loss
+// injection and air time per attempt: queue() hands the frame over and
+// returns, whatever the link does, and every outcome is still reported.
+
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "hal.h"
+#include "async_radio.h"
+
+static const uint32_t SLOT_US = 5000;
+static const uint32_t ATTEMPT_US = 300;         // 2 Mbps frame, ACK wait and 250 us ARD
+static const uint8_t RETRIES = 15;
+static const uint32_t FRAMES = 2000;
+static const uint64_t QUEUE_BOUND_NS = 20000;   // p99 host time of queue(), loose for shared CI hosts
+
+// Fresh radio and TX path for every test
+struct Link {
+  RadioDriver radio;
+  TelemetryStore store;
+  AsyncRadio async;
+
+  Link() : radio(0, 0), async(radio, store) {}
+};
+
+static Link* tx;
+static uint32_t results_delivered;
+static uint32_t results_failed;
+
+static void onResult(const FrameResult& result) {
+  if (result.delivered) results_delivered++;
+  else results_failed++;
+}
+
+static void sendSlots(uint32_t frames) {
+  uint8_t frame[FRAME_SIZE] = { FRAME_PROTOCOL_VERSION };
+  for (uint32_t i = 0; i < frames; i++) {
+    tx->async.poll();
+    frame[1] = (uint8_t)i;
+    tx->async.queue(frame, FRAME_SIZE, 0);
+    sim_clock.advance(SLOT_US);
+  }
+  tx->async.poll();
+}
+
+void setUp(void) {
+  // The mock receiver falls back to its lost-link profile after a silence
+  sim_clock = VirtualClock();
+  tx = new Link();
+  tx->radio.openWritingPipe(BASE_PIPES[0]);
+  tx->radio.setRetries(1, RETRIES);
+  tx->radio.setAttemptTime(ATTEMPT_US);
+  tx->async.setResultHandler(onResult);
+  results_delivered = results_failed = 0;
+}
+
+void tearDown(void) {
+  delete tx;
+}
+
+// No virtual time passes in queue() and its host time does not grow with loss
+void test_queue_returns_at_once_at_any_loss(void) {
+  const double LOSS[] = { 0, 30, 60, 90 };
+  uint8_t frame[FRAME_SIZE] = { FRAME_PROTOCOL_VERSION };
+  for (uint8_t l = 0; l < sizeof(LOSS) / sizeof(LOSS[0]); l++) {
+    tx->radio.setLossPercent(LOSS[l]);
+    std::vector<uint64_t> host_ns;
+    for (uint32_t i = 0; i < FRAMES; i++) {
+      tx->async.poll();
+      uint64_t before_us = sim_clock.now();
+      std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+      tx->async.queue(frame, FRAME_SIZE, 0);
+      host_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin).count());
+      TEST_ASSERT_EQUAL_UINT64(before_us, sim_clock.now());
+      sim_clock.advance(SLOT_US);
+    }
+    std::sort(host_ns.begin(), host_ns.end());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(QUEUE_BOUND_NS, host_ns[host_ns.size() * 99 / 100]);
+  }
+}
+
+// The blocking path the latency mode uses holds the caller for every retry
+void test_await_grows_with_loss(void) {
+  uint8_t frame[FRAME_SIZE] = { FRAME_PROTOCOL_VERSION };
+  double average_us[2];
+  const double LOSS[] = { 0, 60 };
+  for (uint8_t l = 0; l < 2; l++) {
+    tx->radio.setLossPercent(LOSS[l]);
+    uint64_t total_us = 0;
+    for (uint32_t i = 0; i < FRAMES; i++) {
+      tx->async.queue(frame, FRAME_SIZE, 0);
+      uint64_t before_us = sim_clock.now();
+      tx->async.await(RETRIES * ATTEMPT_US * 2);
+      total_us += sim_clock.now() - before_us;
+      sim_clock.advance(SLOT_US);
+    }
+    average_us[l] = (double)total_us / FRAMES;
+  }
+  TEST_ASSERT_INT_WITHIN(20, ATTEMPT_US, (int)average_us[0]);
+  TEST_ASSERT_TRUE(average_us[1] > 2 * average_us[0]);
+}
+
+// Every frame comes back once, delivered, failed or overrun
+void test_every_outcome_is_reported(void) {
+  tx->radio.setLossPercent(80);
+  sendSlots(FRAMES);
+  const LinkStats& stats = tx->async.linkStats(0);
+  TEST_ASSERT_EQUAL_UINT32(FRAMES, stats.sent);
+  TEST_ASSERT_EQUAL_UINT32(stats.sent, stats.acked + stats.failed + stats.overruns);
+  TEST_ASSERT_EQUAL_UINT32(stats.acked, results_delivered);
+  TEST_ASSERT_EQUAL_UINT32(stats.failed + stats.overruns, results_failed);
+  // 0.8^16 of the frames exhaust the retries
+  TEST_ASSERT_INT_WITHIN(30, FRAMES * 28 / 1000, stats.failed);
+  TEST_ASSERT_EQUAL_UINT32(tx->radio.pipe(0).delivered, stats.acked);
+}
+
+// With a longer retransmit delay sixteen attempts outlast the slot, so a
+// dead link overruns instead of holding up the next frame
+void test_dead_link_overruns_without_blocking(void) {
+  tx->radio.setAttemptTime(SLOT_US / 8);
+  tx->radio.setLossPercent(100);
+  uint64_t start_us = sim_clock.now();
+  sendSlots(100);
+  TEST_ASSERT_EQUAL_UINT64(start_us + 100 * SLOT_US, sim_clock.now());
+  const LinkStats& stats = tx->async.linkStats(0);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.acked);
+  TEST_ASSERT_EQUAL_UINT32(99, stats.overruns);
+  // The last one is still retrying, and fails once its attempts are spent
+  TEST_ASSERT_TRUE(tx->async.busy());
+  sim_clock.advance(SLOT_US);
+  tx->async.poll();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.failed);
+  TEST_ASSERT_FALSE(tx->async.busy());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_returns_at_once_at_any_loss);
+  RUN_TEST(test_await_grows_with_loss);
+  RUN_TEST(test_every_outcome_is_reported);
+  RUN_TEST(test_dead_link_overruns_without_blocking);
+  return UNITY_END();
+}
@@ -0,0 +1,227 @@
+// Fixed-point attitude filter (attitude_filter.h) and MPU6050 FIFO helpers
+// (mpu6050_fifo.h) on synthetic IMU traces at IMU_SAMPLE_RATE, in the
+// sensor's raw units: the transmitter is moved through known pitch and
+// roll, and the accelerometer and gyro readings it would give are
+// generated with bias and noise.
+
+#include <unity.h>
+#include <math.h>
+#include <attitude_filter.h>
+#include <mpu6050_fifo.h>
+
+static const double DEG = M_PI / 180;
+
+// Deterministic noise, roughly normal (sum of four uniforms)
+class Noise {
+private:
+  uint32_t state;
+
+public:
+  explicit Noise(uint32_t seed) : state(seed) {}
+
+  double next(double sigma) {
+    double total = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      state = state * 1664525u + 1013904223u;
+      total += (state >> 8) / 16777216.0 - 0.5;
+    }
+    return total * sigma * 1.732;
+  }
+};
+
+// Where the transmitter is at a moment, angles in radians, rates in rad/s,
+// plus any acceleration on top of gravity (in g, sensor axes)
+struct Pose {
+  double pitch, roll;
+  double pitch_rate, roll_rate;
+  double extra[3];
+};
+
+struct TraceSettings {
+  double gyro_bias_dps[3];
+  double accel_noise_g;
+  double gyro_noise_dps;
+  uint32_t seed;
+};
+
+static ImuSample sensorSample(const Pose& pose, const TraceSettings& settings, Noise& noise) {
+  double accel[3] = { -sin(pose.pitch), sin(pose.roll) * cos(pose.pitch), cos(pose.roll) * cos(pose.pitch) };
+  double rates[3] = { pose.roll_rate / DEG, pose.pitch_rate / DEG, 0 };
+  ImuSample sample;
+  for (uint8_t i = 0; i < 3; i++) {
+    double g = accel[i] + pose.extra[i] + noise.next(settings.accel_noise_g);
+    double dps = rates[i] + settings.gyro_bias_dps[i] + noise.next(settings.gyro_noise_dps);
+    sample.accel[i] = (int16_t)lround(g * AttitudeFilter::ACCEL_LSB_PER_G);
+    sample.gyro[i] = (int16_t)lround(dps * AttitudeFilter::GYRO_LSB_PER_DPS_X10 / 10);
+  }
+  return sample;
+}
+
+static double angleDegrees(int16_t angle) {
+  return angle * 360.0 / 65536;
+}
+
+// Error statistics of one run from settle_s on, in degrees
+struct Run {
+  double rms;
+  double max;
+  double accel_rms;         // Tilt straight from the accelerometer
+  double gyro_rms;          // Gyro integrated from the true start
+  int32_t pitch_bias;       // Learned, 0.01 dps
+  int32_t roll_bias;
+  uint32_t rejected;
+  double final_pitch, final_roll;
+};
+
+typedef void (*Motion)(double seconds, Pose& pose);
+
+static Run runTrace(Motion motion, const TraceSettings& settings, double seconds, double settle_s) {
+  AttitudeFilter filter(IMU_SAMPLE_RATE);
+  Noise noise(settings.seed);
+  uint32_t count = (uint32_t)(seconds * IMU_SAMPLE_RATE);
+  double gyro_pitch = 0, gyro_roll = 0;
+  double squared = 0, accel_squared = 0, gyro_squared = 0;
+  uint32_t measured = 0;
+  Run run = {};
+
+  for (uint32_t i = 0; i < count; i++) {
+    double t = (double)i / IMU_SAMPLE_RATE;
+    Pose pose = {};
+    motion(t, pose);
+    ImuSample sample = sensorSample(pose, settings, noise);
+    filter.update(sample);
+
+    if (i == 0) {
+      gyro_pitch = pose.pitch / DEG;
+      gyro_roll = pose.roll / DEG;
+    }
+    gyro_pitch += sample.gyro[1] * 10.0 / AttitudeFilter::GYRO_LSB_PER_DPS_X10 / IMU_SAMPLE_RATE;
+    gyro_roll += sample.gyro[0] * 10.0 / AttitudeFilter::GYRO_LSB_PER_DPS_X10 / IMU_SAMPLE_RATE;
+    if (t < settle_s) continue;
+
+    double pitch_error = angleDegrees(filter.pitch()) - pose.pitch / DEG;
+    double roll_error = angleDegrees(filter.roll()) - pose.roll / DEG;
+    double accel_pitch = atan2(-(double)sample.accel[0],
+                               sqrt((double)sample.accel[1] * sample.accel[1] + (double)sample.accel[2] * sample.accel[2])) / DEG;
+    double accel_roll = atan2((double)sample.accel[1], (double)sample.accel[2]) / DEG;
+    squared += pitch_error * pitch_error + roll_error * roll_error;
+    accel_squared += pow(accel_pitch - pose.pitch / DEG, 2) + pow(accel_roll - pose.roll / DEG, 2);
+    gyro_squared += pow(gyro_pitch - pose.pitch / DEG, 2) + pow(gyro_roll - pose.roll / DEG, 2);
+    if (fabs(pitch_error) > run.max) run.max = fabs(pitch_error);
+    if (fabs(roll_error) > run.max) run.max = fabs(roll_error);
+    measured++;
+  }
+  run.rms = sqrt(squared / (2.0 * measured));
+  run.accel_rms = sqrt(accel_squared / (2.0 * measured));
+  run.gyro_rms = sqrt(gyro_squared / (2.0 * measured));
+  run.pitch_bias = filter.pitchBias();
+  run.roll_bias = filter.rollBias();
+  run.rejected = filter.rejected();
+  run.final_pitch = angleDegrees(filter.pitch());
+  run.final_roll = angleDegrees(filter.roll());
+  return run;
+}
+
+static void heldTilt(double seconds, Pose& pose) {
+  pose.pitch = 30 * DEG;
+  pose.roll = -20 * DEG;
+}
+
+static void rocking(double seconds, Pose& pose) {
+  double pitch_w = 2 * M_PI * 0.5;
+  double roll_w = 2 * M_PI * 0.3;
+  pose.pitch = 25 * DEG * sin(pitch_w * seconds);
+  pose.roll = 15 * DEG * sin(roll_w * seconds);
+  pose.pitch_rate = 25 * DEG * pitch_w * cos(pitch_w * seconds);
+  pose.roll_rate = 15 * DEG * roll_w * cos(roll_w * seconds);
+}
+
+// Rocking with vibration the motors of a model on the bench might shake
+// into the transmitter, aliased at the sample rate
+static void vibrating(double seconds, Pose& pose) {
+  rocking(seconds, pose);
+  pose.extra[0] = 0.25 * sin(2 * M_PI * 83 * seconds);
+  pose.extra[1] = 0.25 * sin(2 * M_PI * 71 * seconds + 1);
+  pose.extra[2] = 0.25 * sin(2 * M_PI * 97 * seconds + 2);
+}
+
+// Level, with a hard shake along x between 10 and 11 s
+static void shaken(double seconds, Pose& pose) {
+  if (seconds >= 10 && seconds < 11) pose.extra[0] = 1.5 * sin(2 * M_PI * 6 * seconds);
+}
+
+static const TraceSettings QUIET = { { -3, 2, 0.5 }, 0.005, 0.05, 7 };
+static const TraceSettings NOISY = { { 1.5, -0.8, 0.3 }, 0.02, 0.3, 11 };
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_integer_atan_over_the_full_circle(void) {
+  for (int32_t step = 0; step < 3600; step++) {
+    double angle = step * 0.1 * DEG;
+    int32_t x = (int32_t)lround(cos(angle) * 46000);
+    int32_t y = (int32_t)lround(sin(angle) * 46000);
+    double error = angleDegrees(atan2Angle(y, x)) - atan2((double)y, (double)x) / DEG;
+    if (error > 180) error -= 360;
+    if (error < -180) error += 360;
+    TEST_ASSERT_TRUE(fabs(error) < 0.1);
+  }
+}
+
+void test_fifo_parsing_and_overflow(void) {
+  const uint8_t bytes[IMU_SAMPLE_BYTES] = { 0x20, 0x00, 0xE0, 0x00, 0x00, 0x01, 0xFF, 0xFF, 0x00, 0x83, 0x80, 0x00 };
+  ImuSample sample;
+  parseFifoSample(bytes, sample);
+  TEST_ASSERT_EQUAL_INT16(8192, sample.accel[0]);
+  TEST_ASSERT_EQUAL_INT16(-8192, sample.accel[1]);
+  TEST_ASSERT_EQUAL_INT16(1, sample.accel[2]);
+  TEST_ASSERT_EQUAL_INT16(-1, sample.gyro[0]);
+  TEST_ASSERT_EQUAL_INT16(131, sample.gyro[1]);
+  TEST_ASSERT_EQUAL_INT16(-32768, sample.gyro[2]);
+  // 85 samples fit, a full 1024 bytes means it overflowed
+  TEST_ASSERT_EQUAL_INT(0, fifoSamples(0));
+  TEST_ASSERT_EQUAL_INT(2, fifoSamples(30));
+  TEST_ASSERT_EQUAL_INT(85, fifoSamples(1020));
+  TEST_ASSERT_EQUAL_INT(-1, fifoSamples(1024));
+}
+
+// Held at 30/-20 degrees with a gyro bias: the angle settles and the
+// integral term learns the bias
+void test_held_tilt_settles_and_learns_the_bias(void) {
+  Run run = runTrace(heldTilt, QUIET, 120, 60);
+  TEST_ASSERT_TRUE(run.max < 0.5);
+  TEST_ASSERT_TRUE(fabs(run.pitch_bias / 100.0 - QUIET.gyro_bias_dps[1]) < 0.2);
+  TEST_ASSERT_TRUE(fabs(run.roll_bias / 100.0 - QUIET.gyro_bias_dps[0]) < 0.2);
+}
+
+// Rocked on sines up to 25 degrees: better than either sensor alone
+void test_rocking_beats_either_sensor_alone(void) {
+  Run run = runTrace(rocking, NOISY, 120, 30);
+  TEST_ASSERT_TRUE(run.rms < 1.0);
+  TEST_ASSERT_TRUE(run.rms < run.accel_rms);
+  TEST_ASSERT_TRUE(run.rms < run.gyro_rms);
+}
+
+void test_vibration_is_filtered(void) {
+  Run run = runTrace(vibrating, NOISY, 120, 30);
+  TEST_ASSERT_TRUE(run.rms < 1.5);
+  TEST_ASSERT_TRUE(run.rms * 4 < run.accel_rms);
+}
+
+// A 1 s, 1.5 g shake: rejected samples only integrate the gyro
+void test_shake_is_rejected(void) {
+  Run run = runTrace(shaken, NOISY, 20, 5);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, run.rejected);
+  TEST_ASSERT_TRUE(run.max < 2.0);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_integer_atan_over_the_full_circle);
+  RUN_TEST(test_fifo_parsing_and_overflow);
+  RUN_TEST(test_held_tilt_settles_and_learns_the_bias);
+  RUN_TEST(test_rocking_beats_either_sensor_alone);
+  RUN_TEST(test_vibration_is_filtered);
+  RUN_TEST(test_shake_is_rejected);
+  return UNITY_END();
+}
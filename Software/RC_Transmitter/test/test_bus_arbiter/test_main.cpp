@@ -0,0 +1,172 @@
+// Shared I2C bus arbitration (bus_arbiter.h): grant order and accounting,
+// and a discrete-event run of the firmware's three clients on a bus with a
+// timing model (9 clocks per byte at 400 kHz plus a fixed cost per
+// transaction) while the OLED streams chunked flushes.
+
+#include <unity.h>
+#include <vector>
+#include <bus_arbiter.h>
+
+static const uint32_t I2C_CLOCK_HZ = 400000;
+static const uint32_t TRANSACTION_OVERHEAD_US = 30;   // Driver setup, start and stop
+static const uint32_t IMU_PERIOD_US = 20000;
+static const uint8_t IMU_BURST_BYTES = 48;
+static const uint8_t OLED_PAGES = 8;
+static const uint8_t OLED_WIDTH = 128;
+static const uint8_t OLED_CHUNK = 31;
+static const uint8_t OLED_WINDOW_BYTES = 7;             // Control byte and 6 commands
+static const uint32_t EXPANDER_MIN_GAP_US = 2000;
+static const uint32_t EXPANDER_MAX_GAP_US = 20000;
+static const uint32_t RUN_US = 5000000;
+static const uint32_t IDLE = 0xFFFFFFFF;
+
+// Address byte plus payload
+static uint32_t transferUs(uint32_t payload_bytes) {
+  return (uint32_t)((uint64_t)(payload_bytes + 1) * 9 * 1000000 / I2C_CLOCK_HZ) + TRANSACTION_OVERHEAD_US;
+}
+
+// Transactions of one full-screen flush, as sendWindow() chunks it
+static std::vector<uint32_t> flushTransactions() {
+  std::vector<uint32_t> durations;
+  for (uint8_t page = 0; page < OLED_PAGES; page++) {
+    durations.push_back(transferUs(OLED_WINDOW_BYTES));
+    for (uint16_t sent = 0; sent < OLED_WIDTH; sent += OLED_CHUNK) {
+      uint16_t chunk = OLED_WIDTH - sent < OLED_CHUNK ? OLED_WIDTH - sent : OLED_CHUNK;
+      durations.push_back(transferUs(chunk + 1));
+    }
+  }
+  return durations;
+}
+
+struct Client {
+  uint32_t next_request;
+  uint32_t requested_at;
+  uint32_t duration;         // Of the outstanding transaction
+};
+
+struct Result {
+  uint32_t expander_reads;
+  uint32_t expander_max_us;
+  uint64_t busy_us;
+};
+
+// Back-to-back flushes, an IMU FIFO burst every IMU_PERIOD_US and an
+// expander read at random 2-20 ms intervals, all through the arbiter
+static Result simulate() {
+  BusArbiter arbiter;
+  std::vector<uint32_t> flush = flushTransactions();
+  size_t flush_step = 0;
+  uint32_t random_state = 12345;
+
+  Client clients[BUS_DEVICE_COUNT];
+  clients[BUS_IMU].next_request = 0;
+  clients[BUS_EXPANDER].next_request = 700;
+  clients[BUS_OLED].next_request = 0;
+  bool outstanding[BUS_DEVICE_COUNT] = {};
+
+  Result result = {};
+  uint32_t busy_until = 0;
+
+  for (;;) {
+    // Next event: the transfer in flight ends or a client asks
+    uint32_t now = arbiter.currentOwner() != BUS_FREE ? busy_until : IDLE;
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      if (!outstanding[i] && clients[i].next_request < now) now = clients[i].next_request;
+    }
+    if (now == IDLE || now >= RUN_US) break;
+
+    uint8_t owner = arbiter.currentOwner();
+    if (owner != BUS_FREE && busy_until == now) {
+      Client& done = clients[owner];
+      outstanding[owner] = false;
+      if (owner == BUS_EXPANDER) {
+        result.expander_reads++;
+        if (now - done.requested_at > result.expander_max_us) result.expander_max_us = now - done.requested_at;
+        random_state = random_state * 1103515245 + 12345;
+        done.next_request = now + EXPANDER_MIN_GAP_US +
+                            (random_state >> 8) % (EXPANDER_MAX_GAP_US - EXPANDER_MIN_GAP_US);
+      } else if (owner == BUS_IMU) {
+        done.next_request = done.requested_at + IMU_PERIOD_US;
+        if (done.next_request < now) done.next_request = now;
+      } else {
+        flush_step = (flush_step + 1) % flush.size();
+        done.next_request = now;
+      }
+
+      uint8_t granted = arbiter.release(owner, now);
+      if (granted != BUS_FREE) busy_until = now + clients[granted].duration;
+    }
+
+    for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+      if (outstanding[i] || clients[i].next_request != now) continue;
+      outstanding[i] = true;
+      clients[i].requested_at = now;
+      clients[i].duration = i == BUS_OLED ? flush[flush_step]
+                          : i == BUS_IMU ? transferUs(IMU_BURST_BYTES + 1)
+                          : transferUs(2);
+      if (arbiter.request(i, now)) busy_until = now + clients[i].duration;
+    }
+  }
+
+  for (uint8_t i = 0; i < BUS_DEVICE_COUNT; i++) {
+    result.busy_us += arbiter.stats(i).busy_us;
+  }
+  return result;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_freed_bus_goes_to_the_highest_priority_waiter(void) {
+  BusArbiter arbiter;
+  TEST_ASSERT_TRUE(arbiter.request(BUS_OLED, 0));
+  TEST_ASSERT_FALSE(arbiter.request(BUS_EXPANDER, 100));
+  TEST_ASSERT_FALSE(arbiter.request(BUS_IMU, 200));
+  TEST_ASSERT_EQUAL_UINT8(BUS_IMU, arbiter.release(BUS_OLED, 750));
+  TEST_ASSERT_EQUAL_UINT8(BUS_EXPANDER, arbiter.release(BUS_IMU, 1100));
+  TEST_ASSERT_EQUAL_UINT8(BUS_FREE, arbiter.release(BUS_EXPANDER, 1200));
+}
+
+void test_wait_and_hold_accounted_per_device(void) {
+  BusArbiter arbiter;
+  arbiter.request(BUS_OLED, 0);
+  arbiter.request(BUS_EXPANDER, 100);
+  arbiter.request(BUS_IMU, 200);
+  arbiter.release(BUS_OLED, 750);
+  arbiter.release(BUS_IMU, 1100);
+  arbiter.release(BUS_EXPANDER, 1200);
+
+  const BusDeviceStats& expander = arbiter.stats(BUS_EXPANDER);
+  const BusDeviceStats& imu = arbiter.stats(BUS_IMU);
+  const BusDeviceStats& oled = arbiter.stats(BUS_OLED);
+  TEST_ASSERT_EQUAL_UINT32(550, imu.wait_max_us);
+  TEST_ASSERT_EQUAL_UINT32(1000, expander.wait_max_us);
+  TEST_ASSERT_EQUAL_UINT32(750, oled.busy_us);
+  TEST_ASSERT_EQUAL_UINT32(350, imu.busy_us);
+  TEST_ASSERT_EQUAL_UINT32(100, expander.busy_us);
+  TEST_ASSERT_EQUAL_UINT32(1, oled.transactions);
+  TEST_ASSERT_EQUAL_UINT32(1, expander.transactions);
+}
+
+// An expander read waits for at most one chunk and one IMU burst
+void test_input_latency_bounded_while_the_display_streams(void) {
+  Result result = simulate();
+  uint32_t bound = transferUs(OLED_CHUNK + 1) + transferUs(IMU_BURST_BYTES + 1) + transferUs(2);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, result.expander_reads);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(bound, result.expander_max_us);
+}
+
+// The display takes all the time the reads leave, the bus never idles
+void test_display_fills_the_bus(void) {
+  Result result = simulate();
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(RUN_US / 100 * 99, result.busy_us);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_freed_bus_goes_to_the_highest_priority_waiter);
+  RUN_TEST(test_wait_and_hold_accounted_per_device);
+  RUN_TEST(test_input_latency_bounded_while_the_display_streams);
+  RUN_TEST(test_display_fills_the_bus);
+  return UNITY_END();
+}
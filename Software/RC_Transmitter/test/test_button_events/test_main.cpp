@@ -0,0 +1,193 @@
+// Menu-button debouncer (button_events.h) on a virtual millisecond clock,
+// ticked every ButtonDebouncer::TICK_MS like the firmware's button timer.
+
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include <button_events.h>
+
+// One pin change at a millisecond
+struct Edge {
+  uint32_t at_ms;
+  uint8_t button;
+  bool pressed;
+};
+
+struct Run {
+  std::vector<ButtonEvent> events;
+  std::vector<uint32_t> times;
+};
+
+static bool edgeBefore(const Edge& a, const Edge& b) { return a.at_ms < b.at_ms; }
+
+// Contact bounce: toggles every millisecond for bounce_ms, settling on pressed
+static void addEdge(std::vector<Edge>& edges, uint32_t at_ms, uint8_t button, bool pressed, uint32_t bounce_ms) {
+  for (uint32_t t = 0; t < bounce_ms; t++) {
+    Edge edge = { at_ms + t, button, (t % 2 == 0) == pressed };
+    edges.push_back(edge);
+  }
+  Edge edge = { at_ms + bounce_ms, button, pressed };
+  edges.push_back(edge);
+}
+
+// Replays edges for duration_ms and records every event with its tick
+static Run replay(std::vector<Edge> edges, uint32_t duration_ms) {
+  std::stable_sort(edges.begin(), edges.end(), edgeBefore);
+  ButtonEventQueue queue;
+  ButtonDebouncer debouncer(queue);
+
+  Run run;
+  uint8_t down = 0;
+  size_t next = 0;
+  for (uint32_t now = 0; now <= duration_ms; now++) {
+    while (next < edges.size() && edges[next].at_ms == now) {
+      uint8_t bit = 1 << edges[next].button;
+      down = edges[next].pressed ? down | bit : down & ~bit;
+      next++;
+    }
+    if (now % ButtonDebouncer::TICK_MS == 0) {
+      debouncer.tick(down);
+      ButtonEvent event;
+      while (queue.pop(event)) {
+        run.events.push_back(event);
+        run.times.push_back(now);
+      }
+    }
+  }
+  return run;
+}
+
+static uint32_t count(const Run& run, uint8_t button, uint8_t type) {
+  uint32_t total = 0;
+  for (size_t i = 0; i < run.events.size(); i++) {
+    if (run.events[i].button == button && run.events[i].type == type) total++;
+  }
+  return total;
+}
+
+static void assertPressRelease(uint32_t bounce_ms) {
+  std::vector<Edge> edges;
+  addEdge(edges, 101, BUTTON_DOWN, true, bounce_ms);
+  addEdge(edges, 301, BUTTON_DOWN, false, bounce_ms);
+  Run run = replay(edges, 400);
+  TEST_ASSERT_EQUAL_UINT32(2, run.events.size());
+  TEST_ASSERT_EQUAL_UINT32(1, count(run, BUTTON_DOWN, BUTTON_PRESS));
+  TEST_ASSERT_EQUAL_UINT32(1, count(run, BUTTON_DOWN, BUTTON_RELEASE));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_clean_press_and_release(void) {
+  assertPressRelease(0);
+}
+
+void test_bounce_gives_one_event_per_edge(void) {
+  assertPressRelease(6);
+}
+
+void test_short_spikes_give_no_events(void) {
+  // Spikes up to one tick short of the integrator, each followed by a gap
+  const uint32_t longest = ButtonDebouncer::TICK_MS * (ButtonDebouncer::INTEGRATOR_MAX - 1);
+  std::vector<Edge> edges;
+  uint32_t at = 100;
+  for (uint32_t length = 1; length <= longest; length++) {
+    Edge down = { at, BUTTON_UP, true };
+    Edge up = { at + length, BUTTON_UP, false };
+    edges.push_back(down);
+    edges.push_back(up);
+    at += 50;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, replay(edges, at + 50).events.size());
+}
+
+void test_chord(void) {
+  std::vector<Edge> edges;
+  addEdge(edges, 100, BUTTON_UP, true, 3);
+  addEdge(edges, 101, BUTTON_SELECT, true, 4);
+  addEdge(edges, 200, BUTTON_DOWN, true, 3);
+  addEdge(edges, 260, BUTTON_DOWN, false, 3);
+  addEdge(edges, 400, BUTTON_UP, false, 3);
+  addEdge(edges, 402, BUTTON_SELECT, false, 2);
+  Run run = replay(edges, 500);
+  TEST_ASSERT_EQUAL_UINT32(6, run.events.size());
+  for (uint8_t button = 0; button < MENU_BUTTON_COUNT; button++) {
+    TEST_ASSERT_EQUAL_UINT32(1, count(run, button, BUTTON_PRESS));
+    TEST_ASSERT_EQUAL_UINT32(1, count(run, button, BUTTON_RELEASE));
+  }
+}
+
+void test_hold_long_presses_then_repeats(void) {
+  std::vector<Edge> edges;
+  addEdge(edges, 100, BUTTON_UP, true, 0);
+  addEdge(edges, 1100, BUTTON_UP, false, 0);
+  Run run = replay(edges, 1200);
+
+  uint32_t pressed_at = 0;
+  uint32_t long_at = 0;
+  std::vector<uint32_t> repeats;
+  for (size_t i = 0; i < run.events.size(); i++) {
+    if (run.events[i].type == BUTTON_PRESS) pressed_at = run.times[i];
+    if (run.events[i].type == BUTTON_LONG_PRESS) long_at = run.times[i];
+    if (run.events[i].type == BUTTON_REPEAT) repeats.push_back(run.times[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, count(run, BUTTON_UP, BUTTON_LONG_PRESS));
+  TEST_ASSERT_EQUAL_UINT32(ButtonDebouncer::LONG_PRESS_MS, long_at - pressed_at);
+  TEST_ASSERT_EQUAL_UINT32(4, repeats.size());
+  uint32_t expected_at = long_at + ButtonDebouncer::REPEAT_MS;
+  for (size_t i = 0; i < repeats.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(expected_at, repeats[i]);
+    expected_at += ButtonDebouncer::REPEAT_MS;
+  }
+}
+
+void test_bouncy_press_accepted_within_20_ms(void) {
+  for (uint32_t offset = 0; offset < ButtonDebouncer::TICK_MS; offset++) {
+    std::vector<Edge> edges;
+    addEdge(edges, 100 + offset, BUTTON_SELECT, true, 5);
+    Run run = replay(edges, 200);
+    TEST_ASSERT_FALSE(run.events.empty());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(20, run.times[0] - (100 + offset));
+  }
+}
+
+void test_full_queue_counts_drops(void) {
+  ButtonEventQueue queue;
+  ButtonEvent event = { BUTTON_DOWN, BUTTON_REPEAT };
+  uint32_t accepted = 0;
+  for (uint8_t i = 0; i < 20; i++) {
+    if (queue.push(event)) accepted++;
+  }
+  uint32_t taken = 0;
+  while (queue.pop(event)) taken++;
+  TEST_ASSERT_EQUAL_UINT32(15, accepted);
+  TEST_ASSERT_EQUAL_UINT32(15, taken);
+  TEST_ASSERT_EQUAL_UINT32(5, queue.dropped());
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+// 8 taps a second, up and down in turn: every one arrives
+void test_fast_taps_all_arrive(void) {
+  const uint32_t presses = 50;
+  std::vector<Edge> taps;
+  for (uint32_t i = 0; i < presses; i++) {
+    uint8_t button = i % 2 == 0 ? BUTTON_UP : BUTTON_DOWN;
+    addEdge(taps, 100 + i * 125, button, true, 3);
+    addEdge(taps, 100 + i * 125 + 60, button, false, 3);
+  }
+  Run run = replay(taps, 200 + presses * 125);
+  TEST_ASSERT_EQUAL_UINT32(presses, count(run, BUTTON_UP, BUTTON_PRESS) + count(run, BUTTON_DOWN, BUTTON_PRESS));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_press_and_release);
+  RUN_TEST(test_bounce_gives_one_event_per_edge);
+  RUN_TEST(test_short_spikes_give_no_events);
+  RUN_TEST(test_chord);
+  RUN_TEST(test_hold_long_presses_then_repeats);
+  RUN_TEST(test_bouncy_press_accepted_within_20_ms);
+  RUN_TEST(test_full_queue_counts_drops);
+  RUN_TEST(test_fast_taps_all_arrive);
+  return UNITY_END();
+}
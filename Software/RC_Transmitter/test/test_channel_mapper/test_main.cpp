@@ -0,0 +1,124 @@
+// Stick mapping (channel_mapper.h) against the map() calls it replaced:
+// every raw ADC value, over random calibrations and trims, must come out
+// bit for bit the same, including out-of-range input and map()'s -1 for
+// an empty calibration range.
+
+#include <unity.h>
+#include <channel_mapper.h>
+
+// map() as in the ESP32 Arduino core
+static long arduinoMap(long x, long in_min, long in_max, long out_min, long out_max) {
+  const long run = in_max - in_min;
+  if (run == 0) return -1;
+  const long rise = out_max - out_min;
+  const long delta = x - in_min;
+  return (delta * rise) / run + out_min;
+}
+
+// readAndMapAnalog() plus trim, as readInputs() used it
+static int16_t mapAnalog(uint16_t raw, int16_t min_val, int16_t mid_val, int16_t max_val, int16_t trim) {
+  int16_t mapped;
+  if (raw < mid_val) {
+    mapped = (int16_t)arduinoMap(raw, min_val, mid_val, -511, 0);
+  } else {
+    mapped = (int16_t)arduinoMap(raw, mid_val, max_val, 0, 512);
+  }
+  return (int16_t)(mapped + trim);
+}
+
+static uint32_t random_state;
+
+static int16_t randomIn(int16_t low, int16_t high) {
+  random_state = random_state * 1664525u + 1013904223u;
+  return (int16_t)(low + (int32_t)((random_state >> 8) % (uint32_t)(high - low + 1)));
+}
+
+// Every raw value the 12-bit ADC can give, and some it cannot
+static void assertMatchesMap(int16_t min_val, int16_t mid_val, int16_t max_val, int16_t trim) {
+  ChannelMapper mapper;
+  mapper.configure(min_val, mid_val, max_val, trim);
+  for (uint16_t raw = 0; raw < 4200; raw++) {
+    int16_t expected = mapAnalog(raw, min_val, mid_val, max_val, trim);
+    if (mapper.map(raw) != expected) {
+      char message[96];
+      snprintf(message, sizeof(message), "cal %d/%d/%d trim %d raw %u", min_val, mid_val, max_val, trim, raw);
+      TEST_ASSERT_EQUAL_INT16_MESSAGE(expected, mapper.map(raw), message);
+    }
+  }
+}
+
+void setUp(void) {
+  random_state = 0x5EED;
+}
+
+void tearDown(void) {}
+
+void test_default_calibration(void) {
+  assertMatchesMap(0, 2048, 4095, 0);
+  assertMatchesMap(0, 2048, 4095, 37);
+  assertMatchesMap(0, 2048, 4095, -100);
+}
+
+void test_random_calibrations(void) {
+  for (uint16_t i = 0; i < 3000; i++) {
+    int16_t min_val = randomIn(0, 1500);
+    int16_t mid_val = randomIn(min_val + 1, 3000);
+    int16_t max_val = randomIn(mid_val + 1, 4095);
+    assertMatchesMap(min_val, mid_val, max_val, randomIn(-127, 127));
+  }
+}
+
+// A stick calibrated the wrong way round still maps like map() did
+void test_reversed_calibrations(void) {
+  for (uint16_t i = 0; i < 200; i++) {
+    int16_t max_val = randomIn(0, 1500);
+    int16_t mid_val = randomIn(max_val + 1, 3000);
+    int16_t min_val = randomIn(mid_val + 1, 4095);
+    assertMatchesMap(min_val, mid_val, max_val, randomIn(-127, 127));
+  }
+}
+
+// min == mid or mid == max: map() gives -1 on that side
+void test_empty_range_is_minus_one(void) {
+  ChannelMapper mapper;
+  mapper.configure(2048, 2048, 4095, 0);
+  TEST_ASSERT_EQUAL_INT16(-1, mapper.map(0));
+  TEST_ASSERT_EQUAL_INT16(-1, mapper.map(2047));
+  TEST_ASSERT_EQUAL_INT16(0, mapper.map(2048));
+
+  mapper.configure(0, 3000, 3000, 20);
+  TEST_ASSERT_EQUAL_INT16(19, mapper.map(3000));
+  TEST_ASSERT_EQUAL_INT16(19, mapper.map(4095));
+
+  assertMatchesMap(2048, 2048, 4095, 5);
+  assertMatchesMap(0, 3000, 3000, -5);
+  assertMatchesMap(1000, 1000, 1000, 0);
+}
+
+void test_linear_throttle(void) {
+  ChannelMapper mapper;
+  mapper.configureLinear(0, 4095, 0);
+  for (uint16_t raw = 0; raw < 4200; raw++) {
+    TEST_ASSERT_EQUAL_INT16((int16_t)arduinoMap(raw, 0, 4095, -511, 512), mapper.map(raw));
+  }
+}
+
+void test_set_trim_keeps_the_segments(void) {
+  ChannelMapper mapper;
+  mapper.configure(100, 2000, 3900, 0);
+  mapper.setTrim(-42);
+  for (uint16_t raw = 0; raw < 4096; raw++) {
+    TEST_ASSERT_EQUAL_INT16(mapAnalog(raw, 100, 2000, 3900, -42), mapper.map(raw));
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_default_calibration);
+  RUN_TEST(test_random_calibrations);
+  RUN_TEST(test_reversed_calibrations);
+  RUN_TEST(test_empty_range_is_minus_one);
+  RUN_TEST(test_linear_throttle);
+  RUN_TEST(test_set_trim_keeps_the_segments);
+  return UNITY_END();
+}
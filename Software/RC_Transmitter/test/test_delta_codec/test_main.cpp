@@ -0,0 +1,241 @@
+// Delta frames (delta_codec.h): what the receiver decodes always matches
+// what was sent, deltas only build on ACKed frames it still holds, and
+// keyframes bound recovery when the receiver has lost its history.
+
+#include <unity.h>
+#include <delta_codec.h>
+
+static ChannelData sticks(int16_t throttle, int16_t pitch, int16_t roll, int16_t yaw) {
+  ChannelData data = {};
+  data.throttle = throttle;
+  data.pitch = pitch;
+  data.roll = roll;
+  data.yaw = yaw;
+  data.aux1 = -300;
+  data.aux2 = 200;
+  data.aux7 = 1;
+  data.receiver_id = 3;
+  return data;
+}
+
+static void assertSameChannels(const ChannelData& expected, const ChannelData& actual) {
+  int16_t sent[6], received[6];
+  analogChannels(expected, sent);
+  analogChannels(actual, received);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(sent, received, 6);
+  TEST_ASSERT_TRUE(sameSwitches(expected, actual));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_first_frame_is_a_keyframe(void) {
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ChannelData data = sticks(-511, 10, -20, 30);
+  uint8_t frame[FRAME_SIZE];
+  TEST_ASSERT_EQUAL_UINT8(FRAME_SIZE, encoder.encode(data, 7, frame));
+  TEST_ASSERT_FALSE(encoder.lastWasDelta());
+  TEST_ASSERT_EQUAL_UINT8(FRAME_PROTOCOL_VERSION, frame[0]);
+
+  ChannelData decoded;
+  uint8_t sequence;
+  TEST_ASSERT_TRUE(decoder.decode(frame, FRAME_SIZE, decoded, sequence));
+  TEST_ASSERT_EQUAL_UINT8(7, sequence);
+  assertSameChannels(data, decoded);
+}
+
+void test_small_changes_after_ack_are_short_deltas(void) {
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ChannelData data = sticks(0, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  ChannelData decoded;
+  uint8_t sequence;
+
+  decoder.decode(frame, encoder.encode(data, 0, frame), decoded, sequence);
+  encoder.acknowledge();
+
+  // One channel at each end of the 5-bit range, one just past it
+  data.pitch += DELTA_SMALL_MAX;
+  data.roll += DELTA_SMALL_MIN;
+  data.yaw += DELTA_SMALL_MAX + 1;
+  uint8_t length = encoder.encode(data, 1, frame);
+  TEST_ASSERT_TRUE(encoder.lastWasDelta());
+  TEST_ASSERT_EQUAL_UINT8(FRAME_DELTA, frame[0]);
+  TEST_ASSERT_EQUAL_UINT8(DELTA_HEADER_SIZE + (2 * (1 + DELTA_SMALL_BITS) + 1 + FRAME_CHANNEL_BITS + 7) / 8,
+                          length);
+  TEST_ASSERT_TRUE(decoder.decode(frame, length, decoded, sequence));
+  TEST_ASSERT_EQUAL_UINT8(1, sequence);
+  assertSameChannels(data, decoded);
+}
+
+void test_unchanged_frame_is_a_header(void) {
+  DeltaEncoder encoder;
+  ChannelData data = sticks(100, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  encoder.encode(data, 0, frame);
+  encoder.acknowledge();
+  TEST_ASSERT_EQUAL_UINT8(DELTA_HEADER_SIZE, encoder.encode(data, 1, frame));
+  TEST_ASSERT_EQUAL_UINT8(0, frame[3]);
+}
+
+void test_switch_change_carries_the_switch_group(void) {
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ChannelData data = sticks(0, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  ChannelData decoded;
+  uint8_t sequence;
+  decoder.decode(frame, encoder.encode(data, 0, frame), decoded, sequence);
+  encoder.acknowledge();
+
+  data.aux4 = 1;
+  data.aux8 = -1;
+  uint8_t length = encoder.encode(data, 1, frame);
+  TEST_ASSERT_EQUAL_HEX8(1 << DELTA_SWITCHES, frame[3]);
+  TEST_ASSERT_TRUE(decoder.decode(frame, length, decoded, sequence));
+  assertSameChannels(data, decoded);
+}
+
+// Without ACKs the base stays put; the receiver holds it, so the deltas
+// still decode, until the base is older than its history
+void test_deltas_build_on_the_last_acked_frame(void) {
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ChannelData data = sticks(0, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  ChannelData decoded;
+  uint8_t sequence;
+  decoder.decode(frame, encoder.encode(data, 0, frame), decoded, sequence);
+  encoder.acknowledge();
+
+  for (uint8_t i = 1; i <= DELTA_HISTORY; i++) {
+    data.throttle = i * 3;
+    uint8_t length = encoder.encode(data, i, frame);
+    TEST_ASSERT_TRUE(encoder.lastWasDelta());
+    TEST_ASSERT_EQUAL_UINT8(0, frame[2]);
+    TEST_ASSERT_TRUE(decoder.decode(frame, length, decoded, sequence));
+    assertSameChannels(data, decoded);
+  }
+  encoder.encode(data, DELTA_HISTORY + 1, frame);
+  TEST_ASSERT_FALSE(encoder.lastWasDelta());
+}
+
+void test_keyframe_every_interval(void) {
+  DeltaEncoder encoder;
+  ChannelData data = sticks(0, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  uint16_t keyframes = 0;
+  for (uint16_t i = 0; i < 4 * DELTA_KEYFRAME_INTERVAL; i++) {
+    data.pitch = i % 7;
+    encoder.encode(data, (uint8_t)i, frame);
+    encoder.acknowledge();
+    if (!encoder.lastWasDelta()) keyframes++;
+  }
+  TEST_ASSERT_INT_WITHIN(1, 4 * DELTA_KEYFRAME_INTERVAL / (DELTA_KEYFRAME_INTERVAL + 1) + 1, keyframes);
+}
+
+// A restarted receiver drops deltas until the next keyframe, never
+// decoding one against a base it does not have
+void test_restarted_receiver_recovers_on_keyframe(void) {
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ChannelData data = sticks(0, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  ChannelData decoded;
+  uint8_t sequence;
+  for (uint8_t i = 0; i < 10; i++) {
+    data.roll = i;
+    decoder.decode(frame, encoder.encode(data, i, frame), decoded, sequence);
+    encoder.acknowledge();
+  }
+
+  decoder.reset();
+  uint16_t dropped = 0;
+  for (uint16_t i = 10; i < 10 + DELTA_KEYFRAME_INTERVAL + 1; i++) {
+    data.roll = i % 11;
+    uint8_t length = encoder.encode(data, (uint8_t)i, frame);
+    encoder.acknowledge();
+    if (!decoder.decode(frame, length, decoded, sequence)) {
+      TEST_ASSERT_TRUE(encoder.lastWasDelta());
+      dropped++;
+      continue;
+    }
+    assertSameChannels(data, decoded);
+    TEST_ASSERT_FALSE(encoder.lastWasDelta());
+    break;
+  }
+  TEST_ASSERT_GREATER_THAN(0, dropped);
+  TEST_ASSERT_LESS_OR_EQUAL(DELTA_KEYFRAME_INTERVAL, dropped);
+}
+
+// The periodic keyframe is lost on the air, so it is not ACKed either;
+// the transmitter keeps sending keyframes instead of another interval of
+// deltas the restarted receiver cannot decode
+void test_lost_keyframe_is_repeated(void) {
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ChannelData data = sticks(0, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  ChannelData decoded;
+  uint8_t sequence;
+  for (uint8_t i = 0; i < 10; i++) {
+    data.roll = i;
+    decoder.decode(frame, encoder.encode(data, i, frame), decoded, sequence);
+    encoder.acknowledge();
+  }
+
+  decoder.reset();
+  uint16_t i = 10;
+  for (; i < 10 + DELTA_KEYFRAME_INTERVAL + 1; i++) {
+    data.roll = i % 11;
+    encoder.encode(data, (uint8_t)i, frame);
+    if (!encoder.lastWasDelta()) break;
+    encoder.acknowledge();
+  }
+  TEST_ASSERT_FALSE(encoder.lastWasDelta());
+
+  uint16_t frames = 0;
+  for (i++; frames < DELTA_KEYFRAME_INTERVAL; i++) {
+    data.roll = i % 11;
+    uint8_t length = encoder.encode(data, (uint8_t)i, frame);
+    encoder.acknowledge();
+    frames++;
+    if (decoder.decode(frame, length, decoded, sequence)) break;
+  }
+  TEST_ASSERT_EQUAL_UINT16(1, frames);
+  assertSameChannels(data, decoded);
+}
+
+void test_truncated_delta_is_rejected(void) {
+  DeltaEncoder encoder;
+  DeltaDecoder decoder;
+  ChannelData data = sticks(0, 0, 0, 0);
+  uint8_t frame[FRAME_SIZE];
+  ChannelData decoded;
+  uint8_t sequence;
+  decoder.decode(frame, encoder.encode(data, 0, frame), decoded, sequence);
+  encoder.acknowledge();
+
+  data.throttle = 400;
+  data.yaw = -400;
+  uint8_t length = encoder.encode(data, 1, frame);
+  TEST_ASSERT_TRUE(encoder.lastWasDelta());
+  TEST_ASSERT_FALSE(decoder.decode(frame, length - 1, decoded, sequence));
+  TEST_ASSERT_TRUE(decoder.decode(frame, length, decoded, sequence));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_frame_is_a_keyframe);
+  RUN_TEST(test_small_changes_after_ack_are_short_deltas);
+  RUN_TEST(test_unchanged_frame_is_a_header);
+  RUN_TEST(test_switch_change_carries_the_switch_group);
+  RUN_TEST(test_deltas_build_on_the_last_acked_frame);
+  RUN_TEST(test_keyframe_every_interval);
+  RUN_TEST(test_restarted_receiver_recovers_on_keyframe);
+  RUN_TEST(test_lost_keyframe_is_repeated);
+  RUN_TEST(test_truncated_delta_is_rejected);
+  return UNITY_END();
+}
@@ -0,0 +1,164 @@
+// Bit-packed frames (frame_codec.h): every field survives the round trip,
+// channels clamp to 11 bits at the edges, and frames from another protocol
+// version or cut short are rejected.
+
+#include <unity.h>
+#include <frame_codec.h>
+
+static ChannelData sample(int16_t throttle, int16_t pitch, int16_t roll, int16_t yaw,
+                          int16_t aux1, int16_t aux2) {
+  ChannelData data = {};
+  data.throttle = throttle;
+  data.pitch = pitch;
+  data.roll = roll;
+  data.yaw = yaw;
+  data.aux1 = aux1;
+  data.aux2 = aux2;
+  data.aux3 = 1;
+  data.aux5 = 1;
+  data.aux7 = -1;
+  data.aux8 = 1;
+  data.receiver_id = 5;
+  data.timestamp = 123456;
+  return data;
+}
+
+static ChannelData roundTrip(const ChannelData& data, uint8_t sequence, uint8_t& decoded_sequence) {
+  uint8_t frame[FRAME_SIZE];
+  TEST_ASSERT_EQUAL_UINT8(FRAME_SIZE, encodeFrame(data, sequence, frame));
+  ChannelData decoded;
+  TEST_ASSERT_TRUE(decodeFrame(frame, FRAME_SIZE, decoded, decoded_sequence));
+  return decoded;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_round_trip_keeps_every_field(void) {
+  ChannelData data = sample(-511, 512, 0, -1, 37, -300);
+  uint8_t sequence;
+  ChannelData decoded = roundTrip(data, 201, sequence);
+  TEST_ASSERT_EQUAL_UINT8(201, sequence);
+  TEST_ASSERT_EQUAL_INT16(data.throttle, decoded.throttle);
+  TEST_ASSERT_EQUAL_INT16(data.pitch, decoded.pitch);
+  TEST_ASSERT_EQUAL_INT16(data.roll, decoded.roll);
+  TEST_ASSERT_EQUAL_INT16(data.yaw, decoded.yaw);
+  TEST_ASSERT_EQUAL_INT16(data.aux1, decoded.aux1);
+  TEST_ASSERT_EQUAL_INT16(data.aux2, decoded.aux2);
+  TEST_ASSERT_EQUAL_UINT8(1, decoded.aux3);
+  TEST_ASSERT_EQUAL_UINT8(0, decoded.aux4);
+  TEST_ASSERT_EQUAL_UINT8(1, decoded.aux5);
+  TEST_ASSERT_EQUAL_UINT8(0, decoded.aux6);
+  TEST_ASSERT_EQUAL_INT8(-1, decoded.aux7);
+  TEST_ASSERT_EQUAL_INT8(1, decoded.aux8);
+  TEST_ASSERT_EQUAL_UINT8(5, decoded.receiver_id);
+  // The timestamp is not carried on air
+  TEST_ASSERT_EQUAL_UINT32(0, decoded.timestamp);
+}
+
+// Each channel on its own, so a bit landing in a neighbour shows up
+void test_round_trip_every_channel_value(void) {
+  for (int32_t value = FRAME_CHANNEL_MIN; value <= FRAME_CHANNEL_MAX; value++) {
+    for (uint8_t channel = 0; channel < 6; channel++) {
+      int16_t values[6] = { 0, 0, 0, 0, 0, 0 };
+      values[channel] = (int16_t)value;
+      ChannelData data = sample(values[0], values[1], values[2], values[3], values[4], values[5]);
+      uint8_t sequence;
+      ChannelData decoded = roundTrip(data, (uint8_t)value, sequence);
+      int16_t received[6] = { decoded.throttle, decoded.pitch, decoded.roll,
+                              decoded.yaw, decoded.aux1, decoded.aux2 };
+      TEST_ASSERT_EQUAL_INT16_ARRAY(values, received, 6);
+    }
+  }
+}
+
+void test_switch_positions_round_trip(void) {
+  const int8_t positions[] = { -1, 0, 1 };
+  for (uint8_t bits = 0; bits < 16; bits++) {
+    for (uint8_t a = 0; a < 3; a++) {
+      for (uint8_t b = 0; b < 3; b++) {
+        ChannelData data = sample(0, 0, 0, 0, 0, 0);
+        data.aux3 = bits & 1;
+        data.aux4 = (bits >> 1) & 1;
+        data.aux5 = (bits >> 2) & 1;
+        data.aux6 = (bits >> 3) & 1;
+        data.aux7 = positions[a];
+        data.aux8 = positions[b];
+        data.receiver_id = (bits + a + b) & 7;
+        uint8_t sequence;
+        ChannelData decoded = roundTrip(data, 0, sequence);
+        TEST_ASSERT_EQUAL_UINT8(data.aux3, decoded.aux3);
+        TEST_ASSERT_EQUAL_UINT8(data.aux4, decoded.aux4);
+        TEST_ASSERT_EQUAL_UINT8(data.aux5, decoded.aux5);
+        TEST_ASSERT_EQUAL_UINT8(data.aux6, decoded.aux6);
+        TEST_ASSERT_EQUAL_INT8(data.aux7, decoded.aux7);
+        TEST_ASSERT_EQUAL_INT8(data.aux8, decoded.aux8);
+        TEST_ASSERT_EQUAL_UINT8(data.receiver_id, decoded.receiver_id);
+      }
+    }
+  }
+}
+
+void test_channels_clamp_to_eleven_bits(void) {
+  TEST_ASSERT_EQUAL_INT16(-1024, FRAME_CHANNEL_MIN);
+  TEST_ASSERT_EQUAL_INT16(1023, FRAME_CHANNEL_MAX);
+  ChannelData data = sample(-1025, 1024, -32768, 32767, FRAME_CHANNEL_MIN, FRAME_CHANNEL_MAX);
+  uint8_t sequence;
+  ChannelData decoded = roundTrip(data, 0, sequence);
+  TEST_ASSERT_EQUAL_INT16(FRAME_CHANNEL_MIN, decoded.throttle);
+  TEST_ASSERT_EQUAL_INT16(FRAME_CHANNEL_MAX, decoded.pitch);
+  TEST_ASSERT_EQUAL_INT16(FRAME_CHANNEL_MIN, decoded.roll);
+  TEST_ASSERT_EQUAL_INT16(FRAME_CHANNEL_MAX, decoded.yaw);
+  TEST_ASSERT_EQUAL_INT16(FRAME_CHANNEL_MIN, decoded.aux1);
+  TEST_ASSERT_EQUAL_INT16(FRAME_CHANNEL_MAX, decoded.aux2);
+}
+
+// Bits 77-79 stay zero, and nothing is written past the frame
+void test_reserved_bits_and_length(void) {
+  uint8_t frame[FRAME_SIZE + 1];
+  frame[FRAME_SIZE] = 0xA5;
+  ChannelData data = sample(FRAME_CHANNEL_MAX, FRAME_CHANNEL_MAX, FRAME_CHANNEL_MAX,
+                            FRAME_CHANNEL_MAX, FRAME_CHANNEL_MAX, FRAME_CHANNEL_MAX);
+  data.aux4 = data.aux6 = 1;
+  data.receiver_id = 7;
+  encodeFrame(data, 0xFF, frame);
+  TEST_ASSERT_EQUAL_HEX8(0, frame[FRAME_SIZE - 1] & 0xE0);
+  TEST_ASSERT_EQUAL_HEX8(0xA5, frame[FRAME_SIZE]);
+}
+
+void test_other_version_is_rejected(void) {
+  uint8_t frame[FRAME_SIZE];
+  encodeFrame(sample(1, 2, 3, 4, 5, 6), 9, frame);
+  ChannelData decoded = sample(0, 0, 0, 0, 0, 0);
+  uint8_t sequence = 42;
+  for (uint16_t version = 0; version < 256; version++) {
+    if (version == FRAME_PROTOCOL_VERSION) continue;
+    frame[0] = (uint8_t)version;
+    TEST_ASSERT_FALSE(decodeFrame(frame, FRAME_SIZE, decoded, sequence));
+  }
+  // A rejected frame leaves the outputs alone
+  TEST_ASSERT_EQUAL_INT16(0, decoded.throttle);
+  TEST_ASSERT_EQUAL_UINT8(42, sequence);
+}
+
+void test_short_frame_is_rejected(void) {
+  uint8_t frame[FRAME_SIZE];
+  encodeFrame(sample(1, 2, 3, 4, 5, 6), 9, frame);
+  ChannelData decoded;
+  uint8_t sequence;
+  for (uint8_t length = 0; length < FRAME_SIZE; length++) {
+    TEST_ASSERT_FALSE(decodeFrame(frame, length, decoded, sequence));
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_keeps_every_field);
+  RUN_TEST(test_round_trip_every_channel_value);
+  RUN_TEST(test_switch_positions_round_trip);
+  RUN_TEST(test_channels_clamp_to_eleven_bits);
+  RUN_TEST(test_reserved_bits_and_length);
+  RUN_TEST(test_other_version_is_rejected);
+  RUN_TEST(test_short_frame_is_rejected);
+  return UNITY_END();
+}
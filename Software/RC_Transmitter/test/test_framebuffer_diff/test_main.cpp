@@ -0,0 +1,126 @@
+// OLED page diff (framebuffer_diff.h): each page reports exactly the column
+// window that changed since it was last sent, and nothing when it did not.
+
+#include <unity.h>
+#include <string.h>
+#include <framebuffer_diff.h>
+
+static const uint8_t WIDTH = 128;
+static const uint8_t HEIGHT = 64;
+typedef FramebufferDiff<WIDTH, HEIGHT> Diff;
+
+static uint8_t frame[WIDTH * HEIGHT / 8];
+
+// Takes one full pass, so the shadow matches frame
+static void sync(Diff& diff) {
+  uint8_t first, last;
+  for (uint8_t page = 0; page < Diff::PAGE_COUNT; page++) diff.takeDirtyRange(frame, page, first, last);
+}
+
+static void assertClean(Diff& diff) {
+  uint8_t first, last;
+  for (uint8_t page = 0; page < Diff::PAGE_COUNT; page++) {
+    TEST_ASSERT_FALSE(diff.takeDirtyRange(frame, page, first, last));
+  }
+}
+
+static void assertWindow(Diff& diff, uint8_t page, uint8_t first, uint8_t last) {
+  uint8_t got_first = 0xFF, got_last = 0xFF;
+  TEST_ASSERT_TRUE(diff.takeDirtyRange(frame, page, got_first, got_last));
+  TEST_ASSERT_EQUAL_UINT8(first, got_first);
+  TEST_ASSERT_EQUAL_UINT8(last, got_last);
+}
+
+void setUp(void) {
+  for (uint16_t i = 0; i < sizeof(frame); i++) frame[i] = (uint8_t)(i * 37);
+}
+
+void tearDown(void) {}
+
+void test_first_pass_sends_every_page_whole(void) {
+  Diff diff;
+  for (uint8_t page = 0; page < Diff::PAGE_COUNT; page++) assertWindow(diff, page, 0, WIDTH - 1);
+  assertClean(diff);
+}
+
+void test_single_byte_is_a_one_column_window(void) {
+  Diff diff;
+  sync(diff);
+  frame[3 * WIDTH + 77] ^= 0x10;
+  assertWindow(diff, 3, 77, 77);
+  assertClean(diff);
+}
+
+void test_window_spans_first_to_last_change(void) {
+  Diff diff;
+  sync(diff);
+  frame[5 * WIDTH + 12] ^= 1;
+  frame[5 * WIDTH + 40] ^= 1;
+  frame[5 * WIDTH + 90] ^= 1;
+  frame[6 * WIDTH + 0] ^= 1;
+  frame[6 * WIDTH + WIDTH - 1] ^= 1;
+  uint8_t first, last;
+  for (uint8_t page = 0; page < 5; page++) TEST_ASSERT_FALSE(diff.takeDirtyRange(frame, page, first, last));
+  assertWindow(diff, 5, 12, 90);
+  assertWindow(diff, 6, 0, WIDTH - 1);
+  TEST_ASSERT_FALSE(diff.takeDirtyRange(frame, 7, first, last));
+}
+
+// A change made and undone between passes sends nothing
+void test_reverted_change_is_clean(void) {
+  Diff diff;
+  sync(diff);
+  frame[WIDTH + 9] ^= 0xFF;
+  frame[WIDTH + 9] ^= 0xFF;
+  assertClean(diff);
+}
+
+void test_invalidate_resends_everything(void) {
+  Diff diff;
+  sync(diff);
+  diff.invalidate();
+  for (uint8_t page = 0; page < Diff::PAGE_COUNT; page++) assertWindow(diff, page, 0, WIDTH - 1);
+  assertClean(diff);
+}
+
+// Random edits against a brute-force diff of the shown and the new frame
+void test_random_edits_match_a_full_compare(void) {
+  Diff diff;
+  sync(diff);
+  static uint8_t shown[sizeof(frame)];
+  memcpy(shown, frame, sizeof(frame));
+  uint32_t state = 0xC0FFEE;
+  for (uint16_t round = 0; round < 500; round++) {
+    uint8_t edits = round % 7;
+    for (uint8_t e = 0; e < edits; e++) {
+      state = state * 1664525u + 1013904223u;
+      frame[(state >> 8) % sizeof(frame)] ^= (uint8_t)(1 << ((state >> 4) & 7));
+    }
+    for (uint8_t page = 0; page < Diff::PAGE_COUNT; page++) {
+      int16_t first = -1, last = -1;
+      for (uint8_t x = 0; x < WIDTH; x++) {
+        if (frame[page * WIDTH + x] == shown[page * WIDTH + x]) continue;
+        if (first < 0) first = x;
+        last = x;
+      }
+      if (first < 0) {
+        uint8_t a, b;
+        TEST_ASSERT_FALSE(diff.takeDirtyRange(frame, page, a, b));
+      } else {
+        assertWindow(diff, page, (uint8_t)first, (uint8_t)last);
+      }
+    }
+    memcpy(shown, frame, sizeof(frame));
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_pass_sends_every_page_whole);
+  RUN_TEST(test_single_byte_is_a_one_column_window);
+  RUN_TEST(test_window_spans_first_to_last_change);
+  RUN_TEST(test_reverted_change_is_clean);
+  RUN_TEST(test_invalidate_resends_everything);
+  RUN_TEST(test_random_edits_match_a_full_compare);
+  return UNITY_END();
+}
@@ -0,0 +1,108 @@
+// Channel hopping with the blacklist against a fixed channel, on the mock
+// radio with a busy Wi-Fi channel 13 over the fixed channel and a blackout
+// every minute, as in the simulator's interference runs. Hopping has to
+// deliver clearly more, and get the link back within one pass through the
+// hop order after every blackout.
+
+#include <unity.h>
+#include "hal.h"
+#include "channel_blacklist.h"
+
+void setup();
+void loop();
+
+extern Runtime runtime;
+extern RadioDriver radio;
+extern ChannelBlacklist channel_blacklists[MAX_RECEIVERS];
+
+static const uint64_t FRAME_US = 20000;         // Single receiver at 50 Hz
+static const uint64_t MINUTE_US = 60000000;
+static const uint8_t OUTAGES = 5;
+static const uint64_t OUTAGE_STEP_US = 500000;   // 0.5 to 2.5 s in turn
+static const uint64_t RESYNC_BOUND_US = (HOP_CHANNEL_COUNT + 1) * FRAME_US;
+
+struct Run {
+  uint32_t writes;
+  uint32_t delivered;
+  uint32_t failsafes;
+  uint32_t resyncs;
+  uint64_t resync_max_us;   // Highest since boot
+};
+
+static Run fixed_run, hopping_run;
+
+static void runFor(uint64_t span_us) {
+  uint64_t end_us = sim_clock.now() + span_us;
+  while (sim_clock.now() < end_us) {
+    loop();
+  }
+}
+
+static void setHopping(bool on) {
+  Serial.inject(on ? "H0 1\n" : "H0 0\n");
+  runtime.wakeUi();
+  runFor(50000);
+  radio.setReceiverHopping(0, on);
+}
+
+// One minute per outage, each blackout starting halfway through
+static Run measure() {
+  const RadioPipeStats& pipe = radio.pipe(0);
+  Run start = { pipe.writes, pipe.delivered, pipe.failsafes, pipe.resyncs, 0 };
+
+  for (uint8_t i = 0; i < OUTAGES; i++) {
+    uint64_t outage_us = OUTAGE_STEP_US * (1 + i);
+    runFor(MINUTE_US / 2);
+    radio.setBlackout(true);
+    runFor(outage_us);
+    radio.setBlackout(false);
+    runFor(MINUTE_US / 2 - outage_us);
+  }
+
+  Run run = { pipe.writes - start.writes, pipe.delivered - start.delivered,
+              pipe.failsafes - start.failsafes, pipe.resyncs - start.resyncs, pipe.resync_max_us };
+  return run;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fixed_channel_baseline(void) {
+  setHopping(false);
+  runFor(10000000);
+  fixed_run = measure();
+  // The fixed channel sits in the busy band
+  TEST_ASSERT_LESS_THAN(60, 100 * fixed_run.delivered / fixed_run.writes);
+  TEST_ASSERT_EQUAL_UINT32(OUTAGES, fixed_run.resyncs);
+}
+
+void test_hopping_delivers_more_than_fixed(void) {
+  setHopping(true);
+  runFor(10000000);
+  hopping_run = measure();
+  TEST_ASSERT_GREATER_THAN(0, channel_blacklists[0].blocked());
+  TEST_ASSERT_GREATER_OR_EQUAL(93, 100 * hopping_run.delivered / hopping_run.writes);
+  TEST_ASSERT_GREATER_THAN(fixed_run.delivered + fixed_run.writes / 3, hopping_run.delivered);
+  // Outputs only fall back to failsafe during the blackouts themselves
+  TEST_ASSERT_LESS_OR_EQUAL(OUTAGES, hopping_run.failsafes);
+}
+
+// Longer blackouts outlast LINK_LOST_MS, so both ends are back on all
+// channels, the busy ones included
+void test_hopping_resyncs_within_a_pass(void) {
+  TEST_ASSERT_EQUAL_UINT32(OUTAGES, hopping_run.resyncs);
+  TEST_ASSERT_GREATER_THAN(0, hopping_run.resync_max_us);
+  TEST_ASSERT_LESS_OR_EQUAL(RESYNC_BOUND_US, hopping_run.resync_max_us);
+}
+
+int main(int argc, char** argv) {
+  memset(sim_pins, HIGH, sizeof(sim_pins));
+  setup();
+  radio.setChannelLoss(61, 83, 70);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_channel_baseline);
+  RUN_TEST(test_hopping_delivers_more_than_fixed);
+  RUN_TEST(test_hopping_resyncs_within_a_pass);
+  return UNITY_END();
+}
@@ -0,0 +1,136 @@
+// Input filter chain (input_filter.h) on step, spike and ramp input at the
+// transmitter's 5 ms sample period: exact final values, no overshoot,
+// and each stage doing only what it is set to.
+
+#include <unity.h>
+#include <vector>
+#include <input_filter.h>
+
+static const uint32_t PERIOD_US = 5000;     // Transmitter slot interval
+
+static ChannelFilter makeFilter(uint8_t median, uint8_t smoothing, uint8_t deadband, uint16_t slew) {
+  ChannelFilter filter = { median, smoothing, deadband, 0, slew };
+  return filter;
+}
+
+// Output for each input value, from a fresh filter
+static std::vector<int16_t> run(const ChannelFilter& settings, const std::vector<int16_t>& input) {
+  InputFilter filter;
+  filter.configure(settings, PERIOD_US);
+  std::vector<int16_t> output;
+  for (size_t i = 0; i < input.size(); i++) output.push_back(filter.apply(input[i]));
+  return output;
+}
+
+static std::vector<int16_t> stepInput(int16_t from, int16_t to, size_t before, size_t after) {
+  std::vector<int16_t> input(before, from);
+  input.insert(input.end(), after, to);
+  return input;
+}
+
+// First sample from start at which output has reached target within tolerance for good
+static int settleIndex(const std::vector<int16_t>& output, size_t start, int16_t target, int16_t tolerance) {
+  int settled = -1;
+  for (size_t i = start; i < output.size(); i++) {
+    int16_t error = output[i] > target ? output[i] - target : target - output[i];
+    if (error > tolerance) settled = -1;
+    else if (settled < 0) settled = (int)(i - start);
+  }
+  return settled;
+}
+
+static void assertCleanStep(const ChannelFilter& settings) {
+  std::vector<int16_t> output = run(settings, stepInput(0, 400, 10, 200));
+  for (size_t i = 10; i < output.size(); i++) {
+    TEST_ASSERT_LESS_OR_EQUAL(400, output[i]);
+    TEST_ASSERT_GREATER_OR_EQUAL(output[i - 1], output[i]);
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(0, settleIndex(output, 10, 400, 0));
+  TEST_ASSERT_EQUAL_INT16(400, output.back());
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_constant_input_holds(void) {
+  const ChannelFilter settings[] = {
+    makeFilter(0, 0, 0, 0), makeFilter(1, 64, 2, 0), makeFilter(1, 255, 0, 0), makeFilter(1, 128, 0, 100),
+  };
+  const int16_t values[] = { -511, -37, 0, 123, 512 };
+  for (size_t s = 0; s < sizeof(settings) / sizeof(settings[0]); s++) {
+    for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+      // The deadband shifts values, compare against a single pass
+      InputFilter reference;
+      reference.configure(settings[s], PERIOD_US);
+      int16_t expected = reference.apply(values[v]);
+      std::vector<int16_t> output = run(settings[s], std::vector<int16_t>(200, values[v]));
+      for (size_t i = 0; i < output.size(); i++) TEST_ASSERT_EQUAL_INT16(expected, output[i]);
+    }
+  }
+}
+
+void test_default_step_is_monotonic_and_exact(void) {
+  assertCleanStep(makeFilter(1, 64, 0, 0));
+}
+
+void test_heavy_smoothing_is_slower_but_exact(void) {
+  assertCleanStep(makeFilter(1, 224, 0, 0));
+  std::vector<int16_t> light = run(makeFilter(1, 64, 0, 0), stepInput(0, 400, 10, 200));
+  std::vector<int16_t> heavy = run(makeFilter(1, 224, 0, 0), stepInput(0, 400, 10, 200));
+  TEST_ASSERT_GREATER_THAN(settleIndex(light, 10, 400, 40), settleIndex(heavy, 10, 400, 40));
+}
+
+void test_median_removes_a_single_spike(void) {
+  std::vector<int16_t> input(100, 100);
+  input[50] = 500;
+  int16_t worst[2] = {0, 0};
+  for (uint8_t median = 0; median < 2; median++) {
+    std::vector<int16_t> output = run(makeFilter(median, 64, 0, 0), input);
+    for (size_t i = 0; i < output.size(); i++) {
+      int16_t error = output[i] > 100 ? output[i] - 100 : 100 - output[i];
+      if (error > worst[median]) worst[median] = error;
+    }
+  }
+  TEST_ASSERT_EQUAL_INT16(0, worst[1]);
+  TEST_ASSERT_GREATER_THAN(0, worst[0]);
+}
+
+void test_deadband_keeps_full_scale(void) {
+  const uint8_t band = 10;
+  InputFilter filter;
+  filter.configure(makeFilter(0, 0, band, 0), PERIOD_US);
+  int16_t previous = -32768;
+  for (int16_t value = ChannelMapper::OUTPUT_MIN; value <= ChannelMapper::OUTPUT_MAX; value++) {
+    filter.restart();
+    int16_t output = filter.apply(value);
+    if (value >= -band && value <= band) TEST_ASSERT_EQUAL_INT16(0, output);
+    TEST_ASSERT_GREATER_OR_EQUAL(previous, output);
+    previous = output;
+  }
+  filter.restart();
+  TEST_ASSERT_EQUAL_INT16(ChannelMapper::OUTPUT_MAX, filter.apply(ChannelMapper::OUTPUT_MAX));
+  filter.restart();
+  TEST_ASSERT_EQUAL_INT16(ChannelMapper::OUTPUT_MIN, filter.apply(ChannelMapper::OUTPUT_MIN));
+}
+
+void test_slew_limits_the_rate(void) {
+  const uint16_t rate = 2000;    // Units per second, 10 per 5 ms sample
+  std::vector<int16_t> output = run(makeFilter(0, 0, 0, rate), stepInput(-500, 500, 10, 200));
+  for (size_t i = 1; i < output.size(); i++) {
+    int16_t change = output[i] > output[i - 1] ? output[i] - output[i - 1] : output[i - 1] - output[i];
+    TEST_ASSERT_LESS_OR_EQUAL(10, change);
+  }
+  int expected = 1000 * 1000 / rate / (int)(PERIOD_US / 1000);
+  TEST_ASSERT_EQUAL_INT(expected, settleIndex(output, 10, 500, 0) + 1);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_constant_input_holds);
+  RUN_TEST(test_default_step_is_monotonic_and_exact);
+  RUN_TEST(test_heavy_smoothing_is_slower_but_exact);
+  RUN_TEST(test_median_removes_a_single_spike);
+  RUN_TEST(test_deadband_keeps_full_scale);
+  RUN_TEST(test_slew_limits_the_rate);
+  return UNITY_END();
+}
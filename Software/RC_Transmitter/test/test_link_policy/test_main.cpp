@@ -0,0 +1,204 @@
+// Link profile policy (link_quality.h) against a link-margin loss model:
+// it reacts to a worse link within a second and to a better one within an
+// averaging span or two, and at steady loss it settles instead of
+// flapping between neighbouring profiles.
+
+#include <unity.h>
+#include <math.h>
+#include <link_quality.h>
+
+static const uint32_t FRAME_MS = 20;            // One receiver at 50 Hz
+static const uint32_t HOUR_MS = 3600000;
+
+// One failed probe of a cheaper profile per longest hold-off, and the odd
+// step up and back for a real loss burst
+static const uint32_t STEADY_CHANGES_PER_HOUR = 2 * HOUR_MS / LinkPolicy::MAX_HOLD_DOWN_MS + 4;
+static const uint32_t WORSE_REACTION_MS = 1000;
+static const uint32_t BETTER_REACTION_MS = 45000;
+
+// Per-attempt loss from the link margin, as in the mock radio: loss_percent
+// applies at 2 Mbps and max power, lower PA levels cost margin and slower
+// rates gain it
+class MarginLink {
+private:
+  uint32_t state;
+  double reference_margin_db;
+
+public:
+  MarginLink() : state(0x11A7), reference_margin_db(100) {}
+
+  void setLossPercent(double percent) {
+    reference_margin_db = 3.0 * log((100 - percent) / percent);
+  }
+
+  double attemptLoss(uint8_t profile) const {
+    static const double PA_OFFSET_DB[] = { -18, -12, -6, 0 };
+    static const double RATE_OFFSET_DB[] = { 3, 0, 12 };   // 1M, 2M, 250K
+    const LinkProfile& link = LINK_PROFILES[profile];
+    double margin = reference_margin_db + PA_OFFSET_DB[link.pa_level] + RATE_OFFSET_DB[link.data_rate];
+    return 1.0 / (1.0 + exp(margin / 3.0));
+  }
+
+  // Sends one frame with auto-retransmit, returns the retransmit count
+  bool send(uint8_t profile, uint8_t& arc) {
+    double loss = attemptLoss(profile);
+    for (arc = 0; arc <= LINK_PROFILES[profile].retry_count; arc++) {
+      state = state * 1664525u + 1013904223u;
+      if ((state >> 8) / 16777216.0 >= loss) return true;
+    }
+    arc = LINK_PROFILES[profile].retry_count;
+    return false;
+  }
+};
+
+static LinkPolicy* policy;
+static MarginLink* radio;
+static uint32_t now_ms;
+static uint32_t delivered;
+static uint32_t frames;
+
+// One frame per FRAME_MS; a pending change goes out in place of a data
+// frame, as transmitData() does
+static void runFor(uint32_t span_ms) {
+  for (uint32_t end_ms = now_ms + span_ms; now_ms < end_ms; now_ms += FRAME_MS) {
+    uint8_t profile = policy->profile();
+    uint8_t arc;
+    uint8_t next;
+    bool ok = radio->send(profile, arc);
+    if (policy->pendingChange(next)) {
+      policy->recordControl(ok, next, now_ms);
+    } else {
+      policy->record(ok, arc, now_ms);
+      frames++;
+      if (ok) delivered++;
+    }
+  }
+}
+
+// Time from now until the profile first changes, or span_ms if it does not
+static uint32_t reactionWithin(uint32_t span_ms) {
+  uint32_t changes = policy->changes();
+  uint32_t start_ms = now_ms;
+  while (policy->changes() == changes && now_ms - start_ms < span_ms) {
+    runFor(FRAME_MS);
+  }
+  return now_ms - start_ms;
+}
+
+static void assertSettles(double loss_percent) {
+  radio->setLossPercent(loss_percent);
+  runFor(HOUR_MS);
+  uint32_t changes = policy->changes();
+  delivered = 0;
+  frames = 0;
+  runFor(HOUR_MS);
+
+  char message[64];
+  snprintf(message, sizeof(message), "%.0f%% loss, on profile %u", loss_percent, policy->profile());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(STEADY_CHANGES_PER_HOUR, policy->changes() - changes, message);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(frames * 995 / 1000, delivered, message);
+}
+
+// Settles at from_percent, then steps to to_percent
+static uint32_t stepReaction(double from_percent, double to_percent, uint32_t bound_ms) {
+  radio->setLossPercent(from_percent);
+  runFor(HOUR_MS / 2);
+  radio->setLossPercent(to_percent);
+  return reactionWithin(bound_ms + FRAME_MS);
+}
+
+void setUp(void) {
+  policy = new LinkPolicy();
+  radio = new MarginLink();
+  now_ms = 0;
+  delivered = 0;
+  frames = 0;
+}
+
+void tearDown(void) {
+  delete policy;
+  delete radio;
+}
+
+void test_settles_on_a_clean_link(void) {
+  assertSettles(1);
+}
+
+void test_settles_at_moderate_loss(void) {
+  assertSettles(5);
+}
+
+void test_settles_at_ten_percent_loss(void) {
+  assertSettles(10);
+}
+
+void test_settles_at_heavy_loss(void) {
+  assertSettles(20);
+}
+
+void test_settles_at_very_heavy_loss(void) {
+  assertSettles(30);
+}
+
+void test_reacts_to_a_worse_link(void) {
+  uint8_t before = 0;
+  radio->setLossPercent(2);
+  runFor(HOUR_MS / 2);
+  before = policy->profile();
+  radio->setLossPercent(30);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(WORSE_REACTION_MS, reactionWithin(WORSE_REACTION_MS + FRAME_MS));
+  runFor(10000);
+  TEST_ASSERT_GREATER_THAN_UINT8(before, policy->profile());
+
+  // The new profile holds
+  uint32_t changes = policy->changes();
+  runFor(HOUR_MS / 4);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(STEADY_CHANGES_PER_HOUR / 4, policy->changes() - changes);
+}
+
+void test_reacts_to_a_better_link(void) {
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(BETTER_REACTION_MS, stepReaction(20, 5, BETTER_REACTION_MS));
+}
+
+// A failed probe of the cheaper profile has grown its hold-off; the link
+// getting much better starts it over
+void test_reacts_to_a_better_link_after_failed_probes(void) {
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(BETTER_REACTION_MS, stepReaction(10, 1, BETTER_REACTION_MS));
+  tearDown();
+  setUp();
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(BETTER_REACTION_MS, stepReaction(40, 2, BETTER_REACTION_MS));
+}
+
+// Every profile goes quiet in a blackout, it is no reason to hold off
+void test_blackout_does_not_grow_the_hold_off(void) {
+  radio->setLossPercent(2);
+  runFor(HOUR_MS / 4);
+  uint8_t before = policy->profile();
+  uint32_t hold_ms = policy->holdDown();
+
+  radio->setLossPercent(99.999);
+  runFor(2 * LINK_LOST_MS);
+  TEST_ASSERT_EQUAL_UINT8(LINK_FALLBACK_PROFILE, policy->profile());
+
+  radio->setLossPercent(2);
+  uint32_t start_ms = now_ms;
+  while (policy->profile() != before && now_ms - start_ms < 2 * BETTER_REACTION_MS) {
+    runFor(FRAME_MS);
+  }
+  TEST_ASSERT_EQUAL_UINT8(before, policy->profile());
+  TEST_ASSERT_EQUAL_UINT32(hold_ms, policy->holdDown());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_settles_on_a_clean_link);
+  RUN_TEST(test_settles_at_moderate_loss);
+  RUN_TEST(test_settles_at_ten_percent_loss);
+  RUN_TEST(test_settles_at_heavy_loss);
+  RUN_TEST(test_settles_at_very_heavy_loss);
+  RUN_TEST(test_reacts_to_a_worse_link);
+  RUN_TEST(test_reacts_to_a_better_link);
+  RUN_TEST(test_reacts_to_a_better_link_after_failed_probes);
+  RUN_TEST(test_blackout_does_not_grow_the_hold_off);
+  return UNITY_END();
+}
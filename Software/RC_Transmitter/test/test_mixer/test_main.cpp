@@ -0,0 +1,217 @@
+// Mixer (mixer.h) against known mixes: the presets, curves, offsets,
+// switch sources, and programs the compiler has to accept or reject.
+
+#include <unity.h>
+#include <vector>
+#include <mixer.h>
+
+static ChannelData sticks(int16_t throttle, int16_t pitch, int16_t roll, int16_t yaw) {
+  ChannelData data = {};
+  data.throttle = throttle;
+  data.pitch = pitch;
+  data.roll = roll;
+  data.yaw = yaw;
+  data.aux1 = 123;
+  data.aux2 = -45;
+  return data;
+}
+
+static ChannelData mixed(const MixProgram& program, ChannelData data) {
+  program.apply(data);
+  return data;
+}
+
+static MixProgram preset(uint8_t index) {
+  MixProgram program;
+  program.compile(MIX_PRESETS[index].rules, MIX_PRESETS[index].rule_count);
+  return program;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_none_passes_through(void) {
+  MixProgram program = preset(MIX_PRESET_NONE);
+  TEST_ASSERT_EQUAL_UINT8(MIX_OUTPUT_COUNT, program.termCount());
+  for (int16_t value = -511; value <= 512; value += 7) {
+    ChannelData in = sticks(value, value == -511 ? 512 : -value, value / 2, value / 3);
+    ChannelData out = mixed(program, in);
+    TEST_ASSERT_EQUAL_INT16(in.throttle, out.throttle);
+    TEST_ASSERT_EQUAL_INT16(in.pitch, out.pitch);
+    TEST_ASSERT_EQUAL_INT16(in.roll, out.roll);
+    TEST_ASSERT_EQUAL_INT16(in.yaw, out.yaw);
+    TEST_ASSERT_EQUAL_INT16(in.aux1, out.aux1);
+    TEST_ASSERT_EQUAL_INT16(in.aux2, out.aux2);
+  }
+}
+
+void test_elevon(void) {
+  MixProgram program = preset(MIX_PRESET_ELEVON);
+  ChannelData up = mixed(program, sticks(0, 512, 0, 0));
+  ChannelData right = mixed(program, sticks(0, 0, 512, 0));
+  ChannelData both = mixed(program, sticks(0, 512, 512, 0));
+  ChannelData left_down = mixed(program, sticks(0, -511, -511, 0));
+  TEST_ASSERT_EQUAL_INT16(256, up.pitch);
+  TEST_ASSERT_EQUAL_INT16(256, up.roll);
+  TEST_ASSERT_EQUAL_INT16(256, right.pitch);
+  TEST_ASSERT_EQUAL_INT16(-256, right.roll);
+  TEST_ASSERT_EQUAL_INT16(512, both.pitch);
+  TEST_ASSERT_EQUAL_INT16(0, both.roll);
+  TEST_ASSERT_EQUAL_INT16(-511, left_down.pitch);
+  TEST_ASSERT_EQUAL_INT16(0, left_down.roll);
+  TEST_ASSERT_EQUAL_INT16(0, up.throttle);
+  TEST_ASSERT_EQUAL_INT16(0, up.yaw);
+  TEST_ASSERT_EQUAL_INT16(123, up.aux1);
+}
+
+void test_vtail(void) {
+  MixProgram program = preset(MIX_PRESET_VTAIL);
+  ChannelData up = mixed(program, sticks(0, 400, 0, 0));
+  ChannelData rudder = mixed(program, sticks(0, 0, 0, 400));
+  TEST_ASSERT_EQUAL_INT16(200, up.pitch);
+  TEST_ASSERT_EQUAL_INT16(200, up.yaw);
+  TEST_ASSERT_EQUAL_INT16(200, rudder.pitch);
+  TEST_ASSERT_EQUAL_INT16(-200, rudder.yaw);
+  TEST_ASSERT_EQUAL_INT16(0, up.roll);
+}
+
+void test_differential_saturates_the_outer_motor(void) {
+  MixProgram program = preset(MIX_PRESET_DIFFERENTIAL);
+  ChannelData ahead = mixed(program, sticks(300, 0, 0, 0));
+  ChannelData spin = mixed(program, sticks(0, 0, 0, 200));
+  ChannelData turn = mixed(program, sticks(400, 0, 0, 300));
+  ChannelData reverse = mixed(program, sticks(-511, 0, 0, -100));
+  TEST_ASSERT_EQUAL_INT16(300, ahead.throttle);
+  TEST_ASSERT_EQUAL_INT16(300, ahead.yaw);
+  TEST_ASSERT_EQUAL_INT16(200, spin.throttle);
+  TEST_ASSERT_EQUAL_INT16(-200, spin.yaw);
+  TEST_ASSERT_EQUAL_INT16(512, turn.throttle);
+  TEST_ASSERT_EQUAL_INT16(100, turn.yaw);
+  TEST_ASSERT_EQUAL_INT16(-511, reverse.throttle);
+  TEST_ASSERT_EQUAL_INT16(-411, reverse.yaw);
+}
+
+void test_gyro_adds_tilt(void) {
+  MixProgram program = preset(MIX_PRESET_GYRO);
+  ChannelData level = sticks(100, 200, -300, 50);
+  ChannelData tilted = level;
+  ChannelData full = level;
+  program.apply(level);
+  program.apply(tilted, 150, 100);
+  program.apply(full, 512, -511);
+  TEST_ASSERT_EQUAL_INT16(200, level.pitch);
+  TEST_ASSERT_EQUAL_INT16(-300, level.roll);
+  TEST_ASSERT_EQUAL_INT16(350, tilted.pitch);
+  TEST_ASSERT_EQUAL_INT16(-200, tilted.roll);
+  TEST_ASSERT_EQUAL_INT16(512, full.pitch);
+  TEST_ASSERT_EQUAL_INT16(-511, full.roll);
+  TEST_ASSERT_EQUAL_INT16(100, tilted.throttle);
+  TEST_ASSERT_EQUAL_INT16(50, tilted.yaw);
+}
+
+void test_curve_follows_its_points(void) {
+  const MixRule rules[] = { { MIX_PITCH, MIX_PITCH, 100, 0, 0 } };
+  MixProgram program;
+  TEST_ASSERT_TRUE(program.compile(rules, 1));
+  const MixCurve& curve = MIX_CURVES[0];
+  const int16_t inputs[] = { -512, -256, 0, 256, 512 };
+  for (uint8_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL_INT16(inputs[i] == -512 ? -511 : curve.points[i],
+                            mixed(program, sticks(0, inputs[i], 0, 0)).pitch);
+  }
+  // Linear between points
+  TEST_ASSERT_EQUAL_INT16((curve.points[2] + curve.points[3]) / 2, mixed(program, sticks(0, 128, 0, 0)).pitch);
+}
+
+void test_offsets_add_and_saturate(void) {
+  const MixRule rules[] = {
+    { MIX_AUX1, MIX_AUX1, 100, MIX_NO_CURVE, 50 },
+    { MIX_AUX2, MIX_AUX1, 0, MIX_NO_CURVE, 25 },
+  };
+  MixProgram program;
+  program.compile(rules, 2);
+  ChannelData data = sticks(0, 0, 0, 0);
+  TEST_ASSERT_EQUAL_INT16(198, mixed(program, data).aux1);
+  data.aux1 = 500;
+  TEST_ASSERT_EQUAL_INT16(512, mixed(program, data).aux1);
+}
+
+void test_switch_sources_read_as_ends_and_centre(void) {
+  const MixRule rules[] = {
+    { 6, MIX_AUX1, 100, MIX_NO_CURVE, 0 },       // aux3
+    { 10, MIX_AUX2, 100, MIX_NO_CURVE, 0 },      // aux7
+  };
+  MixProgram program;
+  program.compile(rules, 2);
+  ChannelData data = sticks(0, 0, 0, 0);
+  const int8_t positions[] = { -1, 0, 1 };
+  const int16_t expected[] = { -511, 0, 512 };
+  for (uint8_t i = 0; i < 3; i++) {
+    data.aux3 = i == 2;
+    data.aux7 = positions[i];
+    ChannelData out = mixed(program, data);
+    TEST_ASSERT_EQUAL_INT16(data.aux3 ? 512 : -511, out.aux1);
+    TEST_ASSERT_EQUAL_INT16(expected[i], out.aux2);
+  }
+}
+
+void test_invalid_rule_leaves_a_pass_through(void) {
+  const MixRule rules[] = {
+    { MIX_PITCH, MIX_ROLL, 100, MIX_NO_CURVE, 0 },
+    { MIX_SOURCE_COUNT, MIX_PITCH, 100, MIX_NO_CURVE, 0 },
+  };
+  MixProgram program;
+  TEST_ASSERT_FALSE(program.compile(rules, 2));
+  ChannelData out = mixed(program, sticks(10, 20, 30, 40));
+  TEST_ASSERT_EQUAL_INT16(20, out.pitch);
+  TEST_ASSERT_EQUAL_INT16(30, out.roll);
+}
+
+void test_full_matrix_compiles(void) {
+  std::vector<MixRule> rules;
+  for (uint8_t out = 0; out < MIX_OUTPUT_COUNT; out++) {
+    for (uint8_t source = 0; source < MIX_SOURCE_COUNT; source++) {
+      MixRule rule = { source, out, 50, MIX_NO_CURVE, 0 };
+      rules.push_back(rule);
+    }
+  }
+  MixProgram full;
+  TEST_ASSERT_TRUE(full.compile(&rules[0], (uint8_t)rules.size()));
+  TEST_ASSERT_EQUAL_UINT8(MIX_MAX_TERMS, full.termCount());
+}
+
+void test_rules_on_one_output_leave_room_for_pass_throughs(void) {
+  // MIX_MAX_TERMS rules plus an identity term for each other output
+  std::vector<MixRule> rules(MIX_MAX_TERMS);
+  for (uint8_t i = 0; i < MIX_MAX_TERMS; i++) {
+    MixRule rule = { MIX_THROTTLE, MIX_THROTTLE, 1, MIX_NO_CURVE, 0 };
+    rules[i] = rule;
+  }
+  MixProgram program;
+  TEST_ASSERT_TRUE(program.compile(&rules[0], MIX_MAX_TERMS));
+  TEST_ASSERT_EQUAL_UINT8(MIX_MAX_TERMS + MIX_OUTPUT_COUNT - 1, program.termCount());
+  ChannelData out = mixed(program, sticks(256, 20, 30, 40));
+  // 1% compiles to 2/256
+  TEST_ASSERT_EQUAL_INT16((MIX_MAX_TERMS * 2 * 256 + 128) / 256, out.throttle);
+  TEST_ASSERT_EQUAL_INT16(20, out.pitch);
+  TEST_ASSERT_EQUAL_INT16(30, out.roll);
+  TEST_ASSERT_EQUAL_INT16(40, out.yaw);
+  TEST_ASSERT_EQUAL_INT16(123, out.aux1);
+  TEST_ASSERT_EQUAL_INT16(-45, out.aux2);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_none_passes_through);
+  RUN_TEST(test_elevon);
+  RUN_TEST(test_vtail);
+  RUN_TEST(test_differential_saturates_the_outer_motor);
+  RUN_TEST(test_gyro_adds_tilt);
+  RUN_TEST(test_curve_follows_its_points);
+  RUN_TEST(test_offsets_add_and_saturate);
+  RUN_TEST(test_switch_sources_read_as_ends_and_centre);
+  RUN_TEST(test_invalid_rule_leaves_a_pass_through);
+  RUN_TEST(test_full_matrix_compiles);
+  RUN_TEST(test_rules_on_one_output_leave_room_for_pass_throughs);
+  return UNITY_END();
+}
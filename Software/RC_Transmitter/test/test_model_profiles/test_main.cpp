@@ -0,0 +1,251 @@
+// Model memory in fleet mode: with two receivers sharing the link, each
+// one's frames carry the sticks through its own model's trims, throttle
+// mode and filters, whichever receiver is selected. The sticks are held
+// still, so every decoded frame can be checked against the model.
+
+#include <unity.h>
+#include "hal.h"
+#include "channel_mapper.h"
+#include "input_filter.h"
+#include "trim_buttons.h"
+#include "ui_controller.h"
+
+void setup();
+void loop();
+
+extern Runtime runtime;
+extern RadioDriver radio;
+extern AnalogInputs adc_sampler;
+extern SystemSettings system_settings;
+extern IoExpander pcf8575;
+extern UIController ui_controller;
+
+static const uint16_t RAW_THROTTLE = 1000;
+static const uint16_t RAW_PITCH = 3000;
+static const uint16_t RAW_ROLL = 1500;
+static const uint16_t RAW_YAW = 2100;     // Just off centre
+
+static void runFor(uint64_t span_us) {
+  uint64_t end_us = sim_clock.now() + span_us;
+  while (sim_clock.now() < end_us) {
+    loop();
+  }
+}
+
+static void command(const char* line) {
+  Serial.inject(line);
+  runtime.wakeUi();
+  runFor(200000);
+}
+
+// A menu button press, well short of a long press
+static void pressMenu(uint8_t pin) {
+  sim_pins[pin] = LOW;
+  runFor(100000);
+  sim_pins[pin] = HIGH;
+  runFor(100000);
+}
+
+// From the first main menu entry down to Trim Settings
+static void openTrimScreen() {
+  pressMenu(BTN_DOWN_PIN);
+  pressMenu(BTN_DOWN_PIN);
+  pressMenu(BTN_SELECT_PIN);
+}
+
+// SELECT past the last axis, then back up to the first entry
+static void closeTrimScreen() {
+  for (uint8_t axis = 0; axis < TRIM_AXIS_COUNT; axis++) {
+    pressMenu(BTN_SELECT_PIN);
+  }
+  pressMenu(BTN_UP_PIN);
+  pressMenu(BTN_UP_PIN);
+}
+
+static void pressTrim(uint8_t button) {
+  pcf8575.setLevels(0xFFFF & ~(1 << button));
+  runFor(100000);
+  pcf8575.setLevels(0xFFFF);
+  runFor(100000);
+}
+
+static const ChannelData& decoded(uint8_t receiver_id) {
+  for (uint8_t i = 0; i < radio.pipeCount(); i++) {
+    if (radio.pipe(i).address == BASE_PIPES[receiver_id]) return radio.receiverChannels(i);
+  }
+  TEST_FAIL_MESSAGE("receiver never addressed");
+  return radio.receiverChannels(0);
+}
+
+// A held stick through one slot's mapper and filter, once settled
+static int16_t settled(const ChannelMapper& mapper, uint16_t raw, const ChannelFilter& settings) {
+  InputFilter filter;
+  filter.configure(settings, 5000);
+  int16_t value = 0;
+  for (uint8_t i = 0; i < 100; i++) {
+    value = filter.apply(mapper.map(raw));
+  }
+  return value;
+}
+
+// What the receiver should see through its model with the sticks held
+static void assertOwnModel(uint8_t receiver_id) {
+  const CalibrationData& cal = system_settings.calibration;
+  const ModelProfile& model = system_settings.models[receiver_id];
+  ChannelMapper throttle, pitch, roll, yaw;
+  if (model.throttle_bidirectional) {
+    throttle.configureLinear(0, 4095, 0);
+  } else {
+    throttle.configure(cal.throttle_min, cal.throttle_mid, cal.throttle_max, 0);
+  }
+  pitch.configure(cal.pitch_min, cal.pitch_mid, cal.pitch_max, model.trim.pitch_trim);
+  roll.configure(cal.roll_min, cal.roll_mid, cal.roll_max, model.trim.roll_trim);
+  yaw.configure(cal.yaw_min, cal.yaw_mid, cal.yaw_max, model.trim.yaw_trim);
+
+  const ChannelData& data = decoded(receiver_id);
+  TEST_ASSERT_EQUAL_UINT8(receiver_id, data.receiver_id);
+  TEST_ASSERT_EQUAL_INT16(settled(throttle, RAW_THROTTLE, model.filters[SLOT_THROTTLE]), data.throttle);
+  TEST_ASSERT_EQUAL_INT16(settled(pitch, RAW_PITCH, model.filters[SLOT_PITCH]), data.pitch);
+  TEST_ASSERT_EQUAL_INT16(settled(roll, RAW_ROLL, model.filters[SLOT_ROLL]), data.roll);
+  TEST_ASSERT_EQUAL_INT16(settled(yaw, RAW_YAW, model.filters[SLOT_YAW]), data.yaw);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// The two models differ in every input that is not the mix
+void test_models_differ(void) {
+  const ModelProfile& first = system_settings.models[0];
+  const ModelProfile& second = system_settings.models[1];
+  TEST_ASSERT_TRUE(first.throttle_bidirectional != second.throttle_bidirectional);
+  TEST_ASSERT_TRUE(first.trim.pitch_trim != second.trim.pitch_trim);
+  TEST_ASSERT_TRUE(first.filters[SLOT_YAW].deadband != second.filters[SLOT_YAW].deadband);
+}
+
+void test_each_receiver_gets_its_own_model(void) {
+  command("F0 50\nF1 50\n");
+  runFor(1000000);
+  assertOwnModel(0);
+  assertOwnModel(1);
+  TEST_ASSERT_TRUE(decoded(0).pitch != decoded(1).pitch);
+  TEST_ASSERT_TRUE(decoded(0).throttle != decoded(1).throttle);
+  TEST_ASSERT_EQUAL_INT16(0, decoded(1).yaw);
+  TEST_ASSERT_TRUE(decoded(0).yaw != 0);
+}
+
+void test_selecting_another_receiver_keeps_each_model(void) {
+  command("R1\n");
+  runFor(1000000);
+  assertOwnModel(0);
+  assertOwnModel(1);
+  command("R0\n");
+  runFor(1000000);
+  assertOwnModel(0);
+  assertOwnModel(1);
+}
+
+// A model edited while another receiver is selected reaches only its own
+// receiver
+void test_editing_a_model_reaches_only_its_receiver(void) {
+  int16_t first_pitch = decoded(0).pitch;
+  system_settings.models[1].trim.pitch_trim = 60;
+  system_settings.models[1].trim.roll_trim = -15;
+  runtime.wakeUi();
+  runFor(1000000);
+  TEST_ASSERT_EQUAL_INT16(first_pitch, decoded(0).pitch);
+  assertOwnModel(0);
+  assertOwnModel(1);
+}
+
+// Trim buttons step the selected model, through the UI task, and the next
+// frames carry the new trim
+void test_trim_button_steps_the_selected_model(void) {
+  int16_t first_trim = system_settings.models[0].trim.pitch_trim;
+  int16_t second_trim = system_settings.models[1].trim.pitch_trim;
+  pressTrim(TRIM_PITCH_UP);
+  TEST_ASSERT_EQUAL_INT16(first_trim + TRIM_STEP, system_settings.models[0].trim.pitch_trim);
+  TEST_ASSERT_EQUAL_INT16(second_trim, system_settings.models[1].trim.pitch_trim);
+  assertOwnModel(0);
+  assertOwnModel(1);
+}
+
+// The Trim screen is static, so only a trim change makes it draw again
+void test_trim_button_redraws_the_trim_screen(void) {
+  openTrimScreen();
+  runFor(500000);
+  uint32_t idle_bytes = ui_controller.busBytes();
+  runFor(500000);
+  TEST_ASSERT_EQUAL_UINT32(idle_bytes, ui_controller.busBytes());
+
+  pressTrim(TRIM_ROLL_DOWN);
+  TEST_ASSERT_GREATER_THAN_UINT32(idle_bytes, ui_controller.busBytes());
+  closeTrimScreen();
+}
+
+// UP and DOWN on the Trim screen step the marked axis of the selected
+// model, one way each; SELECT marks the next axis
+void test_trim_screen_steps_the_marked_axis(void) {
+  TrimSettings start = system_settings.models[0].trim;
+  TrimSettings other = system_settings.models[1].trim;
+  openTrimScreen();
+  pressMenu(BTN_UP_PIN);
+  pressMenu(BTN_UP_PIN);
+  pressMenu(BTN_DOWN_PIN);
+  pressMenu(BTN_SELECT_PIN);
+  pressMenu(BTN_DOWN_PIN);
+  pressMenu(BTN_SELECT_PIN);
+  pressMenu(BTN_DOWN_PIN);
+  pressMenu(BTN_DOWN_PIN);
+
+  const TrimSettings& trim = system_settings.models[0].trim;
+  TEST_ASSERT_EQUAL_INT16(start.pitch_trim + TRIM_STEP, trim.pitch_trim);
+  TEST_ASSERT_EQUAL_INT16(start.roll_trim - TRIM_STEP, trim.roll_trim);
+  TEST_ASSERT_EQUAL_INT16(start.yaw_trim - 2 * TRIM_STEP, trim.yaw_trim);
+  TEST_ASSERT_EQUAL_MEMORY(&other, &system_settings.models[1].trim, sizeof(other));
+
+  // Holding DOWN repeats on the same axis
+  sim_pins[BTN_DOWN_PIN] = LOW;
+  runFor(1000000);
+  sim_pins[BTN_DOWN_PIN] = HIGH;
+  runFor(100000);
+  TEST_ASSERT_LESS_THAN(start.yaw_trim - 3 * TRIM_STEP, trim.yaw_trim);
+  TEST_ASSERT_EQUAL_INT16(start.roll_trim - TRIM_STEP, trim.roll_trim);
+  closeTrimScreen();
+  runFor(1000000);
+  assertOwnModel(0);
+  assertOwnModel(1);
+}
+
+int main(int argc, char** argv) {
+  memset(sim_pins, HIGH, sizeof(sim_pins));
+  setup();
+
+  // Off-centre throttle calibration, so the throttle modes map apart
+  system_settings.calibration.throttle_mid = 1500;
+  adc_sampler.setNoise(0);
+  adc_sampler.hold(SLOT_THROTTLE, RAW_THROTTLE);
+  adc_sampler.hold(SLOT_PITCH, RAW_PITCH);
+  adc_sampler.hold(SLOT_ROLL, RAW_ROLL);
+  adc_sampler.hold(SLOT_YAW, RAW_YAW);
+
+  ModelProfile& first = system_settings.models[0];
+  first.trim.pitch_trim = 30;
+  first.throttle_bidirectional = 0;
+  first.filters[SLOT_YAW].deadband = 0;
+  ModelProfile& second = system_settings.models[1];
+  second.trim.pitch_trim = -40;
+  second.trim.roll_trim = 25;
+  second.throttle_bidirectional = 1;
+  second.filters[SLOT_YAW].deadband = 100;
+  second.mix = first.mix;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_models_differ);
+  RUN_TEST(test_each_receiver_gets_its_own_model);
+  RUN_TEST(test_selecting_another_receiver_keeps_each_model);
+  RUN_TEST(test_editing_a_model_reaches_only_its_receiver);
+  RUN_TEST(test_trim_button_steps_the_selected_model);
+  RUN_TEST(test_trim_button_redraws_the_trim_screen);
+  RUN_TEST(test_trim_screen_steps_the_marked_axis);
+  return UNITY_END();
+}
@@ -0,0 +1,56 @@
+// The firmware boots on the mock HAL and drives the selected receiver:
+// setup() and loop() run on the virtual clock as in the simulator.
+
+#include <unity.h>
+#include "hal.h"
+
+void setup();
+void loop();
+
+extern Runtime runtime;
+extern RadioDriver radio;
+
+static void runFor(uint64_t span_us) {
+  uint64_t end_us = sim_clock.now() + span_us;
+  while (sim_clock.now() < end_us) {
+    loop();
+  }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_boots_into_single_receiver_rate(void) {
+  uint32_t writes = radio.writes();
+  runFor(1000000);
+  // 50 Hz to the selected receiver, link-control frames included
+  TEST_ASSERT_INT_WITHIN(2, 50, radio.writes() - writes);
+  TEST_ASSERT_EQUAL_UINT8(1, radio.pipeCount());
+  TEST_ASSERT_EQUAL_HEX64(BASE_PIPES[0], radio.pipe(0).address);
+}
+
+void test_receiver_decodes_every_frame(void) {
+  runFor(2000000);
+  const RadioPipeStats& pipe = radio.pipe(0);
+  TEST_ASSERT_EQUAL_UINT32(pipe.writes, pipe.delivered);
+  TEST_ASSERT_EQUAL_UINT32(0, pipe.undecodable);
+  TEST_ASSERT_EQUAL_UINT32(0, pipe.failsafes);
+}
+
+void test_slots_keep_the_period(void) {
+  const IntervalHistogram& stats = runtime.frameStats();
+  TEST_ASSERT_GREATER_THAN(0, stats.count());
+  TEST_ASSERT_EQUAL_UINT32(5000, stats.minimum());
+  TEST_ASSERT_EQUAL_UINT32(5000, stats.maximum());
+}
+
+int main(int argc, char** argv) {
+  memset(sim_pins, HIGH, sizeof(sim_pins));
+  setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_boots_into_single_receiver_rate);
+  RUN_TEST(test_receiver_decodes_every_frame);
+  RUN_TEST(test_slots_keep_the_period);
+  return UNITY_END();
+}
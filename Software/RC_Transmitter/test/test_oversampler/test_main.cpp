@@ -0,0 +1,133 @@
+// ADC oversampling (oversampler.h) against synthetic sample sources: block
+// means are published once per decimation block, rounded, and the noise on
+// a steady input drops with the square root of the decimation.
+
+#include <unity.h>
+#include <math.h>
+#include <oversampler.h>
+
+// Deterministic 12-bit source: a level with uniform noise of +-spread counts
+class SampleSource {
+private:
+  uint32_t state;
+  uint16_t level;
+  uint16_t spread;
+
+public:
+  SampleSource(uint16_t value, uint16_t noise) : state(0xADC), level(value), spread(noise) {}
+
+  uint16_t next() {
+    state = state * 1664525u + 1013904223u;
+    int32_t value = level + (int32_t)((state >> 8) % (2 * spread + 1)) - spread;
+    return (uint16_t)(value < 0 ? 0 : value > 4095 ? 4095 : value);
+  }
+};
+
+// Standard deviation of the published values over blocks
+static double publishedSpread(uint16_t decimation, uint16_t spread, uint16_t blocks) {
+  Oversampler sampler(decimation);
+  SampleSource source(2048, spread);
+  double sum = 0, sum_squares = 0;
+  for (uint16_t b = 0; b < blocks; b++) {
+    for (uint16_t i = 0; i < decimation; i++) sampler.push(source.next());
+    sum += sampler.latest();
+    sum_squares += (double)sampler.latest() * sampler.latest();
+  }
+  double mean = sum / blocks;
+  return sqrt(sum_squares / blocks - mean * mean);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_publishes_once_per_block(void) {
+  Oversampler sampler(8);
+  for (uint8_t i = 0; i < 7; i++) {
+    sampler.push(1000);
+    TEST_ASSERT_EQUAL_UINT16(0, sampler.latest());
+  }
+  sampler.push(1000);
+  TEST_ASSERT_EQUAL_UINT16(1000, sampler.latest());
+  for (uint8_t i = 0; i < 7; i++) {
+    sampler.push(3000);
+    TEST_ASSERT_EQUAL_UINT16(1000, sampler.latest());
+  }
+  sampler.push(3000);
+  TEST_ASSERT_EQUAL_UINT16(3000, sampler.latest());
+  TEST_ASSERT_EQUAL_UINT32(16, sampler.samples());
+}
+
+void test_block_mean_rounds_to_nearest(void) {
+  Oversampler sampler(4);
+  sampler.push(10);
+  sampler.push(11);
+  sampler.push(11);
+  sampler.push(11);       // 10.75
+  TEST_ASSERT_EQUAL_UINT16(11, sampler.latest());
+  sampler.push(10);
+  sampler.push(10);
+  sampler.push(10);
+  sampler.push(11);       // 10.25
+  TEST_ASSERT_EQUAL_UINT16(10, sampler.latest());
+  for (uint8_t i = 0; i < 4; i++) sampler.push(4095);
+  TEST_ASSERT_EQUAL_UINT16(4095, sampler.latest());
+}
+
+void test_mean_of_a_noisy_level(void) {
+  Oversampler sampler(32);
+  SampleSource source(1234, 40);
+  for (uint16_t i = 0; i < 32 * 100; i++) {
+    sampler.push(source.next());
+    if (i % 32 == 31) TEST_ASSERT_INT_WITHIN(20, 1234, sampler.latest());
+  }
+}
+
+// Alternating a and b has a standard deviation of |a - b| / 2
+void test_noise_is_the_block_spread(void) {
+  Oversampler sampler(16);
+  for (uint8_t i = 0; i < 16; i++) sampler.push(i % 2 ? 2100 : 2000);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 50.0f, sampler.noise());
+  for (uint8_t i = 0; i < 16; i++) sampler.push(777);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, sampler.noise());
+}
+
+// Uniform noise of +-40 counts has a spread of 23; a block of 32 should cut
+// that by about sqrt(32)
+void test_decimation_reduces_noise(void) {
+  double raw = publishedSpread(1, 40, 4000);
+  double decimated = publishedSpread(32, 40, 4000);
+  TEST_ASSERT_FLOAT_WITHIN(2.0, 40 / sqrt(3.0), raw);
+  TEST_ASSERT_TRUE(decimated < raw / sqrt(32.0) * 1.3);
+  TEST_ASSERT_TRUE(decimated < publishedSpread(4, 40, 4000));
+}
+
+void test_set_decimation_drops_the_partial_block(void) {
+  Oversampler sampler(4);
+  sampler.push(4000);
+  sampler.push(4000);
+  sampler.setDecimation(2);
+  sampler.push(100);
+  sampler.push(100);
+  TEST_ASSERT_EQUAL_UINT16(100, sampler.latest());
+}
+
+void test_zero_decimation_passes_samples_through(void) {
+  Oversampler sampler(0);
+  sampler.push(321);
+  TEST_ASSERT_EQUAL_UINT16(321, sampler.latest());
+  sampler.setDecimation(0);
+  sampler.push(123);
+  TEST_ASSERT_EQUAL_UINT16(123, sampler.latest());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_publishes_once_per_block);
+  RUN_TEST(test_block_mean_rounds_to_nearest);
+  RUN_TEST(test_mean_of_a_noisy_level);
+  RUN_TEST(test_noise_is_the_block_spread);
+  RUN_TEST(test_decimation_reduces_noise);
+  RUN_TEST(test_set_decimation_drops_the_partial_block);
+  RUN_TEST(test_zero_decimation_passes_samples_through);
+  return UNITY_END();
+}
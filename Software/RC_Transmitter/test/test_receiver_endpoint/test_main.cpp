@@ -0,0 +1,130 @@
+// Receiver end of the link (receiver_endpoint.h): frames become pulses,
+// silence becomes failsafe after exactly the timeout, and the first
+// decodable frame ends it.
+
+#include <unity.h>
+#include <receiver_endpoint.h>
+
+static ReceiverSettings settings;
+static ReceiverEndpoint endpoint;
+static DeltaEncoder encoder;
+static uint8_t next_sequence;
+
+static ChannelData sample() {
+  ChannelData data = {};
+  data.throttle = -511;
+  data.pitch = 512;
+  data.roll = 256;
+  data.yaw = 0;
+  data.aux1 = -256;
+  data.aux2 = 100;
+  data.aux3 = 1;
+  data.aux7 = -1;
+  data.aux8 = 1;
+  return data;
+}
+
+static uint8_t deliver(const ChannelData& data, uint32_t now_ms) {
+  uint8_t frame[FRAME_SIZE];
+  uint8_t length = encoder.encode(data, next_sequence++, frame);
+  encoder.acknowledge();
+  return endpoint.onFrame(frame, length, now_ms * 1000, now_ms);
+}
+
+void setUp(void) {
+  defaultReceiverSettings(settings);
+  settings.hopping = 0;
+  endpoint = ReceiverEndpoint();
+  encoder = DeltaEncoder();
+  endpoint.bind(BASE_PIPES[0]);
+  next_sequence = 0;
+}
+
+void tearDown(void) {}
+
+void test_waiting_outputs_only_failsafe_pulses(void) {
+  uint16_t pulses[RECEIVER_MAX_OUTPUTS];
+  endpoint.outputs(settings, pulses);
+  TEST_ASSERT_EQUAL_INT(RECEIVER_WAITING, endpoint.state());
+  TEST_ASSERT_EQUAL_UINT16(PULSE_MIN_US, pulses[0]);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_MID_US, pulses[1]);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_OFF, pulses[4]);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_OFF, pulses[11]);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_OFF, pulses[12]);
+}
+
+void test_frame_sets_every_output(void) {
+  TEST_ASSERT_EQUAL_HEX8(RECEIVER_DATA, deliver(sample(), 10));
+  uint16_t pulses[RECEIVER_MAX_OUTPUTS];
+  endpoint.outputs(settings, pulses);
+  const uint16_t expected[RECEIVER_SOURCE_COUNT] = {
+    1001, 2000, 1750, 1500, 1250, 1597, 2000, 1000, 1000, 1000, 1000, 2000
+  };
+  TEST_ASSERT_EQUAL_MEMORY(expected, pulses, sizeof(expected));
+  TEST_ASSERT_EQUAL_UINT16(PULSE_OFF, pulses[RECEIVER_SOURCE_COUNT]);
+}
+
+void test_failsafe_at_the_timeout(void) {
+  deliver(sample(), 100);
+  TEST_ASSERT_EQUAL_HEX8(0, endpoint.poll(settings, 100 + settings.failsafe_ms - 1) & RECEIVER_FAILSAFE);
+  TEST_ASSERT_EQUAL_HEX8(RECEIVER_FAILSAFE, endpoint.poll(settings, 100 + settings.failsafe_ms) & RECEIVER_FAILSAFE);
+  TEST_ASSERT_EQUAL_HEX8(0, endpoint.poll(settings, 100 + 2 * settings.failsafe_ms) & RECEIVER_FAILSAFE);
+  TEST_ASSERT_EQUAL_UINT32(1, endpoint.failsafes());
+
+  // Throttle cuts and the sticks centre, the pots and switches hold
+  uint16_t pulses[RECEIVER_MAX_OUTPUTS];
+  endpoint.outputs(settings, pulses);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_MIN_US, pulses[0]);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_MID_US, pulses[1]);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_MID_US, pulses[2]);
+  TEST_ASSERT_EQUAL_UINT16(1250, pulses[4]);
+  TEST_ASSERT_EQUAL_UINT16(2000, pulses[6]);
+}
+
+void test_first_frame_ends_failsafe(void) {
+  deliver(sample(), 0);
+  endpoint.poll(settings, settings.failsafe_ms);
+  TEST_ASSERT_EQUAL_INT(RECEIVER_IN_FAILSAFE, endpoint.state());
+
+  ChannelData data = sample();
+  data.pitch = -512;
+  TEST_ASSERT_EQUAL_HEX8(RECEIVER_DATA, deliver(data, settings.failsafe_ms + 30));
+  TEST_ASSERT_EQUAL_INT(RECEIVER_ACTIVE, endpoint.state());
+  uint16_t pulses[RECEIVER_MAX_OUTPUTS];
+  endpoint.outputs(settings, pulses);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_MIN_US, pulses[1]);
+}
+
+// A delta whose base the receiver never saw is flagged and does not hold
+// failsafe off
+void test_undecodable_frames_do_not_refresh(void) {
+  deliver(sample(), 0);
+
+  DeltaEncoder other;
+  uint8_t frame[FRAME_SIZE];
+  other.encode(sample(), 200, frame);
+  other.acknowledge();
+  uint8_t length = other.encode(sample(), 201, frame);
+  TEST_ASSERT_TRUE(other.lastWasDelta());
+  TEST_ASSERT_EQUAL_HEX8(RECEIVER_UNDECODABLE, endpoint.onFrame(frame, length, 300000, 300));
+  TEST_ASSERT_EQUAL_HEX8(RECEIVER_FAILSAFE, endpoint.poll(settings, settings.failsafe_ms) & RECEIVER_FAILSAFE);
+}
+
+void test_sequence_gaps_count_as_lost(void) {
+  deliver(sample(), 0);
+  next_sequence += 3;
+  deliver(sample(), 20);
+  TEST_ASSERT_EQUAL_UINT16(3, endpoint.framesLost());
+  TEST_ASSERT_EQUAL_UINT32(2, endpoint.frames());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_waiting_outputs_only_failsafe_pulses);
+  RUN_TEST(test_frame_sets_every_output);
+  RUN_TEST(test_failsafe_at_the_timeout);
+  RUN_TEST(test_first_frame_ends_failsafe);
+  RUN_TEST(test_undecodable_frames_do_not_refresh);
+  RUN_TEST(test_sequence_gaps_count_as_lost);
+  return UNITY_END();
+}
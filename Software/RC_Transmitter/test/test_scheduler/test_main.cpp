@@ -0,0 +1,113 @@
+// Frame scheduling on the virtual clock while the UI task is saturated: the
+// UI sleeps only its one tick minimum, every step holds the UI core for
+// several slots and serial commands keep it redrawing. As task_layout.h
+// places it the control task keeps its period; moved onto the UI core at
+// or below the UI priority it does not.
+
+#include <unity.h>
+#include "hal.h"
+
+void setup();
+void loop();
+
+extern Runtime runtime;
+extern RadioDriver radio;
+
+static const uint32_t SLOT_US = 5000;                    // SLOT_INTERVAL in main.cpp
+static const uint32_t UI_STEP_US = 4 * SLOT_US + 700;   // Off the slot grid on purpose
+static const uint32_t UI_SLEEP_US = 1000;                // The UI task's minimum sleep
+static const uint32_t CONTROL_STEP_US = 300;
+static const uint32_t JITTER_BOUND_US = 100;             // One histogram bucket
+static const uint32_t LOAD_SPAN_US = 5000000;
+
+static void runFor(uint64_t span_us) {
+  uint64_t end_us = sim_clock.now() + span_us;
+  while (sim_clock.now() < end_us) {
+    loop();
+  }
+}
+
+// Saturates the UI for LOAD_SPAN_US with the control task placed as given,
+// leaving the frame stats of that span behind
+static void runUnderUiLoad(int8_t core, uint8_t priority) {
+  runtime.placeControl(core, priority);
+  runtime.setControlLoad(CONTROL_STEP_US);
+  runtime.setUiLoad(UI_STEP_US);
+  runtime.resetStats();
+  for (int i = 0; i < 20; i++) {
+    Serial.inject("hlaspftqcdmkbig");
+    runFor(LOAD_SPAN_US / 20);
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+  runtime.setUiLoad(0);
+  runtime.setControlLoad(0);
+  runtime.placeControl(CONTROL_TASK_CORE, CONTROL_TASK_PRIORITY);
+  runFor(100000);
+}
+
+void test_frames_keep_the_period_under_ui_load(void) {
+  uint32_t ui_steps = runtime.uiSteps();
+  uint32_t control_steps = runtime.controlSteps();
+  runUnderUiLoad(CONTROL_TASK_CORE, CONTROL_TASK_PRIORITY);
+
+  // The UI really was busy the whole time; serial wakes skip a few sleeps
+  ui_steps = runtime.uiSteps() - ui_steps;
+  TEST_ASSERT_GREATER_OR_EQUAL(LOAD_SPAN_US / (UI_STEP_US + UI_SLEEP_US) - 1, ui_steps);
+  TEST_ASSERT_LESS_OR_EQUAL(LOAD_SPAN_US / UI_STEP_US + 1, ui_steps);
+  TEST_ASSERT_INT_WITHIN(1, LOAD_SPAN_US / SLOT_US, runtime.controlSteps() - control_steps);
+
+  const IntervalHistogram& stats = runtime.frameStats();
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(SLOT_US - JITTER_BOUND_US, stats.minimum());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SLOT_US + JITTER_BOUND_US, stats.maximum());
+  TEST_ASSERT_EQUAL_UINT32(0, runtime.missedFrames());
+
+  const RadioPipeStats& pipe = radio.pipe(0);
+  TEST_ASSERT_EQUAL_UINT32(pipe.writes, pipe.delivered);
+  TEST_ASSERT_EQUAL_UINT32(0, pipe.failsafes);
+  // 50 Hz to the selected receiver, every 4th slot
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(4 * SLOT_US + JITTER_BOUND_US, pipe.max_interval_us);
+}
+
+void test_unpinned_control_keeps_the_period(void) {
+  // Free to take either core, it finds the app core idle
+  runUnderUiLoad(TASK_NO_AFFINITY, CONTROL_TASK_PRIORITY);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SLOT_US + JITTER_BOUND_US, runtime.frameStats().maximum());
+  TEST_ASSERT_EQUAL_UINT32(0, runtime.missedFrames());
+}
+
+void test_control_preempting_the_ui_keeps_the_period(void) {
+  runUnderUiLoad(UI_TASK_CORE, CONTROL_TASK_PRIORITY);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SLOT_US + JITTER_BOUND_US, runtime.frameStats().maximum());
+  TEST_ASSERT_EQUAL_UINT32(0, runtime.missedFrames());
+}
+
+void test_control_at_the_ui_priority_waits_for_the_tick(void) {
+  runUnderUiLoad(UI_TASK_CORE, UI_TASK_PRIORITY);
+  // Round robin hands over the core on the next tick at best
+  TEST_ASSERT_GREATER_THAN_UINT32(SLOT_US + JITTER_BOUND_US, runtime.frameStats().maximum());
+}
+
+void test_demoted_control_misses_frames(void) {
+  runUnderUiLoad(UI_TASK_CORE, UI_TASK_PRIORITY - 1);
+  // Each UI step spans four slots, the control step only gets the gap
+  TEST_ASSERT_GREATER_THAN_UINT32(UI_STEP_US - SLOT_US, runtime.frameStats().maximum());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, runtime.missedFrames());
+}
+
+int main(int argc, char** argv) {
+  memset(sim_pins, HIGH, sizeof(sim_pins));
+  setup();
+  runFor(500000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_frames_keep_the_period_under_ui_load);
+  RUN_TEST(test_unpinned_control_keeps_the_period);
+  RUN_TEST(test_control_preempting_the_ui_keeps_the_period);
+  RUN_TEST(test_control_at_the_ui_priority_waits_for_the_tick);
+  RUN_TEST(test_demoted_control_misses_frames);
+  return UNITY_END();
+}
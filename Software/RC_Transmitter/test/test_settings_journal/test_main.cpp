@@ -0,0 +1,236 @@
+// Settings journal (settings_journal.h) on a NOR flash model: wear spread
+// over the sectors, and power cut at every byte of a run of appends that
+// crosses a sector rotation. After the cut, mount() must find each group's
+// newest complete record and the journal must carry on from there.
+
+#include <unity.h>
+#include <vector>
+#include <settings_journal.h>
+
+// NOR flash: erase sets a sector to 0xFF, programming can only clear bits.
+// With a power budget, the write or erase that runs out of it stops half
+// way and every later one is lost until restore().
+class NorFlash {
+private:
+  static const uint16_t SECTOR_SIZE = 4096;
+  uint16_t sector_count;
+  std::vector<uint8_t> memory;
+  std::vector<uint32_t> sector_erases;
+  bool limited;
+  uint32_t budget;      // Bytes left to program, an erase counts as one
+
+public:
+  explicit NorFlash(uint16_t sectors = 4)
+    : sector_count(sectors), memory((size_t)SECTOR_SIZE * sectors, 0xFF),
+      sector_erases(sectors, 0), limited(false), budget(0) {}
+
+  uint16_t sectorSize() const { return SECTOR_SIZE; }
+  uint16_t sectorCount() const { return sector_count; }
+
+  void read(uint32_t offset, uint8_t* data, uint16_t length) const {
+    memcpy(data, &memory[offset], length);
+  }
+
+  void write(uint32_t offset, const uint8_t* data, uint16_t length) {
+    if (limited && budget < length) {
+      length = (uint16_t)budget;
+    }
+    for (uint16_t i = 0; i < length; i++) {
+      memory[offset + i] &= data[i];
+    }
+    if (limited) budget -= length;
+  }
+
+  // A cut erase leaves the first half of the sector erased
+  void erase(uint16_t sector) {
+    size_t start = (size_t)sector * SECTOR_SIZE;
+    if (limited && budget == 0) {
+      memset(&memory[start], 0xFF, SECTOR_SIZE / 2);
+      return;
+    }
+    memset(&memory[start], 0xFF, SECTOR_SIZE);
+    sector_erases[sector]++;
+    if (limited) budget--;
+  }
+
+  void cutPowerAfter(uint32_t bytes) {
+    limited = true;
+    budget = bytes;
+  }
+
+  void restore() { limited = false; }
+  bool powered() const { return !limited || budget > 0; }
+  uint32_t erases(uint16_t sector) const { return sector_erases[sector]; }
+};
+
+typedef SettingsJournal<NorFlash> Journal;
+
+static const uint8_t SCHEMA = 3;
+static const uint8_t GROUPS = 11;     // Live groups of the settings store
+
+// A group's payload: its number and how often it has been written
+struct Payload {
+  uint8_t group;
+  uint32_t version;
+  uint8_t fill[15];
+};
+
+static Payload payload(uint8_t group, uint32_t version) {
+  Payload value;
+  memset(&value, 0, sizeof(value));
+  value.group = group;
+  value.version = version;
+  memset(value.fill, (uint8_t)(group * 31 + version), sizeof(value.fill));
+  return value;
+}
+
+static void assertGroup(Journal& journal, uint8_t group, uint32_t version) {
+  Payload expected = payload(group, version);
+  Payload actual;
+  TEST_ASSERT_TRUE(journal.read(group, &actual, sizeof(actual)));
+  TEST_ASSERT_EQUAL_UINT32(version, actual.version);
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &actual, sizeof(actual));
+}
+
+// Writes each group once, then updates them round robin
+static void appendUpdates(Journal& journal, std::vector<uint32_t>& versions, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint8_t group = (uint8_t)(i % GROUPS);
+    versions[group]++;
+    Payload value = payload(group, versions[group]);
+    journal.append(group, &value, sizeof(value));
+  }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_blank_flash_mounts_empty(void) {
+  NorFlash flash;
+  Journal journal(flash, SCHEMA);
+  TEST_ASSERT_EQUAL_UINT8(0, journal.mount());
+  Payload value;
+  TEST_ASSERT_FALSE(journal.read(0, &value, sizeof(value)));
+  TEST_ASSERT_EQUAL_UINT32(1, journal.erases());
+}
+
+void test_remount_finds_the_newest_records(void) {
+  NorFlash flash;
+  std::vector<uint32_t> versions(GROUPS, 0);
+  {
+    Journal journal(flash, SCHEMA);
+    journal.mount();
+    appendUpdates(journal, versions, 500);
+  }
+  Journal journal(flash, SCHEMA);
+  TEST_ASSERT_EQUAL_UINT8(GROUPS, journal.mount());
+  for (uint8_t g = 0; g < GROUPS; g++) assertGroup(journal, g, versions[g]);
+
+  Journal other_schema(flash, SCHEMA + 1);
+  TEST_ASSERT_EQUAL_UINT8(0, other_schema.mount());
+}
+
+// Sectors are erased in turn, once per sector's worth of updates net of the
+// live groups carried over
+void test_erases_spread_over_the_sectors(void) {
+  NorFlash flash;
+  Journal journal(flash, SCHEMA);
+  journal.mount();
+  std::vector<uint32_t> versions(GROUPS, 0);
+  const uint32_t updates = 20000;
+  appendUpdates(journal, versions, updates);
+
+  uint16_t slots = flash.sectorSize() / Journal::RECORD_SIZE;
+  uint32_t rotations = journal.erases() - 1;
+  TEST_ASSERT_UINT32_WITHIN(1, (updates - slots) / (slots - GROUPS) + 1, rotations);
+
+  uint32_t total = 0;
+  for (uint16_t s = 0; s < flash.sectorCount(); s++) {
+    TEST_ASSERT_UINT32_WITHIN(1, rotations / flash.sectorCount(), flash.erases(s));
+    total += flash.erases(s);
+  }
+  TEST_ASSERT_EQUAL_UINT32(journal.erases(), total);
+}
+
+// Cuts power at every byte of a run of appends that fills the active
+// sector and rotates into the next, then checks each group comes back as
+// its last complete write, or the torn one if that made it whole
+static void cutPowerAtEveryByte(uint16_t sectors, uint32_t before_cut) {
+  const uint32_t cut_run = 24;
+  uint32_t run_bytes = (cut_run + GROUPS) * Journal::RECORD_SIZE + 2;
+
+  for (uint32_t cut = 0; cut <= run_bytes; cut++) {
+    NorFlash flash(sectors);
+    std::vector<uint32_t> versions(GROUPS, 0);
+    std::vector<uint32_t> committed;
+    uint8_t torn_group = GROUPS;
+    {
+      Journal journal(flash, SCHEMA);
+      journal.mount();
+      appendUpdates(journal, versions, before_cut);
+      committed = versions;
+
+      flash.cutPowerAfter(cut);
+      for (uint32_t i = 0; i < cut_run && flash.powered(); i++) {
+        uint8_t group = (uint8_t)((before_cut + i) % GROUPS);
+        Payload value = payload(group, versions[group] + 1);
+        journal.append(group, &value, sizeof(value));
+        versions[group]++;
+        if (flash.powered()) {
+          committed[group] = versions[group];
+        } else {
+          torn_group = group;
+        }
+      }
+      flash.restore();
+    }
+
+    char message[64];
+    snprintf(message, sizeof(message), "%u sectors, power cut after %u bytes", sectors, cut);
+    Journal journal(flash, SCHEMA);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(GROUPS, journal.mount(), message);
+    for (uint8_t g = 0; g < GROUPS; g++) {
+      Payload actual;
+      TEST_ASSERT_TRUE_MESSAGE(journal.read(g, &actual, sizeof(actual)), message);
+      if (g == torn_group && actual.version == versions[g]) committed[g] = versions[g];
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(committed[g], actual.version, message);
+      assertGroup(journal, g, committed[g]);
+    }
+
+    // Carries on through several rotations with only one group changing,
+    // as trim does, so the others must be carried over, and mounts again
+    versions = committed;
+    for (uint16_t i = 0; i < 3 * flash.sectorSize() / Journal::RECORD_SIZE; i++) {
+      versions[0]++;
+      Payload value = payload(0, versions[0]);
+      journal.append(0, &value, sizeof(value));
+    }
+    Journal remounted(flash, SCHEMA);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(GROUPS, remounted.mount(), message);
+    for (uint8_t g = 0; g < GROUPS; g++) assertGroup(remounted, g, versions[g]);
+  }
+}
+
+void test_power_cut_within_a_sector(void) {
+  cutPowerAtEveryByte(4, 20);
+}
+
+void test_power_cut_across_rotation(void) {
+  // The active sector has a few slots left when the cut run starts
+  cutPowerAtEveryByte(4, 60);
+}
+
+void test_power_cut_across_rotation_on_two_sectors(void) {
+  cutPowerAtEveryByte(2, 60 + (64 - GROUPS));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_blank_flash_mounts_empty);
+  RUN_TEST(test_remount_finds_the_newest_records);
+  RUN_TEST(test_erases_spread_over_the_sectors);
+  RUN_TEST(test_power_cut_within_a_sector);
+  RUN_TEST(test_power_cut_across_rotation);
+  RUN_TEST(test_power_cut_across_rotation_on_two_sectors);
+  return UNITY_END();
+}
@@ -0,0 +1,152 @@
+// TDMA fleet mode end to end: fleets set up over serial with F commands,
+// checked against what the mock radio actually wrote. The writes follow
+// the slot cycle, each receiver gets the rate it asked for, a full cycle
+// takes slots from the lowest priority first, and writes to one receiver
+// stay spread over the cycle.
+
+#include <unity.h>
+#include "hal.h"
+#include "tdma_scheduler.h"
+
+void setup();
+void loop();
+
+extern Runtime runtime;
+extern RadioDriver radio;
+
+static const uint64_t SLOT_US = 5000;                    // SLOT_INTERVAL in main.cpp
+static const uint8_t SLOTS = TdmaScheduler::SLOT_COUNT;
+static const uint64_t CYCLE_US = SLOTS * SLOT_US;
+static const uint64_t RATE_SPAN_US = 10 * CYCLE_US;     // Two seconds
+
+// Receiver 0 at 100 Hz, 1 at 50 Hz and 2 at 20 Hz, in priority order
+static const char* const FLEET = "F0 100 2\nF1 50 1\nF2 20 0\n";
+// The cycle build() makes of it, one character per slot, '.' idle
+static const char* const FLEET_CYCLE = "0102010.010.0102010.0102010.010.0102010.";
+
+static void runFor(uint64_t span_us) {
+  uint64_t end_us = sim_clock.now() + span_us;
+  while (sim_clock.now() < end_us) {
+    loop();
+  }
+}
+
+// Sends the commands, then lets the new schedule fill a few cycles
+static void configure(const char* commands) {
+  Serial.inject(commands);
+  runtime.wakeUi();
+  runFor(3 * CYCLE_US);
+}
+
+static uint32_t writesTo(uint8_t receiver_id) {
+  for (uint8_t i = 0; i < radio.pipeCount(); i++) {
+    if (radio.pipe(i).address == BASE_PIPES[receiver_id]) return radio.pipe(i).writes;
+  }
+  return 0;
+}
+
+// Frames per second each receiver got over RATE_SPAN_US
+static void measureRates(uint32_t* rates_hz) {
+  uint32_t before[MAX_RECEIVERS];
+  for (uint8_t id = 0; id < MAX_RECEIVERS; id++) before[id] = writesTo(id);
+  runFor(RATE_SPAN_US);
+  for (uint8_t id = 0; id < MAX_RECEIVERS; id++) {
+    rates_hz[id] = (uint32_t)((writesTo(id) - before[id]) * 1000000ULL / RATE_SPAN_US);
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+  configure("F0 0\nF1 0\nF2 0\nF3 0\nF4 0\nF5 0\nF6 0\nF7 0\n");
+}
+
+void test_writes_follow_the_cycle(void) {
+  configure(FLEET);
+
+  uint8_t cycle[SLOTS];
+  uint8_t busy = 0;
+  for (uint8_t i = 0; i < SLOTS; i++) {
+    if (FLEET_CYCLE[i] != '.') cycle[busy++] = FLEET_CYCLE[i] - '0';
+  }
+
+  // The newest two cycles of writes, oldest first, are that order from
+  // some slot on, one cycle apart
+  int16_t start = -1;
+  for (uint8_t phase = 0; phase < busy && start < 0; phase++) {
+    bool match = true;
+    for (uint8_t j = 0; j < 2 * busy && match; j++) {
+      match = radio.recentWrite(2 * busy - 1 - j).address == BASE_PIPES[cycle[(phase + j) % busy]];
+    }
+    if (match) start = phase;
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(0, start);
+  for (uint8_t j = 0; j < busy; j++) {
+    TEST_ASSERT_EQUAL_UINT64(CYCLE_US, radio.recentWrite(j).time_us - radio.recentWrite(j + busy).time_us);
+  }
+}
+
+void test_receivers_get_their_rates(void) {
+  configure(FLEET);
+  uint32_t rates_hz[MAX_RECEIVERS];
+  measureRates(rates_hz);
+  TEST_ASSERT_INT_WITHIN(1, 100, rates_hz[0]);
+  TEST_ASSERT_INT_WITHIN(1, 50, rates_hz[1]);
+  TEST_ASSERT_INT_WITHIN(1, 20, rates_hz[2]);
+  for (uint8_t id = 3; id < MAX_RECEIVERS; id++) {
+    TEST_ASSERT_EQUAL_UINT32(0, rates_hz[id]);
+  }
+}
+
+// 60 slots asked for out of 40: receiver 1, lowest, gets what is left
+void test_priority_keeps_its_rate_when_oversubscribed(void) {
+  configure("F0 100 2\nF1 150 0\nF2 50 1\n");
+  uint32_t rates_hz[MAX_RECEIVERS];
+  measureRates(rates_hz);
+  TEST_ASSERT_INT_WITHIN(1, 100, rates_hz[0]);
+  TEST_ASSERT_INT_WITHIN(1, 50, rates_hz[2]);
+  TEST_ASSERT_INT_WITHIN(1, 50, rates_hz[1]);
+}
+
+// Even spreading leaves the receiver placed first exactly on its period;
+// the others move to the nearest free slot, never below half of it
+void test_writes_to_one_receiver_stay_apart(void) {
+  configure(FLEET);
+  uint64_t since_us = sim_clock.now();
+  runFor(4 * CYCLE_US);
+
+  const uint32_t periods_us[3] = { 10000, 20000, 50000 };
+  uint64_t last_us[3] = {};
+  uint64_t min_us[3] = { UINT64_MAX, UINT64_MAX, UINT64_MAX };
+  uint64_t max_us[3] = {};
+  for (int16_t i = RadioDriver::LOG_SIZE - 1; i >= 0; i--) {
+    const RadioWrite& write = radio.recentWrite(i);
+    if (write.time_us < since_us) continue;
+    for (uint8_t id = 0; id < 3; id++) {
+      if (write.address != BASE_PIPES[id]) continue;
+      if (last_us[id] != 0) {
+        uint64_t spacing_us = write.time_us - last_us[id];
+        if (spacing_us < min_us[id]) min_us[id] = spacing_us;
+        if (spacing_us > max_us[id]) max_us[id] = spacing_us;
+      }
+      last_us[id] = write.time_us;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT64(periods_us[0], min_us[0]);
+  TEST_ASSERT_EQUAL_UINT64(periods_us[0], max_us[0]);
+  TEST_ASSERT_EQUAL_UINT64(periods_us[1], min_us[1]);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(periods_us[2] / 2, (uint32_t)min_us[2]);
+}
+
+int main(int argc, char** argv) {
+  memset(sim_pins, HIGH, sizeof(sim_pins));
+  setup();
+  runFor(500000);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_writes_follow_the_cycle);
+  RUN_TEST(test_receivers_get_their_rates);
+  RUN_TEST(test_priority_keeps_its_rate_when_oversubscribed);
+  RUN_TEST(test_writes_to_one_receiver_stay_apart);
+  return UNITY_END();
+}
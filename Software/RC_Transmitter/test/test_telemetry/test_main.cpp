@@ -0,0 +1,158 @@
+// Telemetry payloads (telemetry_codec.h) and their history
+// (telemetry_buffer.h): every sensor count and the echo block survive the
+// round trip, short or foreign payloads are rejected, the ring keeps the
+// newest CAPACITY - 1 samples in order once it wraps, and latest() drops
+// samples older than the age asked for.
+
+#include <unity.h>
+#include <telemetry_codec.h>
+#include "telemetry_buffer.h"
+
+static TelemetrySample sample(uint8_t sensor_count, bool echo) {
+  TelemetrySample sample = {};
+  sample.battery_mv = 7412;
+  sample.link_quality = 97;
+  sample.frames_lost = 0xA55A;
+  sample.last_sequence = 201;
+  sample.sensor_count = sensor_count;
+  for (uint8_t i = 0; i < TELEMETRY_MAX_SENSORS; i++) {
+    sample.sensors[i] = i < sensor_count ? (int16_t)(i % 2 ? -1000 * (i + 1) : 300 * (i + 1)) : 0;
+  }
+  sample.echo = echo;
+  if (echo) {
+    sample.probe_us = 0xDEADBEEF;
+    sample.rx_decode_us = 412;
+    sample.rx_output_us = 1530;
+  }
+  return sample;
+}
+
+// A sample that only differs from its neighbours in the ring by its marker
+static TelemetrySample marked(uint16_t marker, uint32_t timestamp = 0) {
+  TelemetrySample entry = sample(0, false);
+  entry.battery_mv = marker;
+  entry.timestamp = timestamp;
+  return entry;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_round_trip_with_every_sensor_count(void) {
+  for (uint8_t echo = 0; echo <= 1; echo++) {
+    for (uint8_t count = 0; count <= TELEMETRY_MAX_SENSORS; count++) {
+      TelemetrySample sent = sample(count, echo);
+      uint8_t payload[TELEMETRY_MAX_SIZE];
+      uint8_t length = encodeTelemetry(sent, payload);
+      TEST_ASSERT_EQUAL_UINT8(TELEMETRY_HEADER_SIZE + count * 2 + (echo ? TELEMETRY_ECHO_SIZE : 0), length);
+
+      // Start from a sample with every field set, sensors and echo included
+      TelemetrySample received = sample(TELEMETRY_MAX_SENSORS, true);
+      received.timestamp = 77;
+      TEST_ASSERT_TRUE(decodeTelemetry(payload, length, received));
+      TEST_ASSERT_EQUAL_UINT16(sent.battery_mv, received.battery_mv);
+      TEST_ASSERT_EQUAL_UINT8(sent.link_quality, received.link_quality);
+      TEST_ASSERT_EQUAL_UINT16(sent.frames_lost, received.frames_lost);
+      TEST_ASSERT_EQUAL_UINT8(sent.last_sequence, received.last_sequence);
+      TEST_ASSERT_EQUAL_UINT8(count, received.sensor_count);
+      // Words past the count read as zero
+      TEST_ASSERT_EQUAL_INT16_ARRAY(sent.sensors, received.sensors, TELEMETRY_MAX_SENSORS);
+      TEST_ASSERT_EQUAL(sent.echo, received.echo);
+      TEST_ASSERT_EQUAL_UINT32(sent.probe_us, received.probe_us);
+      TEST_ASSERT_EQUAL_UINT16(sent.rx_decode_us, received.rx_decode_us);
+      TEST_ASSERT_EQUAL_UINT16(sent.rx_output_us, received.rx_output_us);
+      TEST_ASSERT_EQUAL_UINT32(77, received.timestamp);
+    }
+  }
+}
+
+void test_extra_sensors_are_not_encoded(void) {
+  TelemetrySample sent = sample(TELEMETRY_MAX_SENSORS, false);
+  sent.sensor_count = 7;
+  uint8_t payload[TELEMETRY_MAX_SIZE];
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_SENSORS * 2, encodeTelemetry(sent, payload));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_MAX_SENSORS, payload[1]);
+}
+
+void test_truncated_payload_is_rejected(void) {
+  for (uint8_t echo = 0; echo <= 1; echo++) {
+    for (uint8_t count = 0; count <= TELEMETRY_MAX_SENSORS; count++) {
+      uint8_t payload[TELEMETRY_MAX_SIZE];
+      uint8_t length = encodeTelemetry(sample(count, echo), payload);
+      TelemetrySample received;
+      for (uint8_t cut = 0; cut < length; cut++) {
+        TEST_ASSERT_FALSE(decodeTelemetry(payload, cut, received));
+      }
+    }
+  }
+}
+
+void test_other_version_is_rejected(void) {
+  uint8_t payload[TELEMETRY_MAX_SIZE];
+  uint8_t length = encodeTelemetry(sample(2, true), payload);
+  TelemetrySample received;
+  payload[0] = TELEMETRY_PROTOCOL_VERSION + 1;
+  TEST_ASSERT_FALSE(decodeTelemetry(payload, length, received));
+  payload[0] = 0;
+  TEST_ASSERT_FALSE(decodeTelemetry(payload, length, received));
+}
+
+// The count field has room for 7 words, only 4 are defined
+void test_sensor_count_above_the_maximum_is_rejected(void) {
+  uint8_t payload[TELEMETRY_MAX_SIZE + 6] = {};
+  uint8_t length = encodeTelemetry(sample(TELEMETRY_MAX_SENSORS, false), payload);
+  TelemetrySample received;
+  for (uint8_t count = TELEMETRY_MAX_SENSORS + 1; count <= 7; count++) {
+    payload[1] = count;
+    TEST_ASSERT_FALSE(decodeTelemetry(payload, length, received));
+    TEST_ASSERT_FALSE(decodeTelemetry(payload, TELEMETRY_HEADER_SIZE + count * 2, received));
+  }
+}
+
+void test_ring_keeps_the_newest_after_wrapping(void) {
+  const uint8_t CAPACITY = 4;
+  TelemetryRing<CAPACITY> ring;
+  TEST_ASSERT_EQUAL_UINT8(0, ring.available());
+
+  for (uint16_t pushed = 1; pushed <= 3 * CAPACITY + 1; pushed++) {
+    ring.push(marked(pushed));
+    // The slot after the newest is the one being written next
+    uint8_t expected = pushed < CAPACITY - 1 ? pushed : CAPACITY - 1;
+    TEST_ASSERT_EQUAL_UINT8(expected, ring.available());
+    TEST_ASSERT_EQUAL_UINT32(pushed, ring.total());
+    for (uint8_t age = 0; age < ring.available(); age++) {
+      TEST_ASSERT_EQUAL_UINT16(pushed - age, ring.at(age).battery_mv);
+    }
+  }
+}
+
+void test_store_latest_honours_the_age_limit(void) {
+  TelemetryStore store;
+  TEST_ASSERT_NULL(store.latest(3, 1000, 500));
+
+  store.push(3, marked(1, 1000));
+  store.push(3, marked(2, 1200));
+  const TelemetrySample* latest = store.latest(3, 1700, 500);
+  TEST_ASSERT_NOT_NULL(latest);
+  TEST_ASSERT_EQUAL_UINT16(2, latest->battery_mv);
+  TEST_ASSERT_NULL(store.latest(3, 1701, 500));
+  // Other receivers have their own history
+  TEST_ASSERT_NULL(store.latest(2, 1200, 500));
+
+  // Ages are taken across millis() wrapping
+  store.push(3, marked(3, 0xFFFFFF00));
+  TEST_ASSERT_NOT_NULL(store.latest(3, 0x100, 0x200));
+  TEST_ASSERT_NULL(store.latest(3, 0x101, 0x200));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_with_every_sensor_count);
+  RUN_TEST(test_extra_sensors_are_not_encoded);
+  RUN_TEST(test_truncated_payload_is_rejected);
+  RUN_TEST(test_other_version_is_rejected);
+  RUN_TEST(test_sensor_count_above_the_maximum_is_rejected);
+  RUN_TEST(test_ring_keeps_the_newest_after_wrapping);
+  RUN_TEST(test_store_latest_honours_the_age_limit);
+  return UNITY_END();
+}
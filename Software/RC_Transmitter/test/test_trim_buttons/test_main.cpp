@@ -0,0 +1,238 @@
+// Interrupt-driven trim buttons (trim_buttons.h) against a mock PCF8575
+// that replays bounce patterns on a virtual millisecond clock, with the
+// reader serviced at the UI task's 10 ms period.
+
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include <trim_buttons.h>
+
+static const uint32_t SERVICE_MS = 10;       // UI task period
+
+// PCF8575 stand-in: pins idle high, INT fires on every change and a read
+// returns all 16 pins
+class MockExpander {
+private:
+  uint16_t levels;
+  uint32_t read_count;
+
+public:
+  TrimButtonReader<MockExpander>* reader;
+
+  MockExpander() : levels(0xFFFF), read_count(0), reader(NULL) {}
+
+  uint16_t readAll() {
+    read_count++;
+    return levels;
+  }
+
+  void set(uint8_t pin, bool pressed) {
+    uint16_t next = pressed ? levels & ~(1 << pin) : levels | (1 << pin);
+    if (next == levels) return;
+    levels = next;
+    if (reader) reader->notify();
+  }
+
+  uint32_t reads() const { return read_count; }
+};
+
+// One pin change at a millisecond
+struct Edge {
+  uint32_t at_ms;
+  uint8_t pin;
+  bool pressed;
+};
+
+struct Run {
+  std::vector<TrimEvent> events;
+  std::vector<uint32_t> times;
+  uint32_t reads;
+};
+
+static bool edgeBefore(const Edge& a, const Edge& b) { return a.at_ms < b.at_ms; }
+
+// Replays edges for duration_ms, servicing the reader every SERVICE_MS
+static Run replay(std::vector<Edge> edges, uint32_t duration_ms) {
+  std::stable_sort(edges.begin(), edges.end(), edgeBefore);
+  MockExpander expander;
+  TrimEventQueue queue;
+  TrimButtonReader<MockExpander> reader(expander, queue);
+  expander.reader = &reader;
+
+  Run run;
+  size_t next = 0;
+  for (uint32_t now = 0; now <= duration_ms; now++) {
+    while (next < edges.size() && edges[next].at_ms == now) {
+      expander.set(edges[next].pin, edges[next].pressed);
+      next++;
+    }
+    if (now % SERVICE_MS == 0) {
+      reader.service(now);
+      TrimEvent event;
+      while (queue.pop(event)) {
+        run.events.push_back(event);
+        run.times.push_back(now);
+      }
+    }
+  }
+  run.reads = expander.reads();
+  return run;
+}
+
+// Contact bounce: toggles every millisecond for bounce_ms, settling on pressed
+static void addEdge(std::vector<Edge>& edges, uint32_t at_ms, uint8_t pin, bool pressed, uint32_t bounce_ms) {
+  for (uint32_t t = 0; t < bounce_ms; t++) {
+    Edge edge = { at_ms + t, pin, (t % 2 == 0) == pressed };
+    edges.push_back(edge);
+  }
+  Edge edge = { at_ms + bounce_ms, pin, pressed };
+  edges.push_back(edge);
+}
+
+static uint32_t countType(const Run& run, uint8_t type) {
+  uint32_t count = 0;
+  for (size_t i = 0; i < run.events.size(); i++) {
+    if (run.events[i].type == type) count++;
+  }
+  return count;
+}
+
+static void assertPressRelease(uint32_t bounce_ms) {
+  std::vector<Edge> edges;
+  addEdge(edges, 103, TRIM_ROLL_UP, true, bounce_ms);
+  addEdge(edges, 253, TRIM_ROLL_UP, false, bounce_ms);
+  Run run = replay(edges, 400);
+  TEST_ASSERT_EQUAL_UINT32(2, run.events.size());
+  TEST_ASSERT_EQUAL_UINT8(TRIM_PRESS, run.events[0].type);
+  TEST_ASSERT_EQUAL_UINT8(TRIM_RELEASE, run.events[1].type);
+  TEST_ASSERT_EQUAL_UINT8(TRIM_ROLL_UP, run.events[0].button);
+  TEST_ASSERT_EQUAL_UINT8(TRIM_ROLL_UP, run.events[1].button);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_clean_press_and_release(void) {
+  assertPressRelease(0);
+}
+
+void test_bounce_gives_one_event_per_edge(void) {
+  assertPressRelease(5);
+}
+
+void test_glitch_gives_no_events(void) {
+  std::vector<Edge> edges;
+  Edge down = { 108, TRIM_YAW_DOWN, true };
+  Edge up = { 112, TRIM_YAW_DOWN, false };
+  edges.push_back(down);
+  edges.push_back(up);
+  TEST_ASSERT_EQUAL_UINT32(0, replay(edges, 300).events.size());
+}
+
+void test_hold_repeats(void) {
+  std::vector<Edge> edges;
+  addEdge(edges, 100, TRIM_PITCH_UP, true, 0);
+  addEdge(edges, 1100, TRIM_PITCH_UP, false, 0);
+  Run run = replay(edges, 1300);
+  TEST_ASSERT_EQUAL_UINT32(1, countType(run, TRIM_PRESS));
+  TEST_ASSERT_EQUAL_UINT32(1, countType(run, TRIM_RELEASE));
+  TEST_ASSERT_EQUAL_UINT32(6, countType(run, TRIM_REPEAT));
+  // Pressed at 100, accepted at the 120 service, repeats from 520
+  uint32_t expected_at = 120 + TrimDebouncer::REPEAT_DELAY_MS;
+  for (size_t i = 0; i < run.events.size(); i++) {
+    if (run.events[i].type != TRIM_REPEAT) continue;
+    TEST_ASSERT_EQUAL_UINT32(expected_at, run.times[i]);
+    expected_at += TrimDebouncer::REPEAT_INTERVAL_MS;
+  }
+}
+
+void test_chord(void) {
+  std::vector<Edge> edges;
+  addEdge(edges, 100, TRIM_PITCH_DOWN, true, 3);
+  addEdge(edges, 101, TRIM_YAW_UP, true, 3);
+  addEdge(edges, 300, TRIM_PITCH_DOWN, false, 3);
+  addEdge(edges, 301, TRIM_YAW_UP, false, 3);
+  Run run = replay(edges, 400);
+  bool pitch_press = false, yaw_press = false;
+  for (size_t i = 0; i < run.events.size(); i++) {
+    if (run.events[i].type != TRIM_PRESS) continue;
+    if (run.events[i].button == TRIM_PITCH_DOWN) pitch_press = true;
+    if (run.events[i].button == TRIM_YAW_UP) yaw_press = true;
+  }
+  TEST_ASSERT_TRUE(pitch_press);
+  TEST_ASSERT_TRUE(yaw_press);
+  TEST_ASSERT_EQUAL_UINT32(2, countType(run, TRIM_PRESS));
+  TEST_ASSERT_EQUAL_UINT32(2, countType(run, TRIM_RELEASE));
+}
+
+void test_trim_steps_stop_at_the_limit(void) {
+  TrimSettings trim = { 0, 96, -100 };
+  stepTrim(trim, TRIM_PITCH_UP);
+  stepTrim(trim, TRIM_PITCH_UP);
+  stepTrim(trim, TRIM_ROLL_UP);
+  stepTrim(trim, TRIM_ROLL_UP);
+  stepTrim(trim, TRIM_YAW_DOWN);
+  stepTrim(trim, TRIM_YAW_UP);
+  TEST_ASSERT_EQUAL_INT(8, trim.pitch_trim);
+  TEST_ASSERT_EQUAL_INT(TRIM_LIMIT, trim.roll_trim);
+  TEST_ASSERT_EQUAL_INT(-96, trim.yaw_trim);
+}
+
+// The menu steps an axis directly, the same as that axis's buttons
+void test_axis_steps_match_the_buttons(void) {
+  for (uint8_t axis = 0; axis < TRIM_AXIS_COUNT; axis++) {
+    for (uint8_t up = 0; up <= 1; up++) {
+      TrimSettings by_axis = { 10, -20, 30 };
+      TrimSettings by_button = by_axis;
+      stepTrim(by_axis, axis, up);
+      stepTrim(by_button, axis * 2 + (up ? 0 : 1));
+      TEST_ASSERT_EQUAL_INT(by_button.pitch_trim, by_axis.pitch_trim);
+      TEST_ASSERT_EQUAL_INT(by_button.roll_trim, by_axis.roll_trim);
+      TEST_ASSERT_EQUAL_INT(by_button.yaw_trim, by_axis.yaw_trim);
+    }
+  }
+  TrimSettings trim = { 0, 0, 0 };
+  stepTrim(trim, TRIM_AXIS_ROLL, false);
+  TEST_ASSERT_EQUAL_INT(0, trim.pitch_trim);
+  TEST_ASSERT_EQUAL_INT(-TRIM_STEP, trim.roll_trim);
+  TEST_ASSERT_EQUAL_INT(0, trim.yaw_trim);
+}
+
+void test_full_queue_counts_drops(void) {
+  TrimEventQueue queue;
+  TrimEvent event = { TRIM_ROLL_DOWN, TRIM_REPEAT };
+  uint32_t accepted = 0;
+  for (uint8_t i = 0; i < 20; i++) {
+    if (queue.push(event)) accepted++;
+  }
+  uint32_t taken = 0;
+  while (queue.pop(event)) taken++;
+  TEST_ASSERT_EQUAL_UINT32(15, accepted);
+  TEST_ASSERT_EQUAL_UINT32(15, taken);
+  TEST_ASSERT_EQUAL_UINT32(5, queue.dropped());
+  TEST_ASSERT_TRUE(queue.empty());
+}
+
+// The first service reads once to learn the resting levels, after that
+// only pin changes and held buttons cost a read
+void test_resting_buttons_are_not_read(void) {
+  std::vector<Edge> none;
+  TEST_ASSERT_EQUAL_UINT32(1, replay(none, 10000).reads);
+  std::vector<Edge> hold;
+  addEdge(hold, 0, TRIM_PITCH_UP, true, 5);
+  TEST_ASSERT_LESS_THAN_UINT32(10, replay(hold, 10000).reads);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_press_and_release);
+  RUN_TEST(test_bounce_gives_one_event_per_edge);
+  RUN_TEST(test_glitch_gives_no_events);
+  RUN_TEST(test_hold_repeats);
+  RUN_TEST(test_chord);
+  RUN_TEST(test_trim_steps_stop_at_the_limit);
+  RUN_TEST(test_axis_steps_match_the_buttons);
+  RUN_TEST(test_full_queue_counts_drops);
+  RUN_TEST(test_resting_buttons_are_not_read);
+  return UNITY_END();
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Dumps and plots the transmitter's latency histograms from a serial capture.
+
+Switch the measurement mode on with 'L', let it run, send 'd' and save the
+serial output, e.g. `pio device monitor | tee capture.log`. Then:
+
+    tools/latency_plot.py capture.log              text histograms
+    tools/latency_plot.py capture.log --png out.png  one chart per stage
+
+Only the newest dump of each stage in the capture is used, so a log holding
+several 'd' outputs shows the last one. Other lines are ignored.
+"""
+
+import argparse
+import sys
+
+BAR_WIDTH = 50
+
+
+class Stage:
+    def __init__(self, name, fields):
+        self.name = name
+        self.width, self.count, self.minimum, self.mean, self.p50, self.p99, self.maximum = \
+            (int(f) for f in fields)
+        self.buckets = []       # (centre_us, count)
+
+
+def parse(lines):
+    stages = {}
+    for line in lines:
+        fields = line.strip().split(",")
+        if fields[0] == "lat" and len(fields) == 9:
+            stages[fields[1]] = Stage(fields[1], fields[2:])
+        elif fields[0] == "latb" and len(fields) == 4 and fields[1] in stages:
+            stages[fields[1]].buckets.append((int(fields[2]), int(fields[3])))
+    return stages
+
+
+def print_stage(stage):
+    print("%-10s n=%-7d min=%-6d mean=%-6d p50=%-6d p99=%-6d max=%d us" % (
+        stage.name, stage.count, stage.minimum, stage.mean, stage.p50, stage.p99, stage.maximum))
+    peak = max(count for _, count in stage.buckets)
+    for centre, count in stage.buckets:
+        bar = "#" * max(1, count * BAR_WIDTH // peak)
+        print("  %7d %-*s %d" % (centre, BAR_WIDTH, bar, count))
+    print()
+
+
+def plot(stages, path):
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        sys.exit("--png needs matplotlib")
+
+    figure, axes = plt.subplots(len(stages), 1, figsize=(8, 2.2 * len(stages)), squeeze=False)
+    for axis, stage in zip(axes[:, 0], stages):
+        centres = [centre for centre, _ in stage.buckets]
+        counts = [count for _, count in stage.buckets]
+        axis.bar(centres, counts, width=stage.width * 0.9)
+        axis.set_title("%s  p50=%d p99=%d max=%d us" % (stage.name, stage.p50, stage.p99, stage.maximum),
+                       fontsize=9)
+        axis.set_xlabel("us", fontsize=8)
+    figure.tight_layout()
+    figure.savefig(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="serial log, stdin if omitted")
+    parser.add_argument("--png", help="write the histograms to this image (needs matplotlib)")
+    args = parser.parse_args()
+
+    if args.capture:
+        with open(args.capture, errors="replace") as capture:
+            stages = parse(capture)
+    else:
+        stages = parse(sys.stdin)
+    if not stages:
+        sys.exit("no latency dump found; switch the mode on with 'L' and send 'd'")
+
+    for stage in stages.values():
+        print_stage(stage)
+    if args.png:
+        plot(list(stages.values()), args.png)
+
+
+if __name__ == "__main__":
+    main()